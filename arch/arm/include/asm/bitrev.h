@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __ASM_BITREV_H
+#define __ASM_BITREV_H
+
+#include <linux/compiler.h>
+
+/* AArch64 only, see HAVE_ARCH_BITREVERSE */
+
+static __always_inline __attribute_const__ u64 __arch_bitrev64(u64 x)
+{
+	__asm__ ("rbit %0, %1" : "=r" (x) : "r" (x));
+	return x;
+}
+
+static __always_inline __attribute_const__ u32 __arch_bitrev32(u32 x)
+{
+	__asm__ ("rbit %w0, %w1" : "=r" (x) : "r" (x));
+	return x;
+}
+
+static __always_inline __attribute_const__ u16 __arch_bitrev16(u16 x)
+{
+	return __arch_bitrev32((u32)x) >> 16;
+}
+
+static __always_inline __attribute_const__ u8 __arch_bitrev8(u8 x)
+{
+	return __arch_bitrev32((u32)x) >> 24;
+}
+
+/* Reverse the bits of each byte, keeping the byte order */
+static __always_inline __attribute_const__ u64 __arch_bitrev8x8(u64 x)
+{
+	__asm__ ("rbit %0, %1\n\trev %0, %0" : "=r" (x) : "r" (x));
+	return x;
+}
+
+#endif
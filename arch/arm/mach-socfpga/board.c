@@ -49,6 +49,9 @@ int board_init(void)
 int dram_init_banksize(void)
 {
 	fdtdec_setup_memory_banksize();
+#if defined(CONFIG_ALTERA_SDRAM_ECC_LAZY) && !defined(CONFIG_SPL_BUILD)
+	sdram_ecc_lazy_hide(gd->bd);
+#endif
 
 	return 0;
 }
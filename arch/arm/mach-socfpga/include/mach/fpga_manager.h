@@ -8,6 +8,7 @@
 #define	_FPGA_MANAGER_H_
 
 #include <altera.h>
+#include <linux/errno.h>
 
 #if defined(CONFIG_TARGET_SOCFPGA_GEN5)
 #include <asm/arch/fpga_manager_gen5.h>
@@ -26,9 +27,60 @@
 /* Common prototypes */
 int fpgamgr_get_mode(void);
 int fpgamgr_poll_fpga_ready(void);
-void fpgamgr_program_write(const void *rbf_data, size_t rbf_size);
+int fpgamgr_program_write(const void *rbf_data, size_t rbf_size);
+int fpgamgr_program_write_start(const void *rbf_data, size_t rbf_size);
+int fpgamgr_program_write_wait(void);
 int fpgamgr_test_fpga_ready(void);
 int fpgamgr_dclkcnt_set(unsigned long cnt);
 
+/* Size of the SHA-256 digest identifying a loaded bitstream */
+#define FPGA_BITSTREAM_DIGEST_LEN		32
+
+#if CONFIG_IS_ENABLED(FPGA_SOCFPGA_SKIP_LOADED)
+bool fpgamgr_bitstream_loaded(size_t rbf_size, const u8 *digest);
+bool fpgamgr_bitstream_match(const void *rbf_data, size_t rbf_size);
+int fpgamgr_bitstream_digest(const void *rbf_data, size_t rbf_size, u8 *digest);
+void *fpgamgr_bitstream_hash_start(void);
+void fpgamgr_bitstream_hash_update(void *ctx, const void *data, size_t len);
+int fpgamgr_bitstream_hash_finish(void *ctx, u8 *digest);
+void fpgamgr_bitstream_save(size_t rbf_size, const u8 *digest);
+void fpgamgr_bitstream_forget(void);
+#else
+static inline bool fpgamgr_bitstream_loaded(size_t rbf_size,
+					    const u8 *digest)
+{
+	return false;
+}
+
+static inline bool fpgamgr_bitstream_match(const void *rbf_data,
+					   size_t rbf_size)
+{
+	return false;
+}
+
+static inline int fpgamgr_bitstream_digest(const void *rbf_data,
+					   size_t rbf_size, u8 *digest)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void *fpgamgr_bitstream_hash_start(void)
+{
+	return NULL;
+}
+
+static inline void fpgamgr_bitstream_hash_update(void *ctx, const void *data,
+						 size_t len) {}
+
+static inline int fpgamgr_bitstream_hash_finish(void *ctx, u8 *digest)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline void fpgamgr_bitstream_save(size_t rbf_size,
+					  const u8 *digest) {}
+static inline void fpgamgr_bitstream_forget(void) {}
+#endif
+
 #endif /* __ASSEMBLY__ */
 #endif /* _FPGA_MANAGER_H_ */
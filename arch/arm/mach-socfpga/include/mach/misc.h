@@ -39,6 +39,21 @@ void socfpga_init_security_policies(void);
 void socfpga_sdram_remap_zero(void);
 #endif
 
+#if defined(CONFIG_SPL_BUILD) && defined(CONFIG_SPL_SOCFPGA_SECONDARY_RUN)
+int socfpga_secondary_start(void (*entry)(unsigned int cpu));
+void socfpga_secondary_stop(void);
+#endif
+
+#ifdef CONFIG_ALTERA_SDRAM_ECC_LAZY
+void sdram_ecc_lazy_window(bd_t *bd, phys_addr_t *low_end,
+			   phys_addr_t *high_start);
+void sdram_ecc_lazy_set_pending(bool pending);
+void sdram_ecc_lazy_hide(bd_t *bd);
+int sdram_ecc_lazy_init(void);
+void sdram_ecc_lazy_step(void);
+int sdram_ecc_lazy_finish(void);
+#endif
+
 void do_bridge_reset(int enable, unsigned int mask);
 void socfpga_pl310_clear(void);
 
@@ -74,6 +74,33 @@ struct rsu_slot_info {
 	int priority;
 };
 
+/**
+ * struct rsu_delta_stats - delta programming statistics
+ * @skipped: sectors which already matched the new data
+ * @erased: sectors which had to be erased
+ * @written: sectors which had to be programmed
+ * @verified: sectors programmed, read back and found matching the new data
+ *
+ * This structure is used to report how much of a slot was actually changed
+ * by rsu_slot_program_buf_delta() and rsu_slot_program_buf_raw_delta()
+ */
+struct rsu_delta_stats {
+	u32 skipped;
+	u32 erased;
+	u32 written;
+	u32 verified;
+};
+
+/**
+ * typedef rsu_data_callback - producer of data to be programmed
+ * @buf: pointer to buffer to be filled
+ * @size: size of buffer
+ *
+ * Returns: bytes placed into the buffer, 0 at the end of data, or negative
+ * value on error
+ */
+typedef int (*rsu_data_callback)(void *buf, int size);
+
 /**
  * rsu_init() - initialize flash driver, SPT and CPB data
  * @filename: NULL for qspi
@@ -181,6 +208,104 @@ int rsu_slot_program_factory_update_buf(int slot, void *buf, int size);
  */
 int rsu_slot_program_buf_raw(int slot, void *buf, int size);
 
+/**
+ * rsu_slot_program_buf_delta() - program only the changed sectors of a slot
+ *                                from FPGA buffer data
+ * @slot: slot number
+ * @buf: pointer to data buffer
+ * @size: bytes to read from buffer
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to update a slot using FPGA config data from a
+ * buffer without erasing it first. Each erase sector is compared against
+ * the new data and only erased and programmed when it differs, then the
+ * slot is entered into CPB.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_buf_delta(int slot, void *buf, int size,
+			       struct rsu_delta_stats *stats);
+
+/**
+ * rsu_slot_program_buf_raw_delta() - program only the changed sectors of a
+ *                                    slot from raw buffer data
+ * @slot: slot number
+ * @buf: pointer to data buffer
+ * @size: bytes to read from buffer
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to update a slot using raw data from a buffer
+ * without erasing it first, the slot is not entered into CPB.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_buf_raw_delta(int slot, void *buf, int size,
+				   struct rsu_delta_stats *stats);
+
+/**
+ * rsu_slot_program_callback() - program a slot from FPGA data produced by a
+ *                               callback
+ * @slot: slot number
+ * @callback: callback function providing the data
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to program a slot as the data becomes available,
+ * one erase sector at a time, and then enter the slot into CPB. Only the
+ * changed sectors are erased and programmed.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_callback(int slot, rsu_data_callback callback,
+			      struct rsu_delta_stats *stats);
+
+/**
+ * rsu_slot_program_callback_raw() - program a slot from raw data produced by
+ *                                   a callback
+ * @slot: slot number
+ * @callback: callback function providing the data
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to program a slot as the raw data becomes
+ * available, the slot is not entered into CPB.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_callback_raw(int slot, rsu_data_callback callback,
+				  struct rsu_delta_stats *stats);
+
+/**
+ * rsu_slot_stream_open() - start programming a slot from pushed data
+ * @slot: slot number
+ * @rawdata: flag (raw data or not)
+ *
+ * This is the counterpart of rsu_slot_program_callback() for sources which
+ * push data, such as network or DFU transfers. Only one slot can be
+ * programmed at a time.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_stream_open(int slot, int rawdata);
+
+/**
+ * rsu_slot_stream_write() - program the next piece of data into the slot
+ * @buf: pointer to data buffer
+ * @size: bytes in the buffer
+ *
+ * Each time an erase sector worth of data has arrived it is programmed.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_stream_write(void *buf, int size);
+
+/**
+ * rsu_slot_stream_close() - finish programming the slot
+ * @abort: flag, stop programming after an error in the data source
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_stream_close(int abort, struct rsu_delta_stats *stats);
+
 /**
  * rsu_slot_verify_buf() - verify FPGA config data in a slot against a
  * buffer
@@ -25,6 +25,8 @@
  * @data.read: read data from flash device
  * @data.write: write date to flash device
  * @data.erase: erase date from flash device
+ * @data.erase_range: erase part of a slot, aligned to the sector size
+ * @data.sector_size: get the flash erase sector size
  * @fw_ops.load: inform firmware to load image
  * @fw_ops.status: get status from firmware
  * @fw_ops.notify: send notify command to firmware
@@ -52,6 +54,8 @@ struct rsu_ll_intf {
 		int (*read)(int part_num, int offset, int bytes, void *buf);
 		int (*write)(int part_num, int offset, int bytes, void *buf);
 		int (*erase)(int part_num);
+		int (*erase_range)(int part_num, int offset, int bytes);
+		int (*sector_size)(void);
 	} data;
 
 	struct {
@@ -41,12 +41,17 @@ enum rsu_log_level {
 	RSU_DEBUG
 };
 
-typedef int (*rsu_data_callback)(void *buf, int size);
 int rsu_cb_buf_init(void *buf, int size);
 void rsu_cb_buf_exit(void);
 int rsu_cb_buf(void *buf, int len);
 int rsu_cb_program_common(struct rsu_ll_intf *ll_intf, int slot,
 			  rsu_data_callback callback, int rawdata);
+int rsu_cb_program_delta_common(struct rsu_ll_intf *ll_intf, int slot,
+				rsu_data_callback callback, int rawdata,
+				struct rsu_delta_stats *stats);
+int rsu_stream_open(struct rsu_ll_intf *ll_intf, int slot, int rawdata);
+int rsu_stream_write(void *buf, int len);
+int rsu_stream_close(int abort, struct rsu_delta_stats *stats);
 int rsu_cb_verify_common(struct rsu_ll_intf *ll_intf, int slot,
 			 rsu_data_callback callback, int rawdata);
 
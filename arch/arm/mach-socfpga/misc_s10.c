@@ -157,6 +157,10 @@ int arch_early_init_r(void)
 {
 	socfpga_fpga_add(&altera_fpga[0]);
 
+#ifdef CONFIG_ALTERA_SDRAM_ECC_LAZY
+	sdram_ecc_lazy_init();
+#endif
+
 	return 0;
 }
 
@@ -178,5 +182,8 @@ void do_bridge_reset(int enable, unsigned int mask)
 
 void arch_preboot_os(void)
 {
+#ifdef CONFIG_ALTERA_SDRAM_ECC_LAZY
+	sdram_ecc_lazy_finish();
+#endif
 	mbox_hps_stage_notify(HPS_EXECUTION_STATE_OS);
 }
@@ -328,6 +328,199 @@ int rsu_slot_program_buf_raw(int slot, void *buf, int size)
 	return ret;
 }
 
+/**
+ * rsu_slot_program_buf_delta() - program only the changed sectors of a slot
+ *                                from FPGA buffer data
+ * @slot: slot number
+ * @buf: pointer to data buffer
+ * @size: bytes to read from buffer
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to update a slot using FPGA config data from a
+ * buffer without erasing it first, and then enter the slot into CPB.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_buf_delta(int slot, void *buf, int size,
+			       struct rsu_delta_stats *stats)
+{
+	int ret;
+
+	if (!ll_intf)
+		return -EINTF;
+
+	if (slot < 0 || slot >= rsu_slot_count()) {
+		rsu_log(RSU_ERR, "invalid slot number\n");
+		return -ESLOTNUM;
+	}
+
+	if (rsu_cb_buf_init(buf, size)) {
+		rsu_log(RSU_ERR, "Bad buf/size arguments\n");
+		return -EARGS;
+	}
+
+	ret = rsu_cb_program_delta_common(ll_intf, slot, rsu_cb_buf, 0,
+					  stats);
+	rsu_cb_buf_exit();
+	if (ret)
+		rsu_log(RSU_ERR, "fail to program buf data\n");
+
+	return ret;
+}
+
+/**
+ * rsu_slot_program_buf_raw_delta() - program only the changed sectors of a
+ *                                    slot from raw buffer data
+ * @slot: slot number
+ * @buf: pointer to data buffer
+ * @size: bytes to read from buffer
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to update a slot using raw data from a buffer
+ * without erasing it first, the slot is not entered into CPB.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_buf_raw_delta(int slot, void *buf, int size,
+				   struct rsu_delta_stats *stats)
+{
+	int ret;
+
+	if (!ll_intf)
+		return -EINTF;
+
+	if (slot < 0 || slot >= rsu_slot_count()) {
+		rsu_log(RSU_ERR, "invalid slot number\n");
+		return -ESLOTNUM;
+	}
+
+	if (rsu_cb_buf_init(buf, size)) {
+		rsu_log(RSU_ERR, "Bad buf/size arguments\n");
+		return -EARGS;
+	}
+
+	ret = rsu_cb_program_delta_common(ll_intf, slot, rsu_cb_buf, 1,
+					  stats);
+	rsu_cb_buf_exit();
+	if (ret)
+		rsu_log(RSU_ERR, "fail to program raw data\n");
+
+	return ret;
+}
+
+/**
+ * rsu_slot_program_callback() - program a slot from FPGA data produced by a
+ *                               callback
+ * @slot: slot number
+ * @callback: callback function providing the data
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to program a slot as the data becomes available,
+ * and then enter the slot into CPB.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_callback(int slot, rsu_data_callback callback,
+			      struct rsu_delta_stats *stats)
+{
+	int ret;
+
+	if (!ll_intf)
+		return -EINTF;
+
+	if (slot < 0 || slot >= rsu_slot_count()) {
+		rsu_log(RSU_ERR, "invalid slot number\n");
+		return -ESLOTNUM;
+	}
+
+	ret = rsu_cb_program_delta_common(ll_intf, slot, callback, 0, stats);
+	if (ret)
+		rsu_log(RSU_ERR, "fail to program data\n");
+
+	return ret;
+}
+
+/**
+ * rsu_slot_program_callback_raw() - program a slot from raw data produced by
+ *                                   a callback
+ * @slot: slot number
+ * @callback: callback function providing the data
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * This function is used to program a slot as the raw data becomes
+ * available, the slot is not entered into CPB.
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_program_callback_raw(int slot, rsu_data_callback callback,
+				  struct rsu_delta_stats *stats)
+{
+	int ret;
+
+	if (!ll_intf)
+		return -EINTF;
+
+	if (slot < 0 || slot >= rsu_slot_count()) {
+		rsu_log(RSU_ERR, "invalid slot number\n");
+		return -ESLOTNUM;
+	}
+
+	ret = rsu_cb_program_delta_common(ll_intf, slot, callback, 1, stats);
+	if (ret)
+		rsu_log(RSU_ERR, "fail to program raw data\n");
+
+	return ret;
+}
+
+/**
+ * rsu_slot_stream_open() - start programming a slot from pushed data
+ * @slot: slot number
+ * @rawdata: flag (raw data or not)
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_stream_open(int slot, int rawdata)
+{
+	if (!ll_intf)
+		return -EINTF;
+
+	if (slot < 0 || slot >= rsu_slot_count()) {
+		rsu_log(RSU_ERR, "invalid slot number\n");
+		return -ESLOTNUM;
+	}
+
+	return rsu_stream_open(ll_intf, slot, rawdata);
+}
+
+/**
+ * rsu_slot_stream_write() - program the next piece of data into the slot
+ * @buf: pointer to data buffer
+ * @size: bytes in the buffer
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_stream_write(void *buf, int size)
+{
+	if (!buf || size < 0) {
+		rsu_log(RSU_ERR, "Bad buf/size arguments\n");
+		return -EARGS;
+	}
+
+	return rsu_stream_write(buf, size);
+}
+
+/**
+ * rsu_slot_stream_close() - finish programming the slot
+ * @abort: flag, stop programming after an error in the data source
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * Returns: 0 on success, or error code
+ */
+int rsu_slot_stream_close(int abort, struct rsu_delta_stats *stats)
+{
+	return rsu_stream_close(abort, stats);
+}
+
 /**
  * rsu_slot_verify_buf() - verify FPGA config data in a slot
  * @slot: slot number
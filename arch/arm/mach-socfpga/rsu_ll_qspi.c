@@ -225,6 +225,28 @@ static int erase_part(int part_num)
 	return erase_dev(part_offset, spt.partition[part_num].length);
 }
 
+/**
+ * erase_part_range() - erase part of a selected partition data
+ * @part_num: the selected partition number
+ * @offset: the offset from which data will be erased
+ * @len: the size of data to be erased
+ *
+ * Return: 0 on success, or -ve for error
+ */
+static int erase_part_range(int part_num, u64 offset, int len)
+{
+	u64 part_offset;
+
+	if (get_part_offset(part_num, &part_offset))
+		return -1;
+
+	if (offset < 0 || len < 0 ||
+	    (offset + len) > spt.partition[part_num].length)
+		return -1;
+
+	return erase_dev(part_offset + offset, len);
+}
+
 /**
  * writeback_spt() - write back SPT
  *
@@ -921,6 +943,29 @@ static int data_erase(int part_num)
 	return erase_part(part_num);
 }
 
+/**
+ * data_erase_range() - erase part of the flash data of a partition
+ * @part_num: partition number
+ * @offset: offset from which data will be erased
+ * @bytes: data size in bytes which will be erased
+ *
+ * Return: 0 for success, or error code
+ */
+static int data_erase_range(int part_num, int offset, int bytes)
+{
+	return erase_part_range(part_num, offset, bytes);
+}
+
+/**
+ * data_sector_size() - get flash erase sector size
+ *
+ * Return: erase sector size in bytes
+ */
+static int data_sector_size(void)
+{
+	return flash->erase_size;
+}
+
 /**
  * image_load() - load production or factory image
  * @offset: the image offset
@@ -1003,6 +1048,8 @@ static struct rsu_ll_intf qspi_ll_intf = {
 	.data.read = data_read,
 	.data.write = data_write,
 	.data.erase = data_erase,
+	.data.erase_range = data_erase_range,
+	.data.sector_size = data_sector_size,
 
 	.fw_ops.load = image_load,
 	.fw_ops.status = status_log,
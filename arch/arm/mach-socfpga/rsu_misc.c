@@ -5,6 +5,8 @@
  */
 
 #include <common.h>
+#include <malloc.h>
+#include <linux/bitrev.h>
 #include <linux/compat.h>
 #include <linux/compiler.h>
 #include <linux/errno.h>
@@ -113,28 +115,6 @@ static int add_section(struct rsu_image_state *state, u64 section)
 	return 0;
 }
 
-/**
- * swap_bits() - swap bits
- * @data: pointer point to data
- * @len: data length
- */
-static void swap_bits(char *data, int len)
-{
-	int x, y;
-	char tmp;
-
-	for (x = 0; x < len; x++) {
-		tmp = 0;
-		for (y = 0; y < 8; y++) {
-			tmp <<= 1;
-			if (data[x] & 1)
-				tmp |= 1;
-			data[x] >>= 1;
-		}
-		data[x] = tmp;
-	}
-}
-
 /**
  * rsu_misc_is_rsvd_name() - check if a reserved name
  *
@@ -386,7 +366,7 @@ static int sig_block_adjust(struct rsu_image_state *state, void *block,
 	 * bit-swapped before they can used in zlib CRC32 library function.
 	 * The CRC value is stored in big endian in the bitstream.
 	 */
-	swap_bits(block, IMAGE_BLOCK_SZ);
+	bitrev8_buf(block, IMAGE_BLOCK_SZ);
 	calc_crc = crc32(0, (uchar *)block, SIG_BLOCK_CRC_OFFS);
 	if (be32_to_cpu(ptr_blk->crc) != calc_crc) {
 		rsu_log(RSU_ERR,
@@ -394,7 +374,7 @@ static int sig_block_adjust(struct rsu_image_state *state, void *block,
 			calc_crc, be32_to_cpu(ptr_blk->crc));
 		return -1;
 	}
-	swap_bits(block, IMAGE_BLOCK_SZ);
+	bitrev8_buf(block, IMAGE_BLOCK_SZ);
 
 	/* Check pointers */
 	for (x = 0; x < 4; x++) {
@@ -430,10 +410,10 @@ static int sig_block_adjust(struct rsu_image_state *state, void *block,
 	}
 
 	/* Update CRC in block */
-	swap_bits(block, IMAGE_BLOCK_SZ);
+	bitrev8_buf(block, IMAGE_BLOCK_SZ);
 	calc_crc = crc32(0, (uchar *)block, SIG_BLOCK_CRC_OFFS);
 	ptr_blk->crc = be32_to_cpu(calc_crc);
-	swap_bits(block, IMAGE_BLOCK_SZ);
+	bitrev8_buf(block, IMAGE_BLOCK_SZ);
 
 	return 0;
 }
@@ -498,10 +478,10 @@ static int sig_block_compare(struct rsu_image_state *state, void *ublock,
 				ptr_blk->ptrs[x] += info->offset;
 
 		/* Update CRC in block */
-		swap_bits(block, IMAGE_BLOCK_SZ);
+		bitrev8_buf(block, IMAGE_BLOCK_SZ);
 		calc_crc = crc32(0, (uchar *)block, SIG_BLOCK_CRC_OFFS);
 		ptr_blk->crc = be32_to_cpu(calc_crc);
-		swap_bits(block, IMAGE_BLOCK_SZ);
+		bitrev8_buf(block, IMAGE_BLOCK_SZ);
 	}
 
 	return block_compare(state, block, vblock);
@@ -703,6 +683,367 @@ int rsu_cb_program_common(struct rsu_ll_intf *ll_intf, int slot,
 	return 0;
 }
 
+/**
+ * is_blank() - check if data read from flash is erased
+ * @buf: pointer to data buffer
+ * @len: size of data buffer
+ *
+ * Return: 1 if all bytes are 0xFF, 0 otherwise
+ */
+static int is_blank(unsigned char *buf, int len)
+{
+	int x;
+
+	for (x = 0; x < len; x++)
+		if (buf[x] != 0xFF)
+			return 0;
+
+	return 1;
+}
+
+/**
+ * struct rsu_stream - state of a slot being programmed sector by sector
+ * @ll_intf: pointer to ll_intf
+ * @part_num: partition number of the slot
+ * @part_size: size of the slot
+ * @rawdata: flag (raw data or not)
+ * @in_cpb: the slot is still in CPB, it is taken out before its first change
+ * @sector: erase sector size
+ * @offset: slot offset of the sector being filled
+ * @fill: bytes of new data in the sector being filled
+ * @buf: sector being filled with new data
+ * @vbuf: sector read back from flash
+ * @info: slot information
+ * @state: image block state machine state
+ * @stats: delta programming statistics
+ *
+ * The slot is programmed as the data arrives: each time a sector worth of
+ * data is available it is compared against flash, and erased, programmed
+ * and verified if needed, before more data is requested.
+ */
+struct rsu_stream {
+	struct rsu_ll_intf *ll_intf;
+	int part_num;
+	int part_size;
+	int rawdata;
+	int in_cpb;
+	int sector;
+	int offset;
+	int fill;
+	unsigned char *buf;
+	unsigned char *vbuf;
+	struct rsu_slot_info info;
+	struct rsu_image_state state;
+	struct rsu_delta_stats stats;
+};
+
+static struct rsu_stream stream;
+
+/**
+ * stream_sector() - commit the sector being filled to flash
+ *
+ * The new data in the sector is followed by erased bytes up to the end of
+ * the sector. A sector matching flash already is left alone, others are
+ * erased unless already blank, programmed and read back right away. The
+ * slot is taken out of CPB before the first sector is changed.
+ *
+ * Return: 0 on success, or error code
+ */
+static int stream_sector(void)
+{
+	struct rsu_stream *s = &stream;
+	int cnt = s->fill;
+	int len = s->sector;
+	int x;
+
+	if (!s->rawdata)
+		for (x = 0; x < cnt; x += IMAGE_BLOCK_SZ)
+			if (rsu_misc_image_block_process(&s->state, s->buf + x,
+							 NULL, &s->info))
+				return -EPROGRAM;
+
+	/* Past the end of the data the slot is expected erased */
+	memset(s->buf + cnt, 0xFF, len - cnt);
+
+	if (s->ll_intf->data.read(s->part_num, s->offset, len, s->vbuf))
+		return -ELOWLEVEL;
+
+	if (!memcmp(s->buf, s->vbuf, len)) {
+		s->stats.skipped++;
+		goto next;
+	}
+
+	/* The slot contents are going to change under the firmware */
+	if (s->in_cpb) {
+		if (s->ll_intf->priority.remove(s->part_num))
+			return -ELOWLEVEL;
+		s->in_cpb = 0;
+	}
+
+	if (!is_blank(s->vbuf, len)) {
+		if (s->ll_intf->data.erase_range(s->part_num, s->offset, len))
+			return -ELOWLEVEL;
+		s->stats.erased++;
+	}
+
+	if (!cnt)
+		goto next;
+
+	if (s->ll_intf->data.write(s->part_num, s->offset, cnt, s->buf) ||
+	    s->ll_intf->data.read(s->part_num, s->offset, cnt, s->vbuf))
+		return -ELOWLEVEL;
+	s->stats.written++;
+
+	for (x = 0; x < cnt; x++)
+		if (s->vbuf[x] != s->buf[x]) {
+			rsu_log(RSU_DEBUG,
+				"Expect %02X, got %02X @ 0x%08X\n",
+				s->buf[x], s->vbuf[x], s->offset + x);
+			return -ECMP;
+		}
+	s->stats.verified++;
+
+next:
+	s->offset += len;
+	s->fill = 0;
+
+	return 0;
+}
+
+/**
+ * stream_commit() - account for new data placed in the sector being filled
+ * @len: bytes added at stream.buf + stream.fill
+ *
+ * Return: 0 on success, or error code
+ */
+static int stream_commit(int len)
+{
+	struct rsu_stream *s = &stream;
+
+	s->fill += len;
+	if (s->fill < s->sector)
+		return 0;
+
+	return stream_sector();
+}
+
+/**
+ * rsu_stream_open() - start programming a slot as data arrives
+ * @ll_intf: pointer to ll_intf
+ * @slot: slot number
+ * @rawdata: flag (raw data or not)
+ *
+ * The slot does not need to be erased first, only the sectors which change
+ * are erased and programmed, see stream_sector().
+ *
+ * Return 0 if success, or error code
+ */
+int rsu_stream_open(struct rsu_ll_intf *ll_intf, int slot, int rawdata)
+{
+	struct rsu_stream *s = &stream;
+	int part_num;
+
+	if (!ll_intf)
+		return -EINTF;
+
+	if (slot < 0)
+		return -ESLOTNUM;
+
+	if (s->ll_intf) {
+		rsu_log(RSU_ERR, "Slot programming already in progress\n");
+		return -EPROGRAM;
+	}
+
+	if (rsu_misc_writeprotected(slot)) {
+		rsu_log(RSU_ERR,
+			"Trying to program a write protected slot\n");
+		return -EWRPROT;
+	}
+
+	memset(s, 0, sizeof(*s));
+	if (rsu_slot_get_info(slot, &s->info)) {
+		rsu_log(RSU_ERR, "Unable to read slot info\n");
+		return -ESLOTNUM;
+	}
+
+	part_num = rsu_misc_slot2part(ll_intf, slot);
+	if (part_num < 0)
+		return -ESLOTNUM;
+
+	s->sector = ll_intf->data.sector_size();
+	if (s->sector <= 0 || s->sector % IMAGE_BLOCK_SZ ||
+	    s->info.offset % s->sector || s->info.size % s->sector) {
+		rsu_log(RSU_ERR, "Slot not aligned to erase sectors\n");
+		return -EARGS;
+	}
+
+	if (ll_intf->priority.get(part_num) > 0) {
+		if (rawdata) {
+			rsu_log(RSU_ERR,
+				"Trying to program a slot already in use\n");
+			return -EPROGRAM;
+		}
+
+		s->in_cpb = 1;
+	}
+
+	if (rsu_misc_image_block_init(&s->state))
+		return -EPROGRAM;
+
+	s->buf = malloc(s->sector);
+	s->vbuf = malloc(s->sector);
+	if (!s->buf || !s->vbuf) {
+		free(s->vbuf);
+		free(s->buf);
+		return -ENOMEM;
+	}
+
+	s->ll_intf = ll_intf;
+	s->part_num = part_num;
+	s->part_size = s->info.size;
+	s->rawdata = rawdata;
+
+	return 0;
+}
+
+/**
+ * rsu_stream_write() - program the next piece of data into the slot
+ * @buf: pointer to data buffer
+ * @len: size of data buffer
+ *
+ * Return 0 if success, or error code
+ */
+int rsu_stream_write(void *buf, int len)
+{
+	struct rsu_stream *s = &stream;
+	char *data = buf;
+	int chunk, ret;
+
+	if (!s->ll_intf)
+		return -EINTF;
+
+	while (len > 0) {
+		if (s->offset >= s->part_size) {
+			rsu_log(RSU_ERR,
+				"Trying to program too much data into slot\n");
+			return -ESIZE;
+		}
+
+		chunk = min(len, s->sector - s->fill);
+		memcpy(s->buf + s->fill, data, chunk);
+		ret = stream_commit(chunk);
+		if (ret)
+			return ret;
+
+		data += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+/**
+ * rsu_stream_close() - finish programming the slot
+ * @abort: flag, stop without programming the rest of the slot
+ * @stats: pointer to statistics to be filled in, or NULL
+ *
+ * Commit the last partial sector, make sure the rest of the slot is erased
+ * and for FPGA data enter the slot into CPB, unless it never left it as no
+ * sector changed. An aborted slot is left out of CPB if it was changed.
+ *
+ * Return 0 if success, or error code
+ */
+int rsu_stream_close(int abort, struct rsu_delta_stats *stats)
+{
+	struct rsu_stream *s = &stream;
+	int ret = 0;
+
+	if (!s->ll_intf)
+		return -EINTF;
+
+	while (!abort && !ret && s->offset < s->part_size)
+		ret = stream_sector();
+
+	if (!abort && !ret) {
+		rsu_log(RSU_DEBUG,
+			"%u sectors skipped, %u erased, %u written, %u verified\n",
+			s->stats.skipped, s->stats.erased, s->stats.written,
+			s->stats.verified);
+
+		if (!s->rawdata && !s->in_cpb &&
+		    s->ll_intf->priority.add(s->part_num))
+			ret = -ELOWLEVEL;
+	}
+
+	if (stats)
+		*stats = s->stats;
+
+	free(s->vbuf);
+	free(s->buf);
+	s->ll_intf = NULL;
+
+	return ret;
+}
+
+/**
+ * rsu_cb_program_delta_common() - callback to program only changed sectors
+ * @ll_intf: pointer to ll_intf
+ * @slot: slot number
+ * @callback: callback function pointer
+ * @rawdata: flag (raw data or not)
+ * @stats: pointer to statistics, or NULL
+ *
+ * The callback fills the sector buffer directly, and each sector is
+ * committed to flash as soon as it is full.
+ *
+ * Return 0 if success, or error code
+ */
+int rsu_cb_program_delta_common(struct rsu_ll_intf *ll_intf, int slot,
+				rsu_data_callback callback, int rawdata,
+				struct rsu_delta_stats *stats)
+{
+	struct rsu_stream *s = &stream;
+	int c, ret;
+
+	if (!callback)
+		return -EARGS;
+
+	ret = rsu_stream_open(ll_intf, slot, rawdata);
+	if (ret)
+		return ret;
+
+	for (;;) {
+		if (s->offset >= s->part_size) {
+			/* Anything more does not fit into the slot */
+			c = callback(s->vbuf, 1);
+			if (c > 0) {
+				rsu_log(RSU_ERR,
+					"Trying to program too much data into slot\n");
+				ret = -ESIZE;
+			} else if (c < 0) {
+				ret = -ECALLBACK;
+			}
+			break;
+		}
+
+		c = callback(s->buf + s->fill, s->sector - s->fill);
+		if (c == 0)
+			break;
+		if (c < 0) {
+			ret = -ECALLBACK;
+			break;
+		}
+
+		ret = stream_commit(c);
+		if (ret)
+			break;
+	}
+
+	c = rsu_stream_close(ret, stats);
+
+	return ret ? ret : c;
+}
+
 /**
  * rsu_cb_verify_common() - callback for data verification
  * @ll_intf: pointer to ll_intf
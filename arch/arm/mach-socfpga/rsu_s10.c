@@ -5,6 +5,10 @@
  */
 
 #include <common.h>
+#include <fs.h>
+#include <net.h>
+#include <net/tftp.h>
+#include <watchdog.h>
 #include <linux/errno.h>
 #include <asm/arch/mailbox_s10.h>
 #include <asm/arch/rsu.h>
@@ -506,6 +510,143 @@ static int slot_program_buf_raw(int argc, char * const argv[])
 	return CMD_RET_SUCCESS;
 }
 
+static int slot_program_buf_delta(int argc, char * const argv[])
+{
+	struct rsu_delta_stats stats;
+	int slot;
+	char *endp;
+	u64 address;
+	int size;
+	int ret;
+	int raw;
+
+	if (argc != 4)
+		return CMD_RET_USAGE;
+
+	if (!initialized) {
+		if (rsu_init(NULL))
+			return CMD_RET_FAILURE;
+
+		initialized = 1;
+	}
+
+	raw = !strcmp(argv[0], "slot_program_buf_raw_delta");
+	slot = simple_strtoul(argv[1], &endp, 16);
+	address = simple_strtoul(argv[2], &endp, 16);
+	size = simple_strtoul(argv[3], &endp, 16);
+
+	if (raw)
+		ret = rsu_slot_program_buf_raw_delta(slot, (void *)address,
+						     size, &stats);
+	else
+		ret = rsu_slot_program_buf_delta(slot, (void *)address, size,
+						 &stats);
+	if (ret)
+		return CMD_RET_FAILURE;
+
+	printf("Slot %d was updated with %sbuffer=0x%08x%08x size=%d.\n",
+	       slot, raw ? "raw " : "", upper_32_bits(address),
+	       lower_32_bits(address), size);
+	printf("Sectors: %u skipped, %u erased, %u written, %u verified.\n",
+	       stats.skipped, stats.erased, stats.written, stats.verified);
+
+	return CMD_RET_SUCCESS;
+}
+
+static int rsu_stream_push(void *priv, const void *buf, size_t len)
+{
+	WATCHDOG_RESET();
+
+	return rsu_slot_stream_write((void *)buf, len);
+}
+
+static int slot_program_fs(int argc, char * const argv[])
+{
+	struct rsu_delta_stats stats;
+	loff_t size;
+	int slot;
+	char *endp;
+	int ret;
+	int raw;
+
+	if (argc != 5)
+		return CMD_RET_USAGE;
+
+	if (!initialized) {
+		if (rsu_init(NULL))
+			return CMD_RET_FAILURE;
+
+		initialized = 1;
+	}
+
+	raw = !strcmp(argv[0], "slot_program_fs_raw");
+	slot = simple_strtoul(argv[1], &endp, 16);
+
+	if (fs_set_blk_dev(argv[2], argv[3], FS_TYPE_ANY))
+		return CMD_RET_FAILURE;
+
+	if (rsu_slot_stream_open(slot, raw))
+		return CMD_RET_FAILURE;
+
+	/* The file is opened once and each chunk goes straight to flash */
+	ret = fs_read_stream(argv[4], 0, 0, rsu_stream_push, NULL, &size);
+	if (ret)
+		printf("Failed to read %s\n", argv[4]);
+
+	if (rsu_slot_stream_close(ret != 0, &stats) || ret)
+		return CMD_RET_FAILURE;
+
+	printf("Slot %d was programmed with %s%s size=%lld.\n", slot,
+	       raw ? "raw " : "", argv[4], size);
+	printf("Sectors: %u skipped, %u erased, %u written, %u verified.\n",
+	       stats.skipped, stats.erased, stats.written, stats.verified);
+
+	return CMD_RET_SUCCESS;
+}
+
+#ifdef CONFIG_CMD_NET
+static int slot_program_tftp(int argc, char * const argv[])
+{
+	struct rsu_delta_stats stats;
+	int slot;
+	char *endp;
+	int ret;
+	int raw;
+
+	if (argc != 3)
+		return CMD_RET_USAGE;
+
+	if (!initialized) {
+		if (rsu_init(NULL))
+			return CMD_RET_FAILURE;
+
+		initialized = 1;
+	}
+
+	raw = !strcmp(argv[0], "slot_program_tftp_raw");
+	slot = simple_strtoul(argv[1], &endp, 16);
+	copy_filename(net_boot_file_name, argv[2], sizeof(net_boot_file_name));
+
+	if (rsu_slot_stream_open(slot, raw))
+		return CMD_RET_FAILURE;
+
+	/* Each block goes to flash as it arrives; nothing is buffered */
+	tftp_set_consumer(rsu_stream_push, NULL);
+	ret = net_loop(TFTPGET);
+	tftp_set_consumer(NULL, NULL);
+
+	if (rsu_slot_stream_close(ret < 0, &stats) || ret < 0)
+		return CMD_RET_FAILURE;
+
+	printf("Slot %d was programmed with %s%s size=%d.\n", slot,
+	       raw ? "raw " : "", argv[2], ret);
+	printf("Sectors: %u skipped, %u erased, %u written, %u verified.\n",
+	       stats.skipped, stats.erased, stats.written, stats.verified);
+
+	return CMD_RET_SUCCESS;
+}
+#endif
+
 static int slot_verify_buf(int argc, char * const argv[])
 {
 	int slot;
@@ -812,8 +953,16 @@ static const struct func_t rsu_func_t[] = {
 	{"slot_load_factory", slot_load_factory},
 	{"slot_priority", slot_priority},
 	{"slot_program_buf", slot_program_buf},
+	{"slot_program_buf_delta", slot_program_buf_delta},
 	{"slot_program_buf_raw", slot_program_buf_raw},
+	{"slot_program_buf_raw_delta", slot_program_buf_delta},
 	{"slot_program_factory_update_buf", slot_program_factory_update_buf},
+	{"slot_program_fs", slot_program_fs},
+	{"slot_program_fs_raw", slot_program_fs},
+#ifdef CONFIG_CMD_NET
+	{"slot_program_tftp", slot_program_tftp},
+	{"slot_program_tftp_raw", slot_program_tftp},
+#endif
 	{"slot_rename", slot_rename},
 	{"slot_size", slot_size},
 	{"slot_verify_buf", slot_verify_buf},
@@ -846,7 +995,7 @@ int do_rsu(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 }
 
 U_BOOT_CMD(
-	rsu, 5, 1, do_rsu,
+	rsu, 6, 1, do_rsu,
 	"SoCFPGA Stratix10 SoC Remote System Update",
 	"dtb   - Update Linux DTB qspi-boot parition offset with spt0 value\n"
 	"list  - List down the available bitstreams in flash\n"
@@ -860,8 +1009,16 @@ U_BOOT_CMD(
 	"slot_load_factory - load factory immediately\n"
 	"slot_priority <slot> - display slot priority\n"
 	"slot_program_buf <slot> <buffer> <size> - program buffer into slot, and make it highest priority\n"
+	"slot_program_buf_delta <slot> <buffer> <size> - program only the changed sectors of slot from buffer, and make it highest priority\n"
 	"slot_program_buf_raw <slot> <buffer> <size> - program raw buffer into slot\n"
+	"slot_program_buf_raw_delta <slot> <buffer> <size> - program only the changed sectors of slot from raw buffer\n"
 	"slot_program_factory_update_buf <slot> <buffer> <size> - program factory update buffer into slot, and make it highest priority\n"
+	"slot_program_fs <slot> <interface> <dev[:part]> <filename> - program file into slot while reading it, and make it highest priority\n"
+	"slot_program_fs_raw <slot> <interface> <dev[:part]> <filename> - program raw file into slot while reading it\n"
+#ifdef CONFIG_CMD_NET
+	"slot_program_tftp <slot> <filename> - program file into slot while downloading it with TFTP, and make it highest priority\n"
+	"slot_program_tftp_raw <slot> <filename> - program raw file into slot while downloading it with TFTP\n"
+#endif
 	"slot_rename <slot> <name> - rename slot\n"
 	"slot_size <slot> - display slot size\n"
 	"slot_verify_buf <slot> <buffer> <size> - verify slot contents against buffer\n"
@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Lazy SDRAM ECC initialization for Stratix 10 and Agilex
+ *
+ * SPL only initializes the ECC bits of the start of the first bank, where
+ * U-Boot, the FIT and the kernel are loaded, and of its end, where SPL
+ * keeps its BSS and malloc area and U-Boot relocates to.
+ *
+ * U-Boot hides the rest from the bank info before relocation, so none of
+ * its allocators (bootm, EFI) ever hands it out and no memory map passed on
+ * describes it. It is tracked as reserved regions of an LMB, initialized a
+ * step at a time while the console is idle and at the latest when a device
+ * tree is fixed up for the OS, and only then added back to the banks.
+ */
+
+#include <common.h>
+#include <efi_loader.h>
+#include <fdt_support.h>
+#include <fdtdec.h>
+#include <lmb.h>
+#include <watchdog.h>
+#include <asm/io.h>
+#include <asm/arch/misc.h>
+#include <asm/arch/system_manager.h>
+#include <linux/sizes.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Kept in a cold reset scratch register until all of SDRAM is initialized */
+#define SDRAM_ECC_LAZY_MAGIC	0x45434370
+
+static struct socfpga_system_manager *sysmgr_regs =
+	(struct socfpga_system_manager *)SOCFPGA_SYSMGR_ADDRESS;
+
+/*
+ * Get the end of the window SPL initializes at the start of the first bank,
+ * and the start of the one at its end.
+ */
+void sdram_ecc_lazy_window(bd_t *bd, phys_addr_t *low_end,
+			   phys_addr_t *high_start)
+{
+	phys_addr_t start = bd->bi_dram[0].start;
+	phys_size_t size = bd->bi_dram[0].size;
+
+	*low_end = start + min_t(phys_size_t, size,
+				 CONFIG_ALTERA_SDRAM_ECC_LAZY_LOW);
+	*high_start = start + size -
+		      min_t(phys_size_t, size,
+			    CONFIG_ALTERA_SDRAM_ECC_LAZY_HIGH);
+	if (*high_start < *low_end)
+		*high_start = *low_end;
+}
+
+void sdram_ecc_lazy_set_pending(bool pending)
+{
+	writel(pending ? SDRAM_ECC_LAZY_MAGIC : 0,
+	       &sysmgr_regs->boot_scratch_cold3);
+}
+
+#ifndef CONFIG_SPL_BUILD
+/* The memory left to initialize, as the reserved regions */
+static struct lmb ecc_pending;
+/* The memory hidden from the banks, to add back once initialized */
+static struct lmb_region ecc_hidden;
+
+/*
+ * Leave only the windows SPL initialized in the bank info, the start one as
+ * the first bank and the end one as the second. Called before relocation,
+ * so there is no state but the scratch register.
+ */
+void sdram_ecc_lazy_hide(bd_t *bd)
+{
+	phys_addr_t low_end, high_start, end;
+	int bank;
+
+	if (readl(&sysmgr_regs->boot_scratch_cold3) != SDRAM_ECC_LAZY_MAGIC)
+		return;
+
+	sdram_ecc_lazy_window(bd, &low_end, &high_start);
+	end = bd->bi_dram[0].start + bd->bi_dram[0].size;
+
+	bd->bi_dram[0].size = low_end - bd->bi_dram[0].start;
+	bd->bi_dram[1].start = high_start;
+	bd->bi_dram[1].size = end - high_start;
+	for (bank = 2; bank < CONFIG_NR_DRAM_BANKS; bank++)
+		bd->bi_dram[bank].size = 0;
+}
+
+/* Use DC ZVA instruction to clear memory to zeros by a cache line */
+static void sdram_ecc_clear(phys_addr_t addr, phys_size_t size)
+{
+	phys_addr_t end = addr + size;
+	phys_size_t step;
+
+	while (addr < end) {
+		step = min_t(phys_size_t, end - addr, SZ_64M);
+		for (; step; step -= CONFIG_SYS_CACHELINE_SIZE) {
+			asm volatile("dc zva, %0" : : "r"(addr) : "memory");
+			addr += CONFIG_SYS_CACHELINE_SIZE;
+		}
+		WATCHDOG_RESET();
+	}
+}
+
+static void sdram_ecc_pending_done(void)
+{
+#ifdef CONFIG_EFI_LOADER
+	int i;
+#endif
+
+	if (ecc_pending.reserved.cnt)
+		return;
+
+	/* Hand the memory out only now that nothing will clear it */
+	if (ecc_hidden.cnt) {
+		fdtdec_setup_memory_banksize();
+#ifdef CONFIG_EFI_LOADER
+		for (i = 0; i < ecc_hidden.cnt; i++)
+			efi_add_memory_map(ecc_hidden.region[i].base,
+					   ecc_hidden.region[i].size >>
+					   EFI_PAGE_SHIFT,
+					   EFI_CONVENTIONAL_MEMORY, false);
+#endif
+		ecc_hidden.cnt = 0;
+	}
+
+	sdram_ecc_lazy_set_pending(false);
+	debug("SDRAM-ECC: Initialization completed\n");
+}
+
+/* Pick up the memory SPL left uninitialized, if any */
+int sdram_ecc_lazy_init(void)
+{
+	phys_addr_t low_end, high_start;
+	int bank;
+
+	lmb_init(&ecc_pending);
+
+	if (readl(&sysmgr_regs->boot_scratch_cold3) != SDRAM_ECC_LAZY_MAGIC)
+		return 0;
+
+	/* The window layout is derived from the real banks */
+	fdtdec_setup_memory_banksize();
+	sdram_ecc_lazy_window(gd->bd, &low_end, &high_start);
+	if (high_start > low_end)
+		lmb_reserve(&ecc_pending, low_end, high_start - low_end);
+
+	for (bank = 1; bank < CONFIG_NR_DRAM_BANKS; bank++) {
+		if (gd->bd->bi_dram[bank].size)
+			lmb_reserve(&ecc_pending, gd->bd->bi_dram[bank].start,
+				    gd->bd->bi_dram[bank].size);
+	}
+
+	if (ecc_pending.reserved.cnt) {
+		ecc_hidden = ecc_pending.reserved;
+		sdram_ecc_lazy_hide(gd->bd);
+	}
+	sdram_ecc_pending_done();
+
+	return 0;
+}
+
+/* Initialize whatever is left of [addr, addr + size) */
+static void sdram_ecc_ensure(phys_addr_t addr, phys_size_t size)
+{
+	struct lmb_region *rgn = &ecc_pending.reserved;
+	phys_addr_t end = addr + size;
+	phys_addr_t base, top;
+	int i;
+
+	for (i = 0; i < rgn->cnt; ) {
+		base = max(addr, rgn->region[i].base);
+		top = min(end, rgn->region[i].base + rgn->region[i].size);
+		if (base >= top) {
+			i++;
+			continue;
+		}
+
+		/* Region bounds are cache line aligned */
+		base = rounddown(base, CONFIG_SYS_CACHELINE_SIZE);
+		top = roundup(top, CONFIG_SYS_CACHELINE_SIZE);
+		sdram_ecc_clear(base, top - base);
+
+		/* This may split or drop the region, look at it again */
+		lmb_free(&ecc_pending, base, top - base);
+	}
+
+	sdram_ecc_pending_done();
+}
+
+/* Initialize the next CONFIG_ALTERA_SDRAM_ECC_LAZY_STEP bytes left */
+void sdram_ecc_lazy_step(void)
+{
+	struct lmb_region *rgn = &ecc_pending.reserved;
+
+	if (!rgn->cnt)
+		return;
+
+	sdram_ecc_ensure(rgn->region[0].base,
+			 min_t(phys_size_t, rgn->region[0].size,
+			       CONFIG_ALTERA_SDRAM_ECC_LAZY_STEP));
+}
+
+/*
+ * Initialize everything left and add it back to the banks. Returns whether
+ * there was anything left.
+ */
+int sdram_ecc_lazy_finish(void)
+{
+	struct lmb_region *rgn = &ecc_pending.reserved;
+	unsigned long start;
+
+	if (!rgn->cnt)
+		return 0;
+
+	start = get_timer(0);
+	while (rgn->cnt)
+		sdram_ecc_ensure(rgn->region[0].base, rgn->region[0].size);
+
+	printf("SDRAM-ECC: Finished initialization in %lu ms\n",
+	       get_timer(start));
+
+	return 1;
+}
+
+/*
+ * Every device tree handed over, by bootm and bootefi alike, is fixed up
+ * here. The memory node was written from the banks with the memory still
+ * hidden, rewrite it with all of it.
+ */
+int ft_system_setup(void *blob, bd_t *bd)
+{
+	u64 start[CONFIG_NR_DRAM_BANKS];
+	u64 size[CONFIG_NR_DRAM_BANKS];
+	int bank;
+#ifdef CONFIG_EFI_LOADER
+	u64 addr, len;
+	int i;
+#endif
+
+	if (!sdram_ecc_lazy_finish())
+		return 0;
+
+#ifdef CONFIG_EFI_LOADER
+	/* bootefi carved these out before the memory was added to its map */
+	for (i = 0; i < fdt_num_mem_rsv(blob); i++) {
+		if (fdt_get_mem_rsv(blob, i, &addr, &len))
+			continue;
+		len = efi_size_in_pages(len + (addr & EFI_PAGE_MASK));
+		efi_add_memory_map(addr & ~EFI_PAGE_MASK, len,
+				   EFI_RESERVED_MEMORY_TYPE, false);
+	}
+#endif
+
+	for (bank = 0; bank < CONFIG_NR_DRAM_BANKS; bank++) {
+		start[bank] = bd->bi_dram[bank].start;
+		size[bank] = bd->bi_dram[bank].size;
+	}
+
+	return fdt_fixup_memory_banks(blob, start, size,
+				      CONFIG_NR_DRAM_BANKS);
+}
+
+#ifdef CONFIG_CMD_GO
+/* The application may use any memory, no matter what it is told */
+unsigned long do_go_exec(ulong (*entry)(int, char * const []), int argc,
+			 char * const argv[])
+{
+	sdram_ecc_lazy_finish();
+
+	return entry(argc, argv);
+}
+#endif
+
+#ifdef CONFIG_SHOW_ACTIVITY
+/*
+ * Called with 0 while the command line waits for input, and with 1 from the
+ * network loop, which is left alone so as not to slow down transfers.
+ */
+void show_activity(int arg)
+{
+	if (!arg)
+		sdram_ecc_lazy_step();
+}
+#endif
+#endif
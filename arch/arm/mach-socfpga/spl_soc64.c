@@ -12,6 +12,7 @@
 #include <dm.h>
 #include <dm/ofnode.h>
 #include <image.h>
+#include <malloc.h>
 #include <spl.h>
 #include <asm/arch/ccu_agilex.h>
 #include <asm/arch/clock_manager.h>
@@ -22,6 +23,7 @@
 #include <asm/arch/smmu_s10.h>
 #include <watchdog.h>
 #include <dm/uclass.h>
+#include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -86,3 +88,79 @@ u32 spl_boot_mode(const u32 boot_device)
 #endif
 }
 #endif
+
+#if CONFIG_IS_ENABLED(SOCFPGA_SECONDARY_RUN)
+#define SECONDARY_STACK_SIZE	SZ_1K
+
+/*
+ * The secondary CPUs read these from lowlevel_init with their MMU off, so
+ * they are kept in OCRAM (.bss is in SDRAM) and flushed on every update.
+ * Every socfpga_secondary_start() counts a new kick, a kick which is not
+ * counted is the one from U-Boot that releases them for good.
+ */
+u64 socfpga_secondary_kicks __section(.data);
+u64 socfpga_secondary_entry __section(.data);
+u64 socfpga_secondary_sp[CONFIG_ARMV8_PSCI_NR_CPUS] __section(.data);
+
+/*
+ * Make the secondary CPUs parked in lowlevel_init call @entry with their
+ * CPU number, on a small stack of their own and with the MMU and caches
+ * off. They go back to waiting for a kick once @entry returns. They take
+ * no part in coherency: the boot CPU has to clean or invalidate whatever
+ * it shares with them around every access, and what they write must not
+ * share a cache line with anything the boot CPU writes.
+ *
+ * The stacks come from the pre-relocation malloc() area, which is in OCRAM
+ * as SDRAM may not be usable yet (or is being cleared). Return -ENOMEM if
+ * there is no room for them, the boot CPU then has to do all the work.
+ */
+int socfpga_secondary_start(void (*entry)(unsigned int cpu))
+{
+	const size_t size = (CONFIG_ARMV8_PSCI_NR_CPUS - 1) *
+			    SECONDARY_STACK_SIZE;
+	static u8 *stacks;
+	int cpu;
+
+	/* CPU0 keeps its own stack */
+	if (!stacks)
+		stacks = memalign(CONFIG_SYS_CACHELINE_SIZE, size);
+	if (!stacks)
+		return -ENOMEM;
+
+	/* Nothing of the stacks may be written back while they are used */
+	flush_dcache_range((ulong)stacks, (ulong)stacks + size);
+
+	for (cpu = 1; cpu < CONFIG_ARMV8_PSCI_NR_CPUS; cpu++)
+		socfpga_secondary_sp[cpu] =
+			(u64)(stacks + cpu * SECONDARY_STACK_SIZE);
+	socfpga_secondary_entry = (u64)entry;
+	socfpga_secondary_kicks++;
+
+	flush_dcache_range((ulong)socfpga_secondary_sp,
+			   (ulong)socfpga_secondary_sp +
+			   sizeof(socfpga_secondary_sp));
+	flush_dcache_range((ulong)&socfpga_secondary_entry,
+			   (ulong)&socfpga_secondary_entry +
+			   sizeof(socfpga_secondary_entry));
+	flush_dcache_range((ulong)&socfpga_secondary_kicks,
+			   (ulong)&socfpga_secondary_kicks +
+			   sizeof(socfpga_secondary_kicks));
+
+	/* Release them from gic_wait_for_interrupt */
+	smp_kick_all_cpus();
+
+	return 0;
+}
+
+/*
+ * Stop handing out work, a secondary CPU released late goes back to
+ * waiting without running it.
+ */
+void socfpga_secondary_stop(void)
+{
+	socfpga_secondary_entry = 0;
+	flush_dcache_range((ulong)&socfpga_secondary_entry,
+			   (ulong)&socfpga_secondary_entry +
+			   sizeof(socfpga_secondary_entry));
+}
+#endif
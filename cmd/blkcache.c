@@ -12,29 +12,46 @@
 static int blkc_show(cmd_tbl_t *cmdtp, int flag,
 		     int argc, char * const argv[])
 {
+	struct block_cache_dev_stats dev;
 	struct block_cache_stats stats;
+	int i;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
 	       "entries: %u\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
+	       "max cache entries: %u\n"
+	       "ways: %u\n"
+	       "read-ahead blocks: %u\n",
 	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       stats.max_blocks_per_entry, stats.max_entries,
+	       stats.ways, stats.read_ahead);
+
+	for (i = 0; !blkcache_dev_stats(i, &dev); i++)
+		printf("%s %d: hits %u, misses %u, read ahead %u blocks, %u hits\n",
+		       blk_get_if_type_name(dev.iftype), dev.devnum,
+		       dev.hits, dev.misses, dev.read_ahead_blocks,
+		       dev.read_ahead_hits);
 	return 0;
 }
 
 static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 			  int argc, char * const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	struct block_cache_stats stats;
+	unsigned blocks_per_entry, max_entries, ways, read_ahead;
+	if (argc < 3 || argc > 5)
 		return CMD_RET_USAGE;
 
+	blkcache_stats(&stats);
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
+	ways = argc > 3 ? simple_strtoul(argv[3], 0, 0) : stats.ways;
+	read_ahead = argc > 4 ? simple_strtoul(argv[4], 0, 0) :
+		     stats.read_ahead;
+	blkcache_configure(blocks_per_entry, max_entries, ways, read_ahead);
 	printf("changed to max of %u entries of %u blocks each\n",
 	       max_entries, blocks_per_entry);
 	return 0;
@@ -42,7 +59,7 @@ static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 
 static cmd_tbl_t cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 5, 0, blkc_configure, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -79,8 +96,8 @@ static int do_blkcache(cmd_tbl_t *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 6, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"blkcache configure blocks entries [ways [readahead]]\n"
 );
@@ -401,23 +401,33 @@ static int do_fpga_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
 	argc -= 2;
 	argv += 2;
 
+	/* -f reloads a bitstream which the device may already hold */
+	if (argc && !strcmp(argv[0], "-f")) {
+		fpga_set_force(true);
+		argc--;
+		argv++;
+	}
+
 	if (argc > fpga_cmd->maxargs) {
 		debug("fpga: more parameters passed\n");
+		fpga_set_force(false);
 		return CMD_RET_USAGE;
 	}
 
 	ret = fpga_cmd->cmd(fpga_cmd, flag, argc, argv);
+	fpga_set_force(false);
 
 	return cmd_process_error(fpga_cmd, ret);
 }
 
 #if defined(CONFIG_CMD_FPGA_LOADFS) || defined(CONFIG_CMD_FPGA_LOAD_SECURE)
-U_BOOT_CMD(fpga, 9, 1, do_fpga_wrapper,
+U_BOOT_CMD(fpga, 10, 1, do_fpga_wrapper,
 #else
-U_BOOT_CMD(fpga, 6, 1, do_fpga_wrapper,
+U_BOOT_CMD(fpga, 7, 1, do_fpga_wrapper,
 #endif
 	   "loadable FPGA image support",
-	   "[operation type] [device number] [image address] [image size]\n"
+	   "[operation type] [-f] [device number] [image address] [image size]\n"
+	   "-f: program the device even if it holds the same bitstream\n"
 	   "fpga operations:\n"
 	   "  dump\t[dev] [address] [size]\tLoad device to memory buffer\n"
 	   "  info\t[dev]\t\t\tlist known device information\n"
@@ -434,7 +444,8 @@ U_BOOT_CMD(fpga, 6, 1, do_fpga_wrapper,
 	   "(Xilinx only)\n"
 #endif
 #if defined(CONFIG_CMD_FPGA_LOADFS)
-	   "Load device from filesystem (FAT by default) (Xilinx only)\n"
+	   "Load device from filesystem (FAT by default)\n"
+	   "(Xilinx, SoCFPGA and SDM only)\n"
 	   "  loadfs [dev] [address] [image size] [blocksize] <interface>\n"
 	   "        [<dev[:part]>] <filename>\n"
 #endif
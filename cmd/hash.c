@@ -18,38 +18,51 @@ static int do_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	char *s;
 	int flags = HASH_FLAG_ENV;
+	int file = 0;
 
+	for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
 #ifdef CONFIG_HASH_VERIFY
-	if (argc < 4)
-		return CMD_RET_USAGE;
-	if (!strcmp(argv[1], "-v")) {
-		flags |= HASH_FLAG_VERIFY;
-		argc--;
-		argv++;
-	}
+		if (!strcmp(argv[1], "-v")) {
+			flags |= HASH_FLAG_VERIFY;
+			continue;
+		}
 #endif
+		if (!strcmp(argv[1], "-f"))
+			file = 1;
+		else
+			return CMD_RET_USAGE;
+	}
+	if (argc < 3)
+		return CMD_RET_USAGE;
+
 	/* Move forward to 'algorithm' parameter */
 	argc--;
 	argv++;
 	for (s = *argv; *s; s++)
 		*s = tolower(*s);
+	if (file)
+		return hash_file_command(*argv, flags, argc - 1, argv + 1);
 	return hash_command(*argv, flags, cmdtp, flag, argc - 1, argv + 1);
 }
 
 #ifdef CONFIG_HASH_VERIFY
-#define HARGS 6
+#define HARGS 8
 #else
-#define HARGS 5
+#define HARGS 7
 #endif
 
 U_BOOT_CMD(
 	hash,	HARGS,	1,	do_hash,
 	"compute hash message digest",
 	"algorithm address count [[*]hash_dest]\n"
-		"    - compute message digest [save to env var / *address]"
+		"    - compute message digest [save to env var / *address]\n"
+	"hash -f algorithm <interface> <dev[:part]> <filename> [[*]hash_dest]\n"
+		"    - compute message digest of a file as it is read"
 #ifdef CONFIG_HASH_VERIFY
 	"\nhash -v algorithm address count [*]hash\n"
 		"    - verify message digest of memory area to immediate value, \n"
-		"      env var or *address"
+		"      env var or *address\n"
+	"hash -v -f algorithm <interface> <dev[:part]> <filename> [*]hash\n"
+		"    - verify message digest of a file"
 #endif
 );
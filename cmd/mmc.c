@@ -7,6 +7,7 @@
 #include <common.h>
 #include <command.h>
 #include <console.h>
+#include <fs.h>
 #include <mmc.h>
 #include <sparse_format.h>
 #include <image-sparse.h>
@@ -113,6 +114,8 @@ static struct mmc *init_mmc_device(int dev, bool force_init)
 	struct blk_desc *bd = mmc_get_blk_desc(mmc);
 	blkcache_invalidate(bd->if_type, bd->devnum);
 #endif
+	fs_mount_invalidate(mmc_get_blk_desc(mmc));
+	part_cache_invalidate(mmc_get_blk_desc(mmc));
 
 	return mmc;
 }
@@ -9,6 +9,7 @@
  */
 #include <common.h>
 #include <command.h>
+#include <dm.h>
 #include <net.h>
 
 static int netboot_common(enum proto_t, cmd_tbl_t *, int, char * const []);
@@ -113,6 +114,20 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_WGET)
+static int do_wget(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	return netboot_common(WGET, cmdtp, argc, argv);
+}
+
+U_BOOT_CMD(
+	wget,	3,	1,	do_wget,
+	"boot image via network using HTTP protocol",
+	"[loadAddress] [[hostIPaddr:]path]\n"
+	"wget [loadAddress] http://hostIPaddr[:port]/path"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[22];
@@ -296,6 +311,47 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_NET_STATS)
+static int do_net(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	struct eth_stats stats;
+	struct udevice *dev;
+	int ret;
+
+	if (argc < 2 || strcmp(argv[1], "stats"))
+		return CMD_RET_USAGE;
+
+	dev = argc > 2 ? eth_get_dev_by_name(argv[2]) : eth_get_dev();
+	if (!dev) {
+		puts("No such ethernet device\n");
+		return CMD_RET_FAILURE;
+	}
+
+	ret = eth_get_stats(dev, &stats);
+	if (ret) {
+		printf("%s: cannot read counters (err=%d)\n", dev->name, ret);
+		return CMD_RET_FAILURE;
+	}
+
+	printf("%s:\n", dev->name);
+	printf("  rx packets:  %lu\n", stats.rx_packets);
+	printf("  rx errors:   %lu\n", stats.rx_errors);
+	printf("  rx missed:   %lu\n", stats.rx_missed);
+	printf("  rx overruns: %lu\n", stats.rx_overruns);
+	printf("  tx packets:  %lu\n", stats.tx_packets);
+	printf("  tx errors:   %lu\n", stats.tx_errors);
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	net,	3,	1,	do_net,
+	"network device information",
+	"stats [ethN|name] - show packet counters of the current or given\n"
+	"    Ethernet device"
+);
+#endif
+
 #if defined(CONFIG_CMD_CDP)
 
 static void cdp_update_env(void)
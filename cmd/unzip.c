@@ -6,12 +6,54 @@
 
 #include <common.h>
 #include <command.h>
+#include <fs.h>
+#include <mapmem.h>
+
+/* Inflate a gzip'd file as it is read, without loading it first */
+static int unzip_file(int argc, char * const argv[], unsigned long *lenp)
+{
+	unsigned long dst, dst_len = ~0UL;
+	loff_t actread;
+	void *buf, *ctx;
+	int ret;
+
+	if (argc < 4)
+		return CMD_RET_USAGE;
+	dst = simple_strtoul(argv[3], NULL, 16);
+	if (argc > 4)
+		dst_len = simple_strtoul(argv[4], NULL, 16);
+
+	if (fs_set_blk_dev(argv[0], argv[1], FS_TYPE_ANY))
+		return 1;
+
+	buf = map_sysmem(dst, dst_len);
+	ctx = gunzip_push_start(buf, dst_len);
+	if (ctx) {
+		ret = fs_read_stream(argv[2], 0, 0, gunzip_push, ctx,
+				     &actread);
+		if (gunzip_push_end(ctx, lenp))
+			ret = -1;
+	} else {
+		ret = -ENOMEM;
+	}
+	unmap_sysmem(buf);
+
+	return ret ? 1 : 0;
+}
 
 static int do_unzip(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	unsigned long src, dst;
 	unsigned long src_len = ~0UL, dst_len = ~0UL;
 
+	if (argc > 1 && !strcmp(argv[1], "-f")) {
+		int ret = unzip_file(argc - 2, argv + 2, &src_len);
+
+		if (ret)
+			return ret;
+		goto done;
+	}
+
 	switch (argc) {
 		case 4:
 			dst_len = simple_strtoul(argv[3], NULL, 16);
@@ -24,9 +66,18 @@ static int do_unzip(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			return CMD_RET_USAGE;
 	}
 
-	if (gunzip((void *) dst, dst_len, (void *) src, &src_len) != 0)
+	if (IS_ENABLED(CONFIG_ZSTD) && zstd_is_compressed((void *)src, 4)) {
+		size_t srcn = src_len, dstn = dst_len;
+
+		if (zstd_decompress_frame((void *)src, &srcn, (void *)dst,
+					  &dstn))
+			return 1;
+		src_len = dstn;
+	} else if (gunzip((void *) dst, dst_len, (void *) src, &src_len) != 0) {
 		return 1;
+	}
 
+done:
 	printf("Uncompressed size: %lu = 0x%lX\n", src_len, src_len);
 	env_set_hex("filesize", src_len);
 
@@ -34,9 +85,11 @@ static int do_unzip(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 }
 
 U_BOOT_CMD(
-	unzip,	4,	1,	do_unzip,
+	unzip,	7,	1,	do_unzip,
 	"unzip a memory region",
-	"srcaddr dstaddr [dstsize]"
+	"srcaddr dstaddr [dstsize]\n"
+	"unzip -f <interface> <dev[:part]> <filename> dstaddr [dstsize]\n"
+	"    - unzip a gzip'd file as it is read"
 );
 
 static int do_gzwrite(cmd_tbl_t *cmdtp, int flag,
@@ -12,6 +12,7 @@
 #ifndef USE_HOSTCC
 #include <common.h>
 #include <command.h>
+#include <fs.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <hw_sha.h>
@@ -107,7 +108,8 @@ static int hash_finish_crc16_ccitt(struct hash_algo *algo, void *ctx,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint16_t *)dest_buf) = *((uint16_t *)ctx);
+	/* Big endian, as stored by crc16_ccitt_wd_buf() */
+	*((uint16_t *)dest_buf) = cpu_to_be16(*((uint16_t *)ctx));
 	free(ctx);
 	return 0;
 }
@@ -133,7 +135,8 @@ static int hash_finish_crc32(struct hash_algo *algo, void *ctx, void *dest_buf,
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* Big endian, as stored by crc32_wd_buf() */
+	*((uint32_t *)dest_buf) = cpu_to_be32(*((uint32_t *)ctx));
 	free(ctx);
 	return 0;
 }
@@ -403,15 +406,69 @@ static int parse_verify_sum(struct hash_algo *algo, char *verify_str,
 	return 0;
 }
 
-static void hash_show(struct hash_algo *algo, ulong addr, ulong len, uint8_t *output)
+static void hash_show(struct hash_algo *algo, const char *what,
+		      uint8_t *output)
 {
 	int i;
 
-	printf("%s for %08lx ... %08lx ==> ", algo->name, addr, addr + len - 1);
+	printf("%s for %s ==> ", algo->name, what);
 	for (i = 0; i < algo->digest_size; i++)
 		printf("%02x", output[i]);
 }
 
+/**
+ * hash_result: Verify, or show and store, a computed digest
+ *
+ * @algo:		Hash algorithm being used
+ * @flags:		Flags value (HASH_FLAG_...)
+ * @what:		Description of the data hashed, for the messages
+ * @output:		Hash digest (algo->digest_size bytes)
+ * @argc:		Number of arguments left: the digest to verify against
+ *			or where to store the result, if any
+ * @argv:		Arguments left
+ * @return 0 if ok, 1 on verify failure or error
+ */
+static int hash_result(struct hash_algo *algo, int flags, const char *what,
+		       uint8_t *output, int argc, char * const argv[])
+{
+	uint8_t vsum[HASH_MAX_DIGEST_SIZE];
+
+	/* Try to avoid code bloat when verify is not needed */
+#if defined(CONFIG_CRC32_VERIFY) || defined(CONFIG_SHA1SUM_VERIFY) || \
+	defined(CONFIG_HASH_VERIFY)
+	if (flags & HASH_FLAG_VERIFY) {
+#else
+	if (0) {
+#endif
+		if (parse_verify_sum(algo, *argv, vsum,
+				flags & HASH_FLAG_ENV)) {
+			printf("ERROR: %s does not contain a valid "
+				"%s sum\n", *argv, algo->name);
+			return 1;
+		}
+		if (memcmp(output, vsum, algo->digest_size) != 0) {
+			int i;
+
+			hash_show(algo, what, output);
+			printf(" != ");
+			for (i = 0; i < algo->digest_size; i++)
+				printf("%02x", vsum[i]);
+			puts(" ** ERROR **\n");
+			return 1;
+		}
+	} else {
+		hash_show(algo, what, output);
+		printf("\n");
+
+		if (argc) {
+			store_result(algo, output, *argv,
+				flags & HASH_FLAG_ENV);
+		}
+	}
+
+	return 0;
+}
+
 int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		 int argc, char * const argv[])
 {
@@ -425,9 +482,10 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 
 	if (multi_hash()) {
 		struct hash_algo *algo;
+		char what[4 * sizeof(ulong) + 6];
 		u8 *output;
-		uint8_t vsum[HASH_MAX_DIGEST_SIZE];
 		void *buf;
+		int ret;
 
 		if (hash_lookup_algo(algo_name, &algo)) {
 			printf("Unknown hash algorithm '%s'\n", algo_name);
@@ -447,40 +505,12 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		algo->hash_func_ws(buf, len, output, algo->chunk_size);
 		unmap_sysmem(buf);
 
-		/* Try to avoid code bloat when verify is not needed */
-#if defined(CONFIG_CRC32_VERIFY) || defined(CONFIG_SHA1SUM_VERIFY) || \
-	defined(CONFIG_HASH_VERIFY)
-		if (flags & HASH_FLAG_VERIFY) {
-#else
-		if (0) {
-#endif
-			if (parse_verify_sum(algo, *argv, vsum,
-					flags & HASH_FLAG_ENV)) {
-				printf("ERROR: %s does not contain a valid "
-					"%s sum\n", *argv, algo->name);
-				return 1;
-			}
-			if (memcmp(output, vsum, algo->digest_size) != 0) {
-				int i;
-
-				hash_show(algo, addr, len, output);
-				printf(" != ");
-				for (i = 0; i < algo->digest_size; i++)
-					printf("%02x", vsum[i]);
-				puts(" ** ERROR **\n");
-				return 1;
-			}
-		} else {
-			hash_show(algo, addr, len, output);
-			printf("\n");
-
-			if (argc) {
-				store_result(algo, output, *argv,
-					flags & HASH_FLAG_ENV);
-			}
-		unmap_sysmem(output);
+		snprintf(what, sizeof(what), "%08lx ... %08lx", addr,
+			 addr + len - 1);
+		ret = hash_result(algo, flags, what, output, argc, argv);
+		free(output);
 
-		}
+		return ret;
 
 	/* Horrible code size hack for boards that just want crc32 */
 	} else {
@@ -500,5 +530,58 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 
 	return 0;
 }
+
+#ifdef CONFIG_CMD_HASH
+struct hash_file {
+	struct hash_algo *algo;
+	void *ctx;
+};
+
+static int hash_file_update(void *priv, const void *buf, size_t len)
+{
+	struct hash_file *hf = priv;
+
+	return hf->algo->hash_update(hf->algo, hf->ctx, buf, len, 0);
+}
+
+int hash_file_command(const char *algo_name, int flags, int argc,
+		      char * const argv[])
+{
+	uint8_t output[HASH_MAX_DIGEST_SIZE];
+	struct hash_file hf;
+	loff_t len;
+	int ret;
+
+	if ((argc < 3) || ((flags & HASH_FLAG_VERIFY) && (argc < 4)))
+		return CMD_RET_USAGE;
+
+	if (hash_lookup_algo(algo_name, &hf.algo)) {
+		printf("Unknown hash algorithm '%s'\n", algo_name);
+		return CMD_RET_USAGE;
+	}
+	if (hf.algo->digest_size > HASH_MAX_DIGEST_SIZE) {
+		puts("HASH_MAX_DIGEST_SIZE exceeded\n");
+		return 1;
+	}
+
+	if (fs_set_blk_dev(argv[0], argv[1], FS_TYPE_ANY))
+		return 1;
+
+	ret = hf.algo->hash_init(hf.algo, &hf.ctx);
+	if (ret)
+		return 1;
+
+	/* The file is hashed as it is read, without loading it anywhere */
+	ret = fs_read_stream(argv[2], 0, 0, hash_file_update, &hf, &len);
+	if (hf.algo->hash_finish(hf.algo, hf.ctx, output,
+				 hf.algo->digest_size) || ret) {
+		printf("** Unable to hash %s **\n", argv[2]);
+		return 1;
+	}
+
+	return hash_result(hf.algo, flags, argv[2], output, argc - 3,
+			   argv + 3);
+}
+#endif /* CONFIG_CMD_HASH */
 #endif /* CONFIG_CMD_HASH || CONFIG_CMD_SHA1SUM || CONFIG_CMD_CRC32) */
 #endif /* !USE_HOSTCC */
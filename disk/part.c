@@ -7,6 +7,7 @@
 #include <common.h>
 #include <command.h>
 #include <errno.h>
+#include <fs.h>
 #include <ide.h>
 #include <malloc.h>
 #include <part.h>
@@ -234,6 +235,8 @@ void part_init(struct blk_desc *dev_desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	fs_mount_invalidate(dev_desc);
+	part_cache_invalidate(dev_desc);
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -654,6 +657,8 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 	part_drv = part_driver_lookup_type(dev_desc);
 	if (!part_drv)
 		return -1;
+	if (part_drv->get_info_by_name)
+		return part_drv->get_info_by_name(dev_desc, name, info);
 	for (i = 1; i < part_drv->max_entries; i++) {
 		ret = part_drv->get_info(dev_desc, i, info);
 		if (ret != 0) {
@@ -675,6 +680,29 @@ int part_get_info_by_name(struct blk_desc *dev_desc, const char *name,
 	return part_get_info_by_name_type(dev_desc, name, info, PART_TYPE_ALL);
 }
 
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  disk_partition_t *info)
+{
+	struct part_driver *part_drv;
+	int __maybe_unused i;
+
+	part_drv = part_driver_lookup_type(dev_desc);
+	if (!part_drv)
+		return -1;
+	if (part_drv->get_info_by_uuid)
+		return part_drv->get_info_by_uuid(dev_desc, uuid, info);
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	for (i = 1; i < part_drv->max_entries; i++) {
+		if (part_drv->get_info(dev_desc, i, info))
+			break;
+		if (!strcasecmp(uuid, info->uuid))
+			return i;
+	}
+#endif
+
+	return -1;
+}
+
 void part_set_generic_name(const struct blk_desc *dev_desc,
 	int part_num, char *name)
 {
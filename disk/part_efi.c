@@ -178,62 +178,240 @@ static void prepare_backup_gpt_header(gpt_header *gpt_h)
 
 #if CONFIG_IS_ENABLED(EFI_PARTITION)
 /*
- * Public Functions (include/part.h)
+ * The validated table of a device (hardware partition) is kept, with the
+ * names of its entries decoded and indexed by name and by unique GUID, so
+ * that looking up partitions does not read and check the whole table every
+ * time. It is dropped when the device is initialised or removed, and when a
+ * block outside its usable area (where the tables are) is written or erased.
  */
+#define GPT_INDEX_BUCKETS	64
+
+struct gpt_cache {
+	struct list_head list;
+	struct blk_desc *desc;
+	int hwpart;				/* hardware partition read */
+	gpt_header head;
+	gpt_entry *pte;
+	int count;				/* entries in pte */
+	char (*names)[PARTNAME_SZ + 1];		/* decoded entry names */
+	int name_head[GPT_INDEX_BUCKETS];	/* first entry of a bucket */
+	int uuid_head[GPT_INDEX_BUCKETS];
+	int *name_next;				/* next entry in the bucket */
+	int *uuid_next;
+};
 
-/*
- * UUID is displayed as 32 hexadecimal digits, in 5 groups,
- * separated by hyphens, in the form 8-4-4-4-12 for a total of 36 characters
- */
-int get_disk_guid(struct blk_desc * dev_desc, char *guid)
+static LIST_HEAD(gpt_cache_list);
+
+static uint gpt_name_hash(const char *name)
+{
+	uint hash = 0;
+
+	while (*name)
+		hash = hash * 31 + *name++;
+
+	return hash % GPT_INDEX_BUCKETS;
+}
+
+static uint gpt_uuid_hash(const u8 *b)
+{
+	return (b[0] ^ b[5] ^ b[10] ^ b[15]) % GPT_INDEX_BUCKETS;
+}
+
+static void gpt_cache_free(struct gpt_cache *cache)
+{
+	free(cache->pte);
+	free(cache->names);
+	free(cache->name_next);
+	free(cache->uuid_next);
+	free(cache);
+}
+
+/* Read and validate the table of a device, and index its entries */
+static struct gpt_cache *gpt_cache_read(struct blk_desc *dev_desc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
+	struct gpt_cache *cache;
 	gpt_entry *gpt_pte = NULL;
-	unsigned char *guid_bin;
+	uint h;
+	int i;
 
 	/* This function validates AND fills in the GPT header and PTE */
 	if (is_gpt_valid(dev_desc, GPT_PRIMARY_PARTITION_TABLE_LBA,
 			 gpt_head, &gpt_pte) != 1) {
 		printf("%s: *** ERROR: Invalid GPT ***\n", __func__);
-		if (is_gpt_valid(dev_desc, dev_desc->lba - 1,
+		if (is_gpt_valid(dev_desc, (dev_desc->lba - 1),
 				 gpt_head, &gpt_pte) != 1) {
 			printf("%s: *** ERROR: Invalid Backup GPT ***\n",
 			       __func__);
-			return -EINVAL;
+			return NULL;
 		} else {
 			printf("%s: ***        Using Backup GPT ***\n",
 			       __func__);
 		}
 	}
 
-	guid_bin = gpt_head->disk_guid.b;
-	uuid_bin_to_str(guid_bin, guid, UUID_STR_FORMAT_GUID);
+	cache = calloc(1, sizeof(*cache));
+	if (!cache) {
+		free(gpt_pte);
+		return NULL;
+	}
+	cache->desc = dev_desc;
+	cache->hwpart = dev_desc->hwpart;
+	cache->head = *gpt_head;
+	cache->pte = gpt_pte;
+	cache->count = le32_to_cpu(gpt_head->num_partition_entries);
+	cache->names = calloc(cache->count, sizeof(*cache->names));
+	cache->name_next = calloc(cache->count, sizeof(int));
+	cache->uuid_next = calloc(cache->count, sizeof(int));
+	if (!cache->names || !cache->name_next || !cache->uuid_next) {
+		gpt_cache_free(cache);
+		return NULL;
+	}
+
+	/* Index backwards, so that the lowest numbered entry is found first */
+	for (h = 0; h < GPT_INDEX_BUCKETS; h++) {
+		cache->name_head[h] = -1;
+		cache->uuid_head[h] = -1;
+	}
+	for (i = cache->count - 1; i >= 0; i--) {
+		if (!is_pte_valid(&gpt_pte[i]))
+			continue;
+		strcpy(cache->names[i], print_efiname(&gpt_pte[i]));
+		h = gpt_name_hash(cache->names[i]);
+		cache->name_next[i] = cache->name_head[h];
+		cache->name_head[h] = i;
+		h = gpt_uuid_hash(gpt_pte[i].unique_partition_guid.b);
+		cache->uuid_next[i] = cache->uuid_head[h];
+		cache->uuid_head[h] = i;
+	}
+
+	return cache;
+}
+
+static struct gpt_cache *gpt_cache_get(struct blk_desc *dev_desc)
+{
+	struct gpt_cache *cache;
+
+	if (CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)) {
+		list_for_each_entry(cache, &gpt_cache_list, list) {
+			if (cache->desc == dev_desc &&
+			    cache->hwpart == dev_desc->hwpart)
+				return cache;
+		}
+	}
+
+	cache = gpt_cache_read(dev_desc);
+	if (cache && CONFIG_IS_ENABLED(EFI_PARTITION_CACHE))
+		list_add(&cache->list, &gpt_cache_list);
+
+	return cache;
+}
+
+static void gpt_cache_put(struct gpt_cache *cache)
+{
+	if (!CONFIG_IS_ENABLED(EFI_PARTITION_CACHE))
+		gpt_cache_free(cache);
+}
+
+#if CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+void part_cache_invalidate(struct blk_desc *dev_desc)
+{
+	struct gpt_cache *cache, *next;
+
+	list_for_each_entry_safe(cache, next, &gpt_cache_list, list) {
+		if (!dev_desc || cache->desc == dev_desc) {
+			list_del(&cache->list);
+			gpt_cache_free(cache);
+		}
+	}
+}
+
+void part_cache_write(struct blk_desc *dev_desc, lbaint_t start,
+		      lbaint_t blkcnt)
+{
+	struct gpt_cache *cache;
+
+	list_for_each_entry(cache, &gpt_cache_list, list) {
+		if (cache->desc != dev_desc ||
+		    cache->hwpart != dev_desc->hwpart)
+			continue;
+
+		/* Data written to the partitions cannot change the table */
+		if (start >= le64_to_cpu(cache->head.first_usable_lba) &&
+		    start + blkcnt <= le64_to_cpu(cache->head.last_usable_lba)
+				      + 1)
+			return;
+
+		list_del(&cache->list);
+		gpt_cache_free(cache);
+		return;
+	}
+}
+#endif
+
+/* Fill in @info from entry @i of the table */
+static void gpt_cache_info(struct gpt_cache *cache, int i,
+			   disk_partition_t *info)
+{
+	gpt_entry *pte = &cache->pte[i];
+
+	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
+	info->start = (lbaint_t)le64_to_cpu(pte->starting_lba);
+	/* The ending LBA is inclusive, to calculate size, add 1 to it */
+	info->size = (lbaint_t)le64_to_cpu(pte->ending_lba) + 1
+		     - info->start;
+	info->blksz = cache->desc->blksz;
+
+	strcpy((char *)info->name, cache->names[i]);
+	strcpy((char *)info->type, "U-Boot");
+	info->bootable = is_bootable(pte);
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	uuid_bin_to_str(pte->unique_partition_guid.b, info->uuid,
+			UUID_STR_FORMAT_GUID);
+#endif
+#ifdef CONFIG_PARTITION_TYPE_GUID
+	uuid_bin_to_str(pte->partition_type_guid.b, info->type_guid,
+			UUID_STR_FORMAT_GUID);
+#endif
+
+	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
+	      info->start, info->size, info->name);
+}
+
+/*
+ * Public Functions (include/part.h)
+ */
+
+/*
+ * UUID is displayed as 32 hexadecimal digits, in 5 groups,
+ * separated by hyphens, in the form 8-4-4-4-12 for a total of 36 characters
+ */
+int get_disk_guid(struct blk_desc *dev_desc, char *guid)
+{
+	struct gpt_cache *cache;
+
+	cache = gpt_cache_get(dev_desc);
+	if (!cache)
+		return -EINVAL;
+
+	uuid_bin_to_str(cache->head.disk_guid.b, guid, UUID_STR_FORMAT_GUID);
+	gpt_cache_put(cache);
 
 	return 0;
 }
 
 void part_print_efi(struct blk_desc *dev_desc)
 {
-	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
-	gpt_entry *gpt_pte = NULL;
+	struct gpt_cache *cache;
+	gpt_entry *gpt_pte;
 	int i = 0;
 	char uuid[UUID_STR_LEN + 1];
 	unsigned char *uuid_bin;
 
-	/* This function validates AND fills in the GPT header and PTE */
-	if (is_gpt_valid(dev_desc, GPT_PRIMARY_PARTITION_TABLE_LBA,
-			 gpt_head, &gpt_pte) != 1) {
-		printf("%s: *** ERROR: Invalid GPT ***\n", __func__);
-		if (is_gpt_valid(dev_desc, (dev_desc->lba - 1),
-				 gpt_head, &gpt_pte) != 1) {
-			printf("%s: *** ERROR: Invalid Backup GPT ***\n",
-			       __func__);
-			return;
-		} else {
-			printf("%s: ***        Using Backup GPT ***\n",
-			       __func__);
-		}
-	}
+	cache = gpt_cache_get(dev_desc);
+	if (!cache)
+		return;
+	gpt_pte = cache->pte;
 
 	debug("%s: gpt-entry at %p\n", __func__, gpt_pte);
 
@@ -242,7 +420,7 @@ void part_print_efi(struct blk_desc *dev_desc)
 	printf("\tType GUID\n");
 	printf("\tPartition GUID\n");
 
-	for (i = 0; i < le32_to_cpu(gpt_head->num_partition_entries); i++) {
+	for (i = 0; i < cache->count; i++) {
 		/* Stop at the first non valid PTE */
 		if (!is_pte_valid(&gpt_pte[i]))
 			break;
@@ -250,7 +428,7 @@ void part_print_efi(struct blk_desc *dev_desc)
 		printf("%3d\t0x%08llx\t0x%08llx\t\"%s\"\n", (i + 1),
 			le64_to_cpu(gpt_pte[i].starting_lba),
 			le64_to_cpu(gpt_pte[i].ending_lba),
-			print_efiname(&gpt_pte[i]));
+			cache->names[i]);
 		printf("\tattrs:\t0x%016llx\n", gpt_pte[i].attributes.raw);
 		uuid_bin = (unsigned char *)gpt_pte[i].partition_type_guid.b;
 		uuid_bin_to_str(uuid_bin, uuid, UUID_STR_FORMAT_GUID);
@@ -264,16 +442,13 @@ void part_print_efi(struct blk_desc *dev_desc)
 		printf("\tguid:\t%s\n", uuid);
 	}
 
-	/* Remember to free pte */
-	free(gpt_pte);
-	return;
+	gpt_cache_put(cache);
 }
 
 int part_get_info_efi(struct blk_desc *dev_desc, int part,
 		      disk_partition_t *info)
 {
-	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, dev_desc->blksz);
-	gpt_entry *gpt_pte = NULL;
+	struct gpt_cache *cache;
 
 	/* "part" argument must be at least 1 */
 	if (part < 1) {
@@ -281,55 +456,72 @@ int part_get_info_efi(struct blk_desc *dev_desc, int part,
 		return -1;
 	}
 
-	/* This function validates AND fills in the GPT header and PTE */
-	if (is_gpt_valid(dev_desc, GPT_PRIMARY_PARTITION_TABLE_LBA,
-			gpt_head, &gpt_pte) != 1) {
-		printf("%s: *** ERROR: Invalid GPT ***\n", __func__);
-		if (is_gpt_valid(dev_desc, (dev_desc->lba - 1),
-				 gpt_head, &gpt_pte) != 1) {
-			printf("%s: *** ERROR: Invalid Backup GPT ***\n",
-			       __func__);
-			return -1;
-		} else {
-			printf("%s: ***        Using Backup GPT ***\n",
-			       __func__);
-		}
-	}
+	cache = gpt_cache_get(dev_desc);
+	if (!cache)
+		return -1;
 
-	if (part > le32_to_cpu(gpt_head->num_partition_entries) ||
-	    !is_pte_valid(&gpt_pte[part - 1])) {
+	if (part > cache->count || !is_pte_valid(&cache->pte[part - 1])) {
 		debug("%s: *** ERROR: Invalid partition number %d ***\n",
 			__func__, part);
-		free(gpt_pte);
+		gpt_cache_put(cache);
 		return -1;
 	}
 
-	/* The 'lbaint_t' casting may limit the maximum disk size to 2 TB */
-	info->start = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].starting_lba);
-	/* The ending LBA is inclusive, to calculate size, add 1 to it */
-	info->size = (lbaint_t)le64_to_cpu(gpt_pte[part - 1].ending_lba) + 1
-		     - info->start;
-	info->blksz = dev_desc->blksz;
+	gpt_cache_info(cache, part - 1, info);
+	gpt_cache_put(cache);
 
-	sprintf((char *)info->name, "%s",
-			print_efiname(&gpt_pte[part - 1]));
-	strcpy((char *)info->type, "U-Boot");
-	info->bootable = is_bootable(&gpt_pte[part - 1]);
-#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
-	uuid_bin_to_str(gpt_pte[part - 1].unique_partition_guid.b, info->uuid,
-			UUID_STR_FORMAT_GUID);
-#endif
-#ifdef CONFIG_PARTITION_TYPE_GUID
-	uuid_bin_to_str(gpt_pte[part - 1].partition_type_guid.b,
-			info->type_guid, UUID_STR_FORMAT_GUID);
-#endif
+	return 0;
+}
 
-	debug("%s: start 0x" LBAF ", size 0x" LBAF ", name %s\n", __func__,
-	      info->start, info->size, info->name);
+static int __maybe_unused
+part_get_info_by_name_efi(struct blk_desc *dev_desc, const char *name,
+			  disk_partition_t *info)
+{
+	struct gpt_cache *cache;
+	int i;
 
-	/* Remember to free pte */
-	free(gpt_pte);
-	return 0;
+	cache = gpt_cache_get(dev_desc);
+	if (!cache)
+		return -1;
+
+	for (i = cache->name_head[gpt_name_hash(name)]; i >= 0;
+	     i = cache->name_next[i]) {
+		if (!strcmp(name, cache->names[i])) {
+			gpt_cache_info(cache, i, info);
+			break;
+		}
+	}
+	gpt_cache_put(cache);
+
+	return i >= 0 ? i + 1 : -1;
+}
+
+static int __maybe_unused
+part_get_info_by_uuid_efi(struct blk_desc *dev_desc, const char *uuid,
+			  disk_partition_t *info)
+{
+	struct gpt_cache *cache;
+	efi_guid_t guid;
+	int i;
+
+	if (uuid_str_to_bin((char *)uuid, guid.b, UUID_STR_FORMAT_GUID))
+		return -1;
+
+	cache = gpt_cache_get(dev_desc);
+	if (!cache)
+		return -1;
+
+	for (i = cache->uuid_head[gpt_uuid_hash(guid.b)]; i >= 0;
+	     i = cache->uuid_next[i]) {
+		if (!memcmp(&guid, &cache->pte[i].unique_partition_guid,
+			    sizeof(guid))) {
+			gpt_cache_info(cache, i, info);
+			break;
+		}
+	}
+	gpt_cache_put(cache);
+
+	return i >= 0 ? i + 1 : -1;
 }
 
 static int part_test_efi(struct blk_desc *dev_desc)
@@ -1075,6 +1267,8 @@ U_BOOT_PART_TYPE(a_efi) = {
 	.part_type	= PART_TYPE_EFI,
 	.max_entries	= GPT_ENTRY_NUMBERS,
 	.get_info	= part_get_info_ptr(part_get_info_efi),
+	.get_info_by_name = part_get_info_ptr(part_get_info_by_name_efi),
+	.get_info_by_uuid = part_get_info_ptr(part_get_info_by_uuid_efi),
 	.print		= part_print_ptr(part_print_efi),
 	.test		= part_test_efi,
 };
@@ -7,10 +7,15 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <fs.h>
+#include <watchdog.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
 
+/* Time in ms an asynchronous request may go without any progress */
+#define BLK_REQ_TIMEOUT		5000
+
 static const char *if_typename_str[IF_TYPE_COUNT] = {
 	[IF_TYPE_IDE]		= "ide",
 	[IF_TYPE_SCSI]		= "scsi",
@@ -426,25 +431,38 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/**
+ * struct blk_uclass_priv - uclass information for each block device
+ *
+ * @reqs:	Asynchronous requests submitted and not yet completed
+ */
+struct blk_uclass_priv {
+	struct list_head reqs;
+};
+
+static int blk_wait_reqs(struct blk_desc *block_dev, bool writes);
+
+static unsigned long blk_read_dev(struct blk_desc *block_dev, lbaint_t start,
+				  lbaint_t blkcnt, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+
+	return blk_get_ops(dev)->read(dev, start, blkcnt, buffer);
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
-	ulong blks_read;
 
 	if (!ops->read)
 		return -ENOSYS;
 
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
+	if (blk_wait_reqs(block_dev, true))
+		return -EIO;
 
-	return blks_read;
+	return blkcache_dread(block_dev, start, blkcnt, buffer, blk_read_dev);
 }
 
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
@@ -452,12 +470,24 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_written;
 
 	if (!ops->write)
 		return -ENOSYS;
 
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return ops->write(dev, start, blkcnt, buffer);
+	if (blk_wait_reqs(block_dev, false))
+		return -EIO;
+
+	fs_mount_invalidate(block_dev);
+	part_cache_write(block_dev, start, blkcnt);
+	blks_written = ops->write(dev, start, blkcnt, buffer);
+	if (blks_written == blkcnt)
+		blkcache_write(block_dev->if_type, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	else
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+
+	return blks_written;
 }
 
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
@@ -469,10 +499,210 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	if (!ops->erase)
 		return -ENOSYS;
 
+	if (blk_wait_reqs(block_dev, false))
+		return -EIO;
+
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	fs_mount_invalidate(block_dev);
+	part_cache_write(block_dev, start, blkcnt);
 	return ops->erase(dev, start, blkcnt);
 }
 
+/* Keep the block cache coherent with a request which has completed */
+static void blk_req_finish(struct blk_desc *block_dev, struct blk_req *req)
+{
+	if (req->op != BLK_REQ_WRITE)
+		return;
+
+	if (req->result == req->blkcnt)
+		blkcache_write(block_dev->if_type, block_dev->devnum,
+			       req->start, req->blkcnt, block_dev->blksz,
+			       req->buffer);
+	else
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+}
+
+int blk_submit(struct blk_desc *block_dev, struct blk_req *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	int ret;
+
+	if (!priv)
+		return -ENODEV;
+
+	switch (req->op) {
+	case BLK_REQ_READ:
+		if (!ops->read && !ops->submit)
+			return -ENOSYS;
+		break;
+	case BLK_REQ_WRITE:
+		if (!ops->write && !ops->submit)
+			return -ENOSYS;
+		fs_mount_invalidate(block_dev);
+		part_cache_write(block_dev, req->start, req->blkcnt);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	req->result = 0;
+	req->done = false;
+	INIT_LIST_HEAD(&req->queue);
+
+	if (ops->submit) {
+		ret = ops->submit(dev, req);
+		if (ret)
+			return ret;
+	} else {
+		/* Synchronous fallback, completed by the next poll */
+		if (req->op == BLK_REQ_READ)
+			req->result = ops->read(dev, req->start, req->blkcnt,
+						req->buffer);
+		else
+			req->result = ops->write(dev, req->start, req->blkcnt,
+						 req->buffer);
+		req->done = true;
+	}
+	list_add_tail(&req->node, &priv->reqs);
+
+	return 0;
+}
+
+int blk_poll(struct blk_desc *block_dev)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	struct blk_req *req;
+	int pending = 0;
+	int ret;
+
+	if (!priv)
+		return 0;
+
+	if (ops->poll) {
+		ret = ops->poll(dev);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * Completion functions may submit new requests, so restart the walk
+	 * after each one.
+	 */
+restart:
+	list_for_each_entry(req, &priv->reqs, node) {
+		if (!req->done)
+			continue;
+
+		list_del_init(&req->node);
+		blk_req_finish(block_dev, req);
+		if (req->complete)
+			req->complete(req);
+		goto restart;
+	}
+
+	list_for_each_entry(req, &priv->reqs, node)
+		pending++;
+
+	return pending;
+}
+
+/*
+ * Poll until @req has completed, returning only errors from the driver.
+ * Give up if no request of the device completes for BLK_REQ_TIMEOUT ms,
+ * plus 1 ms per KiB of @req to allow for slow devices.
+ */
+static int blk_wait_done(struct blk_desc *block_dev, struct blk_req *req)
+{
+	ulong timeout, start;
+	int ret, pending = INT_MAX;
+
+	timeout = BLK_REQ_TIMEOUT +
+		  (ulong)(((u64)req->blkcnt * block_dev->blksz) >> 10);
+	start = get_timer(0);
+	while (!list_empty(&req->node)) {
+		ret = blk_poll(block_dev);
+		if (ret < 0)
+			return ret;
+		if (ret < pending) {
+			pending = ret;
+			start = get_timer(0);
+		} else if (get_timer(start) > timeout) {
+			debug("%s: request for block " LBAF " timed out\n",
+			      __func__, req->start);
+			return -ETIMEDOUT;
+		}
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+
+int blk_wait(struct blk_desc *block_dev, struct blk_req *req)
+{
+	int ret;
+
+	ret = blk_wait_done(block_dev, req);
+	if (ret)
+		return ret;
+
+	if (req->result < 0)
+		return req->result;
+
+	return req->result == req->blkcnt ? 0 : -EIO;
+}
+
+/* Wait for the requests in flight, or only for the writes */
+static int blk_wait_reqs(struct blk_desc *block_dev, bool writes)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(block_dev->bdev);
+	struct blk_req *req;
+	int ret;
+
+	/* Devices which are not probed have no requests */
+	if (!priv)
+		return 0;
+
+restart:
+	list_for_each_entry(req, &priv->reqs, node) {
+		if (writes && req->op != BLK_REQ_WRITE)
+			continue;
+
+		ret = blk_wait_done(block_dev, req);
+		if (ret)
+			return ret;
+		goto restart;
+	}
+
+	return 0;
+}
+
+/* Complete the requests still in flight with an error, giving up on them */
+static void blk_cancel_reqs(struct blk_desc *block_dev)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	struct blk_req *req;
+
+	while (!list_empty(&priv->reqs)) {
+		req = list_first_entry(&priv->reqs, struct blk_req, node);
+		list_del_init(&req->node);
+		if (!req->done) {
+			if (ops->cancel)
+				ops->cancel(dev, req);
+			req->result = -ECANCELED;
+			req->done = true;
+		}
+		blk_req_finish(block_dev, req);
+		if (req->complete)
+			req->complete(req);
+	}
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -639,18 +869,36 @@ int blk_unbind_all(int if_type)
 
 static int blk_post_probe(struct udevice *dev)
 {
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
 #if defined(CONFIG_PARTITIONS) && defined(CONFIG_HAVE_BLOCK_DEVICE)
 	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+#endif
 
+	INIT_LIST_HEAD(&priv->reqs);
+#if defined(CONFIG_PARTITIONS) && defined(CONFIG_HAVE_BLOCK_DEVICE)
 	part_init(desc);
 #endif
 
 	return 0;
 }
 
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+
+	if (blk_wait_reqs(desc, false))
+		blk_cancel_reqs(desc);
+	fs_mount_invalidate(desc);
+	part_cache_invalidate(desc);
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
+	.per_device_auto_alloc_size = sizeof(struct blk_uclass_priv),
 	.per_device_platdata_auto_alloc_size = sizeof(struct blk_desc),
 };
@@ -3,170 +3,508 @@
  * Copyright (C) Nelson Integration, LLC 2016
  * Author: Eric Nelson<eric@nelint.com>
  *
+ * The cache is set-associative: it holds max_entries lines of
+ * max_blocks_per_entry blocks, each line aligned to its own size on the
+ * device. A line can only live in the set its device and block number
+ * hash to, and the least recently used way of that set is replaced.
+ *
+ * Small reads are rounded out to whole lines. When a device is read
+ * sequentially, the lines following the request are fetched in the same
+ * device access so that the next reads hit.
  */
 #include <config.h>
 #include <common.h>
+#include <blk.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct block_cache_node {
-	struct list_head lh;
 	int iftype;
 	int devnum;
 	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
+	unsigned long bytes;
+	unsigned long age;
+	bool valid;
+	bool ahead;
 	char *cache;
 };
 
-static LIST_HEAD(block_cache);
+/* Per-device statistics and sequential read detection */
+struct block_cache_dev {
+	struct list_head lh;
+	struct block_cache_dev_stats stats;
+	lbaint_t next;
+	unsigned sequential;
+};
+
+static struct block_cache_node *block_cache;
+static unsigned nsets;
+static unsigned long age;
+static bool configured;
+static bool env_checked;
+static LIST_HEAD(block_cache_devs);
+
+static char *scratch;
+static unsigned long scratch_bytes;
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_blocks_per_entry = CONFIG_VAL(BLOCK_CACHE_BLOCKS),
+	.max_entries = CONFIG_VAL(BLOCK_CACHE_ENTRIES),
+	.ways = CONFIG_VAL(BLOCK_CACHE_WAYS),
+	.read_ahead = CONFIG_VAL(BLOCK_CACHE_READ_AHEAD),
 };
 
+static unsigned long cache_env(const char *name, unsigned long def)
+{
+#if !defined(CONFIG_SPL_BUILD) || CONFIG_IS_ENABLED(ENV_SUPPORT)
+	return env_get_ulong(name, 10, def);
+#else
+	return def;
+#endif
+}
+
+/* Whether the environment, and so any override, has been loaded */
+static bool cache_env_ready(void)
+{
+#if !defined(CONFIG_SPL_BUILD) || CONFIG_IS_ENABLED(ENV_SUPPORT)
+	return gd->flags & GD_FLG_ENV_READY;
+#else
+	return true;
+#endif
+}
+
+static void cache_free(void)
+{
+	unsigned i;
+
+	if (block_cache) {
+		for (i = 0; i < nsets * _stats.ways; i++)
+			free(block_cache[i].cache);
+		free(block_cache);
+		block_cache = NULL;
+	}
+	free(scratch);
+	scratch = NULL;
+	scratch_bytes = 0;
+	_stats.entries = 0;
+}
+
+static void cache_setup(unsigned blocks, unsigned entries, unsigned ways,
+			unsigned read_ahead)
+{
+	cache_free();
+	configured = true;
+
+	if (!ways)
+		ways = 1;
+	if (ways > entries)
+		ways = entries;
+
+	_stats.max_blocks_per_entry = blocks;
+	_stats.ways = ways;
+	_stats.read_ahead = read_ahead;
+	_stats.max_entries = 0;
+	nsets = 0;
+
+	if (!blocks || !entries)
+		return;
+
+	block_cache = calloc(entries - entries % ways, sizeof(*block_cache));
+	if (!block_cache)
+		return;
+
+	nsets = entries / ways;
+	_stats.max_entries = nsets * ways;
+}
+
+/*
+ * The cache is used before the environment is loaded, e.g. to read the
+ * environment itself from the device. Until then it runs with the built-in
+ * geometry, and the overrides are looked at again once it is loaded.
+ */
+static bool cache_enabled(void)
+{
+	unsigned blocks, entries, ways, read_ahead;
+
+	if (configured && (env_checked || !cache_env_ready()))
+		return _stats.max_entries != 0;
+
+	env_checked = cache_env_ready();
+	blocks = cache_env("blkcache_blocks", CONFIG_VAL(BLOCK_CACHE_BLOCKS));
+	entries = cache_env("blkcache_entries",
+			    CONFIG_VAL(BLOCK_CACHE_ENTRIES));
+	ways = cache_env("blkcache_ways", CONFIG_VAL(BLOCK_CACHE_WAYS));
+	read_ahead = cache_env("blkcache_readahead",
+			       CONFIG_VAL(BLOCK_CACHE_READ_AHEAD));
+
+	if (!configured || blocks != _stats.max_blocks_per_entry ||
+	    entries != _stats.max_entries || ways != _stats.ways)
+		cache_setup(blocks, entries, ways, read_ahead);
+	_stats.read_ahead = read_ahead;
+
+	return _stats.max_entries != 0;
+}
+
+static struct block_cache_dev *cache_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *dev;
+
+	list_for_each_entry(dev, &block_cache_devs, lh)
+		if (dev->stats.iftype == iftype && dev->stats.devnum == devnum)
+			return dev;
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		return NULL;
+
+	dev->stats.iftype = iftype;
+	dev->stats.devnum = devnum;
+	list_add_tail(&dev->lh, &block_cache_devs);
+
+	return dev;
+}
+
+static struct block_cache_node *cache_set(int iftype, int devnum,
+					  lbaint_t start)
+{
+	u32 hash;
+
+	hash = (u32)(start / _stats.max_blocks_per_entry);
+	hash ^= (u32)((u64)start >> 32);
+	hash ^= (iftype << 24) ^ (devnum << 16);
+	hash *= 0x9e3779b1;
+
+	return &block_cache[(hash >> 8) % nsets * _stats.ways];
+}
+
+/* Look up the line starting at @start, which must be line aligned */
 static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+					   lbaint_t start, unsigned long blksz)
 {
-	struct block_cache_node *node;
+	struct block_cache_node *node = cache_set(iftype, devnum, start);
+	unsigned i;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
+	for (i = 0; i < _stats.ways; i++, node++)
+		if (node->valid &&
+		    (node->iftype == iftype) &&
 		    (node->devnum == devnum) &&
 		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
+		    (node->start == start)) {
+			node->age = ++age;
 			return node;
 		}
-	return 0;
+
+	return NULL;
+}
+
+static struct block_cache_node *cache_victim(int iftype, int devnum,
+					     lbaint_t start)
+{
+	struct block_cache_node *node = cache_set(iftype, devnum, start);
+	struct block_cache_node *lru = node;
+	unsigned i;
+
+	for (i = 0; i < _stats.ways; i++, node++) {
+		if (!node->valid)
+			return node;
+		if (node->age < lru->age)
+			lru = node;
+	}
+
+	debug("drop: start " LBAF "\n", lru->start);
+	lru->valid = false;
+	_stats.entries--;
+
+	return lru;
+}
+
+static lbaint_t line_start(lbaint_t blk)
+{
+	return blk - (blk % _stats.max_blocks_per_entry);
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
+	unsigned long bpl = _stats.max_blocks_per_entry;
+	struct block_cache_node *node;
+	struct block_cache_dev *dev;
+	lbaint_t blk, first, count;
+	bool ahead = false;
+	char *dst = buffer;
+
+	if (!cache_enabled() || blkcnt > bpl)
+		return 0;
+
+	for (blk = line_start(start); blk < start + blkcnt; blk += bpl)
+		if (!cache_find(iftype, devnum, blk, blksz))
+			break;
+
+	dev = cache_dev(iftype, devnum);
+	if (blk < start + blkcnt) {
+		debug("miss: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+		++_stats.misses;
+		if (dev)
+			++dev->stats.misses;
+		return 0;
+	}
+
+	for (blk = line_start(start); blk < start + blkcnt; blk += bpl) {
+		node = cache_find(iftype, devnum, blk, blksz);
+		first = max(start, blk);
+		count = min(start + blkcnt, blk + bpl) - first;
+		memcpy(dst, node->cache + (first - blk) * blksz,
+		       count * blksz);
+		dst += count * blksz;
+		if (node->ahead) {
+			node->ahead = false;
+			ahead = true;
+		}
 	}
 
-	debug("miss: start " LBAF ", count " LBAFU "\n",
+	debug("hit: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
-	++_stats.misses;
-	return 0;
+	++_stats.hits;
+	if (dev) {
+		++dev->stats.hits;
+		if (ahead)
+			++dev->stats.read_ahead_hits;
+	}
+
+	return 1;
+}
+
+/* Cache every whole line of @buffer, flagging them if read ahead */
+static void cache_fill(int iftype, int devnum, lbaint_t start,
+		       lbaint_t blkcnt, unsigned long blksz,
+		       void const *buffer, bool ahead)
+{
+	unsigned long bpl = _stats.max_blocks_per_entry;
+	unsigned long bytes = blksz * bpl;
+	struct block_cache_node *node;
+	lbaint_t blk;
+
+	for (blk = line_start(start + bpl - 1); blk + bpl <= start + blkcnt;
+	     blk += bpl) {
+		node = cache_find(iftype, devnum, blk, blksz);
+		if (node) {
+			/* already cached; the device data cannot differ */
+			continue;
+		}
+
+		node = cache_victim(iftype, devnum, blk);
+		if (node->bytes < bytes) {
+			free(node->cache);
+			node->cache = malloc(bytes);
+			if (!node->cache) {
+				node->bytes = 0;
+				return;
+			}
+			node->bytes = bytes;
+		}
+
+		debug("fill: start " LBAF "\n", blk);
+		node->iftype = iftype;
+		node->devnum = devnum;
+		node->start = blk;
+		node->blksz = blksz;
+		node->age = ++age;
+		node->ahead = ahead;
+		node->valid = true;
+		memcpy(node->cache, buffer + (blk - start) * blksz, bytes);
+		_stats.entries++;
+	}
 }
 
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	if (cache_enabled())
+		cache_fill(iftype, devnum, start, blkcnt, blksz, buffer,
+			   false);
+}
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
-		return;
+unsigned long blkcache_dread(struct blk_desc *block_dev, lbaint_t start,
+			     lbaint_t blkcnt, void *buffer,
+			     blkcache_read_func read)
+{
+	unsigned long bpl = _stats.max_blocks_per_entry;
+	unsigned long blksz = block_dev->blksz;
+	int iftype = block_dev->if_type;
+	int devnum = block_dev->devnum;
+	struct block_cache_dev *dev;
+	lbaint_t first, last, ahead = 0;
+	unsigned long bytes;
 
-	if (_stats.max_entries == 0)
-		return;
+	if (blkcache_read(iftype, devnum, start, blkcnt, blksz, buffer)) {
+		dev = cache_dev(iftype, devnum);
+		if (dev)
+			dev->next = start + blkcnt;
+		return blkcnt;
+	}
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
+	/* Large reads are file data: pass them straight through */
+	if (!cache_enabled() || blkcnt > bpl)
+		return read(block_dev, start, blkcnt, buffer);
+
+	dev = cache_dev(iftype, devnum);
+	if (dev) {
+		if (start == dev->next)
+			dev->sequential++;
+		else
+			dev->sequential = 0;
+		dev->next = start + blkcnt;
 	}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
+	first = line_start(start);
+	last = line_start(start + blkcnt - 1) + bpl;
+	if (dev && dev->sequential && _stats.read_ahead)
+		ahead = roundup(_stats.read_ahead, bpl);
+	if (block_dev->lba) {
+		if (last > block_dev->lba)
+			last = block_dev->lba;
+		if (last + ahead > block_dev->lba)
+			ahead = block_dev->lba - last;
 	}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
+	bytes = (last - first + ahead) * blksz;
+	if (bytes > scratch_bytes) {
+		free(scratch);
+		scratch = memalign(ARCH_DMA_MINALIGN, bytes);
+		scratch_bytes = scratch ? bytes : 0;
+	}
+	if (!scratch || first + blkcnt > last ||
+	    read(block_dev, first, last - first + ahead, scratch) !=
+	    last - first + ahead)
+		return read(block_dev, start, blkcnt, buffer);
+
+	memcpy(buffer, scratch + (start - first) * blksz, blkcnt * blksz);
+	cache_fill(iftype, devnum, first, last - first, blksz, scratch,
+		   false);
+	if (ahead) {
+		cache_fill(iftype, devnum, last, ahead, blksz,
+			   scratch + (last - first) * blksz, true);
+		if (dev)
+			dev->stats.read_ahead_blocks += ahead;
+	}
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	return blkcnt;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+void blkcache_write(int iftype, int devnum,
+		    lbaint_t start, lbaint_t blkcnt,
+		    unsigned long blksz, void const *buffer)
 {
-	struct list_head *entry, *n;
 	struct block_cache_node *node;
+	lbaint_t first, last;
+	unsigned i;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+	if (!block_cache)
+		return;
+
+	for (i = 0; i < _stats.max_entries; i++) {
+		node = &block_cache[i];
+		if (!node->valid ||
+		    (node->iftype != iftype) ||
+		    (node->devnum != devnum))
+			continue;
+		if (node->blksz != blksz) {
+			node->valid = false;
+			_stats.entries--;
+			continue;
 		}
+
+		first = max(start, node->start);
+		last = min(start + blkcnt,
+			   node->start + _stats.max_blocks_per_entry);
+		if (first < last)
+			memcpy(node->cache + (first - node->start) * blksz,
+			       buffer + (first - start) * blksz,
+			       (last - first) * blksz);
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_invalidate(int iftype, int devnum)
 {
 	struct block_cache_node *node;
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
+	struct block_cache_dev *dev;
+	unsigned i;
+
+	for (i = 0; block_cache && i < _stats.max_entries; i++) {
+		node = &block_cache[i];
+		if (node->valid &&
+		    (node->iftype == iftype) &&
+		    (node->devnum == devnum)) {
+			node->valid = false;
+			--_stats.entries;
 		}
-		_stats.entries = 0;
 	}
 
-	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	list_for_each_entry(dev, &block_cache_devs, lh)
+		if (dev->stats.iftype == iftype &&
+		    dev->stats.devnum == devnum) {
+			dev->next = 0;
+			dev->sequential = 0;
+		}
+}
+
+void blkcache_configure(unsigned blocks, unsigned entries, unsigned ways,
+			unsigned read_ahead)
+{
+	struct block_cache_dev *dev;
+
+	/* An explicit geometry is not overridden from the environment */
+	env_checked = true;
+	if (!configured ||
+	    (blocks != _stats.max_blocks_per_entry) ||
+	    (entries != _stats.max_entries) ||
+	    (ways != _stats.ways))
+		cache_setup(blocks, entries, ways, read_ahead);
+
+	_stats.read_ahead = read_ahead;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	list_for_each_entry(dev, &block_cache_devs, lh) {
+		dev->stats.hits = 0;
+		dev->stats.misses = 0;
+		dev->stats.read_ahead_blocks = 0;
+		dev->stats.read_ahead_hits = 0;
+	}
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
+	cache_enabled();
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
 }
+
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats)
+{
+	struct block_cache_dev *dev;
+
+	list_for_each_entry(dev, &block_cache_devs, lh) {
+		if (index--)
+			continue;
+
+		memcpy(stats, &dev->stats, sizeof(*stats));
+		dev->stats.hits = 0;
+		dev->stats.misses = 0;
+		dev->stats.read_ahead_blocks = 0;
+		dev->stats.read_ahead_hits = 0;
+		return 0;
+	}
+
+	return -ENOENT;
+}
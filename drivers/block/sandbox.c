@@ -48,6 +48,7 @@ static unsigned long host_block_read(struct blk_desc *block_dev,
 		return -1;
 #endif
 
+	host_dev->reads++;
 	if (os_lseek(host_dev->fd, start * block_dev->blksz, OS_SEEK_SET) ==
 			-1) {
 		printf("ERROR: Invalid block %lx\n", start);
@@ -87,6 +88,54 @@ static unsigned long host_block_write(struct blk_desc *block_dev,
 }
 
 #ifdef CONFIG_BLK
+/*
+ * Requests are queued and carried out one per poll, so that callers see
+ * them in flight as they would on a DMA-capable controller.
+ */
+static int host_block_submit(struct udevice *dev, struct blk_req *req)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	list_add_tail(&req->queue, &host_dev->reqs);
+
+	return 0;
+}
+
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+	struct blk_req *req;
+
+	if (list_empty(&host_dev->reqs))
+		return 0;
+
+	req = list_first_entry(&host_dev->reqs, struct blk_req, queue);
+	list_del_init(&req->queue);
+	if (req->op == BLK_REQ_READ)
+		req->result = host_block_read(dev, req->start, req->blkcnt,
+					      req->buffer);
+	else
+		req->result = host_block_write(dev, req->start, req->blkcnt,
+					       req->buffer);
+	req->done = true;
+
+	return 0;
+}
+
+static void host_block_cancel(struct udevice *dev, struct blk_req *req)
+{
+	list_del_init(&req->queue);
+}
+
+static int host_block_probe(struct udevice *dev)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(dev);
+
+	INIT_LIST_HEAD(&host_dev->reqs);
+
+	return 0;
+}
+
 int host_dev_bind(int devnum, char *filename)
 {
 	struct host_block_dev *host_dev;
@@ -221,12 +270,16 @@ int host_get_dev_err(int devnum, struct blk_desc **blk_devp)
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
+	.cancel	= host_block_cancel,
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+	.probe		= host_block_probe,
 	.platdata_auto_alloc_size = sizeof(struct host_block_dev),
 };
 #else
@@ -14,9 +14,11 @@
 #include "sdram_soc64.h"
 #include <wait_bit.h>
 #include <asm/arch/firewall.h>
+#include <asm/arch/misc.h>
 #include <asm/arch/system_manager.h>
 #include <asm/arch/reset_manager.h>
 #include <asm/io.h>
+#include <asm/system.h>
 #include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -104,10 +106,22 @@ int poll_hmc_clock_status(void)
 				 SYSMGR_HMC_CLK_STATUS_MSK, true, 1000, false);
 }
 
-void sdram_clear_mem(phys_addr_t addr, phys_size_t size)
+/* Use DC ZVA instruction to clear memory to zeros by a cache line */
+static void sdram_zero_lines(phys_addr_t addr, phys_size_t size)
 {
 	phys_size_t i;
 
+	for (i = 0; i < size; i = i + CONFIG_SYS_CACHELINE_SIZE) {
+		asm volatile("dc zva, %0"
+		     :
+		     : "r"(addr)
+		     : "memory");
+		addr += CONFIG_SYS_CACHELINE_SIZE;
+	}
+}
+
+void sdram_clear_mem(phys_addr_t addr, phys_size_t size)
+{
 	if (addr % CONFIG_SYS_CACHELINE_SIZE) {
 		printf("DDR: address 0x%llx is not cacheline size aligned.\n",
 		       addr);
@@ -120,9 +134,81 @@ void sdram_clear_mem(phys_addr_t addr, phys_size_t size)
 		hang();
 	}
 
-	/* Use DC ZVA instruction to clear memory to zeros by a cache line */
+	sdram_zero_lines(addr, size);
+}
+
+/* Clear a range 1GB at a time, servicing the watchdog in between */
+static void sdram_clear_range(phys_addr_t start_addr, phys_size_t size)
+{
+	phys_size_t size_init;
+
+	while (size) {
+		size_init = min((phys_addr_t)SZ_1G, (phys_addr_t)size);
+		sdram_clear_mem(start_addr, size_init);
+		size -= size_init;
+		start_addr += size_init;
+		WATCHDOG_RESET();
+	}
+}
+
+#if CONFIG_IS_ENABLED(ALTERA_SDRAM_ECC_SMP)
+#define ECC_NR_CPUS		CONFIG_ARMV8_PSCI_NR_CPUS
+
+enum {
+	ECC_PART_IDLE,
+	ECC_PART_STARTED,
+	ECC_PART_DONE,
+	ECC_PART_ABORTED,
+};
+
+/* The memory cleared by one CPU, in each bank */
+struct sdram_ecc_part {
+	phys_addr_t start[CONFIG_NR_DRAM_BANKS];
+	phys_size_t size[CONFIG_NR_DRAM_BANKS];
+	u64 ticks;
+	u32 state;
+} __aligned(CONFIG_SYS_CACHELINE_SIZE);
+
+/*
+ * Shared with the secondary CPUs, which only access it with their MMU off,
+ * so the boot CPU cleans or invalidates it around every access.
+ */
+static struct sdram_ecc_job {
+	u32 abort;
+	struct sdram_ecc_part part[ECC_NR_CPUS];
+} ecc_job __aligned(CONFIG_SYS_CACHELINE_SIZE) __section(.data);
+
+static u64 sdram_ecc_ticks(void)
+{
+	u64 cntpct;
+
+	isb();
+	asm volatile("mrs %0, cntpct_el0" : "=r" (cntpct));
+
+	return cntpct;
+}
+
+static void sdram_ecc_sync(void *addr, size_t size, bool to_ram)
+{
+	if (to_ram)
+		flush_dcache_range((ulong)addr, (ulong)addr + size);
+	else
+		invalidate_dcache_range((ulong)addr, (ulong)addr + size);
+}
+
+/*
+ * Store zeros a cache line at a time. With the MMU off all of memory is
+ * Device memory, on which DC ZVA faults.
+ */
+static void sdram_zero_lines_uncached(phys_addr_t addr, phys_size_t size)
+{
+	phys_size_t i;
+
 	for (i = 0; i < size; i = i + CONFIG_SYS_CACHELINE_SIZE) {
-		asm volatile("dc zva, %0"
+		asm volatile("stp xzr, xzr, [%0]\n"
+			     "stp xzr, xzr, [%0, #16]\n"
+			     "stp xzr, xzr, [%0, #32]\n"
+			     "stp xzr, xzr, [%0, #48]"
 		     :
 		     : "r"(addr)
 		     : "memory");
@@ -130,42 +216,157 @@ void sdram_clear_mem(phys_addr_t addr, phys_size_t size)
 	}
 }
 
+/*
+ * Runs on a secondary CPU, without gd, on a small stack in OCRAM. The MMU
+ * and caches stay off, so the zeros go straight to SDRAM and nothing
+ * relies on this CPU being coherent with the boot CPU. The boot CPU never
+ * writes to this part; any clean line of it that the boot CPU has
+ * prefetched is dropped when it turns its data cache off.
+ */
+static void sdram_ecc_secondary(unsigned int cpu)
+{
+	struct sdram_ecc_part *part;
+	u64 start;
+	int bank;
+
+	if (cpu >= ECC_NR_CPUS)
+		return;
+
+	part = &ecc_job.part[cpu];
+	writel(ECC_PART_STARTED, &part->state);
+	dsb();
+	if (readl(&ecc_job.abort)) {
+		/* Too late, the boot CPU clears this part itself */
+		writel(ECC_PART_ABORTED, &part->state);
+		return;
+	}
+
+	start = sdram_ecc_ticks();
+
+	for (bank = 0; bank < CONFIG_NR_DRAM_BANKS; bank++)
+		sdram_zero_lines_uncached(part->start[bank], part->size[bank]);
+
+	part->ticks = sdram_ecc_ticks() - start;
+	dsb();
+	writel(ECC_PART_DONE, &part->state);
+}
+
+static void sdram_ecc_clear_part(struct sdram_ecc_part *part)
+{
+	int bank;
+
+	for (bank = 0; bank < CONFIG_NR_DRAM_BANKS; bank++)
+		sdram_clear_range(part->start[bank], part->size[bank]);
+}
+
+/*
+ * Split every bank between all CPUs and clear the boot CPU's part while
+ * the secondary CPUs clear theirs. A secondary CPU which has not picked up
+ * its part by the time the boot CPU is done gets it taken over.
+ */
+static void sdram_ecc_clear_smp(const phys_addr_t *start,
+				const phys_size_t *size)
+{
+	struct sdram_ecc_part *part;
+	phys_size_t chunk, off;
+	u64 ticks[ECC_NR_CPUS];
+	int bank, cpu;
+	u32 state;
+
+	memset(&ecc_job, 0, sizeof(ecc_job));
+
+	for (bank = 0; bank < CONFIG_NR_DRAM_BANKS; bank++) {
+		chunk = roundup(DIV_ROUND_UP(size[bank], ECC_NR_CPUS), SZ_1M);
+		for (cpu = 0; cpu < ECC_NR_CPUS; cpu++) {
+			part = &ecc_job.part[cpu];
+			off = min((phys_size_t)(cpu * chunk), size[bank]);
+			part->start[bank] = start[bank] + off;
+			part->size[bank] = min(chunk, size[bank] - off);
+		}
+	}
+
+	sdram_ecc_sync(&ecc_job, sizeof(ecc_job), true);
+	if (socfpga_secondary_start(sdram_ecc_secondary)) {
+		printf("SDRAM-ECC: No stacks for the other CPUs\n");
+		for (cpu = 0; cpu < ECC_NR_CPUS; cpu++)
+			sdram_ecc_clear_part(&ecc_job.part[cpu]);
+		return;
+	}
+
+	ticks[0] = sdram_ecc_ticks();
+	sdram_ecc_clear_part(&ecc_job.part[0]);
+	ticks[0] = sdram_ecc_ticks() - ticks[0];
+
+	writel(1, &ecc_job.abort);
+	sdram_ecc_sync(&ecc_job.abort, sizeof(ecc_job.abort), true);
+	dsb();
+
+	for (cpu = 1; cpu < ECC_NR_CPUS; cpu++) {
+		part = &ecc_job.part[cpu];
+		do {
+			WATCHDOG_RESET();
+			sdram_ecc_sync(part, sizeof(*part), false);
+			state = readl(&part->state);
+		} while (state == ECC_PART_STARTED);
+
+		if (state == ECC_PART_DONE) {
+			ticks[cpu] = part->ticks;
+		} else {
+			ticks[cpu] = sdram_ecc_ticks();
+			sdram_ecc_clear_part(part);
+			ticks[cpu] = sdram_ecc_ticks() - ticks[cpu];
+			printf("SDRAM-ECC: CPU%d did not start, cleared by CPU0\n",
+			       cpu);
+		}
+	}
+
+	socfpga_secondary_stop();
+
+	for (cpu = 0; cpu < ECC_NR_CPUS; cpu++)
+		printf("SDRAM-ECC: CPU%d done in %lu ms\n", cpu,
+		       (ulong)lldiv(ticks[cpu] * 1000, get_tbclk()));
+}
+#endif
+
 void sdram_init_ecc_bits(bd_t *bd)
 {
-	phys_size_t size, size_init;
-	phys_addr_t start_addr;
-	int bank = 0;
+	phys_size_t size[CONFIG_NR_DRAM_BANKS];
+	phys_addr_t start_addr[CONFIG_NR_DRAM_BANKS];
+	int bank;
 	unsigned int start = get_timer(0);
 
 	icache_enable();
 
-	start_addr = bd->bi_dram[0].start;
-	size = bd->bi_dram[0].size;
+	for (bank = 0; bank < CONFIG_NR_DRAM_BANKS; bank++) {
+		start_addr[bank] = bd->bi_dram[bank].start;
+		size[bank] = bd->bi_dram[bank].size;
+	}
 
 	/* Initialize small block for page table */
-	memset((void *)start_addr, 0, PGTABLE_SIZE + PGTABLE_OFF);
-	gd->arch.tlb_addr = start_addr + PGTABLE_OFF;
+	memset((void *)start_addr[0], 0, PGTABLE_SIZE + PGTABLE_OFF);
+	gd->arch.tlb_addr = start_addr[0] + PGTABLE_OFF;
 	gd->arch.tlb_size = PGTABLE_SIZE;
-	start_addr += PGTABLE_SIZE + PGTABLE_OFF;
-	size -= (PGTABLE_OFF + PGTABLE_SIZE);
+	start_addr[0] += PGTABLE_SIZE + PGTABLE_OFF;
+	size[0] -= (PGTABLE_OFF + PGTABLE_SIZE);
 	dcache_enable();
 
-	while (1) {
-		while (size) {
-			size_init = min((phys_addr_t)SZ_1G, (phys_addr_t)size);
-			sdram_clear_mem(start_addr, size_init);
-			size -= size_init;
-			start_addr += size_init;
-			WATCHDOG_RESET();
-		}
-
-		bank++;
-		if (bank >= CONFIG_NR_DRAM_BANKS)
-			break;
-
-		start_addr = bd->bi_dram[bank].start;
-		size = bd->bi_dram[bank].size;
+#if CONFIG_IS_ENABLED(ALTERA_SDRAM_ECC_SMP)
+	sdram_ecc_clear_smp(start_addr, size);
+#elif defined(CONFIG_ALTERA_SDRAM_ECC_LAZY)
+	/* Only the windows SPL and U-Boot use, U-Boot does the rest */
+	{
+		phys_addr_t low_end, high_start;
+
+		sdram_ecc_lazy_window(bd, &low_end, &high_start);
+		sdram_clear_range(start_addr[0], low_end - start_addr[0]);
+		sdram_clear_range(high_start, start_addr[0] + size[0] -
+				  high_start);
+		sdram_ecc_lazy_set_pending(true);
 	}
+#else
+	for (bank = 0; bank < CONFIG_NR_DRAM_BANKS; bank++)
+		sdram_clear_range(start_addr[bank], size[bank]);
+#endif
 
 	dcache_disable();
 	icache_disable();
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Copyright (C) 2019 Intel Corporation
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <dfu.h>
+#include <asm/arch/rsu.h>
+
+/*
+ * The slot is programmed as the data arrives: the first buffer opens the
+ * stream, every buffer is pushed to it and the flush at the end of the
+ * transfer commits the slot. Only one slot can be programmed at a time.
+ */
+static int dfu_get_medium_size_rsu(struct dfu_entity *dfu, u64 *size)
+{
+	puts("RSU slots cannot be uploaded\n");
+
+	return -EOPNOTSUPP;
+}
+
+static int dfu_read_medium_rsu(struct dfu_entity *dfu, u64 offset, void *buf,
+			       long *len)
+{
+	return -EOPNOTSUPP;
+}
+
+static int dfu_write_medium_rsu(struct dfu_entity *dfu,
+				u64 offset, void *buf, long *len)
+{
+	struct rsu_internal_data *rsu = &dfu->data.rsu;
+	int ret;
+
+	if (!offset) {
+		/* a previous transfer was aborted by the host */
+		if (rsu->open)
+			rsu_slot_stream_close(1, NULL);
+		rsu->open = 0;
+
+		ret = rsu_slot_stream_open(rsu->slot, rsu->rawdata);
+		if (ret)
+			return ret;
+		rsu->open = 1;
+	}
+
+	if (!rsu->open)
+		return -EIO;
+
+	ret = rsu_slot_stream_write(buf, *len);
+	if (ret) {
+		rsu_slot_stream_close(1, NULL);
+		rsu->open = 0;
+	}
+
+	return ret;
+}
+
+static int dfu_flush_medium_rsu(struct dfu_entity *dfu)
+{
+	struct rsu_internal_data *rsu = &dfu->data.rsu;
+
+	if (!rsu->open)
+		return -EIO;
+
+	rsu->open = 0;
+
+	return rsu_slot_stream_close(0, NULL);
+}
+
+static unsigned int dfu_polltimeout_rsu(struct dfu_entity *dfu)
+{
+	return DFU_DEFAULT_POLL_TIMEOUT;
+}
+
+static void dfu_free_entity_rsu(struct dfu_entity *dfu)
+{
+	struct rsu_internal_data *rsu = &dfu->data.rsu;
+
+	if (rsu->open)
+		rsu_slot_stream_close(1, NULL);
+	rsu->open = 0;
+
+	if (rsu->initialized)
+		rsu_exit();
+	rsu->initialized = 0;
+}
+
+int dfu_fill_entity_rsu(struct dfu_entity *dfu, char *devstr, char *s)
+{
+	struct rsu_internal_data *rsu = &dfu->data.rsu;
+	char *st, *endp;
+	int ret;
+
+	dfu->dev_type = DFU_DEV_RSU;
+	dfu->layout = DFU_RAW_ADDR;
+
+	st = strsep(&s, " ");
+	if (!strcmp(st, "slot")) {
+		rsu->rawdata = 0;
+	} else if (!strcmp(st, "raw")) {
+		rsu->rawdata = 1;
+	} else {
+		printf("%s: Memory layout (%s) not supported!\n", __func__, st);
+		return -1;
+	}
+
+	if (!s || !*s) {
+		printf("%s: Missing slot number\n", __func__);
+		return -1;
+	}
+
+	rsu->slot = simple_strtoul(s, &endp, 0);
+	if (*endp) {
+		printf("%s: Invalid slot number %s\n", __func__, s);
+		return -1;
+	}
+
+	/* the rsu command may have set up the flash interface already */
+	rsu->initialized = 0;
+	rsu->open = 0;
+	ret = rsu_slot_count();
+	if (ret == -EINTF) {
+		if (rsu_init(NULL))
+			return -ENODEV;
+		rsu->initialized = 1;
+		ret = rsu_slot_count();
+	}
+
+	if (rsu->slot < 0 || rsu->slot >= ret) {
+		printf("%s: Invalid slot number %d\n", __func__, rsu->slot);
+		dfu_free_entity_rsu(dfu);
+		return -1;
+	}
+
+	dfu->get_medium_size = dfu_get_medium_size_rsu;
+	dfu->read_medium = dfu_read_medium_rsu;
+	dfu->write_medium = dfu_write_medium_rsu;
+	dfu->flush_medium = dfu_flush_medium_rsu;
+	dfu->poll_timeout = dfu_polltimeout_rsu;
+	dfu->free_entity = dfu_free_entity_rsu;
+
+	/* initial state */
+	dfu->inited = 0;
+
+	return 0;
+}
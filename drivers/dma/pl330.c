@@ -0,0 +1,423 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * ARM PrimeCell PL330 DMA controller driver
+ *
+ * Only the memory-to-memory and memory-to-device (fixed destination
+ * address) transfers issued through the uclass transfer() operation are
+ * supported. Each transfer is run on channel 0 by a small microcode
+ * program which is started from the manager thread through the debug
+ * instruction registers, then polled until the channel stops. With
+ * transfer_start() the caller gets on with other work while the channel
+ * runs, and only polls it in transfer_wait().
+ *
+ * Derived from linux/drivers/dma/pl330.c:
+ *	Copyright (C) 2010 Samsung Electronics Co. Ltd.
+ *	Jaswinder Singh <jassi.brar@samsung.com>
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <dma-uclass.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <reset.h>
+#include <watchdog.h>
+#include <asm/io.h>
+#include <asm/unaligned.h>
+#include <linux/log2.h>
+
+/* Register offsets */
+#define PL330_FSRC			0x034
+#define PL330_FTC(ch)			(0x040 + ((ch) << 2))
+#define PL330_CS(ch)			(0x100 + ((ch) << 3))
+#define PL330_DBGSTATUS			0xd00
+#define PL330_DBGCMD			0xd04
+#define PL330_DBGINST0			0xd08
+#define PL330_DBGINST1			0xd0c
+
+#define PL330_CS_STATE_MASK		0xf
+#define PL330_CS_STATE_STOPPED		0x0
+#define PL330_DBGSTATUS_BUSY		BIT(0)
+#define PL330_DBGINST0_CHAN_THREAD	BIT(0)
+
+/* Channel control register fields */
+#define PL330_CC_SRCINC			BIT(0)
+#define PL330_CC_SRCBRSTSIZE_SHIFT	1
+#define PL330_CC_SRCBRSTLEN_SHIFT	4
+#define PL330_CC_SRCPRI			BIT(8)
+#define PL330_CC_DSTINC			BIT(14)
+#define PL330_CC_DSTBRSTSIZE_SHIFT	15
+#define PL330_CC_DSTBRSTLEN_SHIFT	18
+#define PL330_CC_DSTPRI			BIT(22)
+
+/* Microcode instructions */
+#define PL330_CMD_DMAEND		0x00
+#define PL330_CMD_DMAKILL		0x01
+#define PL330_CMD_DMALD			0x04
+#define PL330_CMD_DMAST			0x08
+#define PL330_CMD_DMAWMB		0x13
+#define PL330_CMD_DMALP			0x20
+#define PL330_CMD_DMALPEND		0x28
+#define PL330_CMD_DMAGO			0xa0
+#define PL330_CMD_DMAMOV		0xbc
+
+#define PL330_LPEND_NOT_FOREVER		BIT(4)
+#define PL330_MOV_SAR			0
+#define PL330_MOV_CCR			1
+#define PL330_MOV_DAR			2
+
+/* Each burst moves 16 beats of 4 bytes, so the FPGA data port sees words */
+#define PL330_BEAT_SIZE			4
+#define PL330_BURST_LEN			16
+#define PL330_BURST_BYTES		(PL330_BEAT_SIZE * PL330_BURST_LEN)
+#define PL330_MAX_LOOP			256
+
+#define PL330_CHANNEL			0
+#define PL330_PROG_SIZE			64
+#define PL330_TIMEOUT_MS		1000
+
+/*
+ * @base:	Registers
+ * @prog:	Microcode buffer
+ * @busy:	A transfer has been started and not waited for
+ * @dst_inc:	The destination address increments, i.e. memory to memory
+ * @src:	Source address of the next program
+ * @dst:	Destination address of the next program
+ * @dst_start:	Destination address of the whole transfer
+ * @len:	Length of the whole transfer
+ * @bursts:	Bursts left for the next programs
+ * @singles:	Single beats after the bursts, done by the last program
+ */
+struct pl330_priv {
+	void __iomem *base;
+	u8 *prog;
+	bool busy;
+	bool dst_inc;
+	u32 src;
+	u32 dst;
+	u32 dst_start;
+	size_t len;
+	size_t bursts;
+	unsigned int singles;
+};
+
+static int pl330_emit_mov(u8 *buf, u8 reg, u32 val)
+{
+	buf[0] = PL330_CMD_DMAMOV;
+	buf[1] = reg;
+	put_unaligned_le32(val, &buf[2]);
+
+	return 6;
+}
+
+static int pl330_emit_lp(u8 *buf, int loop, unsigned int count)
+{
+	buf[0] = PL330_CMD_DMALP | (loop << 1);
+	buf[1] = count - 1;
+
+	return 2;
+}
+
+static int pl330_emit_lpend(u8 *buf, int loop, u8 bjump)
+{
+	buf[0] = PL330_CMD_DMALPEND | PL330_LPEND_NOT_FOREVER | (loop << 2);
+	buf[1] = bjump;
+
+	return 2;
+}
+
+static u32 pl330_ccr(bool dst_inc, unsigned int burst_len)
+{
+	u32 ccr = PL330_CC_SRCINC | PL330_CC_SRCPRI | PL330_CC_DSTPRI;
+
+	if (dst_inc)
+		ccr |= PL330_CC_DSTINC;
+
+	ccr |= ilog2(PL330_BEAT_SIZE) << PL330_CC_SRCBRSTSIZE_SHIFT;
+	ccr |= ilog2(PL330_BEAT_SIZE) << PL330_CC_DSTBRSTSIZE_SHIFT;
+	ccr |= (burst_len - 1) << PL330_CC_SRCBRSTLEN_SHIFT;
+	ccr |= (burst_len - 1) << PL330_CC_DSTBRSTLEN_SHIFT;
+
+	return ccr;
+}
+
+/*
+ * Build a program moving @outer * @inner bursts followed by @singles
+ * single beats, starting at @src and @dst. Returns the program length.
+ */
+static int pl330_build_prog(u8 *buf, u32 src, u32 dst, bool dst_inc,
+			    unsigned int outer, unsigned int inner,
+			    unsigned int singles)
+{
+	int off = 0, lp0, lp1;
+
+	off += pl330_emit_mov(&buf[off], PL330_MOV_SAR, src);
+	off += pl330_emit_mov(&buf[off], PL330_MOV_DAR, dst);
+
+	if (outer && inner) {
+		off += pl330_emit_mov(&buf[off], PL330_MOV_CCR,
+				      pl330_ccr(dst_inc, PL330_BURST_LEN));
+		off += pl330_emit_lp(&buf[off], 1, outer);
+		lp1 = off;
+		off += pl330_emit_lp(&buf[off], 0, inner);
+		lp0 = off;
+		buf[off++] = PL330_CMD_DMALD;
+		buf[off++] = PL330_CMD_DMAST;
+		off += pl330_emit_lpend(&buf[off], 0, off - lp0);
+		off += pl330_emit_lpend(&buf[off], 1, off - lp1);
+	}
+
+	if (singles) {
+		off += pl330_emit_mov(&buf[off], PL330_MOV_CCR,
+				      pl330_ccr(dst_inc, 1));
+		off += pl330_emit_lp(&buf[off], 0, singles);
+		lp0 = off;
+		buf[off++] = PL330_CMD_DMALD;
+		buf[off++] = PL330_CMD_DMAST;
+		off += pl330_emit_lpend(&buf[off], 0, off - lp0);
+	}
+
+	/* Make sure the last write has landed before the channel stops */
+	buf[off++] = PL330_CMD_DMAWMB;
+	buf[off++] = PL330_CMD_DMAEND;
+
+	return off;
+}
+
+/* Execute a single instruction through the debug interface */
+static int pl330_exec_dbg(struct pl330_priv *priv, const u8 *insn,
+			  bool on_channel)
+{
+	u32 val;
+
+	if (readl(priv->base + PL330_DBGSTATUS) & PL330_DBGSTATUS_BUSY)
+		return -EBUSY;
+
+	val = (insn[0] << 16) | (insn[1] << 24);
+	if (on_channel)
+		val |= PL330_DBGINST0_CHAN_THREAD | (PL330_CHANNEL << 8);
+	writel(val, priv->base + PL330_DBGINST0);
+	writel(get_unaligned_le32(&insn[2]), priv->base + PL330_DBGINST1);
+	writel(0, priv->base + PL330_DBGCMD);
+
+	return 0;
+}
+
+/* Start the program in priv->prog on the channel */
+static int pl330_start_prog(struct pl330_priv *priv)
+{
+	u8 insn[6] = { 0 };
+
+	flush_dcache_range((ulong)priv->prog,
+			   (ulong)priv->prog + PL330_PROG_SIZE);
+
+	/* DMAGO on the secure channel, issued by the manager thread */
+	insn[0] = PL330_CMD_DMAGO;
+	insn[1] = PL330_CHANNEL;
+	put_unaligned_le32((u32)(uintptr_t)priv->prog, &insn[2]);
+
+	return pl330_exec_dbg(priv, insn, false);
+}
+
+/* Wait for the channel to stop, killing it on a fault or a timeout */
+static int pl330_wait_prog(struct pl330_priv *priv)
+{
+	u8 insn[6] = { 0 };
+	unsigned long start;
+	u32 cs;
+
+	start = get_timer(0);
+	for (;;) {
+		if (readl(priv->base + PL330_FSRC) & BIT(PL330_CHANNEL)) {
+			pr_err("PL330: channel fault 0x%08x\n",
+			       readl(priv->base + PL330_FTC(PL330_CHANNEL)));
+			break;
+		}
+
+		cs = readl(priv->base + PL330_CS(PL330_CHANNEL));
+		if ((cs & PL330_CS_STATE_MASK) == PL330_CS_STATE_STOPPED)
+			return 0;
+
+		if (get_timer(start) > PL330_TIMEOUT_MS) {
+			pr_err("PL330: transfer timeout\n");
+			break;
+		}
+
+		WATCHDOG_RESET();
+	}
+
+	insn[0] = PL330_CMD_DMAKILL;
+	pl330_exec_dbg(priv, insn, true);
+
+	return -EIO;
+}
+
+/* Build and start the program for the next part of the transfer */
+static int pl330_next_prog(struct pl330_priv *priv)
+{
+	unsigned int outer, inner;
+	size_t step;
+	int ret;
+
+	/* One program covers at most 256 x 256 bursts */
+	if (priv->bursts >= PL330_MAX_LOOP) {
+		inner = PL330_MAX_LOOP;
+		outer = min_t(size_t, priv->bursts / PL330_MAX_LOOP,
+			      PL330_MAX_LOOP);
+	} else {
+		inner = priv->bursts;
+		outer = 1;
+	}
+	priv->bursts -= outer * inner;
+	step = outer * inner * PL330_BURST_BYTES;
+
+	pl330_build_prog(priv->prog, priv->src, priv->dst, priv->dst_inc,
+			 outer, inner, priv->bursts ? 0 : priv->singles);
+	ret = pl330_start_prog(priv);
+	if (ret)
+		return ret;
+
+	priv->src += step;
+	if (priv->dst_inc)
+		priv->dst += step;
+
+	return 0;
+}
+
+static int pl330_transfer_start(struct udevice *dev, int direction,
+				void *dst, void *src, size_t len)
+{
+	struct pl330_priv *priv = dev_get_priv(dev);
+	bool dst_inc = direction == DMA_MEM_TO_MEM;
+	u32 s = (u32)(uintptr_t)src;
+	u32 d = (u32)(uintptr_t)dst;
+	int ret;
+
+	if (priv->busy)
+		return -EBUSY;
+
+	if (direction != DMA_MEM_TO_MEM && direction != DMA_MEM_TO_DEV)
+		return -EINVAL;
+
+	/* Only word sized beats are issued, callers handle any tail */
+	if ((s | d | len) & (PL330_BEAT_SIZE - 1))
+		return -EINVAL;
+
+	flush_dcache_range(rounddown(s, ARCH_DMA_MINALIGN),
+			   roundup(s + len, ARCH_DMA_MINALIGN));
+	/* Don't let dirty lines be written back over the copied data */
+	if (dst_inc)
+		flush_dcache_range(rounddown(d, ARCH_DMA_MINALIGN),
+				   roundup(d + len, ARCH_DMA_MINALIGN));
+
+	priv->dst_inc = dst_inc;
+	priv->src = s;
+	priv->dst = d;
+	priv->dst_start = d;
+	priv->len = len;
+	priv->bursts = len / PL330_BURST_BYTES;
+	priv->singles = (len % PL330_BURST_BYTES) / PL330_BEAT_SIZE;
+
+	/* -EBUSY promises the caller that nothing was transferred */
+	ret = pl330_next_prog(priv);
+	if (ret)
+		return ret;
+	priv->busy = true;
+
+	return 0;
+}
+
+static int pl330_transfer_wait(struct udevice *dev)
+{
+	struct pl330_priv *priv = dev_get_priv(dev);
+	u32 d = priv->dst_start;
+	int ret;
+
+	if (!priv->busy)
+		return 0;
+
+	/* Longer transfers need more programs, run one after the other */
+	for (;;) {
+		ret = pl330_wait_prog(priv);
+		if (ret || !priv->bursts)
+			break;
+		ret = pl330_next_prog(priv);
+		if (ret) {
+			/* Some of the data has been sent already */
+			ret = -EIO;
+			break;
+		}
+	}
+	priv->busy = false;
+
+	if (!ret && priv->dst_inc)
+		invalidate_dcache_range(rounddown(d, ARCH_DMA_MINALIGN),
+					roundup(d + priv->len,
+						ARCH_DMA_MINALIGN));
+
+	return ret;
+}
+
+static int pl330_transfer(struct udevice *dev, int direction, void *dst,
+			  void *src, size_t len)
+{
+	int ret;
+
+	ret = pl330_transfer_start(dev, direction, dst, src, len);
+	if (ret)
+		return ret;
+
+	return pl330_transfer_wait(dev);
+}
+
+static int pl330_ofdata_to_platdata(struct udevice *dev)
+{
+	struct pl330_priv *priv = dev_get_priv(dev);
+
+	priv->base = dev_read_addr_ptr(dev);
+	if (!priv->base)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int pl330_probe(struct udevice *dev)
+{
+	struct dma_dev_priv *uc_priv = dev_get_uclass_priv(dev);
+	struct pl330_priv *priv = dev_get_priv(dev);
+	struct reset_ctl_bulk resets;
+	int ret;
+
+	ret = reset_get_bulk(dev, &resets);
+	if (!ret)
+		reset_deassert_bulk(&resets);
+
+	priv->prog = memalign(ARCH_DMA_MINALIGN, PL330_PROG_SIZE);
+	if (!priv->prog)
+		return -ENOMEM;
+
+	uc_priv->supported = DMA_SUPPORTS_MEM_TO_MEM | DMA_SUPPORTS_MEM_TO_DEV;
+
+	return 0;
+}
+
+static const struct dma_ops pl330_ops = {
+	.transfer	= pl330_transfer,
+	.transfer_start	= pl330_transfer_start,
+	.transfer_wait	= pl330_transfer_wait,
+};
+
+static const struct udevice_id pl330_ids[] = {
+	{ .compatible = "arm,pl330" },
+	{ }
+};
+
+U_BOOT_DRIVER(pl330) = {
+	.name	= "pl330",
+	.id	= UCLASS_DMA,
+	.of_match = pl330_ids,
+	.ops	= &pl330_ops,
+	.ofdata_to_platdata = pl330_ofdata_to_platdata,
+	.probe	= pl330_probe,
+	.priv_auto_alloc_size = sizeof(struct pl330_priv),
+};
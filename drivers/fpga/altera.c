@@ -24,6 +24,10 @@ static const struct altera_fpga {
 	int			(*load)(Altera_desc *, const void *, size_t);
 	int			(*dump)(Altera_desc *, const void *, size_t);
 	int			(*info)(Altera_desc *);
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+	int			(*loadfs)(Altera_desc *, const void *, size_t,
+					  fpga_fs_info *);
+#endif
 } altera_fpga[] = {
 #if defined(CONFIG_FPGA_ACEX1K)
 	{ Altera_ACEX1K, "ACEX1K", ACEX1K_load, ACEX1K_dump, ACEX1K_info },
@@ -41,10 +45,18 @@ static const struct altera_fpga {
 #endif
 #if defined(CONFIG_FPGA_INTEL_SDM_MAILBOX)
 	{ Intel_FPGA_SDM_Mailbox, "Intel SDM Mailbox", intel_sdm_mb_load, NULL,
-		NULL },
+		NULL,
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+	  intel_sdm_mb_loadfs,
+#endif
+	},
 #endif
 #if defined(CONFIG_FPGA_SOCFPGA)
-	{ Altera_SoCFPGA, "SoC FPGA", socfpga_load, NULL, NULL },
+	{ Altera_SoCFPGA, "SoC FPGA", socfpga_load, NULL, NULL,
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+	  socfpga_loadfs,
+#endif
+	},
 #endif
 };
 
@@ -112,6 +124,27 @@ int altera_load(Altera_desc *desc, const void *buf, size_t bsize)
 	return 0;
 }
 
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+int altera_loadfs(Altera_desc *desc, const void *buf, size_t bsize,
+		  fpga_fs_info *fpga_fsinfo)
+{
+	const struct altera_fpga *fpga = altera_desc_to_fpga(desc, __func__);
+
+	if (!fpga)
+		return FPGA_FAIL;
+
+	if (!fpga->loadfs) {
+		printf("%s: Missing loadfs operation for %s\n", __func__,
+		       fpga->name);
+		return FPGA_FAIL;
+	}
+
+	debug_cond(FPGA_DEBUG, "%s: Launching the %s file Loader...\n",
+		   __func__, fpga->name);
+	return fpga->loadfs(desc, buf, bsize, fpga_fsinfo);
+}
+#endif
+
 int altera_dump(Altera_desc *desc, const void *buf, size_t bsize)
 {
 	const struct altera_fpga *fpga = altera_desc_to_fpga(desc, __func__);
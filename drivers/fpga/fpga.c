@@ -9,6 +9,8 @@
 #include <xilinx.h>             /* xilinx specific definitions */
 #include <altera.h>             /* altera specific definitions */
 #include <lattice.h>
+#include <asm/unaligned.h>
+#include <linux/sizes.h>
 
 /* Local definitions */
 #ifndef CONFIG_MAX_FPGA_DEVICES
@@ -18,6 +20,7 @@
 /* Local static data */
 static int next_desc = FPGA_INVALID_DEVICE;
 static fpga_desc desc_table[CONFIG_MAX_FPGA_DEVICES];
+static bool fpga_force;
 
 /*
  * fpga_no_sup
@@ -130,6 +133,21 @@ void fpga_init(void)
 	debug("%s\n", __func__);
 }
 
+/*
+ * fpga_set_force
+ * Make the following loads program the device even if its driver knows
+ * that it holds the very same bitstream ('fpga load -f').
+ */
+void fpga_set_force(bool force)
+{
+	fpga_force = force;
+}
+
+bool fpga_get_force(void)
+{
+	return fpga_force;
+}
+
 /*
  * fpga_count
  * Basic interface function to get the current number of devices available.
@@ -179,6 +197,51 @@ int __weak fpga_is_partial_data(int devnum, size_t img_len)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+/* Output window used while inflating a gzip compressed bitstream */
+#define FPGA_GZIP_WINDOW	SZ_256K
+#define FPGA_LZ4F_MAGIC		0x184d2204
+
+bool fpga_is_compressed(const void *buf, size_t bsize)
+{
+	const u8 *p = buf;
+
+	if (bsize < 4)
+		return false;
+
+	if (p[0] == 0x1f && p[1] == 0x8b)
+		return true;
+
+	if (IS_ENABLED(CONFIG_ZSTD) && zstd_is_compressed(buf, bsize))
+		return true;
+
+	return IS_ENABLED(CONFIG_LZ4) &&
+	       get_unaligned_le32(p) == FPGA_LZ4F_MAGIC;
+}
+
+int fpga_decompress(const void *buf, size_t bsize,
+		    int (*write)(void *priv, const void *data, size_t len),
+		    void *priv)
+{
+	const u8 *p = buf;
+
+	if (p[0] == 0x1f && p[1] == 0x8b)
+		return gunzip_stream((unsigned char *)buf, bsize,
+				     FPGA_GZIP_WINDOW, write, priv);
+
+#if defined(CONFIG_LZ4)
+	if (get_unaligned_le32(p) == FPGA_LZ4F_MAGIC)
+		return ulz4fn_stream(buf, bsize, write, priv);
+#endif
+#if defined(CONFIG_ZSTD)
+	if (zstd_is_compressed(buf, bsize))
+		return zstd_decompress_stream(buf, bsize, write, priv);
+#endif
+
+	return -EPROTONOSUPPORT;
+}
+#endif
+
 /*
  * Convert bitstream data and load into the fpga
  */
@@ -205,6 +268,14 @@ int fpga_fsload(int devnum, const void *buf, size_t size,
 						fpga_fsinfo);
 #else
 			fpga_no_sup((char *)__func__, "Xilinx devices");
+#endif
+			break;
+		case fpga_altera:
+#if defined(CONFIG_FPGA_ALTERA)
+			ret_val = altera_loadfs(desc->devdesc, buf, size,
+						fpga_fsinfo);
+#else
+			fpga_no_sup((char *)__func__, "Altera devices");
 #endif
 			break;
 		default:
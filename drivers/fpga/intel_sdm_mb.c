@@ -5,6 +5,12 @@
 
 #include <common.h>
 #include <altera.h>
+#include <bootstage.h>
+#include <div64.h>
+#include <fs.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <watchdog.h>
 #include <asm/arch/mailbox_s10.h>
 
 #define RECONFIG_STATUS_POLL_RESP_TIMEOUT_MS		60000
@@ -44,51 +50,6 @@ static const char *mbox_cfgstat_to_str(int err)
 	return mbox_cfgstat_state[MBOX_CFGSTAT_MAX - 1].error_name;
 }
 
-/*
- * Add the ongoing transaction's command ID into pending list and return
- * the command ID for next transfer.
- */
-static u8 add_transfer(u32 *xfer_pending_list, size_t list_size, u8 id)
-{
-	int i;
-
-	for (i = 0; i < list_size; i++) {
-		if (xfer_pending_list[i])
-			continue;
-		xfer_pending_list[i] = id;
-		debug("ID(%d) added to transaction pending list\n", id);
-		/*
-		 * Increment command ID for next transaction.
-		 * Valid command ID (4 bits) is from 1 to 15.
-		 */
-		id = (id % 15) + 1;
-		break;
-	}
-
-	return id;
-}
-
-/*
- * Check whether response ID match the command ID in the transfer
- * pending list. If a match is found in the transfer pending list,
- * it clears the transfer pending list and return the matched
- * command ID.
- */
-static int get_and_clr_transfer(u32 *xfer_pending_list, size_t list_size,
-				u8 id)
-{
-	int i;
-
-	for (i = 0; i < list_size; i++) {
-		if (id != xfer_pending_list[i])
-			continue;
-		xfer_pending_list[i] = 0;
-		return id;
-	}
-
-	return 0;
-}
-
 /*
  * Polling the FPGA configuration status.
  * Return 0 for success, non-zero for error.
@@ -162,90 +123,313 @@ static u32 get_resp_hdr(u32 *r_index, u32 *w_index, u32 *resp_count,
 	return mbox_hdr;
 }
 
-/* Send bit stream data to SDM via RECONFIG_DATA mailbox command */
-static int send_reconfig_data(const void *rbf_data, size_t rbf_size,
-			      u32 xfer_max, u32 buf_size_max)
+/* One RECONFIG_DATA descriptor owned by the SDM */
+struct sdm_xfer {
+	bool busy;
+	void *buf;		/* staging buffer, for a producer */
+	ulong start;
+	u32 tag;		/* which piece of the bitstream it belongs to */
+};
+
+struct sdm_xfer_stats {
+	u32 count;
+	ulong lat_min;
+	ulong lat_max;
+	u64 lat_total;
+};
+
+/*
+ * RECONFIG_DATA descriptors in flight, up to
+ * CONFIG_FPGA_INTEL_SDM_MAILBOX_XFERS of them. Descriptor slot i always
+ * uses command ID i + 1, valid command IDs (4 bits) being 1 to 15.
+ */
+struct sdm_pipe {
+	struct sdm_xfer xfer[15];
+	struct sdm_xfer_stats stats;
+	u32 resp_buf[MBOX_RESP_BUFFER_SIZE];
+	u32 resp_rindex;
+	u32 resp_windex;
+	u32 resp_count;
+	u32 xfer_max;
+	u32 buf_size_max;
+	u32 xfer_count;
+	bool waiting;
+	int err;
+};
+
+static void sdm_xfer_done(struct sdm_xfer_stats *stats, struct sdm_xfer *xfer)
 {
-	u32 response_buffer[MBOX_RESP_BUFFER_SIZE];
-	u32 xfer_pending[MBOX_RESP_BUFFER_SIZE];
-	u32 resp_rindex = 0;
-	u32 resp_windex = 0;
-	u32 resp_count = 0;
-	u32 xfer_count = 0;
-	int resp_err = 0;
-	u8 cmd_id = 1;
-	u32 args[3];
-	int ret;
+	ulong lat = timer_get_us() - xfer->start;
+
+	if (!stats->count || lat < stats->lat_min)
+		stats->lat_min = lat;
+	if (lat > stats->lat_max)
+		stats->lat_max = lat;
+	stats->lat_total += lat;
+	stats->count++;
+	bootstage_accum_time(BOOTSTAGE_ID_ACCUM_FPGA_SDM_XFER, "fpga_sdm_xfer",
+			     lat);
+	xfer->busy = false;
+}
+
+/* Account the time spent waiting for the SDM to release a buffer */
+static void sdm_xfer_wait(bool *waiting, bool wait)
+{
+	if (wait == *waiting)
+		return;
+
+	if (wait)
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FPGA_SDM_WAIT,
+				"fpga_sdm_wait");
+	else
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FPGA_SDM_WAIT);
+	*waiting = wait;
+}
 
+static int sdm_pipe_init(struct sdm_pipe *pipe, u32 xfer_max,
+			 u32 buf_size_max)
+{
 	debug("SDM xfer_max = %d\n", xfer_max);
 	debug("SDM buf_size_max = %x\n\n", buf_size_max);
 
-	memset(xfer_pending, 0, sizeof(xfer_pending));
-
-	while (rbf_size || xfer_count) {
-		if (!resp_err && rbf_size && xfer_count < xfer_max) {
-			args[0] = MBOX_ARG_DESC_COUNT(1);
-			args[1] = (u64)rbf_data;
-			if (rbf_size >= buf_size_max) {
-				args[2] = buf_size_max;
-				rbf_size -= buf_size_max;
-				rbf_data += buf_size_max;
-			} else {
-				args[2] = (u64)rbf_size;
-				rbf_size = 0;
-			}
-
-			resp_err = mbox_send_cmd_only(cmd_id, MBOX_RECONFIG_DATA,
-						 MBOX_CMD_INDIRECT, 3, args);
-			if (!resp_err) {
-				xfer_count++;
-				cmd_id = add_transfer(xfer_pending,
-						      MBOX_RESP_BUFFER_SIZE,
-						      cmd_id);
-			}
-			puts(".");
-		} else {
-			u32 resp_hdr = get_resp_hdr(&resp_rindex, &resp_windex,
-						    &resp_count,
-						    response_buffer,
-						    MBOX_RESP_BUFFER_SIZE,
-						    MBOX_CLIENT_ID_UBOOT);
-
-			/*
-			 * If no valid response header found or
-			 * non-zero length from RECONFIG_DATA
-			 */
-			if (!resp_hdr || MBOX_RESP_LEN_GET(resp_hdr))
-				continue;
-
-			/* Check for response's status */
-			if (!resp_err) {
-				resp_err = MBOX_RESP_ERR_GET(resp_hdr);
-				debug("Response error code: %08x\n", resp_err);
-			}
-
-			ret = get_and_clr_transfer(xfer_pending,
-						   MBOX_RESP_BUFFER_SIZE,
-						   MBOX_RESP_ID_GET(resp_hdr));
-			if (ret) {
-				/* Claim and reuse the ID */
-				cmd_id = (u8)ret;
-				xfer_count--;
-			}
-
-			if (resp_err && !xfer_count)
-				return resp_err;
-		}
+	memset(pipe, 0, sizeof(*pipe));
+	pipe->xfer_max = min3(xfer_max, (u32)ARRAY_SIZE(pipe->xfer),
+			      (u32)CONFIG_FPGA_INTEL_SDM_MAILBOX_XFERS);
+	pipe->buf_size_max = buf_size_max;
+	if (!pipe->xfer_max || !buf_size_max)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Handle the next response from the SDM, if there is one */
+static void sdm_pipe_poll(struct sdm_pipe *pipe)
+{
+	u32 resp_hdr, id;
+
+	resp_hdr = get_resp_hdr(&pipe->resp_rindex, &pipe->resp_windex,
+				&pipe->resp_count, pipe->resp_buf,
+				MBOX_RESP_BUFFER_SIZE, MBOX_CLIENT_ID_UBOOT);
+
+	/* If no valid response header found or non-zero length */
+	if (!resp_hdr || MBOX_RESP_LEN_GET(resp_hdr))
+		return;
+
+	/* Check for response's status */
+	if (!pipe->err) {
+		pipe->err = MBOX_RESP_ERR_GET(resp_hdr);
+		debug("Response error code: %08x\n", pipe->err);
 	}
 
+	id = MBOX_RESP_ID_GET(resp_hdr);
+	if (id && id <= pipe->xfer_max && pipe->xfer[id - 1].busy) {
+		sdm_xfer_done(&pipe->stats, &pipe->xfer[id - 1]);
+		pipe->xfer_count--;
+		sdm_xfer_wait(&pipe->waiting, false);
+	}
+}
+
+/* Wait for the SDM to release a descriptor slot, and return it in @slot */
+static int sdm_pipe_get_slot(struct sdm_pipe *pipe, int *slot)
+{
+	int i;
+
+	while (!pipe->err && pipe->xfer_count >= pipe->xfer_max) {
+		/* Every buffer is owned by the SDM */
+		sdm_xfer_wait(&pipe->waiting, true);
+		sdm_pipe_poll(pipe);
+	}
+	if (pipe->err)
+		return pipe->err;
+
+	for (i = 0; pipe->xfer[i].busy; i++)
+		;
+	*slot = i;
+
+	return 0;
+}
+
+/* Hand @len bytes at @data to the SDM, with the descriptor in @slot */
+static int sdm_pipe_send(struct sdm_pipe *pipe, int slot, const void *data,
+			 size_t len, u32 tag)
+{
+	u32 args[3];
+
+	args[0] = MBOX_ARG_DESC_COUNT(1);
+	args[1] = (u64)data;
+	args[2] = len;
+
+	pipe->err = mbox_send_cmd_only(slot + 1, MBOX_RECONFIG_DATA,
+				       MBOX_CMD_INDIRECT, 3, args);
+	if (pipe->err)
+		return pipe->err;
+
+	debug("ID(%d) sent\n", slot + 1);
+	pipe->xfer[slot].busy = true;
+	pipe->xfer[slot].start = timer_get_us();
+	pipe->xfer[slot].tag = tag;
+	pipe->xfer_count++;
+	puts(".");
+
 	return 0;
 }
 
 /*
- * This is the interface used by FPGA driver.
- * Return 0 for success, non-zero for error.
+ * Send @size bytes at @data in place, in descriptors of at most @max bytes,
+ * tagged with @tag. The data must stay there until the SDM releases them.
  */
-int intel_sdm_mb_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
+static int sdm_pipe_write(struct sdm_pipe *pipe, const void *data,
+			  size_t size, size_t max, u32 tag)
+{
+	size_t len;
+	int slot;
+	int ret;
+
+	while (size) {
+		ret = sdm_pipe_get_slot(pipe, &slot);
+		if (ret)
+			return ret;
+
+		len = min(size, max);
+		ret = sdm_pipe_send(pipe, slot, data, len, tag);
+		if (ret)
+			return ret;
+		data += len;
+		size -= len;
+	}
+
+	return 0;
+}
+
+/* Check whether the SDM still owns a descriptor tagged with @tag */
+static bool sdm_pipe_busy(struct sdm_pipe *pipe, u32 tag)
+{
+	int i;
+
+	for (i = 0; i < pipe->xfer_max; i++) {
+		if (pipe->xfer[i].busy && pipe->xfer[i].tag == tag)
+			return true;
+	}
+
+	return false;
+}
+
+/* Wait for the SDM to release every descriptor and return the first error */
+static int sdm_pipe_finish(struct sdm_pipe *pipe)
+{
+	sdm_xfer_wait(&pipe->waiting, false);
+	while (pipe->xfer_count)
+		sdm_pipe_poll(pipe);
+
+	if (pipe->stats.count)
+		debug("SDM buffers: %u, latency min/avg/max = %lu/%lu/%lu us\n",
+		      pipe->stats.count, pipe->stats.lat_min,
+		      (ulong)lldiv(pipe->stats.lat_total, pipe->stats.count),
+		      pipe->stats.lat_max);
+
+	return pipe->err;
+}
+
+/*
+ * Send a bit stream which @produce writes into the staging buffers of the
+ * descriptors. The next chunk is read as soon as the SDM releases one of
+ * them, while it consumes the others.
+ */
+static int send_reconfig_produced(struct sdm_pipe *pipe,
+				  int (*produce)(void *priv, void *buf,
+						 size_t size),
+				  void *priv, size_t buf_size)
+{
+	void *buf;
+	int len, slot;
+
+	while (!sdm_pipe_get_slot(pipe, &slot)) {
+		buf = pipe->xfer[slot].buf;
+
+		bootstage_start(BOOTSTAGE_ID_ACCUM_FPGA_SDM_FILL,
+				"fpga_sdm_fill");
+		len = produce(priv, buf, min_t(size_t, buf_size,
+					       pipe->buf_size_max));
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_FPGA_SDM_FILL);
+		if (len <= 0) {
+			pipe->err = len;
+			break;
+		}
+
+		/* The CPU wrote the chunk, make sure the SDM sees it */
+		flush_dcache_range((ulong)buf, roundup((ulong)buf + len,
+						       ARCH_DMA_MINALIGN));
+		if (sdm_pipe_send(pipe, slot, buf, len, 0))
+			break;
+	}
+
+	return sdm_pipe_finish(pipe);
+}
+
+/* Send an in-memory bit stream to SDM, in place */
+static int send_reconfig_data(const void *rbf_data, size_t rbf_size,
+			      u32 xfer_max, u32 buf_size_max)
+{
+	struct sdm_pipe pipe;
+	int ret;
+
+	if (!rbf_size)
+		return 0;
+
+	ret = sdm_pipe_init(&pipe, xfer_max, buf_size_max);
+	if (ret)
+		return ret;
+
+	/* An error is kept in the pipe, for sdm_pipe_finish() */
+	sdm_pipe_write(&pipe, rbf_data, rbf_size, buf_size_max, 0);
+
+	return sdm_pipe_finish(&pipe);
+}
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+struct sdm_mb_stream {
+	u32 xfer_max;
+	u32 buf_size_max;
+};
+
+/*
+ * Send one decompressed chunk. send_reconfig_data() only returns once the
+ * SDM has acknowledged every descriptor, so the window can be reused.
+ */
+static int send_reconfig_chunk(void *priv, const void *data, size_t len)
+{
+	struct sdm_mb_stream *stream = priv;
+
+	/* The chunk was written by the CPU, make sure the SDM sees it */
+	flush_dcache_range((ulong)data,
+			   roundup((ulong)data + len, ARCH_DMA_MINALIGN));
+
+	return send_reconfig_data(data, len, stream->xfer_max,
+				  stream->buf_size_max);
+}
+#endif
+
+/* Send a plain or, if supported, a compressed bitstream to SDM */
+static int send_reconfig_bitstream(const void *rbf_data, size_t rbf_size,
+				   u32 xfer_max, u32 buf_size_max)
+{
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+	if (fpga_is_compressed(rbf_data, rbf_size)) {
+		struct sdm_mb_stream stream = {
+			.xfer_max = xfer_max,
+			.buf_size_max = buf_size_max,
+		};
+
+		return fpga_decompress(rbf_data, rbf_size, send_reconfig_chunk,
+				       &stream);
+	}
+#endif
+
+	return send_reconfig_data(rbf_data, rbf_size, xfer_max, buf_size_max);
+}
+
+/* Enter configuration mode and get the SDM transfer limits */
+static int sdm_reconfig_start(u32 *xfer_max, u32 *buf_size_max)
 {
 	int ret;
 	u32 resp_len = 2;
@@ -259,7 +443,14 @@ int intel_sdm_mb_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
 		return ret;
 	}
 
-	ret = send_reconfig_data(rbf_data, rbf_size, resp_buf[0], resp_buf[1]);
+	*xfer_max = resp_buf[0];
+	*buf_size_max = resp_buf[1];
+
+	return 0;
+}
+
+static int sdm_reconfig_finish(int ret)
+{
 	if (ret) {
 		printf("RECONFIG_DATA error: %08x, %s\n", ret,
 		       mbox_cfgstat_to_str(ret));
@@ -281,3 +472,161 @@ int intel_sdm_mb_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
 
 	return ret;
 }
+
+/*
+ * This is the interface used by FPGA driver.
+ * Return 0 for success, non-zero for error.
+ */
+int intel_sdm_mb_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
+{
+	u32 xfer_max, buf_size_max;
+	int ret;
+
+	ret = sdm_reconfig_start(&xfer_max, &buf_size_max);
+	if (ret)
+		return ret;
+
+	ret = send_reconfig_bitstream(rbf_data, rbf_size, xfer_max,
+				      buf_size_max);
+
+	return sdm_reconfig_finish(ret);
+}
+
+/*
+ * Load a bitstream which is produced in chunks, e.g. read from QSPI or MMC.
+ * @produce fills at most @size bytes of @buf and returns the number of bytes
+ * written, 0 at the end of the bitstream or a negative error code. It is
+ * called again as soon as the SDM has released one of the
+ * CONFIG_FPGA_INTEL_SDM_MAILBOX_XFERS staging buffers, each @buf_size bytes
+ * large, which are allocated here.
+ * Return 0 for success, non-zero for error.
+ */
+int intel_sdm_mb_load_stream(Altera_desc *desc,
+			     int (*produce)(void *priv, void *buf, size_t size),
+			     void *priv, size_t buf_size)
+{
+	u32 xfer_max, buf_size_max;
+	struct sdm_pipe pipe;
+	void *bufs;
+	int ret, i;
+
+	if (!buf_size || buf_size & 0x3) {
+		puts("FPGA: Buffer size must be a non-zero multiple of 4.\n");
+		return -EINVAL;
+	}
+
+	bufs = memalign(ARCH_DMA_MINALIGN,
+			CONFIG_FPGA_INTEL_SDM_MAILBOX_XFERS *
+			roundup(buf_size, ARCH_DMA_MINALIGN));
+	if (!bufs) {
+		puts("FPGA: Out of memory for the staging buffers.\n");
+		return -ENOMEM;
+	}
+
+	ret = sdm_reconfig_start(&xfer_max, &buf_size_max);
+	if (!ret) {
+		ret = sdm_pipe_init(&pipe, xfer_max, buf_size_max);
+		if (!ret) {
+			for (i = 0; i < pipe.xfer_max; i++)
+				pipe.xfer[i].buf = bufs + i *
+					roundup(buf_size, ARCH_DMA_MINALIGN);
+			ret = send_reconfig_produced(&pipe, produce, priv,
+						     buf_size);
+		}
+		ret = sdm_reconfig_finish(ret);
+	}
+
+	free(bufs);
+
+	return ret;
+}
+
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+/* State of intel_sdm_mb_loadfs() while the file is read */
+struct sdm_mb_fs {
+	struct sdm_pipe pipe;
+	size_t xfer_size;	/* largest descriptor */
+	size_t size;		/* of the file */
+	size_t pos;		/* bytes of the file consumed so far */
+	u32 chunk;		/* number of the chunk being consumed */
+};
+
+/*
+ * Hand a chunk of the file to the SDM in place. The file is read into two
+ * buffers in turn, see fs_read_stream(), so the SDM consumes this chunk
+ * while the next one is read. Only the previous chunk has to be released
+ * before its buffer is used again, and the last one before it is freed.
+ */
+static int sdm_mb_fs_consume(void *priv, const void *buf, size_t len)
+{
+	struct sdm_mb_fs *fs = priv;
+	struct sdm_pipe *pipe = &fs->pipe;
+	int ret;
+
+	/* The SDM reads memory directly, make sure it sees the chunk */
+	flush_dcache_range((ulong)buf,
+			   roundup((ulong)buf + len, ARCH_DMA_MINALIGN));
+
+	fs->chunk++;
+	fs->pos += len;
+	ret = sdm_pipe_write(pipe, buf, len, fs->xfer_size, fs->chunk);
+	if (ret || fs->pos == fs->size)
+		return sdm_pipe_finish(pipe);
+
+	while (!pipe->err && sdm_pipe_busy(pipe, fs->chunk - 1)) {
+		sdm_xfer_wait(&pipe->waiting, true);
+		sdm_pipe_poll(pipe);
+	}
+	if (pipe->err)
+		return sdm_pipe_finish(pipe);
+
+	return 0;
+}
+
+/*
+ * Load a bitstream from a filesystem. The file is looked up once and
+ * streamed with fs_read_stream(), the SDM reading every chunk straight from
+ * the buffer it was read into, so @buf is not needed. Descriptors are at
+ * most fpga_fsinfo->blocksize bytes long, if that is given.
+ * Return 0 for success, non-zero for error.
+ */
+int intel_sdm_mb_loadfs(Altera_desc *desc, const void *buf, size_t bsize,
+			fpga_fs_info *fpga_fsinfo)
+{
+	struct sdm_mb_fs fs = { .size = bsize };
+	u32 xfer_max, buf_size_max;
+	loff_t actread = 0;
+	int ret;
+
+	if (fpga_fsinfo->blocksize & 0x3) {
+		puts("FPGA: Block size must be a multiple of 4.\n");
+		return -EINVAL;
+	}
+
+	if (fs_set_blk_dev(fpga_fsinfo->interface, fpga_fsinfo->dev_part,
+			   fpga_fsinfo->fstype))
+		return -ENODEV;
+
+	ret = sdm_reconfig_start(&xfer_max, &buf_size_max);
+	if (ret)
+		return ret;
+
+	ret = sdm_pipe_init(&fs.pipe, xfer_max, buf_size_max);
+	if (!ret) {
+		fs.xfer_size = buf_size_max;
+		if (fpga_fsinfo->blocksize)
+			fs.xfer_size = min_t(size_t, fs.xfer_size,
+					     fpga_fsinfo->blocksize);
+
+		ret = fs_read_stream(fpga_fsinfo->filename, 0, bsize,
+				     sdm_mb_fs_consume, &fs, &actread);
+		/* A failed read leaves the last chunk with the SDM */
+		sdm_pipe_finish(&fs.pipe);
+		if (ret < 0)
+			printf("FPGA: Failed to load %s at offset 0x%llx\n",
+			       fpga_fsinfo->filename, actread);
+	}
+
+	return sdm_reconfig_finish(ret);
+}
+#endif
@@ -5,7 +5,13 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
+#include <dm.h>
+#include <dma-uclass.h>
+#include <fpga.h>
+#include <hash.h>
 #include <asm/io.h>
+#include <linux/sizes.h>
 #include <linux/errno.h>
 #include <asm/arch/fpga_manager.h>
 #include <asm/arch/reset_manager.h>
@@ -14,6 +20,9 @@
 /* Timeout count */
 #define FPGA_TIMEOUT_CNT		0x1000000
 
+/* Smallest write handed to the DMA controller */
+#define FPGA_DMA_MIN_SIZE		SZ_4K
+
 static struct socfpga_fpga_manager *fpgamgr_regs =
 	(struct socfpga_fpga_manager *)SOCFPGA_FPGAMGRREGS_ADDRESS;
 
@@ -40,8 +49,8 @@ int fpgamgr_dclkcnt_set(unsigned long cnt)
 	return -ETIMEDOUT;
 }
 
-/* Write the RBF data to FPGA Manager */
-void fpgamgr_program_write(const void *rbf_data, size_t rbf_size)
+/* Write the RBF data to FPGA Manager with CPU stores */
+static void fpgamgr_program_write_cpu(const void *rbf_data, size_t rbf_size)
 {
 	uint32_t src = (uint32_t)rbf_data;
 	uint32_t dst = SOCFPGA_FPGAMGRDATA_ADDRESS;
@@ -70,3 +79,304 @@ void fpgamgr_program_write(const void *rbf_data, size_t rbf_size)
 		: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "cc");
 }
 
+/* Trailing partial word of the data being written by DMA, for the CPU */
+static const void *fpgamgr_tail;
+static size_t fpgamgr_tail_len;
+
+#if defined(CONFIG_FPGA_SOCFPGA_DMA) && \
+	(!defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_DMA_SUPPORT))
+/* DMA controller with a transfer in progress, or NULL */
+static struct udevice *fpgamgr_dma_dev;
+
+/*
+ * Start writing the word aligned part of the RBF data to FPGA Manager with
+ * a DMA controller. @done is set to the number of bytes taken on, which is
+ * 0 if the CPU has to write the data instead. If the controller can run in
+ * the background the transfer may still be going on when this returns, see
+ * fpgamgr_program_write_dma_wait(). Return a negative error code if the
+ * transfer failed part way, as the data cannot be resent then.
+ */
+static int fpgamgr_program_write_dma_start(const void *rbf_data,
+					   size_t rbf_size, size_t *done)
+{
+	const struct dma_ops *ops;
+	struct udevice *dev;
+	size_t len = rbf_size & ~0x3;
+	int ret;
+
+	*done = 0;
+
+	/* Short writes such as sync words are cheaper with the CPU */
+	if (len < FPGA_DMA_MIN_SIZE || (uintptr_t)rbf_data & 0x3)
+		return 0;
+
+	if (dma_get_device(DMA_SUPPORTS_MEM_TO_DEV, &dev))
+		return 0;
+
+	ops = device_get_ops(dev);
+	if (!ops->transfer)
+		return 0;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FPGA_DMA, "fpga_write_dma");
+	if (ops->transfer_start && ops->transfer_wait) {
+		ret = ops->transfer_start(dev, DMA_MEM_TO_DEV,
+					  (void *)SOCFPGA_FPGAMGRDATA_ADDRESS,
+					  (void *)rbf_data, len);
+		if (!ret) {
+			fpgamgr_dma_dev = dev;
+			*done = len;
+			return 0;
+		}
+	} else {
+		ret = ops->transfer(dev, DMA_MEM_TO_DEV,
+				    (void *)SOCFPGA_FPGAMGRDATA_ADDRESS,
+				    (void *)rbf_data, len);
+	}
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FPGA_DMA);
+
+	/* Nothing was sent, so the CPU can still write the chunk */
+	if (ret == -EBUSY || ret == -EINVAL) {
+		debug("FPGA: DMA unavailable (%d), using the CPU\n", ret);
+		return 0;
+	}
+	if (ret) {
+		printf("FPGA: DMA write failed (%d)\n", ret);
+		return ret;
+	}
+
+	*done = len;
+
+	return 0;
+}
+
+/* Wait for the transfer started by fpgamgr_program_write_dma_start() */
+static int fpgamgr_program_write_dma_wait(void)
+{
+	const struct dma_ops *ops;
+	int ret;
+
+	if (!fpgamgr_dma_dev)
+		return 0;
+
+	ops = device_get_ops(fpgamgr_dma_dev);
+	ret = ops->transfer_wait(fpgamgr_dma_dev);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FPGA_DMA);
+	fpgamgr_dma_dev = NULL;
+	if (ret)
+		printf("FPGA: DMA write failed (%d)\n", ret);
+
+	return ret;
+}
+#else
+static int fpgamgr_program_write_dma_start(const void *rbf_data,
+					   size_t rbf_size, size_t *done)
+{
+	*done = 0;
+
+	return 0;
+}
+
+static int fpgamgr_program_write_dma_wait(void)
+{
+	return 0;
+}
+#endif
+
+static void fpgamgr_program_write_cpu_timed(const void *rbf_data,
+					    size_t rbf_size)
+{
+	bootstage_start(BOOTSTAGE_ID_ACCUM_FPGA_CPU, "fpga_write_cpu");
+	fpgamgr_program_write_cpu(rbf_data, rbf_size);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_FPGA_CPU);
+}
+
+/*
+ * Start writing the RBF data to FPGA Manager. A DMA write goes on in the
+ * background, so the caller can read the next chunk into another buffer
+ * meanwhile; @rbf_data must be left alone until fpgamgr_program_write_wait()
+ * or the next fpgamgr_program_write_start(), which wait for it.
+ */
+int fpgamgr_program_write_start(const void *rbf_data, size_t rbf_size)
+{
+	size_t done;
+	int ret;
+
+	/* The FPGA takes the data in order: finish the last chunk first */
+	ret = fpgamgr_program_write_wait();
+	if (ret)
+		return ret;
+
+	ret = fpgamgr_program_write_dma_start(rbf_data, rbf_size, &done);
+	if (ret)
+		return ret;
+
+	rbf_data += done;
+	rbf_size -= done;
+	if (!rbf_size)
+		return 0;
+
+	/* A trailing partial word has to wait for the DMA to be done */
+	if (done) {
+		fpgamgr_tail = rbf_data;
+		fpgamgr_tail_len = rbf_size;
+		return 0;
+	}
+
+	/* No DMA available */
+	fpgamgr_program_write_cpu_timed(rbf_data, rbf_size);
+
+	return 0;
+}
+
+/* Wait until the data from fpgamgr_program_write_start() is all written */
+int fpgamgr_program_write_wait(void)
+{
+	size_t tail_len = fpgamgr_tail_len;
+	int ret;
+
+	fpgamgr_tail_len = 0;
+	ret = fpgamgr_program_write_dma_wait();
+	if (ret)
+		return ret;
+
+	if (tail_len)
+		fpgamgr_program_write_cpu_timed(fpgamgr_tail, tail_len);
+
+	return 0;
+}
+
+/* Write the RBF data to FPGA Manager */
+int fpgamgr_program_write(const void *rbf_data, size_t rbf_size)
+{
+	int ret;
+
+	ret = fpgamgr_program_write_start(rbf_data, rbf_size);
+	if (ret)
+		return ret;
+
+	return fpgamgr_program_write_wait();
+}
+
+#if CONFIG_IS_ENABLED(FPGA_SOCFPGA_SKIP_LOADED)
+/*
+ * The size and SHA-256 of the last bitstream which reached user mode are kept
+ * in on-chip RAM, which is preserved across a warm reset. The SPL stack is
+ * placed below the record, see socfpga_common.h, and the default address is
+ * next to the bootcounter which socfpga_is1 and socfpga_sr1500 already keep
+ * across warm resets at the end of the on-chip RAM. Should the record still
+ * get overwritten, e.g. by Linux, the magic or the digest no longer match
+ * and the FPGA is simply programmed again. After a cold reset the FPGA is
+ * not in user mode, whatever the record says.
+ */
+#define FPGA_DIGEST_ALGO		"sha256"
+#define FPGA_LOADED_MAGIC		0x4c475046	/* "FPGL" */
+
+struct fpgamgr_loaded {
+	u32 magic;
+	u32 size;
+	u8 digest[FPGA_BITSTREAM_DIGEST_LEN];
+};
+
+static struct fpgamgr_loaded *const fpgamgr_loaded =
+	(struct fpgamgr_loaded *)CONFIG_FPGA_SOCFPGA_SKIP_LOADED_ADDR;
+
+int fpgamgr_bitstream_digest(const void *rbf_data, size_t rbf_size, u8 *digest)
+{
+	struct hash_algo *algo;
+	int ret;
+
+	ret = hash_lookup_algo(FPGA_DIGEST_ALGO, &algo);
+	if (ret)
+		return ret;
+
+	algo->hash_func_ws(rbf_data, rbf_size, digest, algo->chunk_size);
+
+	return 0;
+}
+
+/*
+ * Check whether the FPGA is in user mode with the bitstream recorded last.
+ * Without a @digest only the size is compared, to find out whether the
+ * bitstream is worth hashing. 'fpga load -f' always reloads the FPGA.
+ */
+bool fpgamgr_bitstream_loaded(size_t rbf_size, const u8 *digest)
+{
+	if (fpga_get_force() || !fpgamgr_test_fpga_ready())
+		return false;
+
+	if (fpgamgr_loaded->magic != FPGA_LOADED_MAGIC ||
+	    fpgamgr_loaded->size != rbf_size)
+		return false;
+
+	return !digest || !memcmp(fpgamgr_loaded->digest, digest,
+				  FPGA_BITSTREAM_DIGEST_LEN);
+}
+
+/*
+ * Check whether the FPGA is in user mode with the very same bitstream. The
+ * bitstream is only hashed if the record is valid and its size matches.
+ */
+bool fpgamgr_bitstream_match(const void *rbf_data, size_t rbf_size)
+{
+	u8 digest[FPGA_BITSTREAM_DIGEST_LEN];
+
+	if (!fpgamgr_bitstream_loaded(rbf_size, NULL))
+		return false;
+
+	if (fpgamgr_bitstream_digest(rbf_data, rbf_size, digest))
+		return false;
+
+	return fpgamgr_bitstream_loaded(rbf_size, digest);
+}
+
+/*
+ * Hash a bitstream piece by piece, for loads which never hold it in memory
+ * as a whole. Return the hash context, or NULL if it cannot be hashed.
+ */
+void *fpgamgr_bitstream_hash_start(void)
+{
+	struct hash_algo *algo;
+	void *ctx;
+
+	if (hash_lookup_algo(FPGA_DIGEST_ALGO, &algo) ||
+	    algo->hash_init(algo, &ctx))
+		return NULL;
+
+	return ctx;
+}
+
+void fpgamgr_bitstream_hash_update(void *ctx, const void *data, size_t len)
+{
+	struct hash_algo *algo;
+
+	if (!hash_lookup_algo(FPGA_DIGEST_ALGO, &algo))
+		algo->hash_update(algo, ctx, data, len, 0);
+}
+
+/* Write the digest to @digest and free the hash context */
+int fpgamgr_bitstream_hash_finish(void *ctx, u8 *digest)
+{
+	struct hash_algo *algo;
+	int ret;
+
+	ret = hash_lookup_algo(FPGA_DIGEST_ALGO, &algo);
+	if (ret)
+		return ret;
+
+	return algo->hash_finish(algo, ctx, digest, FPGA_BITSTREAM_DIGEST_LEN);
+}
+
+/* Remember the bitstream now in user mode */
+void fpgamgr_bitstream_save(size_t rbf_size, const u8 *digest)
+{
+	memcpy(fpgamgr_loaded->digest, digest, FPGA_BITSTREAM_DIGEST_LEN);
+	fpgamgr_loaded->size = rbf_size;
+	fpgamgr_loaded->magic = FPGA_LOADED_MAGIC;
+}
+
+/* The FPGA is being reconfigured, the saved digest no longer applies */
+void fpgamgr_bitstream_forget(void)
+{
+	memset(fpgamgr_loaded, 0, sizeof(*fpgamgr_loaded));
+}
+#endif
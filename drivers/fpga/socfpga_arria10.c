@@ -13,6 +13,7 @@
 #include <common.h>
 #include <dm/ofnode.h>
 #include <errno.h>
+#include <fs.h>
 #include <fs_loader.h>
 #include <wait_bit.h>
 #include <watchdog.h>
@@ -746,8 +747,9 @@ static int subsequent_loading_rbf_to_buffer(struct udevice *dev,
 	return 0;
 }
 
-int socfpga_loadfs(fpga_fs_info *fpga_fsinfo, const void *buf, size_t bsize,
-			u32 offset)
+/* Program the bitstream named in the FIT read by the firmware loader */
+static int socfpga_load_firmware(fpga_fs_info *fpga_fsinfo, const void *buf,
+				 size_t bsize, u32 offset)
 {
 	struct fpga_loadfs_info fpga_loadfs;
 	struct udevice *dev;
@@ -833,7 +835,9 @@ int socfpga_loadfs(fpga_fs_info *fpga_fsinfo, const void *buf, size_t bsize,
 	}
 
 	/* Transfer bitstream to FPGA Manager */
-	fpgamgr_program_write((void *)buffer, buffer_sizebytes);
+	ret = fpgamgr_program_write((void *)buffer, buffer_sizebytes);
+	if (ret)
+		return ret;
 
 	total_sizeof_image += buffer_sizebytes;
 
@@ -847,8 +851,10 @@ int socfpga_loadfs(fpga_fs_info *fpga_fsinfo, const void *buf, size_t bsize,
 			return ret;
 
 		/* Transfer data to FPGA Manager */
-		fpgamgr_program_write((void *)buffer,
-					buffer_sizebytes_ori);
+		ret = fpgamgr_program_write((void *)buffer,
+					    buffer_sizebytes_ori);
+		if (ret)
+			return ret;
 
 		total_sizeof_image += buffer_sizebytes_ori;
 
@@ -896,12 +902,12 @@ void fpgamgr_program(const void *buf, size_t bsize, u32 offset)
 
 	fpga_fsinfo.filename = get_fpga_filename();
 
-	socfpga_loadfs(&fpga_fsinfo, buf, bsize, offset);
+	socfpga_load_firmware(&fpga_fsinfo, buf, bsize, offset);
 }
 #endif
 
-/* This function is used to load the core bitstream from the OCRAM. */
-int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
+/* Prepare the FPGA Manager for the bitstream starting at rbf_data */
+static int socfpga_load_start(const void *rbf_data, size_t rbf_size)
 {
 	unsigned long status;
 	struct rbf_info rbfinfo;
@@ -931,8 +937,12 @@ int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
 		return -EPERM;
 	}
 
-	/* Write the bitstream to FPGA Manager */
-	fpgamgr_program_write(rbf_data, rbf_size);
+	return 0;
+}
+
+static int socfpga_load_finish(void)
+{
+	unsigned long status;
 
 	status = fpgamgr_program_finish();
 	if (status)
@@ -943,3 +953,146 @@ int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
 
 	return status;
 }
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+/* Write one decompressed chunk, starting the FPGA Manager on the first */
+static int socfpga_load_chunk(void *priv, const void *data, size_t len)
+{
+	bool *started = priv;
+	int status;
+
+	if (!*started) {
+		status = socfpga_load_start(data, len);
+		if (status)
+			return status;
+		*started = true;
+	}
+
+	return fpgamgr_program_write(data, len);
+}
+#endif
+
+/* This function is used to load the core bitstream from the OCRAM. */
+int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
+{
+	unsigned long status;
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+	if (fpga_is_compressed(rbf_data, rbf_size)) {
+		bool started = false;
+
+		status = fpga_decompress(rbf_data, rbf_size,
+					 socfpga_load_chunk, &started);
+		if (status)
+			return status;
+
+		return socfpga_load_finish();
+	}
+#endif
+
+	status = socfpga_load_start(rbf_data, rbf_size);
+	if (status)
+		return status;
+
+	/* Write the bitstream to FPGA Manager */
+	status = fpgamgr_program_write(rbf_data, rbf_size);
+	if (status)
+		return status;
+
+	return socfpga_load_finish();
+}
+
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+/* State of socfpga_loadfs() while the file is read */
+struct socfpga_loadfs_priv {
+	u8 *buf;		/* gathers a compressed file */
+	size_t size;		/* of the file */
+	size_t pos;		/* bytes of the file consumed so far */
+	bool compressed;
+	bool started;
+};
+
+/*
+ * The file is read into two buffers in turn, see fs_read_stream(), so a
+ * chunk can still be going to the FPGA by DMA while the next one is read.
+ */
+static int socfpga_loadfs_chunk(void *priv, const void *data, size_t len)
+{
+	struct socfpga_loadfs_priv *fs = priv;
+	int status;
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+	if (!fs->pos)
+		fs->compressed = fpga_is_compressed(data, len);
+#endif
+	if (fs->compressed) {
+		memcpy(fs->buf + fs->pos, data, len);
+		fs->pos += len;
+		return 0;
+	}
+	fs->pos += len;
+
+	if (!fs->started) {
+		status = socfpga_load_start(data, len);
+		if (status)
+			return status;
+		fs->started = true;
+	}
+
+	status = fpgamgr_program_write_start(data, len);
+	if (status)
+		return status;
+
+	/* The buffers go once the last chunk has been consumed */
+	if (fs->pos == fs->size)
+		return fpgamgr_program_write_wait();
+
+	return 0;
+}
+
+/*
+ * Program the FPGA straight from a file, as on Gen5: each chunk is written
+ * to the FPGA Manager while the next one is read, and a compressed file is
+ * gathered in @buf, then decompressed into the FPGA Manager.
+ * Return 0 for success, non-zero for error.
+ */
+int socfpga_loadfs(Altera_desc *desc, const void *buf, size_t bsize,
+		   fpga_fs_info *fpga_fsinfo)
+{
+	struct socfpga_loadfs_priv fs = { .buf = (u8 *)buf, .size = bsize };
+	loff_t actread;
+	int status;
+
+	if (fs_set_blk_dev(fpga_fsinfo->interface, fpga_fsinfo->dev_part,
+			   fpga_fsinfo->fstype))
+		return -ENODEV;
+
+	status = fs_read_stream(fpga_fsinfo->filename, 0, bsize,
+				socfpga_loadfs_chunk, &fs, &actread);
+	/* A failed read leaves the last write going */
+	if (fs.started) {
+		int wait = fpgamgr_program_write_wait();
+
+		if (!status)
+			status = wait;
+	}
+	if (!status && actread != bsize)
+		status = -EIO;
+	if (status) {
+		printf("FPGA: Failed to load %s at offset 0x%llx\n",
+		       fpga_fsinfo->filename, actread);
+		return status;
+	}
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+	if (fs.compressed) {
+		status = fpga_decompress(fs.buf, bsize, socfpga_load_chunk,
+					 &fs.started);
+		if (status)
+			return status;
+	}
+#endif
+
+	return socfpga_load_finish();
+}
+#endif
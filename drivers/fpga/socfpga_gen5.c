@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <fs.h>
 #include <asm/io.h>
 #include <linux/errno.h>
 #include <asm/arch/fpga_manager.h>
@@ -198,19 +199,16 @@ static int fpgamgr_program_poll_usermode(void)
 	return 0;
 }
 
-/*
- * FPGA Manager to program the FPGA. This is the interface used by FPGA driver.
- * Return 0 for sucess, non-zero for error.
- */
-int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
+/* Shut off the bridges and initialize the FPGA Manager for programming */
+static int fpgamgr_program_start(const void *rbf_data)
 {
-	int status;
-
 	if ((uint32_t)rbf_data & 0x3) {
 		puts("FPGA: Unaligned data, realign to 32bit boundary.\n");
 		return -EINVAL;
 	}
 
+	fpgamgr_bitstream_forget();
+
 	/* Prior programming the FPGA, all bridges need to be shut off */
 
 	/* Disable all signals from hps peripheral controller to fpga */
@@ -227,12 +225,13 @@ int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
 	writel(0x1, SOCFPGA_L3REGS_ADDRESS);
 
 	/* Initialize the FPGA Manager */
-	status = fpgamgr_program_init();
-	if (status)
-		return status;
+	return fpgamgr_program_init();
+}
 
-	/* Write the RBF data to FPGA Manager */
-	fpgamgr_program_write(rbf_data, rbf_size);
+/* Wait for the FPGA to leave configuration and enter user mode */
+static int fpgamgr_program_finish(void)
+{
+	int status;
 
 	/* Ensure the FPGA entering config done */
 	status = fpgamgr_program_poll_cd();
@@ -247,3 +246,225 @@ int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
 	/* Ensure the FPGA entering user mode */
 	return fpgamgr_program_poll_usermode();
 }
+
+/*
+ * Enter user mode and remember which bitstream got there. It is only hashed
+ * now, so a load which fails or finds no record is not slowed down by it.
+ */
+static int socfpga_load_finish(const void *rbf_data, size_t rbf_size)
+{
+	u8 digest[FPGA_BITSTREAM_DIGEST_LEN];
+	int status;
+
+	status = fpgamgr_program_finish();
+	if (!status && !fpgamgr_bitstream_digest(rbf_data, rbf_size, digest))
+		fpgamgr_bitstream_save(rbf_size, digest);
+
+	return status;
+}
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS) || defined(CONFIG_CMD_FPGA_LOADFS)
+/* Write one chunk of the RBF, starting the FPGA Manager on the first */
+static int fpgamgr_program_write_chunk(void *priv, const void *data,
+				       size_t len)
+{
+	bool *started = priv;
+	int status;
+
+	if (!*started) {
+		status = fpgamgr_program_start(data);
+		if (status)
+			return status;
+		*started = true;
+	}
+
+	return fpgamgr_program_write(data, len);
+}
+#endif
+
+/*
+ * FPGA Manager to program the FPGA. This is the interface used by FPGA driver.
+ * Return 0 for sucess, non-zero for error.
+ */
+int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size)
+{
+	int status;
+
+	if (fpgamgr_bitstream_match(rbf_data, rbf_size)) {
+		puts("FPGA: Bitstream already loaded, skipping.\n");
+		return 0;
+	}
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+	if (fpga_is_compressed(rbf_data, rbf_size)) {
+		bool started = false;
+
+		status = fpga_decompress(rbf_data, rbf_size,
+					 fpgamgr_program_write_chunk, &started);
+		if (status)
+			return status;
+
+		return socfpga_load_finish(rbf_data, rbf_size);
+	}
+#endif
+
+	status = fpgamgr_program_start(rbf_data);
+	if (status)
+		return status;
+
+	/* Write the RBF data to FPGA Manager */
+	status = fpgamgr_program_write(rbf_data, rbf_size);
+	if (status)
+		return status;
+
+	return socfpga_load_finish(rbf_data, rbf_size);
+}
+
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+/* State of socfpga_loadfs() while the file is read */
+struct socfpga_loadfs_priv {
+	u8 *buf;		/* gathers a compressed file */
+	size_t size;		/* of the file */
+	size_t pos;		/* bytes of the file consumed so far */
+	void *hash;		/* digest context, or NULL */
+	bool compressed;
+	bool started;
+};
+
+static int socfpga_loadfs_hash(void *priv, const void *data, size_t len)
+{
+	fpgamgr_bitstream_hash_update(priv, data, len);
+
+	return 0;
+}
+
+/* Hash the file to find out whether it is the bitstream in user mode */
+static bool socfpga_loadfs_loaded(fpga_fs_info *fpga_fsinfo, size_t bsize,
+				  u8 *digest)
+{
+	loff_t actread;
+	void *hash;
+	int status;
+
+	hash = fpgamgr_bitstream_hash_start();
+	if (!hash)
+		return false;
+
+	status = fs_read_stream(fpga_fsinfo->filename, 0, bsize,
+				socfpga_loadfs_hash, hash, &actread);
+	if (fpgamgr_bitstream_hash_finish(hash, digest) || status ||
+	    actread != bsize)
+		return false;
+
+	return fpgamgr_bitstream_loaded(bsize, digest);
+}
+
+/*
+ * The file is read into two buffers in turn, see fs_read_stream(), so a
+ * chunk can still be going to the FPGA by DMA while the next one is read.
+ */
+static int socfpga_loadfs_chunk(void *priv, const void *data, size_t len)
+{
+	struct socfpga_loadfs_priv *fs = priv;
+	int status;
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+	if (!fs->pos)
+		fs->compressed = fpga_is_compressed(data, len);
+#endif
+	if (fs->compressed) {
+		memcpy(fs->buf + fs->pos, data, len);
+	} else {
+		if (!fs->started) {
+			status = fpgamgr_program_start(data);
+			if (status)
+				return status;
+			fs->started = true;
+		}
+		status = fpgamgr_program_write_start(data, len);
+		if (status)
+			return status;
+	}
+
+	/* This overlaps with the DMA too */
+	if (fs->hash)
+		fpgamgr_bitstream_hash_update(fs->hash, data, len);
+	fs->pos += len;
+
+	/* The buffers go once the last chunk has been consumed */
+	if (fs->started && fs->pos == fs->size)
+		return fpgamgr_program_write_wait();
+
+	return 0;
+}
+
+/*
+ * Program the FPGA straight from a file instead of staging the whole RBF in
+ * DRAM. The file is looked up once and each chunk is written to the FPGA
+ * Manager, by DMA when there is one, while the next chunk is read. As with
+ * socfpga_load(), a bitstream already in user mode is skipped and the one
+ * loaded is recorded; a gzip, LZ4 or Zstandard compressed file is gathered
+ * in @buf, then decompressed into the FPGA Manager.
+ * Return 0 for success, non-zero for error.
+ */
+int socfpga_loadfs(Altera_desc *desc, const void *buf, size_t bsize,
+		   fpga_fs_info *fpga_fsinfo)
+{
+	struct socfpga_loadfs_priv fs = { .buf = (u8 *)buf, .size = bsize };
+	u8 digest[FPGA_BITSTREAM_DIGEST_LEN];
+	loff_t actread;
+	int status;
+
+	if (fs_set_blk_dev(fpga_fsinfo->interface, fpga_fsinfo->dev_part,
+			   fpga_fsinfo->fstype))
+		return -ENODEV;
+
+	/* Only read the file twice if it may be the bitstream loaded */
+	if (fpgamgr_bitstream_loaded(bsize, NULL)) {
+		if (socfpga_loadfs_loaded(fpga_fsinfo, bsize, digest)) {
+			puts("FPGA: Bitstream already loaded, skipping.\n");
+			return 0;
+		}
+
+		if (fs_set_blk_dev(fpga_fsinfo->interface,
+				   fpga_fsinfo->dev_part, fpga_fsinfo->fstype))
+			return -ENODEV;
+	}
+
+	fs.hash = fpgamgr_bitstream_hash_start();
+	status = fs_read_stream(fpga_fsinfo->filename, 0, bsize,
+				socfpga_loadfs_chunk, &fs, &actread);
+	/* A failed read leaves the last write going */
+	if (fs.started) {
+		int wait = fpgamgr_program_write_wait();
+
+		if (!status)
+			status = wait;
+	}
+	if (!status && actread != bsize)
+		status = -EIO;
+	if (fs.hash && fpgamgr_bitstream_hash_finish(fs.hash, digest))
+		fs.hash = NULL;
+	if (status) {
+		printf("FPGA: Failed to load %s at offset 0x%llx\n",
+		       fpga_fsinfo->filename, actread);
+		return status;
+	}
+
+#if CONFIG_IS_ENABLED(FPGA_DECOMPRESS)
+	if (fs.compressed) {
+		status = fpga_decompress(fs.buf, bsize,
+					 fpgamgr_program_write_chunk,
+					 &fs.started);
+		if (status)
+			return status;
+	}
+#endif
+
+	status = fpgamgr_program_finish();
+	if (!status && fs.hash)
+		fpgamgr_bitstream_save(bsize, digest);
+
+	return status;
+}
+#endif
@@ -136,15 +136,78 @@ static int dw_mdio_init(const char *name, void *priv)
 	return mdio_register(bus);
 }
 
+/* The DMA engine only takes 32-bit addresses */
+static bool dw_dma_addressable(const void *ptr, ulong size)
+{
+	return (u64)(uintptr_t)ptr + size <= (1ULL << 32);
+}
+
+static void dw_free_rings(struct dw_eth_dev *priv)
+{
+	free(priv->tx_mac_descrtable);
+	free(priv->rx_mac_descrtable);
+	free(priv->txbuffs);
+	free(priv->rxbuffs);
+	priv->tx_mac_descrtable = NULL;
+	priv->rx_mac_descrtable = NULL;
+	priv->txbuffs = NULL;
+	priv->rxbuffs = NULL;
+}
+
+/* Allocate the descriptor rings and their buffers, of the sizes asked for */
+static int dw_alloc_rings(struct dw_eth_dev *priv)
+{
+	ulong tx_descr_size = priv->tx_descr_num * sizeof(struct dmamacdescr);
+	ulong rx_descr_size = priv->rx_descr_num * sizeof(struct dmamacdescr);
+	ulong txbuffs_size = priv->tx_descr_num * CONFIG_ETH_BUFSIZE;
+	ulong rxbuffs_size = priv->rx_descr_num * CONFIG_ETH_BUFSIZE;
+
+	priv->tx_mac_descrtable = memalign(ARCH_DMA_MINALIGN, tx_descr_size);
+	priv->rx_mac_descrtable = memalign(ARCH_DMA_MINALIGN, rx_descr_size);
+	priv->txbuffs = memalign(ARCH_DMA_MINALIGN, txbuffs_size);
+	priv->rxbuffs = memalign(ARCH_DMA_MINALIGN, rxbuffs_size);
+	if (!priv->tx_mac_descrtable || !priv->rx_mac_descrtable ||
+	    !priv->txbuffs || !priv->rxbuffs) {
+		dw_free_rings(priv);
+		return -ENOMEM;
+	}
+
+	if (!dw_dma_addressable(priv->tx_mac_descrtable, tx_descr_size) ||
+	    !dw_dma_addressable(priv->rx_mac_descrtable, rx_descr_size) ||
+	    !dw_dma_addressable(priv->txbuffs, txbuffs_size) ||
+	    !dw_dma_addressable(priv->rxbuffs, rxbuffs_size)) {
+		printf("designware: buffers are outside DMA memory\n");
+		dw_free_rings(priv);
+		return -EINVAL;
+	}
+
+	memset(priv->tx_mac_descrtable, '\0', tx_descr_size);
+	memset(priv->rx_mac_descrtable, '\0', rx_descr_size);
+	memset(priv->txbuffs, '\0', txbuffs_size);
+	memset(priv->rxbuffs, '\0', rxbuffs_size);
+
+	return 0;
+}
+
+/* Add the frames counted by the hardware, which clears them when read */
+static void dw_update_stats(struct dw_eth_dev *priv)
+{
+	u32 missed = readl(&priv->dma_regs_p->missedframes);
+
+	priv->stats.rx_missed += missed & MISSED_FRAMES_MASK;
+	priv->stats.rx_overruns += (missed & FIFO_OVERFLOWS_MASK) >>
+				   FIFO_OVERFLOWS_SHIFT;
+}
+
 static void tx_descs_init(struct dw_eth_dev *priv)
 {
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
-	struct dmamacdescr *desc_table_p = &priv->tx_mac_descrtable[0];
-	char *txbuffs = &priv->txbuffs[0];
+	struct dmamacdescr *desc_table_p = priv->tx_mac_descrtable;
+	char *txbuffs = priv->txbuffs;
 	struct dmamacdescr *desc_p;
 	u32 idx;
 
-	for (idx = 0; idx < CONFIG_TX_DESCR_NUM; idx++) {
+	for (idx = 0; idx < priv->tx_descr_num; idx++) {
 		desc_p = &desc_table_p[idx];
 		desc_p->dmamac_addr = (ulong)&txbuffs[idx * CONFIG_ETH_BUFSIZE];
 		desc_p->dmamac_next = (ulong)&desc_table_p[idx + 1];
@@ -169,8 +232,7 @@ static void tx_descs_init(struct dw_eth_dev *priv)
 
 	/* Flush all Tx buffer descriptors at once */
 	flush_dcache_range((ulong)priv->tx_mac_descrtable,
-			   (ulong)priv->tx_mac_descrtable +
-			   sizeof(priv->tx_mac_descrtable));
+			   (ulong)&priv->tx_mac_descrtable[priv->tx_descr_num]);
 
 	writel((ulong)&desc_table_p[0], &dma_p->txdesclistaddr);
 	priv->tx_currdescnum = 0;
@@ -179,8 +241,8 @@ static void tx_descs_init(struct dw_eth_dev *priv)
 static void rx_descs_init(struct dw_eth_dev *priv)
 {
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
-	struct dmamacdescr *desc_table_p = &priv->rx_mac_descrtable[0];
-	char *rxbuffs = &priv->rxbuffs[0];
+	struct dmamacdescr *desc_table_p = priv->rx_mac_descrtable;
+	char *rxbuffs = priv->rxbuffs;
 	struct dmamacdescr *desc_p;
 	u32 idx;
 
@@ -190,9 +252,10 @@ static void rx_descs_init(struct dw_eth_dev *priv)
 	 * Otherwise there's a chance to get some of them flushed in RAM when
 	 * GMAC is already pushing data to RAM via DMA. This way incoming from
 	 * GMAC data will be corrupted. */
-	flush_dcache_range((ulong)rxbuffs, (ulong)rxbuffs + RX_TOTAL_BUFSIZE);
+	flush_dcache_range((ulong)rxbuffs, (ulong)rxbuffs +
+			   priv->rx_descr_num * CONFIG_ETH_BUFSIZE);
 
-	for (idx = 0; idx < CONFIG_RX_DESCR_NUM; idx++) {
+	for (idx = 0; idx < priv->rx_descr_num; idx++) {
 		desc_p = &desc_table_p[idx];
 		desc_p->dmamac_addr = (ulong)&rxbuffs[idx * CONFIG_ETH_BUFSIZE];
 		desc_p->dmamac_next = (ulong)&desc_table_p[idx + 1];
@@ -209,8 +272,7 @@ static void rx_descs_init(struct dw_eth_dev *priv)
 
 	/* Flush all Rx buffer descriptors at once */
 	flush_dcache_range((ulong)priv->rx_mac_descrtable,
-			   (ulong)priv->rx_mac_descrtable +
-			   sizeof(priv->rx_mac_descrtable));
+			   (ulong)&priv->rx_mac_descrtable[priv->rx_descr_num]);
 
 	writel((ulong)&desc_table_p[0], &dma_p->rxdesclistaddr);
 	priv->rx_currdescnum = 0;
@@ -269,6 +331,9 @@ static void _dw_eth_halt(struct dw_eth_dev *priv)
 	writel(readl(&mac_p->conf) & ~(RXENABLE | TXENABLE), &mac_p->conf);
 	writel(readl(&dma_p->opmode) & ~(RXSTART | TXSTART), &dma_p->opmode);
 
+	/* The counters are reset with the DMA, when the device next starts */
+	dw_update_stats(priv);
+
 	phy_shutdown(priv->phydev);
 }
 
@@ -377,6 +442,7 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	/* Check if the descriptor is owned by CPU */
 	if (desc_p->txrx_status & DESC_TXSTS_OWNBYDMA) {
 		printf("CPU not owner of tx frame\n");
+		priv->stats.tx_errors++;
 		return -EPERM;
 	}
 
@@ -410,10 +476,11 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	flush_dcache_range(desc_start, desc_end);
 
 	/* Test the wrap-around condition. */
-	if (++desc_num >= CONFIG_TX_DESCR_NUM)
+	if (++desc_num >= priv->tx_descr_num)
 		desc_num = 0;
 
 	priv->tx_currdescnum = desc_num;
+	priv->stats.tx_packets++;
 
 	/* Start the transmission */
 	writel(POLL_DATA, &dma_p->txpolldemand);
@@ -421,33 +488,53 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	return 0;
 }
 
+static int _dw_free_pkt(struct dw_eth_dev *priv);
+
 static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
 {
-	u32 status, desc_num = priv->rx_currdescnum;
-	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
-	int length = -EAGAIN;
-	ulong desc_start = (ulong)desc_p;
-	ulong desc_end = desc_start +
-		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
-	ulong data_start = desc_p->dmamac_addr;
-	ulong data_end;
+	struct dmamacdescr *desc_p;
+	ulong desc_start, desc_end;
+	ulong data_start, data_end;
+	u32 status;
+	int length;
+	int i;
 
-	/* Invalidate entire buffer descriptor */
-	invalidate_dcache_range(desc_start, desc_end);
+	/* Drop bad frames, but no more than a ring's worth in one go */
+	for (i = 0; i < priv->rx_descr_num; i++) {
+		desc_p = &priv->rx_mac_descrtable[priv->rx_currdescnum];
+		desc_start = (ulong)desc_p;
+		desc_end = desc_start +
+			roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
 
-	status = desc_p->txrx_status;
+		/* Invalidate entire buffer descriptor */
+		invalidate_dcache_range(desc_start, desc_end);
 
-	/* Check  if the owner is the CPU */
-	if (!(status & DESC_RXSTS_OWNBYDMA)) {
+		status = desc_p->txrx_status;
 
-		length = (status & DESC_RXSTS_FRMLENMSK) >>
-			 DESC_RXSTS_FRMLENSHFT;
+		/* Check  if the owner is the CPU */
+		if (status & DESC_RXSTS_OWNBYDMA)
+			return -EAGAIN;
+		if (!(status & DESC_RXSTS_ERROR))
+			break;
 
-		/* Invalidate received data */
-		data_end = data_start + roundup(length, ARCH_DMA_MINALIGN);
-		invalidate_dcache_range(data_start, data_end);
-		*packetp = (uchar *)(ulong)desc_p->dmamac_addr;
+		debug("%s: dropping bad frame, status %08x\n", __func__,
+		      status);
+		priv->stats.rx_errors++;
+		_dw_free_pkt(priv);
 	}
+	if (i == priv->rx_descr_num)
+		return -EAGAIN;
+
+	length = (status & DESC_RXSTS_FRMLENMSK) >> DESC_RXSTS_FRMLENSHFT;
+
+	/* Invalidate received data */
+	data_start = desc_p->dmamac_addr;
+	data_end = data_start + roundup(length, ARCH_DMA_MINALIGN);
+	invalidate_dcache_range(data_start, data_end);
+
+	/* Hand the DMA buffer up as is; _dw_free_pkt() gives it back */
+	*packetp = (uchar *)(ulong)desc_p->dmamac_addr;
+	priv->stats.rx_packets++;
 
 	return length;
 }
@@ -470,7 +557,7 @@ static int _dw_free_pkt(struct dw_eth_dev *priv)
 	flush_dcache_range(desc_start, desc_end);
 
 	/* Test the wrap-around condition. */
-	if (++desc_num >= CONFIG_RX_DESCR_NUM)
+	if (++desc_num >= priv->rx_descr_num)
 		desc_num = 0;
 	priv->rx_currdescnum = desc_num;
 
@@ -525,15 +612,24 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 
 static int dw_eth_recv(struct eth_device *dev)
 {
+	struct dw_eth_dev *priv = dev->priv;
 	uchar *packet;
 	int length;
+	int i;
 
-	length = _dw_eth_recv(dev->priv, &packet);
-	if (length == -EAGAIN)
-		return 0;
-	net_process_received_packet(packet, length);
+	/*
+	 * Hand over every frame already received, so that a burst does not
+	 * fill the ring while the network loop goes round. Stop after a
+	 * ring's worth so that a busy link cannot hold up the loop for good.
+	 */
+	for (i = 0; i < priv->rx_descr_num; i++) {
+		length = _dw_eth_recv(priv, &packet);
+		if (length == -EAGAIN)
+			break;
+		net_process_received_packet(packet, length);
 
-	_dw_free_pkt(dev->priv);
+		_dw_free_pkt(priv);
+	}
 
 	return 0;
 }
@@ -552,30 +648,30 @@ int designware_initialize(ulong base_addr, u32 interface)
 {
 	struct eth_device *dev;
 	struct dw_eth_dev *priv;
+	int ret;
 
 	dev = (struct eth_device *) malloc(sizeof(struct eth_device));
 	if (!dev)
 		return -ENOMEM;
 
-	/*
-	 * Since the priv structure contains the descriptors which need a strict
-	 * buswidth alignment, memalign is used to allocate memory
-	 */
-	priv = (struct dw_eth_dev *) memalign(ARCH_DMA_MINALIGN,
-					      sizeof(struct dw_eth_dev));
+	priv = (struct dw_eth_dev *) malloc(sizeof(struct dw_eth_dev));
 	if (!priv) {
 		free(dev);
 		return -ENOMEM;
 	}
 
-	if ((phys_addr_t)priv + sizeof(*priv) > (1ULL << 32)) {
-		printf("designware: buffers are outside DMA memory\n");
-		return -EINVAL;
-	}
-
 	memset(dev, 0, sizeof(struct eth_device));
 	memset(priv, 0, sizeof(struct dw_eth_dev));
 
+	priv->tx_descr_num = CONFIG_TX_DESCR_NUM;
+	priv->rx_descr_num = CONFIG_RX_DESCR_NUM;
+	ret = dw_alloc_rings(priv);
+	if (ret) {
+		free(priv);
+		free(dev);
+		return ret;
+	}
+
 	sprintf(dev->name, "dwmac.%lx", base_addr);
 	dev->iobase = (int)base_addr;
 	dev->priv = priv;
@@ -655,6 +751,16 @@ int designware_eth_write_hwaddr(struct udevice *dev)
 	return _dw_write_hwaddr(priv, pdata->enetaddr);
 }
 
+int designware_eth_get_stats(struct udevice *dev, struct eth_stats *stats)
+{
+	struct dw_eth_dev *priv = dev_get_priv(dev);
+
+	dw_update_stats(priv);
+	*stats = priv->stats;
+
+	return 0;
+}
+
 static int designware_eth_bind(struct udevice *dev)
 {
 #ifdef CONFIG_DM_PCI
@@ -673,7 +779,8 @@ static int designware_eth_bind(struct udevice *dev)
 
 int designware_eth_probe(struct udevice *dev)
 {
-	struct eth_pdata *pdata = dev_get_platdata(dev);
+	struct dw_eth_pdata *dw_pdata = dev_get_platdata(dev);
+	struct eth_pdata *pdata = &dw_pdata->eth_pdata;
 	struct dw_eth_dev *priv = dev_get_priv(dev);
 	u32 iobase = pdata->iobase;
 	ulong ioaddr;
@@ -753,11 +860,19 @@ int designware_eth_probe(struct udevice *dev)
 	priv->interface = pdata->phy_interface;
 	priv->max_speed = pdata->max_speed;
 
+	priv->tx_descr_num = dw_pdata->tx_descr_num ?: CONFIG_TX_DESCR_NUM;
+	priv->rx_descr_num = dw_pdata->rx_descr_num ?: CONFIG_RX_DESCR_NUM;
+	ret = dw_alloc_rings(priv);
+	if (ret)
+		return ret;
+
 	dw_mdio_init(dev->name, dev);
 	priv->bus = miiphy_get_dev_by_name(dev->name);
 
 	ret = dw_phy_init(priv, dev);
 	debug("%s, ret=%d\n", __func__, ret);
+	if (ret)
+		dw_free_rings(priv);
 
 	return ret;
 
@@ -778,6 +893,7 @@ static int designware_eth_remove(struct udevice *dev)
 	free(priv->phydev);
 	mdio_unregister(priv->bus);
 	mdio_free(priv->bus);
+	dw_free_rings(priv);
 
 #ifdef CONFIG_CLK
 	return clk_release_all(priv->clocks, priv->clock_count);
@@ -793,6 +909,7 @@ const struct eth_ops designware_eth_ops = {
 	.free_pkt		= designware_eth_free_pkt,
 	.stop			= designware_eth_stop,
 	.write_hwaddr		= designware_eth_write_hwaddr,
+	.get_stats		= designware_eth_get_stats,
 };
 
 int designware_eth_ofdata_to_platdata(struct udevice *dev)
@@ -820,6 +937,21 @@ int designware_eth_ofdata_to_platdata(struct udevice *dev)
 
 	pdata->max_speed = dev_read_u32_default(dev, "max-speed", 0);
 
+	dw_pdata->tx_descr_num = dev_read_u32_default(dev,
+						       "u-boot,tx-ring-size",
+						       CONFIG_TX_DESCR_NUM);
+	dw_pdata->rx_descr_num = dev_read_u32_default(dev,
+						       "u-boot,rx-ring-size",
+						       CONFIG_RX_DESCR_NUM);
+	if (dw_pdata->tx_descr_num < 2 ||
+	    dw_pdata->tx_descr_num > DW_MAX_DESCR_NUM ||
+	    dw_pdata->rx_descr_num < 2 ||
+	    dw_pdata->rx_descr_num > DW_MAX_DESCR_NUM) {
+		debug("%s: Invalid ring size %u/%u\n", __func__,
+		      dw_pdata->tx_descr_num, dw_pdata->rx_descr_num);
+		return -EINVAL;
+	}
+
 #ifdef CONFIG_DM_GPIO
 	if (dev_read_bool(dev, "snps,reset-active-low"))
 		reset_flags |= GPIOD_ACTIVE_LOW;
@@ -11,11 +11,11 @@
 #include <asm-generic/gpio.h>
 #endif
 
+/* Default ring sizes; the device tree may ask for others */
 #define CONFIG_TX_DESCR_NUM	16
 #define CONFIG_RX_DESCR_NUM	16
+#define DW_MAX_DESCR_NUM	256
 #define CONFIG_ETH_BUFSIZE	2048
-#define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
-#define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
 
 #define CONFIG_MACRESET_TIMEOUT	(3 * CONFIG_SYS_HZ)
 #define CONFIG_MDIO_TIMEOUT	(3 * CONFIG_SYS_HZ)
@@ -71,7 +71,8 @@ struct eth_dma_regs {
 	u32 status;		/* 0x14 */
 	u32 opmode;		/* 0x18 */
 	u32 intenable;		/* 0x1c */
-	u32 reserved1[2];
+	u32 missedframes;	/* 0x20 */
+	u32 reserved1[1];
 	u32 axibus;		/* 0x28 */
 	u32 reserved2[7];
 	u32 currhosttxdesc;	/* 0x48 */
@@ -107,6 +108,11 @@ struct eth_dma_regs {
 #define TXSECONDFRAME		(1 << 2)
 #define RXSTART			(1 << 1)
 
+/* Missed frame and buffer overflow counter definitions */
+#define MISSED_FRAMES_MASK	(0xFFFF << 0)
+#define FIFO_OVERFLOWS_MASK	(0x7FF << 17)
+#define FIFO_OVERFLOWS_SHIFT	(17)
+
 /* Descriptior related definitions */
 #define MAC_MAX_FRAME_SZ	(1600)
 
@@ -220,15 +226,18 @@ struct dmamacdescr {
 #endif
 
 struct dw_eth_dev {
-	struct dmamacdescr tx_mac_descrtable[CONFIG_TX_DESCR_NUM];
-	struct dmamacdescr rx_mac_descrtable[CONFIG_RX_DESCR_NUM];
-	char txbuffs[TX_TOTAL_BUFSIZE] __aligned(ARCH_DMA_MINALIGN);
-	char rxbuffs[RX_TOTAL_BUFSIZE] __aligned(ARCH_DMA_MINALIGN);
+	struct dmamacdescr *tx_mac_descrtable;
+	struct dmamacdescr *rx_mac_descrtable;
+	char *txbuffs;
+	char *rxbuffs;
+	u32 tx_descr_num;
+	u32 rx_descr_num;
 
 	u32 interface;
 	u32 max_speed;
 	u32 tx_currdescnum;
 	u32 rx_currdescnum;
+	struct eth_stats stats;
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
@@ -255,6 +264,8 @@ extern const struct eth_ops designware_eth_ops;
 struct dw_eth_pdata {
 	struct eth_pdata eth_pdata;
 	u32 reset_delays[3];
+	u32 tx_descr_num;	/* 0 for the default */
+	u32 rx_descr_num;	/* 0 for the default */
 };
 
 int designware_eth_init(struct dw_eth_dev *priv, u8 *enetaddr);
@@ -265,6 +276,7 @@ int designware_eth_free_pkt(struct udevice *dev, uchar *packet,
 				   int length);
 void designware_eth_stop(struct udevice *dev);
 int designware_eth_write_hwaddr(struct udevice *dev);
+int designware_eth_get_stats(struct udevice *dev, struct eth_stats *stats);
 #endif
 
 #endif
@@ -72,8 +72,10 @@ int sandbox_eth_arp_req_to_reply(struct udevice *dev, void *packet,
 		return -EAGAIN;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	if (priv->recv_packets >= PKTBUFSRX) {
+		priv->stats.rx_missed++;
 		return 0;
+	}
 
 	/* store this as the assumed IP of the fake host */
 	priv->fake_host_ipaddr = net_read_ip(&arp->ar_tpa);
@@ -134,8 +136,10 @@ int sandbox_eth_ping_req_to_reply(struct udevice *dev, void *packet,
 		return -EAGAIN;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	if (priv->recv_packets >= PKTBUFSRX) {
+		priv->stats.rx_missed++;
 		return 0;
+	}
 
 	/* reply to the ping */
 	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
@@ -174,8 +178,10 @@ int sandbox_eth_recv_arp_req(struct udevice *dev)
 	struct arp_hdr *arp_recv;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	if (priv->recv_packets >= PKTBUFSRX) {
+		priv->stats.rx_missed++;
 		return -EOVERFLOW;
+	}
 
 	/* Formulate a fake request */
 	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
@@ -216,8 +222,10 @@ int sandbox_eth_recv_ping_req(struct udevice *dev)
 	struct icmp_hdr *icmpr;
 
 	/* Don't allow the buffer to overrun */
-	if (priv->recv_packets >= PKTBUFSRX)
+	if (priv->recv_packets >= PKTBUFSRX) {
+		priv->stats.rx_missed++;
 		return -EOVERFLOW;
+	}
 
 	/* Formulate a fake ping */
 	eth_recv = (void *)priv->recv_packet_buffer[priv->recv_packets];
@@ -342,6 +350,8 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 	if (priv->disabled)
 		return 0;
 
+	priv->stats.tx_packets++;
+
 	return priv->tx_handler(dev, packet, length);
 }
 
@@ -360,6 +370,7 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		debug("eth_sandbox: received packet[%d], %d waiting\n",
 		      lcl_recv_packet_length, priv->recv_packets - 1);
 		*packetp = priv->recv_packet_buffer[0];
+		priv->stats.rx_packets++;
 		return lcl_recv_packet_length;
 	}
 	return 0;
@@ -368,19 +379,25 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uchar *done;
 	int i;
 
 	if (!priv->recv_packets)
 		return 0;
 
+	/*
+	 * The packet was consumed in place, so just rotate the buffer
+	 * pointers rather than copying each queued packet down a slot. The
+	 * consumed buffer goes to the tail, to be reused last.
+	 */
+	done = priv->recv_packet_buffer[0];
 	--priv->recv_packets;
-	for (i = 0; i < priv->recv_packets; i++) {
+	for (i = 0; i < PKTBUFSRX - 1; i++) {
+		priv->recv_packet_buffer[i] = priv->recv_packet_buffer[i + 1];
 		priv->recv_packet_length[i] = priv->recv_packet_length[i + 1];
-		memcpy(priv->recv_packet_buffer[i],
-		       priv->recv_packet_buffer[i + 1],
-		       priv->recv_packet_length[i + 1]);
 	}
-	priv->recv_packet_length[priv->recv_packets] = 0;
+	priv->recv_packet_buffer[PKTBUFSRX - 1] = done;
+	priv->recv_packet_length[PKTBUFSRX - 1] = 0;
 
 	return 0;
 }
@@ -399,6 +416,15 @@ static int sb_eth_write_hwaddr(struct udevice *dev)
 	return 0;
 }
 
+static int sb_eth_get_stats(struct udevice *dev, struct eth_stats *stats)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	*stats = priv->stats;
+
+	return 0;
+}
+
 static const struct eth_ops sb_eth_ops = {
 	.start			= sb_eth_start,
 	.send			= sb_eth_send,
@@ -406,6 +432,7 @@ static const struct eth_ops sb_eth_ops = {
 	.free_pkt		= sb_eth_free_pkt,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
+	.get_stats		= sb_eth_get_stats,
 };
 
 static int sb_eth_remove(struct udevice *dev)
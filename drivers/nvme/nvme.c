@@ -155,29 +155,23 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	nvmeq->sq_tail = tail;
 }
 
-static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
-				struct nvme_command *cmd,
-				u32 *result, unsigned timeout)
+/**
+ * nvme_reap_cmd() - reap the completion of the oldest command of a queue
+ *
+ * @nvmeq:	The queue to use
+ * @result:	Returns the command specific result, if not NULL
+ * @return 0 if the command completed, -EBUSY if it is still running, or
+ * -EIO if it failed
+ */
+static int nvme_reap_cmd(struct nvme_queue *nvmeq, u32 *result)
 {
 	u16 head = nvmeq->cq_head;
 	u16 phase = nvmeq->cq_phase;
 	u16 status;
-	ulong start_time;
-	ulong timeout_us = timeout * 100000;
-
-	cmd->common.command_id = nvme_get_cmd_id();
-	nvme_submit_cmd(nvmeq, cmd);
 
-	start_time = timer_get_us();
-
-	for (;;) {
-		status = nvme_read_completion_status(nvmeq, head);
-		if ((status & 0x01) == phase)
-			break;
-		if (timeout_us > 0 && (timer_get_us() - start_time)
-		    >= timeout_us)
-			return -ETIMEDOUT;
-	}
+	status = nvme_read_completion_status(nvmeq, head);
+	if ((status & 0x01) != phase)
+		return -EBUSY;
 
 	status >>= 1;
 	if (status) {
@@ -206,7 +200,30 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	nvmeq->cq_head = head;
 	nvmeq->cq_phase = phase;
 
-	return status;
+	return 0;
+}
+
+static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
+				struct nvme_command *cmd,
+				u32 *result, unsigned timeout)
+{
+	ulong start_time;
+	ulong timeout_us = timeout * 100000;
+	int ret;
+
+	cmd->common.command_id = nvme_get_cmd_id();
+	nvme_submit_cmd(nvmeq, cmd);
+
+	start_time = timer_get_us();
+
+	for (;;) {
+		ret = nvme_reap_cmd(nvmeq, result);
+		if (ret != -EBUSY)
+			return ret;
+		if (timeout_us > 0 && (timer_get_us() - start_time)
+		    >= timeout_us)
+			return -ETIMEDOUT;
+	}
 }
 
 static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
@@ -644,6 +661,7 @@ static int nvme_blk_probe(struct udevice *udev)
 
 	memset(ns, 0, sizeof(*ns));
 	ns->dev = ndev;
+	INIT_LIST_HEAD(&ns->reqs);
 	/* extract the namespace id from the block device name */
 	ns->ns_id = trailing_strtol(udev->name) + 1;
 	if (nvme_identify(ndev, ns->ns_id, 0, (dma_addr_t)id))
@@ -668,6 +686,145 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
+/* Complete the asynchronous request being transferred */
+static void nvme_io_finish(struct nvme_dev *dev, long result)
+{
+	struct blk_req *req = dev->io_req;
+
+	if (req->op == BLK_REQ_READ)
+		invalidate_dcache_range((ulong)req->buffer,
+					(ulong)req->buffer +
+					(req->blkcnt << dev->io_ns->lba_shift));
+	req->result = result;
+	req->done = true;
+	dev->io_req = NULL;
+}
+
+/*
+ * Reap the command in flight on the I/O queue, if it has completed.
+ * Returns -EBUSY if it is still running.
+ */
+static int nvme_io_reap(struct nvme_dev *dev)
+{
+	int ret;
+
+	if (!dev->io_busy)
+		return 0;
+
+	ret = nvme_reap_cmd(dev->queues[NVME_IO_Q], NULL);
+	if (ret == -EBUSY)
+		return ret;
+	dev->io_busy = false;
+
+	/* The request is gone if it was cancelled */
+	if (!dev->io_req)
+		return 0;
+
+	if (ret) {
+		nvme_io_finish(dev, dev->io_done ? dev->io_done : -EIO);
+		return 0;
+	}
+
+	dev->io_done += dev->io_lbas;
+	if (dev->io_done == dev->io_req->blkcnt)
+		nvme_io_finish(dev, dev->io_done);
+
+	return 0;
+}
+
+/* Send the next command of the request being transferred */
+static int nvme_io_start(struct nvme_dev *dev)
+{
+	struct nvme_ns *ns = dev->io_ns;
+	struct blk_req *req = dev->io_req;
+	struct nvme_command c;
+	void *buffer;
+	u64 prp2;
+	u16 lbas;
+
+	lbas = min_t(u64, req->blkcnt - dev->io_done,
+		     1 << (dev->max_transfer_shift - ns->lba_shift));
+	buffer = req->buffer + (dev->io_done << ns->lba_shift);
+	if (nvme_setup_prps(dev, &prp2, lbas << ns->lba_shift, (ulong)buffer))
+		return -ENOMEM;
+
+	memset(&c, '\0', sizeof(c));
+	c.rw.opcode = req->op == BLK_REQ_READ ? nvme_cmd_read : nvme_cmd_write;
+	c.rw.command_id = nvme_get_cmd_id();
+	c.rw.nsid = cpu_to_le32(ns->ns_id);
+	c.rw.slba = cpu_to_le64(req->start + dev->io_done);
+	c.rw.length = cpu_to_le16(lbas - 1);
+	c.rw.prp1 = cpu_to_le64((ulong)buffer);
+	c.rw.prp2 = cpu_to_le64(prp2);
+	nvme_submit_cmd(dev->queues[NVME_IO_Q], &c);
+
+	dev->io_lbas = lbas;
+	dev->io_busy = true;
+
+	return 0;
+}
+
+/*
+ * Make progress on the asynchronous requests of all namespaces, which share
+ * the I/O queue, without waiting.
+ */
+static int nvme_io_poll(struct nvme_dev *dev)
+{
+	struct nvme_ns *ns;
+	struct blk_req *req;
+	int ret;
+
+	if (nvme_io_reap(dev))
+		return 0;
+
+	if (!dev->io_req) {
+		list_for_each_entry(ns, &dev->namespaces, list) {
+			if (list_empty(&ns->reqs))
+				continue;
+
+			req = list_first_entry(&ns->reqs, struct blk_req,
+					       queue);
+			list_del_init(&req->queue);
+			if (req->op == BLK_REQ_WRITE)
+				flush_dcache_range((ulong)req->buffer,
+						   (ulong)req->buffer +
+						   (req->blkcnt <<
+						    ns->lba_shift));
+			dev->io_req = req;
+			dev->io_ns = ns;
+			dev->io_done = 0;
+			break;
+		}
+	}
+
+	if (!dev->io_req)
+		return 0;
+
+	if (!dev->io_req->blkcnt) {
+		nvme_io_finish(dev, 0);
+		return 0;
+	}
+
+	ret = nvme_io_start(dev);
+	if (ret)
+		nvme_io_finish(dev, ret);
+
+	return 0;
+}
+
+/* Wait for the command in flight on the I/O queue, if any, to complete */
+static int nvme_io_idle(struct nvme_dev *dev)
+{
+	ulong start = get_timer(0);
+
+	while (nvme_io_reap(dev)) {
+		if (get_timer(start) > IO_TIMEOUT * 1000)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
 static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 			 lbaint_t blkcnt, void *buffer, bool read)
 {
@@ -684,6 +841,10 @@ static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
 	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
 	u64 total_lbas = blkcnt;
 
+	/* The I/O queue takes one command at a time */
+	if (nvme_io_idle(dev))
+		return 0;
+
 	if (!read)
 		flush_dcache_range((unsigned long)buffer,
 				   (unsigned long)buffer + total_len);
@@ -741,9 +902,38 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 	return nvme_blk_rw(udev, blknr, blkcnt, (void *)buffer, false);
 }
 
+static int nvme_blk_submit(struct udevice *udev, struct blk_req *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	list_add_tail(&req->queue, &ns->reqs);
+
+	return nvme_io_poll(ns->dev);
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	return nvme_io_poll(ns->dev);
+}
+
+static void nvme_blk_cancel(struct udevice *udev, struct blk_req *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	/* A command in flight is left to complete, it cannot be stopped */
+	list_del_init(&req->queue);
+	if (ns->dev->io_req == req)
+		ns->dev->io_req = NULL;
+}
+
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
+	.cancel	= nvme_blk_cancel,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
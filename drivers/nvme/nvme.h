@@ -627,6 +627,12 @@ struct nvme_dev {
 	u64 *prp_pool;
 	u32 prp_entry_num;
 	u32 nn;
+	/* Asynchronous request being transferred, a command at a time */
+	struct blk_req *io_req;
+	struct nvme_ns *io_ns;
+	u64 io_done;
+	u16 io_lbas;
+	bool io_busy;
 };
 
 /*
@@ -642,6 +648,8 @@ struct nvme_ns {
 	u8 flbas;
 	u64 mode_select_num_blocks;
 	u32 mode_select_block_len;
+	/* Asynchronous requests waiting for the I/O queue */
+	struct list_head reqs;
 };
 
 #endif /* __DRIVER_NVME_H__ */
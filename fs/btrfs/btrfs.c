@@ -8,6 +8,7 @@
 #include "btrfs.h"
 #include <config.h>
 #include <malloc.h>
+#include <fs_internal.h>
 #include <linux/time.h>
 
 struct btrfs_info btrfs_info;
@@ -207,6 +208,54 @@ int btrfs_read(const char *file, void *buf, loff_t offset, loff_t len,
 	return 0;
 }
 
+struct btrfs_stream {
+	struct btrfs_root root;
+	u64 inr;
+};
+
+static int btrfs_stream_read(void *ctx, void *buf, loff_t pos, loff_t len,
+			     loff_t *actread)
+{
+	struct btrfs_stream *st = ctx;
+	u64 rd;
+
+	rd = btrfs_file_read(&st->root, st->inr, pos, len, buf);
+	if (rd == -1ULL)
+		return -EIO;
+
+	/* A trailing hole is not returned by btrfs_file_read() */
+	if (rd < len)
+		memset(buf + rd, 0, len - rd);
+
+	*actread = len;
+	return 0;
+}
+
+int btrfs_read_stream(const char *file, loff_t offset, loff_t len,
+		      int (*consume)(void *priv, const void *buf, size_t len),
+		      void *priv, loff_t *actread)
+{
+	struct btrfs_stream st = { .root = btrfs_info.fs_root };
+	struct btrfs_inode_item inode;
+	u8 type;
+
+	st.inr = btrfs_lookup_path(&st.root, st.root.root_dirid, file, &type,
+				   &inode, 40);
+
+	if (st.inr == -1ULL) {
+		printf("Cannot lookup file %s\n", file);
+		return -ENOENT;
+	}
+
+	if (type != BTRFS_FT_REG_FILE) {
+		printf("Not a regular file: %s\n", file);
+		return -EISDIR;
+	}
+
+	return fs_stream_chunks(inode.size, offset, len, btrfs_stream_read,
+				&st, consume, priv, actread);
+}
+
 void btrfs_close(void)
 {
 	btrfs_chunk_map_exit();
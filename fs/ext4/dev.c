@@ -46,6 +46,13 @@ void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info)
 		get_fs()->dev_desc->log2blksz;
 }
 
+/* Check the filesystem mounted last is still mounted from this partition */
+bool ext4fs_mounted(struct blk_desc *rbdd, disk_partition_t *info)
+{
+	return ext4fs_root && get_fs()->dev_desc == rbdd &&
+	       part_offset == info->start;
+}
+
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len,
 		   char *buffer)
 {
@@ -955,6 +955,81 @@ int ext4fs_filename_unlink(char *filename)
 	return -1;
 }
 
+/* Whether a block group holds a backup of the superblock and descriptors */
+static int ext4fs_bg_has_super(unsigned int bg_idx)
+{
+	uint32_t ro_compat = le32_to_cpu(ext4fs_root->sblock.feature_ro_compat);
+	unsigned int n;
+
+	if (bg_idx <= 1 || !(ro_compat & EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER))
+		return 1;
+
+	/* With sparse_super only powers of 3, 5 and 7 have one */
+	for (n = 3; n <= 7; n += 2) {
+		unsigned int p = n;
+
+		while (p < bg_idx)
+			p *= n;
+		if (p == bg_idx)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * ext4fs_init_block_bmap() - Build the bitmap of an uninitialised group
+ *
+ * The block bitmap of a group flagged EXT4_BG_BLOCK_UNINIT is not on the
+ * disk. Its free blocks are all but the backup superblock and descriptors
+ * and the bitmaps and inode table, if these lie in the group.
+ *
+ * @bg_idx:	Block group
+ * @return 0, or -1 if the layout of the group is not known (meta_bg)
+ */
+static int ext4fs_init_block_bmap(unsigned int bg_idx)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_sblock *sblock = &ext4fs_root->sblock;
+	struct ext2_block_group *bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+	unsigned char *bmap = fs->blk_bmaps[bg_idx];
+	uint32_t blk_per_grp = le32_to_cpu(sblock->blocks_per_group);
+	uint64_t first = le32_to_cpu(sblock->first_data_block) +
+			 (uint64_t)bg_idx * blk_per_grp;
+	uint64_t blk, meta[3];
+	uint32_t n, i, itb;
+
+	if (le32_to_cpu(sblock->feature_incompat) &
+	    EXT4_FEATURE_INCOMPAT_META_BG)
+		return -1;
+
+	memset(bmap, 0, fs->blksz);
+
+	if (ext4fs_bg_has_super(bg_idx)) {
+		n = 1 + fs->no_blk_pergdt +
+		    le16_to_cpu(sblock->reserved_gdt_blocks);
+		for (i = 0; i < n && i < blk_per_grp; i++)
+			bmap[i >> 3] |= 1 << (i & 7);
+	}
+
+	itb = DIV_ROUND_UP(le32_to_cpu(sblock->inodes_per_group) *
+			   fs->inodesz, fs->blksz);
+	meta[0] = ext4fs_bg_get_block_id(bgd, fs);
+	meta[1] = ext4fs_bg_get_inode_id(bgd, fs);
+	meta[2] = ext4fs_bg_get_inode_table_id(bgd, fs);
+	for (i = 0; i < ARRAY_SIZE(meta); i++) {
+		for (n = 0; n < (i == 2 ? itb : 1); n++) {
+			blk = meta[i] + n;
+			if (blk < first || blk - first >= blk_per_grp)
+				continue;
+			blk -= first;
+			bmap[blk >> 3] |= 1 << (blk & 7);
+		}
+	}
+
+	return 0;
+}
+
 uint32_t ext4fs_get_new_blk_no(void)
 {
 	short i;
@@ -965,8 +1040,7 @@ uint32_t ext4fs_get_new_blk_no(void)
 	unsigned int blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	struct ext_filesystem *fs = get_fs();
 	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
+	if (!journal_buffer)
 		goto fail;
 
 	if (fs->first_pass_bbmap == 0) {
@@ -978,8 +1052,8 @@ uint32_t ext4fs_get_new_blk_no(void)
 				uint64_t b_bitmap_blk =
 					ext4fs_bg_get_block_id(bgd, fs);
 				if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-					memcpy(fs->blk_bmaps[i], zero_buffer,
-					       fs->blksz);
+					if (ext4fs_init_block_bmap(i))
+						continue;
 					put_ext4(b_bitmap_blk * fs->blksz,
 						 fs->blk_bmaps[i], fs->blksz);
 					bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
@@ -1031,7 +1105,11 @@ restart:
 
 		struct ext2_block_group *bgd = NULL;
 		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
-		if (ext4fs_bg_get_free_blocks(bgd, fs) == 0) {
+		uint16_t bg_flags = ext4fs_bg_get_flags(bgd);
+
+		if (ext4fs_bg_get_free_blocks(bgd, fs) == 0 ||
+		    ((bg_flags & EXT4_BG_BLOCK_UNINIT) &&
+		     ext4fs_init_block_bmap(bg_idx))) {
 			debug("block group %u is full. Skipping\n", bg_idx);
 			fs->curr_blkno = (bg_idx + 1) * blk_per_grp;
 			if (fs->blksz == 1024)
@@ -1039,12 +1117,10 @@ restart:
 			goto restart;
 		}
 
-		uint16_t bg_flags = ext4fs_bg_get_flags(bgd);
 		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
 		if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-			memcpy(fs->blk_bmaps[bg_idx], zero_buffer, fs->blksz);
 			put_ext4(b_bitmap_blk * fs->blksz,
-				 zero_buffer, fs->blksz);
+				 fs->blk_bmaps[bg_idx], fs->blksz);
 			bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
 			ext4fs_bg_set_flags(bgd, bg_flags);
 		}
@@ -1074,16 +1150,175 @@ restart:
 	}
 success:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return fs->curr_blkno;
 fail:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return -1;
 }
 
+/*
+ * Journal the on-disk block bitmap of a group about to be modified, once
+ * per operation.
+ */
+int ext4fs_log_block_bmap(int bg_idx)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+	uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
+	unsigned char mask = 1 << (bg_idx & 7);
+	char *journal_buffer;
+	int ret = -1;
+
+	if (fs->blk_bmaps_logged[bg_idx >> 3] & mask)
+		return 0;
+
+	journal_buffer = zalloc(fs->blksz);
+	if (!journal_buffer)
+		return -ENOMEM;
+
+	if (ext4fs_devread(b_bitmap_blk * fs->sect_perblk, 0, fs->blksz,
+			   journal_buffer))
+		ret = ext4fs_log_journal(journal_buffer, b_bitmap_blk);
+	free(journal_buffer);
+
+	if (!ret)
+		fs->blk_bmaps_logged[bg_idx >> 3] |= mask;
+
+	return ret;
+}
+
+/* Length of the run of free blocks at 'bit' in a bitmap, at most 'max' */
+static uint32_t ext4fs_free_run(const unsigned char *bmap, uint32_t bit,
+				uint32_t nbits, uint32_t max)
+{
+	uint32_t len = 0;
+
+	if (max > nbits - bit)
+		max = nbits - bit;
+
+	while (len < max) {
+		uint32_t b = bit + len;
+
+		if (!(b & 7) && !bmap[b >> 3] && max - len >= 8) {
+			len += 8;
+			continue;
+		}
+		if (bmap[b >> 3] & (1 << (b & 7)))
+			break;
+		len++;
+	}
+
+	return len;
+}
+
+/**
+ * ext4fs_alloc_blocks() - Allocate a run of contiguous blocks
+ *
+ * Look for the longest run of free blocks, up to 'max', in one pass over
+ * the block bitmaps from 'goal' on, coming back to the start of the goal
+ * group last. The search stops at the first run of 'max' blocks, and groups
+ * whose descriptors show fewer free blocks than the best run found so far
+ * are not scanned.
+ *
+ * @goal:	Block to start looking from
+ * @max:	Maximum number of blocks to allocate
+ * @start:	Returns the first block allocated
+ * @return number of blocks allocated, 0 if the filesystem is full, -ve on
+ * error
+ */
+int ext4fs_alloc_blocks(uint32_t goal, uint32_t max, uint32_t *start)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_sblock *sblock = &ext4fs_root->sblock;
+	uint32_t first = le32_to_cpu(sblock->first_data_block);
+	uint32_t blk_per_grp = le32_to_cpu(sblock->blocks_per_group);
+	uint32_t total = le32_to_cpu(sblock->total_blocks);
+	uint32_t best_len = 0, best_bit = 0;
+	uint32_t bit, end, len, nbits, goal_bit, i;
+	struct ext2_block_group *bgd;
+	unsigned char *bmap;
+	int bg_idx, best_bg = -1, bg_goal;
+	uint16_t bg_flags;
+
+	if (goal < first || goal >= total)
+		goal = first;
+	bg_goal = (goal - first) / blk_per_grp;
+	goal_bit = (goal - first) % blk_per_grp;
+
+	for (i = 0; i <= fs->no_blkgrp && best_len < max; i++) {
+		bg_idx = (bg_goal + i) % fs->no_blkgrp;
+		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+
+		/* A group cannot hold a run longer than its free blocks */
+		if (ext4fs_bg_get_free_blocks(bgd, fs) <= best_len)
+			continue;
+
+		nbits = min(blk_per_grp, (uint32_t)fs->blksz * 8);
+		if (nbits > total - first - bg_idx * blk_per_grp)
+			nbits = total - first - bg_idx * blk_per_grp;
+
+		/* The goal group is scanned from the goal, then up to it */
+		bit = i ? 0 : goal_bit;
+		end = i < fs->no_blkgrp ? nbits : min(goal_bit, nbits);
+		if (bit >= end)
+			continue;
+
+		/* Uninitialised bitmaps are only written once chosen */
+		if ((ext4fs_bg_get_flags(bgd) & EXT4_BG_BLOCK_UNINIT) &&
+		    ext4fs_init_block_bmap(bg_idx))
+			continue;
+
+		bmap = fs->blk_bmaps[bg_idx];
+		while (bit < end && best_len < max) {
+			/* Skip the used blocks, a byte at a time if possible */
+			if (!(bit & 7) && bmap[bit >> 3] == 0xff) {
+				bit += 8;
+				continue;
+			}
+			if (bmap[bit >> 3] & (1 << (bit & 7))) {
+				bit++;
+				continue;
+			}
+
+			len = ext4fs_free_run(bmap, bit, nbits, max);
+			if (len > best_len) {
+				best_len = len;
+				best_bit = bit;
+				best_bg = bg_idx;
+			}
+			bit += len;
+		}
+	}
+
+	if (!best_len)
+		return 0;
+
+	bgd = ext4fs_get_group_descriptor(fs, best_bg);
+	bmap = fs->blk_bmaps[best_bg];
+	bg_flags = ext4fs_bg_get_flags(bgd);
+	if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
+		put_ext4(ext4fs_bg_get_block_id(bgd, fs) * fs->blksz, bmap,
+			 fs->blksz);
+		bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
+		ext4fs_bg_set_flags(bgd, bg_flags);
+	}
+
+	if (ext4fs_log_block_bmap(best_bg))
+		return -EIO;
+
+	for (bit = best_bit; bit < best_bit + best_len; bit++) {
+		bmap[bit >> 3] |= 1 << (bit & 7);
+		ext4fs_bg_free_blocks_dec(bgd, fs);
+		ext4fs_sb_free_blocks_dec(fs->sb);
+	}
+
+	*start = first + best_bg * blk_per_grp + best_bit;
+
+	return best_len;
+}
+
 int ext4fs_get_new_inode_no(void)
 {
 	short i;
@@ -1976,6 +2211,148 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	return blknr;
 }
 
+/* Map 'fileblock' from the extents in the cache, return false on a miss */
+static bool ext4fs_map_cached(struct ext_extent_cache *cache,
+			      uint32_t fileblock, uint32_t max,
+			      uint64_t *blknr, uint32_t *count)
+{
+	int i;
+
+	if (!cache->count || fileblock < cache->first)
+		return false;
+
+	for (i = 0; i < cache->count; i++) {
+		uint32_t block = cache->ext[i].block;
+		uint32_t len = cache->ext[i].len;
+
+		if (fileblock < block) {
+			/* Sparse file */
+			*blknr = 0;
+			*count = min(block - fileblock, max);
+			return true;
+		}
+
+		if (fileblock - block < len) {
+			*blknr = cache->ext[i].start;
+			if (*blknr)
+				*blknr += fileblock - block;
+			*count = min(block + len - fileblock, max);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int ext4fs_map_extents(struct ext2_inode *inode, uint32_t fileblock,
+			      uint32_t max, struct ext_extent_cache *cache,
+			      uint64_t *blknr, uint32_t *count)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	int log2_blksz;
+	int i, entries;
+
+	if (ext4fs_map_cached(cache, fileblock, max, blknr, count))
+		return 0;
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		     get_fs()->dev_desc->log2blksz;
+	ext_block = ext4fs_get_extent_block(ext4fs_root, &cache->blocks,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock, log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	entries = le16_to_cpu(ext_block->eh_entries);
+
+	/* Skip the extents ending before fileblock */
+	for (i = 0; i < entries; i++) {
+		uint32_t len = le16_to_cpu(extent[i].ee_len);
+
+		if (len > EXT_INIT_MAX_LEN)
+			len -= EXT_INIT_MAX_LEN;
+		if (le32_to_cpu(extent[i].ee_block) + len > fileblock)
+			break;
+	}
+
+	/* Cache the extents from there on, up to the end of the leaf */
+	cache->first = fileblock;
+	for (cache->count = 0; i < entries; i++) {
+		uint32_t len = le16_to_cpu(extent[i].ee_len);
+		uint64_t start;
+		struct ext_cached_extent *e;
+
+		if (cache->count == EXT_EXTENT_CACHE_SIZE)
+			break;
+
+		start = le16_to_cpu(extent[i].ee_start_hi);
+		start = (start << 32) + le32_to_cpu(extent[i].ee_start_lo);
+		/* Unwritten extents read back as zeroes, like holes */
+		if (len > EXT_INIT_MAX_LEN) {
+			len -= EXT_INIT_MAX_LEN;
+			start = 0;
+		}
+
+		e = &cache->ext[cache->count++];
+		e->block = le32_to_cpu(extent[i].ee_block);
+		e->len = len;
+		e->start = start;
+	}
+
+	if (!ext4fs_map_cached(cache, fileblock, max, blknr, count)) {
+		/* Sparse file, past the last extent of the leaf */
+		*blknr = 0;
+		*count = 1;
+	}
+
+	return 0;
+}
+
+/**
+ * ext4fs_map_blocks() - Map a run of file blocks to filesystem blocks
+ *
+ * @inode:	Inode of the file
+ * @fileblock:	First file block of the run
+ * @max:	Maximum number of blocks in the run
+ * @cache:	Extent cache of the file, see ext_extent_cache_init()
+ * @blknr:	Returns the first filesystem block of the run, 0 for a hole
+ * @count:	Returns the number of blocks in the run, at least 1
+ * @return 0 if OK, -ve on error
+ */
+int ext4fs_map_blocks(struct ext2_inode *inode, uint32_t fileblock,
+		      uint32_t max, struct ext_extent_cache *cache,
+		      uint64_t *blknr, uint32_t *count)
+{
+	long int first, next;
+	uint32_t n;
+
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extents(inode, fileblock, max, cache,
+					  blknr, count);
+
+	/* Block maps have to be followed block by block */
+	first = read_allocated_block(inode, fileblock, &cache->blocks);
+	if (first < 0)
+		return first;
+
+	for (n = 1; n < max; n++) {
+		next = read_allocated_block(inode, fileblock + n,
+					    &cache->blocks);
+		if (next < 0 || next != (first ? first + n : 0))
+			break;
+	}
+
+	*blknr = first;
+	*count = n;
+
+	return 0;
+}
+
 /**
  * ext4fs_reinit_global() - Reinitialize values of ext4 write implementation's
  *			    global pointers
@@ -2009,6 +2386,15 @@ void ext4fs_reinit_global(void)
 		ext4fs_indir3_blkno = -1;
 	}
 }
+
+/* Free the file opened by ext4fs_open() and keep the filesystem mounted */
+void ext4fs_release(void)
+{
+	if (ext4fs_file && ext4fs_root)
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+	ext4fs_file = NULL;
+}
+
 void ext4fs_close(void)
 {
 	if ((ext4fs_file != NULL) && (ext4fs_root != NULL)) {
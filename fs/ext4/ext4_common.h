@@ -62,6 +62,8 @@ uint16_t ext4fs_checksum_update(unsigned int i);
 int ext4fs_get_parent_inode_num(const char *dirname, char *dname, int flags);
 int ext4fs_update_parent_dentry(char *filename, int file_type);
 uint32_t ext4fs_get_new_blk_no(void);
+int ext4fs_alloc_blocks(uint32_t goal, uint32_t max, uint32_t *start);
+int ext4fs_log_block_bmap(int bg_idx);
 int ext4fs_get_new_inode_no(void);
 void ext4fs_reset_block_bmap(long int blockno, unsigned char *buffer,
 					int index);
@@ -431,24 +431,103 @@ fail:
 	free(journal_buffer);
 }
 
+/*
+ * Give back blocks taken by ext4fs_alloc_blocks(), journalling the bitmaps
+ * of their groups.
+ */
+static int ext4fs_free_blocks(uint32_t start, uint32_t count)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t blk_per_grp;
+	struct ext2_block_group *bgd;
+	int bg_idx;
+
+	blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
+
+	for (; count; start++, count--) {
+		bg_idx = start / blk_per_grp;
+		if (fs->blksz == 1024 && !(start % blk_per_grp))
+			bg_idx--;
+
+		if (ext4fs_log_block_bmap(bg_idx))
+			return -1;
+
+		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
+
+		ext4fs_reset_block_bmap(start, fs->blk_bmaps[bg_idx], bg_idx);
+		ext4fs_bg_free_blocks_inc(bgd, fs);
+		ext4fs_sb_free_blocks_inc(fs->sb);
+	}
+
+	return 0;
+}
+
+/*
+ * Free the data blocks mapped by an extent tree node, unwritten extents
+ * included, and the blocks of the nodes below it.
+ */
+static int ext4fs_free_extent_tree(struct ext4_extent_header *eh, int depth)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent *ext = (struct ext4_extent *)(eh + 1);
+	struct ext4_extent_idx *idx = (struct ext4_extent_idx *)(eh + 1);
+	int entries = le16_to_cpu(eh->eh_entries);
+	uint32_t len, leaf;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(eh->eh_depth) != depth)
+		return -1;
+
+	if (!depth) {
+		for (i = 0; i < entries; i++) {
+			len = le16_to_cpu(ext[i].ee_len);
+			if (len > EXT_INIT_MAX_LEN)
+				len -= EXT_INIT_MAX_LEN;
+			debug("EXT4 Block releasing %u: %u\n",
+			      le32_to_cpu(ext[i].ee_start_lo), len);
+			if (ext4fs_free_blocks(le32_to_cpu(ext[i].ee_start_lo),
+					       len))
+				return -1;
+		}
+
+		return 0;
+	}
+
+	buf = zalloc(fs->blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	for (i = 0; i < entries && !ret; i++) {
+		leaf = le32_to_cpu(idx[i].ei_leaf_lo);
+		if (!ext4fs_devread((lbaint_t)leaf * fs->sect_perblk, 0,
+				    fs->blksz, buf) ||
+		    ext4fs_free_extent_tree((struct ext4_extent_header *)buf,
+					    depth - 1) ||
+		    ext4fs_free_blocks(leaf, 1))
+			ret = -1;
+	}
+	free(buf);
+
+	return ret;
+}
+
 static int ext4fs_delete_file(int inodeno)
 {
 	struct ext2_inode inode;
+	struct ext_extent_cache cache;
 	short status;
-	int i;
-	int remainder;
-	long int blknr;
-	int bg_idx;
+	uint32_t i, count;
+	uint64_t blknr;
 	int ibmap_idx;
 	char *read_buffer = NULL;
 	char *start_block_address = NULL;
 	uint32_t no_blocks;
 
-	static int prev_bg_bmap_idx = -1;
 	unsigned int inodes_per_block;
 	uint32_t blkno;
 	unsigned int blkoff;
-	uint32_t blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	uint32_t inode_per_grp = le32_to_cpu(ext4fs_root->sblock.inodes_per_group);
 	struct ext2_inode *inode_buffer = NULL;
 	struct ext2_block_group *bgd = NULL;
@@ -466,50 +545,39 @@ static int ext4fs_delete_file(int inodeno)
 		no_blocks++;
 
 	if (le32_to_cpu(inode.flags) & EXT4_EXTENTS_FL) {
-		/* FIXME delete extent index blocks, i.e. eh_depth >= 1 */
 		struct ext4_extent_header *eh =
 			(struct ext4_extent_header *)
 				inode.b.blocks.dir_blocks;
+
+		/*
+		 * Walk the extents rather than map the file block by block,
+		 * which would see preallocated (unwritten) ones as holes.
+		 */
 		debug("del: dep=%d entries=%d\n", eh->eh_depth, eh->eh_entries);
+		if (ext4fs_free_extent_tree(eh, le16_to_cpu(eh->eh_depth)))
+			goto fail;
 	} else {
 		delete_single_indirect_block(&inode);
 		delete_double_indirect_block(&inode);
 		delete_triple_indirect_block(&inode);
-	}
 
-	/* release data blocks */
-	for (i = 0; i < no_blocks; i++) {
-		blknr = read_allocated_block(&inode, i, NULL);
-		if (blknr == 0)
-			continue;
-		if (blknr < 0)
-			goto fail;
-		bg_idx = blknr / blk_per_grp;
-		if (fs->blksz == 1024) {
-			remainder = blknr % blk_per_grp;
-			if (!remainder)
-				bg_idx--;
-		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-					bg_idx);
-		debug("EXT4 Block releasing %ld: %d\n", blknr, bg_idx);
-
-		/* get  block group descriptor table */
-		bgd = ext4fs_get_group_descriptor(fs, bg_idx);
-		ext4fs_bg_free_blocks_inc(bgd, fs);
-		ext4fs_sb_free_blocks_inc(fs->sb);
-		/* journal backup */
-		if (prev_bg_bmap_idx != bg_idx) {
-			uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
-			status = ext4fs_devread(b_bitmap_blk * fs->sect_perblk,
-						0, fs->blksz,
-						journal_buffer);
-			if (status == 0)
+		/* release data blocks, a run of contiguous blocks at a time */
+		ext_extent_cache_init(&cache);
+		for (i = 0; i < no_blocks; i += count) {
+			if (ext4fs_map_blocks(&inode, i, no_blocks - i, &cache,
+					      &blknr, &count)) {
+				ext_extent_cache_fini(&cache);
 				goto fail;
-			if (ext4fs_log_journal(journal_buffer, b_bitmap_blk))
+			}
+			if (!blknr)
+				continue;
+			debug("EXT4 Block releasing %llu: %u\n", blknr, count);
+			if (ext4fs_free_blocks(blknr, count)) {
+				ext_extent_cache_fini(&cache);
 				goto fail;
-			prev_bg_bmap_idx = bg_idx;
+			}
 		}
+		ext_extent_cache_fini(&cache);
 	}
 
 	/* release inode */
@@ -626,6 +694,9 @@ int ext4fs_init(void)
 		if (!fs->blk_bmaps[i])
 			goto fail;
 	}
+	fs->blk_bmaps_logged = zalloc(DIV_ROUND_UP(fs->no_blkgrp, 8));
+	if (!fs->blk_bmaps_logged)
+		goto fail;
 
 	for (i = 0; i < fs->no_blkgrp; i++) {
 		struct ext2_block_group *bgd =
@@ -724,6 +795,8 @@ void ext4fs_deinit(void)
 		free(fs->blk_bmaps);
 		fs->blk_bmaps = NULL;
 	}
+	free(fs->blk_bmaps_logged);
+	fs->blk_bmaps_logged = NULL;
 
 	if (fs->inode_bmaps) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
@@ -748,86 +821,230 @@ void ext4fs_deinit(void)
 }
 
 /*
- * Write data to filesystem blocks. Uses same optimization for
- * contigous sectors as ext4fs_read_file
+ * Write one level of an extent tree under construction: pack 'nr' entries
+ * of 'size' bytes, extents or indexes, into newly allocated blocks and
+ * return the indexes pointing to those blocks in 'up'.
+ */
+static int ext4fs_write_extent_level(const void *ents, int nr, int size,
+				     int depth, uint32_t *goal,
+				     struct ext4_extent_idx **up, int *nr_up,
+				     uint32_t **meta, int *nr_meta)
+{
+	struct ext_filesystem *fs = get_fs();
+	int per_blk = (fs->blksz - sizeof(struct ext4_extent_header)) / size;
+	const char *ent = ents;
+	struct ext4_extent_header *eh;
+	struct ext4_extent_idx *idx;
+	uint32_t start, *m;
+	char *blk;
+	int i, n;
+
+	*nr_up = DIV_ROUND_UP(nr, per_blk);
+	idx = calloc(*nr_up, sizeof(*idx));
+	m = realloc(*meta, (*nr_meta + *nr_up) * sizeof(*m));
+	blk = zalloc(fs->blksz);
+	if (!idx || !m || !blk) {
+		free(idx);
+		free(blk);
+		if (m)
+			*meta = m;
+		return -ENOMEM;
+	}
+	*meta = m;
+	eh = (struct ext4_extent_header *)blk;
+
+	for (i = 0; i < *nr_up; i++, ent += n * size) {
+		n = min(nr - i * per_blk, per_blk);
+
+		if (ext4fs_alloc_blocks(*goal, 1, &start) <= 0) {
+			printf("no block left to assign\n");
+			free(idx);
+			free(blk);
+			return -ENOSPC;
+		}
+		m[(*nr_meta)++] = start;
+
+		memset(blk, 0, fs->blksz);
+		eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+		eh->eh_entries = cpu_to_le16(n);
+		eh->eh_max = cpu_to_le16(per_blk);
+		eh->eh_depth = cpu_to_le16(depth);
+		memcpy(eh + 1, ent, n * size);
+		put_ext4((uint64_t)start * fs->blksz, blk, fs->blksz);
+
+		/* ee_block and ei_block both come first */
+		idx[i].ei_block = *(const __le32 *)ent;
+		idx[i].ei_leaf_lo = cpu_to_le32(start);
+		*goal = start + 1;
+	}
+
+	free(blk);
+	*up = idx;
+
+	return 0;
+}
+
+/*
+ * Allocate the data blocks of a new file in as few contiguous runs as the
+ * free space allows, and map them with extents: in the inode for up to four
+ * runs, else through as many levels of leaf and index blocks as needed.
  */
+static int ext4fs_allocate_extents(struct ext2_inode *file_inode,
+				   uint32_t blocks,
+				   unsigned int *total_no_of_block)
+{
+	struct ext4_extent_header *eh =
+		(struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	int inline_max = (sizeof(file_inode->b) - sizeof(*eh)) /
+			 sizeof(struct ext4_extent);
+	struct ext4_extent *ext = NULL, *e;
+	struct ext4_extent_idx *idx = NULL, *up;
+	uint32_t *meta = NULL;
+	int nr = 0, alloc = 0, nr_idx, nr_meta = 0, depth = 0;
+	uint32_t fileblock = 0, goal = 0, start;
+	int i, ret;
+
+	while (fileblock < blocks) {
+		ret = ext4fs_alloc_blocks(goal, min(blocks - fileblock,
+						    (uint32_t)EXT_INIT_MAX_LEN),
+					  &start);
+		if (ret <= 0) {
+			printf("no block left to assign\n");
+			goto fail;
+		}
+
+		if (nr == alloc) {
+			alloc = alloc ? alloc * 2 : 16;
+			e = realloc(ext, alloc * sizeof(*ext));
+			if (!e) {
+				ext4fs_free_blocks(start, ret);
+				goto fail;
+			}
+			ext = e;
+		}
+
+		e = &ext[nr++];
+		e->ee_block = cpu_to_le32(fileblock);
+		e->ee_len = cpu_to_le16(ret);
+		e->ee_start_hi = 0;
+		e->ee_start_lo = cpu_to_le32(start);
+		debug("EXT %u: %u blocks at %u\n", fileblock, ret, start);
+
+		fileblock += ret;
+		goal = start + ret;
+	}
+
+	/* Add levels of leaf, then index, blocks until the root fits */
+	nr_idx = nr;
+	while (nr_idx > inline_max) {
+		if (depth)
+			ret = ext4fs_write_extent_level(idx, nr_idx,
+							sizeof(*idx), depth,
+							&goal, &up, &nr_idx,
+							&meta, &nr_meta);
+		else
+			ret = ext4fs_write_extent_level(ext, nr, sizeof(*ext),
+							depth, &goal, &up,
+							&nr_idx, &meta,
+							&nr_meta);
+		if (ret)
+			goto fail;
+
+		free(idx);
+		idx = up;
+		depth++;
+	}
+
+	memset(&file_inode->b, 0, sizeof(file_inode->b));
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_max = cpu_to_le16(inline_max);
+	eh->eh_entries = cpu_to_le16(nr_idx);
+	eh->eh_depth = cpu_to_le16(depth);
+	if (depth)
+		memcpy(eh + 1, idx, nr_idx * sizeof(*idx));
+	else
+		memcpy(eh + 1, ext, nr * sizeof(*ext));
+	*total_no_of_block += nr_meta;
+
+	file_inode->flags |= cpu_to_le32(EXT4_EXTENTS_FL);
+	free(meta);
+	free(idx);
+	free(ext);
+
+	return 0;
+
+fail:
+	for (i = 0; i < nr_meta; i++)
+		ext4fs_free_blocks(meta[i], 1);
+	for (i = 0; i < nr; i++)
+		ext4fs_free_blocks(le32_to_cpu(ext[i].ee_start_lo),
+				   le16_to_cpu(ext[i].ee_len));
+	memset(&file_inode->b, 0, sizeof(file_inode->b));
+	free(meta);
+	free(idx);
+	free(ext);
+
+	return -1;
+}
+
+/* Write data to filesystem blocks, a run of contiguous blocks at a time */
 static int ext4fs_write_file(struct ext2_inode *file_inode,
 			     int pos, unsigned int len, char *buf)
 {
-	int i;
-	int blockcnt;
 	uint32_t filesize = le32_to_cpu(file_inode->size);
 	struct ext_filesystem *fs = get_fs();
-	int log2blksz = fs->dev_desc->log2blksz;
-	int log2_fs_blocksize = LOG2_BLOCK_SIZE(ext4fs_root) - log2blksz;
-	int previous_block_number = -1;
-	int delayed_start = 0;
-	int delayed_extent = 0;
-	int delayed_next = 0;
-	char *delayed_buf = NULL;
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(ext4fs_root);
+	struct ext_extent_cache cache;
+	uint32_t fileblock, blockcnt, count, max, full, tail;
+	uint64_t blknr;
+	char *bounce;
+	int ret = 0;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len > filesize)
 		len = filesize;
 
 	blockcnt = ((len + pos) + fs->blksz - 1) / fs->blksz;
+	/* Bytes of the caller's buffer in the last, partial, block */
+	tail = (len + pos) % fs->blksz;
+
+	ext_extent_cache_init(&cache);
+	for (fileblock = pos / fs->blksz; fileblock < blockcnt;
+	     fileblock += count) {
+		/* Keep the byte count of a run within put_ext4()'s size */
+		max = min(blockcnt - fileblock,
+			  (uint32_t)(INT_MAX / fs->blksz));
+		ret = ext4fs_map_blocks(file_inode, fileblock, max, &cache,
+					&blknr, &count);
+		if (ret || !blknr) {
+			ret = -1;
+			break;
+		}
 
-	for (i = pos / fs->blksz; i < blockcnt; i++) {
-		long int blknr;
-		int blockend = fs->blksz;
-		int skipfirst = 0;
-		blknr = read_allocated_block(file_inode, i, NULL);
-		if (blknr <= 0)
-			return -1;
+		full = count;
+		if (tail && fileblock + count == blockcnt)
+			full--;
+		if (full)
+			put_ext4(blknr << log2_fs_blocksize, buf,
+				 full * fs->blksz);
+		buf += full * fs->blksz;
+		if (full == count)
+			continue;
 
-		blknr = blknr << log2_fs_blocksize;
-
-		if (blknr) {
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					put_ext4((uint64_t)
-						 ((uint64_t)delayed_start << log2blksz),
-						 delayed_buf,
-						 (uint32_t) delayed_extent);
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_buf = buf;
-					delayed_next = blknr +
-					    (blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_buf = buf;
-				delayed_next = blknr +
-				    (blockend >> log2blksz);
-			}
-		} else {
-			if (previous_block_number != -1) {
-				/* spill */
-				put_ext4((uint64_t) ((uint64_t)delayed_start <<
-						     log2blksz),
-					 delayed_buf,
-					 (uint32_t) delayed_extent);
-				previous_block_number = -1;
-			}
-			memset(buf, 0, fs->blksz - skipfirst);
+		/* Don't read past the end of the buffer for the last block */
+		bounce = zalloc(fs->blksz);
+		if (!bounce) {
+			ret = -ENOMEM;
+			break;
 		}
-		buf += fs->blksz - skipfirst;
-	}
-	if (previous_block_number != -1) {
-		/* spill */
-		put_ext4((uint64_t) ((uint64_t)delayed_start << log2blksz),
-			 delayed_buf, (uint32_t) delayed_extent);
-		previous_block_number = -1;
+		memcpy(bounce, buf, tail);
+		put_ext4((blknr + full) << log2_fs_blocksize, bounce,
+			 fs->blksz);
+		free(bounce);
 	}
+	ext_extent_cache_fini(&cache);
 
-	return len;
+	return ret ? ret : len;
 }
 
 int ext4fs_write(const char *fname, unsigned char *buffer,
@@ -925,8 +1142,15 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	file_inode->size = cpu_to_le32(sizebytes);
 
 	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	if (le32_to_cpu(fs->sb->feature_incompat) &
+	    EXT4_FEATURE_INCOMPAT_EXTENTS) {
+		if (ext4fs_allocate_extents(file_inode, blocks_remaining,
+					    &blks_reqd_for_file))
+			goto fail;
+	} else {
+		ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				       &blks_reqd_for_file);
+	}
 	file_inode->blockcnt = cpu_to_le32((blks_reqd_for_file * fs->blksz) >>
 		fs->dev_desc->log2blksz);
 
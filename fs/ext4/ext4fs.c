@@ -25,6 +25,7 @@
 #include <ext4fs.h>
 #include "ext4_common.h"
 #include <div64.h>
+#include <fs_internal.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
@@ -49,133 +50,62 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
-	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
-	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
-	lbaint_t delayed_next = 0;
-	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
-	struct ext_block_cache cache;
-
-	ext_cache_init(&cache);
+	struct ext_extent_cache cache;
+	uint32_t fileblock, blockcnt, count, max;
+	uint64_t blknr;
+	loff_t done = 0, n;
+	int skipfirst;
+	int ret = 0;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
 		len = (filesize - pos);
 
-	if (blocksize <= 0 || len <= 0) {
-		ext_cache_fini(&cache);
+	if (blocksize <= 0 || len <= 0)
 		return -1;
-	}
-
-	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
-
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
-		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
-		if (blknr < 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-
-		blknr = blknr << log2_fs_blocksize;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
+	ext_extent_cache_init(&cache);
 
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+	fileblock = lldiv(pos, blocksize);
+	skipfirst = pos - (loff_t)fileblock * blocksize;
+	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
-		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
+	/* Read each run of contiguous blocks, or zero each hole, in one go */
+	while (done < len) {
+		/* Keep the byte count of a run within an int */
+		max = min(blockcnt - fileblock,
+			  (uint32_t)(INT_MAX / blocksize));
+		ret = ext4fs_map_blocks(&node->inode, fileblock, max, &cache,
+					&blknr, &count);
+		if (ret)
+			break;
+
+		n = min((loff_t)count * blocksize - skipfirst, len - done);
 		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
+			if (!ext4fs_devread(blknr << log2_fs_blocksize,
+					    skipfirst, n, buf)) {
+				ret = -1;
+				break;
 			}
 		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
-				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
-			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - (buf - start_buf);
-			if (n > n_left)
-				n = n_left;
 			memset(buf, 0, n);
 		}
-		buf += blocksize - skipfirst;
-	}
-	if (previous_block_number != -1) {
-		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
-			ext_cache_fini(&cache);
-			return -1;
-		}
-		previous_block_number = -1;
+
+		buf += n;
+		done += n;
+		fileblock += count;
+		skipfirst = 0;
 	}
 
+	ext_extent_cache_fini(&cache);
+	if (ret)
+		return -1;
+
 	*actread  = len;
-	ext_cache_fini(&cache);
 	return 0;
 }
 
@@ -255,6 +185,27 @@ int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	return ext4fs_read(buf, offset, len, len_read);
 }
 
+static int ext4_stream_read(void *ctx, void *buf, loff_t pos, loff_t len,
+			    loff_t *actread)
+{
+	return ext4fs_read(buf, pos, len, actread) ? -EIO : 0;
+}
+
+int ext4_read_stream(const char *filename, loff_t offset, loff_t len,
+		     int (*consume)(void *priv, const void *buf, size_t len),
+		     void *priv, loff_t *actread)
+{
+	loff_t file_len;
+
+	if (ext4fs_open(filename, &file_len) < 0) {
+		printf("** File not found %s **\n", filename);
+		return -ENOENT;
+	}
+
+	return fs_stream_chunks(file_len, offset, len, ext4_stream_read, NULL,
+				consume, priv, actread);
+}
+
 int ext4fs_uuid(char *uuid_str)
 {
 	if (ext4fs_root == NULL)
@@ -281,6 +232,18 @@ void ext_cache_fini(struct ext_block_cache *cache)
 	ext_cache_init(cache);
 }
 
+void ext_extent_cache_init(struct ext_extent_cache *cache)
+{
+	ext_cache_init(&cache->blocks);
+	cache->count = 0;
+}
+
+void ext_extent_cache_fini(struct ext_extent_cache *cache)
+{
+	ext_cache_fini(&cache->blocks);
+	cache->count = 0;
+}
+
 int ext_cache_read(struct ext_block_cache *cache, lbaint_t block, int size)
 {
 	/* This could be more lenient, but this is simple and enough for now */
@@ -14,7 +14,10 @@
 #include <exports.h>
 #include <fat.h>
 #include <fs.h>
+#include <fs_internal.h>
 #include <asm/byteorder.h>
+#include <asm/unaligned.h>
+#include <div64.h>
 #include <part.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -36,10 +39,42 @@ static void downcase(char *str, size_t len)
 
 static struct blk_desc *cur_dev;
 static disk_partition_t cur_part_info;
+static u32 cur_vol_id;
 
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
+/* The volume serial number comes right before the volume label */
+#define DOS_VOL_ID_OFFSET(type)	((type) - 0xf)
+
+/* A run of consecutive clusters */
+struct fat_extent {
+	__u32 start;	/* first cluster */
+	__u32 count;	/* number of clusters */
+};
+
+/*
+ * Cluster runs of the file read last. Reading a file in pieces, as the
+ * streaming loaders do, then walks its cluster chain only once. They are
+ * only valid while the volume stays mounted, see fat_close().
+ */
+static struct {
+	struct blk_desc *dev;	/* device, partition and volume of the file */
+	lbaint_t part_start;
+	u32 vol_id;
+	__u32 first_clust;	/* first cluster of the file */
+	loff_t size;		/* file size */
+	__u32 covered;		/* number of clusters in the runs */
+	__u32 next;		/* cluster following the runs */
+	int count;		/* number of runs, -1 if not valid */
+	int alloc;		/* number of runs allocated */
+	struct fat_extent *ext;
+} fat_extents = { .count = -1 };
+
+static void fat_extents_invalidate(void)
+{
+	fat_extents.count = -1;
+}
 
 static int disk_read(__u32 block, __u32 nr_blocks, void *buf)
 {
@@ -60,6 +95,7 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, disk_partition_t *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	fat_extents_invalidate();
 	cur_dev = dev_desc;
 	cur_part_info = *info;
 
@@ -76,15 +112,29 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, disk_partition_t *info)
 	}
 
 	/* Check for FAT12/FAT16/FAT32 filesystem */
-	if (!memcmp(buffer + DOS_FS_TYPE_OFFSET, "FAT", 3))
+	if (!memcmp(buffer + DOS_FS_TYPE_OFFSET, "FAT", 3)) {
+		cur_vol_id = get_unaligned_le32(buffer +
+				DOS_VOL_ID_OFFSET(DOS_FS_TYPE_OFFSET));
 		return 0;
-	if (!memcmp(buffer + DOS_FS32_TYPE_OFFSET, "FAT32", 5))
+	}
+	if (!memcmp(buffer + DOS_FS32_TYPE_OFFSET, "FAT32", 5)) {
+		cur_vol_id = get_unaligned_le32(buffer +
+				DOS_VOL_ID_OFFSET(DOS_FS32_TYPE_OFFSET));
 		return 0;
+	}
 
 	cur_dev = NULL;
 	return -1;
 }
 
+/* Check the FAT volume selected last is still the one on this partition */
+bool fat_mounted(struct blk_desc *dev_desc, disk_partition_t *info)
+{
+	return cur_dev && cur_dev == dev_desc &&
+	       cur_part_info.start == info->start &&
+	       cur_part_info.size == info->size;
+}
+
 int fat_register_device(struct blk_desc *dev_desc, int part_no)
 {
 	disk_partition_t info;
@@ -155,6 +205,97 @@ int flush_dirty_fat_buffer(fsdata *mydata)
 }
 #endif
 
+/*
+ * Allocate fatbuf, with room for the cache slots, and mark it empty.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_alloc(fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbufnum = -1;
+	mydata->fat_dirty = 0;
+	mydata->fatcache_tick = 0;
+	for (i = 0; i < FATCACHE_SLOTS; i++)
+		mydata->fatcache_num[i] = -1;
+
+	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE *
+					      CONFIG_FS_FAT_CACHE_WINDOWS);
+	if (!mydata->fatbuf) {
+		debug("Error: allocating memory\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void fat_cache_swap(__u8 *a, __u8 *b, __u32 size)
+{
+	__u32 *x = (__u32 *)a, *y = (__u32 *)b, tmp;
+
+	for (size /= sizeof(*x); size; size--, x++, y++) {
+		tmp = *x;
+		*x = *y;
+		*y = tmp;
+	}
+}
+
+/*
+ * Make FAT window 'bufnum' the current one in fatbuf, from a cache slot if
+ * it is there or from the disk otherwise. The window it replaces is written
+ * back if dirty, then kept in the least recently used cache slot.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_cache_load(fsdata *mydata, __u32 bufnum)
+{
+	__u32 size = FATBUFSIZE;
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i, victim = 0;
+
+	/* Cache slots only ever hold clean windows */
+	if (flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	for (i = 0; i < FATCACHE_SLOTS; i++) {
+		if (mydata->fatcache_num[i] == (int)bufnum) {
+			fat_cache_swap(mydata->fatbuf,
+				       mydata->fatbuf + (i + 1) * size, size);
+			mydata->fatcache_num[i] = mydata->fatbufnum;
+			mydata->fatcache_lru[i] = ++mydata->fatcache_tick;
+			mydata->fatbufnum = bufnum;
+			return 0;
+		}
+
+		if (mydata->fatcache_num[victim] != -1 &&
+		    (mydata->fatcache_num[i] == -1 ||
+		     mydata->fatcache_lru[i] < mydata->fatcache_lru[victim]))
+			victim = i;
+	}
+
+	if (FATCACHE_SLOTS && mydata->fatbufnum != -1) {
+		memcpy(mydata->fatbuf + (victim + 1) * size, mydata->fatbuf,
+		       size);
+		mydata->fatcache_num[victim] = mydata->fatbufnum;
+		mydata->fatcache_lru[victim] = ++mydata->fatcache_tick;
+	}
+
+	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	mydata->fatbufnum = -1;
+	if (disk_read(startblock, getsize, mydata->fatbuf) < 0) {
+		debug("Error reading FAT blocks\n");
+		return -1;
+	}
+	mydata->fatbufnum = bufnum;
+
+	return 0;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -192,29 +333,9 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Bring the block of FAT entries into fatbuf. */
+	if (bufnum != mydata->fatbufnum && fat_cache_load(mydata, bufnum) < 0)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
@@ -301,6 +422,79 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Make fat_extents describe the cluster runs of the file of 'size' bytes
+ * starting at cluster 'first', at least up to byte 'end'. Only the part of
+ * the cluster chain not known already is walked. A broken chain leaves the
+ * runs short of 'end'.
+ * Return 0 on success, -ENOMEM otherwise.
+ */
+static int fat_extents_get(fsdata *mydata, __u32 first, loff_t size,
+			   loff_t end)
+{
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	struct fat_extent *e = NULL;
+	__u32 want, clust;
+
+	if (fat_extents.count < 0 || fat_extents.dev != cur_dev ||
+	    fat_extents.part_start != cur_part_info.start ||
+	    fat_extents.vol_id != cur_vol_id ||
+	    fat_extents.first_clust != first || fat_extents.size != size) {
+		fat_extents.dev = cur_dev;
+		fat_extents.part_start = cur_part_info.start;
+		fat_extents.vol_id = cur_vol_id;
+		fat_extents.first_clust = first;
+		fat_extents.size = size;
+		fat_extents.count = 0;
+		fat_extents.covered = 0;
+		fat_extents.next = first;
+	}
+
+	want = DIV_ROUND_UP_ULL(end, bytesperclust);
+	clust = fat_extents.next;
+	if (fat_extents.count)
+		e = &fat_extents.ext[fat_extents.count - 1];
+
+	while (fat_extents.covered < want) {
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			debug("Invalid FAT entry\n");
+			break;
+		}
+
+		/* start a new run unless this cluster continues the last one */
+		if (!e || clust != e->start + e->count) {
+			if (fat_extents.count == fat_extents.alloc) {
+				int alloc = fat_extents.alloc ?
+					    fat_extents.alloc * 2 : 16;
+
+				e = realloc(fat_extents.ext,
+					    alloc * sizeof(*e));
+				if (!e) {
+					fat_extents_invalidate();
+					return -ENOMEM;
+				}
+				fat_extents.ext = e;
+				fat_extents.alloc = alloc;
+			}
+
+			e = &fat_extents.ext[fat_extents.count++];
+			e->start = clust;
+			e->count = 0;
+		}
+
+		e->count++;
+		fat_extents.covered++;
+		clust = get_fatent(mydata, clust);
+	}
+	fat_extents.next = clust;
+
+	debug("FAT: %d runs for %u clusters\n", fat_extents.count,
+	      fat_extents.covered);
+
+	return 0;
+}
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
  * into 'buffer'.
@@ -311,9 +505,11 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	struct fat_extent *e;
+	loff_t runsize, actsize;
+	u64 clust;
+	u32 off;
+	int i, ret;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -328,101 +524,61 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
+	ret = fat_extents_get(mydata, START(dentptr), FAT2CPU32(dentptr->size),
+			      filesize);
+	if (ret)
+		return ret;
 
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
+	/* pos and filesize are relative to the start of run i */
+	for (i = 0; i < fat_extents.count && pos < filesize; ) {
+		e = &fat_extents.ext[i];
+		runsize = (loff_t)e->count * bytesperclust;
+		if (pos >= runsize) {
+			pos -= runsize;
+			filesize -= runsize;
+			i++;
+			continue;
 		}
-		actsize += bytesperclust;
-	}
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
+		clust = pos;
+		off = do_div(clust, bytesperclust);
+		clust += e->start;
 
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		__u8 *tmp_buffer;
+		/* align to beginning of next cluster if any */
+		if (off) {
+			__u8 *tmp_buffer;
 
-		actsize = min(filesize, (loff_t)bytesperclust);
-		tmp_buffer = malloc_cache_aligned(actsize);
-		if (!tmp_buffer) {
-			debug("Error: allocating buffer\n");
-			return -ENOMEM;
-		}
+			actsize = min(filesize - (pos - off),
+				      (loff_t)bytesperclust);
+			tmp_buffer = malloc_cache_aligned(actsize);
+			if (!tmp_buffer) {
+				debug("Error: allocating buffer\n");
+				return -ENOMEM;
+			}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
-			printf("Error reading cluster\n");
+			if (get_cluster(mydata, clust, tmp_buffer, actsize)) {
+				printf("Error reading cluster\n");
+				free(tmp_buffer);
+				return -1;
+			}
+			actsize -= off;
+			memcpy(buffer, tmp_buffer + off, actsize);
 			free(tmp_buffer);
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
-		free(tmp_buffer);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return 0;
+		} else {
+			/* the rest of the run, in one go */
+			actsize = min(filesize, runsize) - pos;
+			if (get_cluster(mydata, clust, buffer, actsize)) {
+				printf("Error reading cluster\n");
+				return -1;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
 		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
 		buffer += actsize;
+		pos += actsize;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -606,13 +762,8 @@ static int get_fs_info(fsdata *mydata)
 			sect_to_clust(mydata, mydata->rootdir_sect);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
-		debug("Error: allocating memory\n");
+	if (fat_cache_alloc(mydata))
 		return -1;
-	}
 
 	debug("FAT%d, fat_sect: %d, fatlength: %d\n",
 	       mydata->fatsize, mydata->fat_sect, mydata->fatlength);
@@ -1189,6 +1340,56 @@ int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 	return ret;
 }
 
+struct fat_stream {
+	fsdata *mydata;
+	dir_entry *dentptr;
+};
+
+static int fat_stream_read(void *ctx, void *buf, loff_t pos, loff_t len,
+			   loff_t *actread)
+{
+	struct fat_stream *stream = ctx;
+
+	return get_contents(stream->mydata, stream->dentptr, pos, buf, len,
+			    actread) ? -EIO : 0;
+}
+
+int fat_read_stream(const char *filename, loff_t offset, loff_t len,
+		    int (*consume)(void *priv, const void *buf, size_t len),
+		    void *priv, loff_t *actread)
+{
+	struct fat_stream stream;
+	fsdata fsdata;
+	fat_itr *itr;
+	int ret;
+
+	itr = malloc_cache_aligned(sizeof(fat_itr));
+	if (!itr)
+		return -ENOMEM;
+	ret = fat_itr_root(itr, &fsdata);
+	if (ret)
+		goto out_free_itr;
+
+	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	if (ret) {
+		printf("** File not found %s **\n", filename);
+		goto out_free_both;
+	}
+
+	/* The directory entry stays in the iterator until the end */
+	stream.mydata = &fsdata;
+	stream.dentptr = itr->dent;
+	ret = fs_stream_chunks(FAT2CPU32(itr->dent->size), offset, len,
+			       fat_stream_read, &stream, consume, priv,
+			       actread);
+
+out_free_both:
+	free(fsdata.fatbuf);
+out_free_itr:
+	free(itr);
+	return ret;
+}
+
 typedef struct {
 	struct fs_dir_stream parent;
 	struct fs_dirent dirent;
@@ -1256,4 +1457,9 @@ void fat_closedir(struct fs_dir_stream *dirs)
 
 void fat_close(void)
 {
+	/*
+	 * The volume is no longer tracked, e.g. fs_mount_invalidate() after
+	 * a raw write to the device, so the runs may no longer match the FAT.
+	 */
+	fat_extents_invalidate();
 }
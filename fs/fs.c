@@ -6,6 +6,7 @@
 #include <config.h>
 #include <errno.h>
 #include <common.h>
+#include <fs_internal.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
@@ -14,6 +15,7 @@
 #include <sandboxfs.h>
 #include <ubifs_uboot.h>
 #include <btrfs.h>
+#include <squashfs.h>
 #include <asm/io.h>
 #include <div64.h>
 #include <linux/math64.h>
@@ -25,6 +27,17 @@ static int fs_dev_part;
 static disk_partition_t fs_partition;
 static int fs_type = FS_TYPE_ANY;
 
+/*
+ * Filesystem left mounted by the last command, so that the next command on
+ * the same partition does not have to probe and mount it again. Only one is
+ * kept, as the filesystem drivers hold their state in globals.
+ */
+static struct {
+	struct blk_desc *desc;
+	disk_partition_t partition;
+	int fstype;		/* FS_TYPE_ANY if nothing is kept mounted */
+} fs_mount = { .fstype = FS_TYPE_ANY };
+
 static inline int fs_probe_unsupported(struct blk_desc *fs_dev_desc,
 				      disk_partition_t *fs_partition)
 {
@@ -134,9 +147,30 @@ struct fstype_info {
 	int (*size)(const char *filename, loff_t *size);
 	int (*read)(const char *filename, void *buf, loff_t offset,
 		    loff_t len, loff_t *actread);
+	/*
+	 * Pass a file on to @consume chunk by chunk, looking it up only once,
+	 * usually with fs_stream_chunks(). Optional: without it the file is
+	 * streamed through .read(). See fs_read_stream().
+	 */
+	int (*read_stream)(const char *filename, loff_t offset, loff_t len,
+			   int (*consume)(void *priv, const void *buf,
+					  size_t len),
+			   void *priv, loff_t *actread);
 	int (*write)(const char *filename, void *buf, loff_t offset,
 		     loff_t len, loff_t *actwrite);
 	void (*close)(void);
+	/*
+	 * Return true if the filesystem is still mounted from the given
+	 * device and partition, so it can be used again without probing.
+	 * Leave NULL if the filesystem cannot stay mounted between commands.
+	 */
+	bool (*mounted)(struct blk_desc *fs_dev_desc,
+			disk_partition_t *fs_partition);
+	/*
+	 * Free what a command left behind (e.g. an open file) when the
+	 * filesystem stays mounted instead of being closed. Optional.
+	 */
+	void (*release)(void);
 	int (*uuid)(char *uuid_str);
 	/*
 	 * Open a directory stream.  On success return 0 and directory
@@ -164,10 +198,12 @@ static struct fstype_info fstypes[] = {
 		.null_dev_desc_ok = false,
 		.probe = fat_set_blk_dev,
 		.close = fat_close,
+		.mounted = fat_mounted,
 		.ls = fs_ls_generic,
 		.exists = fat_exists,
 		.size = fat_size,
 		.read = fat_read_file,
+		.read_stream = fat_read_stream,
 #if CONFIG_IS_ENABLED(FAT_WRITE)
 		.write = file_fat_write,
 		.unlink = fat_unlink,
@@ -191,10 +227,13 @@ static struct fstype_info fstypes[] = {
 		.null_dev_desc_ok = false,
 		.probe = ext4fs_probe,
 		.close = ext4fs_close,
+		.mounted = ext4fs_mounted,
+		.release = ext4fs_release,
 		.ls = ext4fs_ls,
 		.exists = ext4fs_exists,
 		.size = ext4fs_size,
 		.read = ext4_read_file,
+		.read_stream = ext4_read_stream,
 #ifdef CONFIG_CMD_EXT4_WRITE
 		.write = ext4_write_file,
 #else
@@ -253,12 +292,35 @@ static struct fstype_info fstypes[] = {
 		.exists = btrfs_exists,
 		.size = btrfs_size,
 		.read = btrfs_read,
+		.read_stream = btrfs_read_stream,
 		.write = fs_write_unsupported,
 		.uuid = btrfs_uuid,
 		.opendir = fs_opendir_unsupported,
 		.unlink = fs_unlink_unsupported,
 		.mkdir = fs_mkdir_unsupported,
 	},
+#endif
+#ifdef CONFIG_FS_SQUASHFS
+	{
+		.fstype = FS_TYPE_SQUASHFS,
+		.name = "squashfs",
+		.null_dev_desc_ok = false,
+		.probe = sqfs_probe,
+		.close = sqfs_close,
+		.mounted = sqfs_mounted,
+		.ls = fs_ls_generic,
+		.exists = sqfs_exists,
+		.size = sqfs_size,
+		.read = sqfs_read,
+		.read_stream = sqfs_read_stream,
+		.write = fs_write_unsupported,
+		.uuid = fs_uuid_unsupported,
+		.opendir = sqfs_opendir,
+		.readdir = sqfs_readdir,
+		.closedir = sqfs_closedir,
+		.unlink = fs_unlink_unsupported,
+		.mkdir = fs_mkdir_unsupported,
+	},
 #endif
 	{
 		.fstype = FS_TYPE_ANY,
@@ -305,6 +367,58 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
+/* Unmount the filesystem kept by fs_close(), if any */
+static void fs_mount_drop(void)
+{
+	if (fs_mount.fstype == FS_TYPE_ANY)
+		return;
+
+	fs_get_info(fs_mount.fstype)->close();
+	fs_mount.fstype = FS_TYPE_ANY;
+}
+
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+void fs_mount_invalidate(struct blk_desc *desc)
+{
+	if (!desc || fs_mount.desc == desc)
+		fs_mount_drop();
+}
+#endif
+
+/*
+ * Use the filesystem kept mounted if it is on the partition just selected
+ * and of the requested type. Otherwise unmount it, as the probing about to
+ * happen would clobber its state anyway.
+ * Return true if the kept filesystem is now the current one.
+ */
+static bool fs_mount_reuse(int fstype)
+{
+	struct fstype_info *info;
+
+	if (fs_mount.fstype == FS_TYPE_ANY)
+		return false;
+
+	info = fs_get_info(fs_mount.fstype);
+	if ((fstype != FS_TYPE_ANY && fstype != fs_mount.fstype) ||
+	    fs_mount.desc != fs_dev_desc ||
+	    fs_mount.partition.start != fs_partition.start ||
+	    fs_mount.partition.size != fs_partition.size ||
+	    fs_mount.partition.blksz != fs_partition.blksz ||
+#if CONFIG_IS_ENABLED(PARTITION_UUIDS)
+	    strcmp(fs_mount.partition.uuid, fs_partition.uuid) ||
+#endif
+	    !info->mounted(fs_dev_desc, &fs_partition)) {
+		fs_mount_drop();
+		return false;
+	}
+
+	/* The command owns the mount until fs_close() keeps it again */
+	fs_type = fs_mount.fstype;
+	fs_mount.fstype = FS_TYPE_ANY;
+
+	return true;
+}
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -331,6 +445,11 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
+	if (fs_mount_reuse(fstype)) {
+		fs_dev_part = part;
+		return 0;
+	}
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
 				fstype != info->fstype)
@@ -363,6 +482,11 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
+	if (fs_mount_reuse(FS_TYPE_ANY)) {
+		fs_dev_part = part;
+		return 0;
+	}
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
@@ -378,8 +502,23 @@ static void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
-	info->close();
+	if (CONFIG_IS_ENABLED(FS_MOUNT_CACHE) && info->mounted) {
+		if (info->release)
+			info->release();
+		fs_mount.desc = fs_dev_desc;
+		fs_mount.partition = fs_partition;
+		fs_mount.fstype = fs_type;
+	} else {
+		info->close();
+	}
+
+	fs_type = FS_TYPE_ANY;
+}
 
+/* Close after a command which modified the filesystem */
+static void fs_close_modified(void)
+{
+	fs_get_info(fs_type)->close();
 	fs_type = FS_TYPE_ANY;
 }
 
@@ -398,7 +537,6 @@ int fs_ls(const char *dirname)
 
 	ret = info->ls(dirname);
 
-	fs_type = FS_TYPE_ANY;
 	fs_close();
 
 	return ret;
@@ -502,6 +640,39 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return _fs_read(filename, addr, offset, len, 0, actread);
 }
 
+/* Read a chunk through the read operation, for filesystems without streaming */
+static int fs_stream_read(void *ctx, void *buf, loff_t pos, loff_t len,
+			  loff_t *actread)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+
+	return info->read(ctx, buf, pos, len, actread) ? -EIO : 0;
+}
+
+int fs_read_stream(const char *filename, loff_t offset, loff_t len,
+		   int (*consume)(void *priv, const void *buf, size_t len),
+		   void *priv, loff_t *actread)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	loff_t size;
+	int ret;
+
+	if (info->read_stream) {
+		ret = info->read_stream(filename, offset, len, consume, priv,
+					actread);
+	} else {
+		ret = info->size(filename, &size);
+		if (!ret)
+			ret = fs_stream_chunks(size, offset, len,
+					       fs_stream_read,
+					       (void *)filename, consume, priv,
+					       actread);
+	}
+	fs_close();
+
+	return ret;
+}
+
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
 {
@@ -517,7 +688,7 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 		printf("** Unable to write file %s **\n", filename);
 		ret = -1;
 	}
-	fs_close();
+	fs_close_modified();
 
 	return ret;
 }
@@ -582,8 +753,7 @@ int fs_unlink(const char *filename)
 
 	ret = info->unlink(filename);
 
-	fs_type = FS_TYPE_ANY;
-	fs_close();
+	fs_close_modified();
 
 	return ret;
 }
@@ -596,8 +766,7 @@ int fs_mkdir(const char *dirname)
 
 	ret = info->mkdir(dirname);
 
-	fs_type = FS_TYPE_ANY;
-	fs_close();
+	fs_close_modified();
 
 	return ret;
 }
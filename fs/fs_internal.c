@@ -7,8 +7,10 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <malloc.h>
 #include <part.h>
 #include <memalign.h>
+#include <watchdog.h>
 
 int fs_devread(struct blk_desc *blk, disk_partition_t *partition,
 	       lbaint_t sector, int byte_offset, int byte_len, char *buf)
@@ -90,3 +92,60 @@ int fs_devread(struct blk_desc *blk, disk_partition_t *partition,
 	}
 	return 1;
 }
+
+int fs_stream_chunks(loff_t size, loff_t offset, loff_t len,
+		     int (*read)(void *ctx, void *buf, loff_t pos, loff_t len,
+				 loff_t *actread),
+		     void *ctx,
+		     int (*consume)(void *priv, const void *buf, size_t len),
+		     void *priv, loff_t *actread)
+{
+	loff_t chunk, stride, got;
+	void *bufs, *buf;
+	int nbufs, which = 0;
+	int ret = 0;
+
+	*actread = 0;
+	/* Fail early rather than hand on a partial file */
+	if (offset > size || len > size - offset)
+		return -EINVAL;
+	if (!len)
+		len = size - offset;
+	if (!len)
+		return 0;
+
+	/*
+	 * Chunks go into two buffers in turn, so that the consumer may still
+	 * be working on the last one, e.g. with a DMA, while the next one is
+	 * read. Small files need neither the whole buffer nor a second one.
+	 */
+	chunk = min_t(loff_t, len, CONFIG_FS_STREAM_BUFSIZE);
+	nbufs = len > chunk ? 2 : 1;
+	stride = roundup(chunk, ARCH_DMA_MINALIGN);
+	bufs = malloc_cache_aligned(stride * nbufs);
+	if (!bufs)
+		return -ENOMEM;
+
+	while (*actread < len) {
+		buf = bufs + which * stride;
+		if (nbufs > 1)
+			which = !which;
+
+		chunk = min_t(loff_t, len - *actread, CONFIG_FS_STREAM_BUFSIZE);
+		ret = read(ctx, buf, offset + *actread, chunk, &got);
+		if (!ret && got != chunk)
+			ret = -EIO;
+		if (ret)
+			break;
+
+		ret = consume(priv, buf, chunk);
+		if (ret)
+			break;
+		*actread += chunk;
+
+		WATCHDOG_RESET();
+	}
+	free(bufs);
+
+	return ret;
+}
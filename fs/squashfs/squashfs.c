@@ -0,0 +1,1013 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Read-only SquashFS 4.0 filesystem
+ *
+ * Metadata blocks and fragment blocks are kept decompressed in two small
+ * caches, since listing a directory or reading a run of small files keeps
+ * going back to the same few blocks. File data blocks are decompressed
+ * straight into the caller's buffer whenever they are read whole.
+ */
+
+#include <common.h>
+#include <fs.h>
+#include <fs_internal.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <squashfs.h>
+#include <linux/lzo.h>
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <lzma/LzmaTools.h>
+#include "squashfs_fs.h"
+
+/* Number of decompressed metadata and fragment blocks kept */
+#define SQFS_META_CACHE_ENTRIES		16
+#define SQFS_FRAG_CACHE_ENTRIES		4
+
+/* Most symbolic links followed while resolving a path */
+#define SQFS_MAX_LINKS			8
+#define SQFS_SYMLINK_MAX		4096
+#define SQFS_MAX_DEPTH			64
+
+/* Block sizes read at once from a file's block list */
+#define SQFS_BLIST_BATCH		64
+
+struct sqfs_cache_entry {
+	u64 pos;		/* disk position of the block */
+	u64 next;		/* disk position of the block after it */
+	u32 len;		/* decompressed length */
+	u32 age;
+	u8 *data;
+};
+
+struct sqfs_cache {
+	struct sqfs_cache_entry *entries;
+	unsigned int count;
+	u32 clock;
+};
+
+/* Position in a metadata table */
+struct sqfs_mpos {
+	u64 block;		/* disk position of the metadata block */
+	u32 offset;		/* offset in the decompressed block */
+};
+
+struct sqfs_inode {
+	u16 type;
+	u32 number;
+	u64 size;		/* file size, or directory listing length */
+	/* directories */
+	struct sqfs_mpos listing;
+	/* regular files */
+	u64 start;
+	u32 frag;
+	u32 frag_offset;
+	struct sqfs_mpos blist;
+	/* symbolic links */
+	struct sqfs_mpos target;
+};
+
+struct sqfs_dir_iter {
+	struct sqfs_mpos pos;
+	u32 remaining;		/* bytes of listing left */
+	u32 count;		/* entries left under the current header */
+	u32 start_block;	/* from the current header */
+	u32 inode_number;
+	/* current entry */
+	u64 ref;
+	u16 type;
+	char name[SQFS_NAME_LEN + 1];
+};
+
+struct sqfs_dir_stream {
+	struct fs_dir_stream parent;
+	struct fs_dirent dirent;
+	struct sqfs_dir_iter iter;
+};
+
+static struct {
+	struct blk_desc *desc;
+	disk_partition_t part;
+	u64 bytes_used;
+	u64 root_inode;
+	u64 inode_table;
+	u64 dir_table;
+	u32 block_size;
+	u32 fragments;
+	u16 comp;
+	u64 *frag_index;	/* disk positions of fragment table blocks */
+	struct sqfs_cache meta;
+	struct sqfs_cache frag;
+	u8 *cbuf;		/* compressed block being read */
+	u8 *dbuf;		/* decompressed block being copied from */
+	u64 dbuf_pos;		/* disk position of the block in dbuf, or 0 */
+} sqfs;
+
+static int sqfs_disk_read(u64 pos, u32 len, void *buf)
+{
+	int log2blksz = sqfs.desc->log2blksz;
+
+	if (pos + len > sqfs.bytes_used)
+		return -EINVAL;
+
+	if (!fs_devread(sqfs.desc, &sqfs.part, pos >> log2blksz,
+			pos & (sqfs.desc->blksz - 1), len, buf))
+		return -EIO;
+
+	return 0;
+}
+
+static const char *sqfs_comp_name(u16 comp)
+{
+	switch (comp) {
+	case SQFS_COMP_GZIP:
+		return "gzip";
+	case SQFS_COMP_LZMA:
+		return "lzma";
+	case SQFS_COMP_LZO:
+		return "lzo";
+	case SQFS_COMP_XZ:
+		return "xz";
+	case SQFS_COMP_LZ4:
+		return "lz4";
+	case SQFS_COMP_ZSTD:
+		return "zstd";
+	default:
+		return "unknown";
+	}
+}
+
+static bool sqfs_comp_supported(u16 comp)
+{
+	switch (comp) {
+	case SQFS_COMP_GZIP:
+		return IS_ENABLED(CONFIG_GZIP);
+	case SQFS_COMP_LZMA:
+		return IS_ENABLED(CONFIG_LZMA);
+	case SQFS_COMP_LZO:
+		return IS_ENABLED(CONFIG_LZO);
+	case SQFS_COMP_LZ4:
+		return IS_ENABLED(CONFIG_LZ4);
+	case SQFS_COMP_ZSTD:
+		return IS_ENABLED(CONFIG_ZSTD);
+	default:
+		return false;
+	}
+}
+
+/* Decompress a block, setting *dstn to its decompressed length */
+static int sqfs_decompress(void *dst, u32 *dstn, void *src, u32 srcn)
+{
+	int ret = -EPROTONOSUPPORT;
+
+	switch (sqfs.comp) {
+#ifdef CONFIG_GZIP
+	case SQFS_COMP_GZIP: {
+		unsigned long len = srcn;
+
+		/* A zlib stream: skip its header, the trailer is ignored */
+		if (srcn < 2)
+			return -EINVAL;
+		ret = zunzip(dst, *dstn, src, &len, 1, 2);
+		*dstn = len;
+		break;
+	}
+#endif
+#ifdef CONFIG_LZMA
+	case SQFS_COMP_LZMA: {
+		SizeT len = *dstn;
+
+		ret = lzmaBuffToBuffDecompress(dst, &len, src, srcn);
+		*dstn = len;
+		break;
+	}
+#endif
+#ifdef CONFIG_LZO
+	case SQFS_COMP_LZO: {
+		size_t len = *dstn;
+
+		ret = lzo1x_decompress_safe(src, srcn, dst, &len);
+		*dstn = len;
+		break;
+	}
+#endif
+#ifdef CONFIG_LZ4
+	case SQFS_COMP_LZ4: {
+		size_t len = *dstn;
+
+		ret = ulz4fn_block(src, srcn, dst, &len);
+		*dstn = len;
+		break;
+	}
+#endif
+#ifdef CONFIG_ZSTD
+	case SQFS_COMP_ZSTD: {
+		size_t len = *dstn;
+
+		ret = zstd_decompress(src, srcn, dst, &len);
+		*dstn = len;
+		break;
+	}
+#endif
+	}
+
+	if (ret) {
+		printf("SquashFS: %s decompression failed (%d)\n",
+		       sqfs_comp_name(sqfs.comp), ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/*
+ * Read the block stored at @pos, @size bytes long on disk, into @dst which
+ * has room for @dstn bytes. *len is set to the length of the block.
+ */
+static int sqfs_read_block(u64 pos, u32 size, bool compressed, void *dst,
+			   u32 dstn, u32 *len)
+{
+	int ret;
+
+	if (size > dstn)
+		return -EINVAL;
+
+	if (!compressed) {
+		*len = size;
+		return sqfs_disk_read(pos, size, dst);
+	}
+
+	ret = sqfs_disk_read(pos, size, sqfs.cbuf);
+	if (ret)
+		return ret;
+	*len = dstn;
+
+	return sqfs_decompress(dst, len, sqfs.cbuf, size);
+}
+
+static int sqfs_cache_init(struct sqfs_cache *cache, unsigned int count,
+			   u32 size)
+{
+	unsigned int i;
+
+	cache->entries = calloc(count, sizeof(*cache->entries));
+	if (!cache->entries)
+		return -ENOMEM;
+	cache->count = count;
+	cache->clock = 0;
+
+	for (i = 0; i < count; i++) {
+		cache->entries[i].data = malloc(size);
+		if (!cache->entries[i].data)
+			return -ENOMEM;
+		cache->entries[i].len = 0;
+	}
+
+	return 0;
+}
+
+static void sqfs_cache_free(struct sqfs_cache *cache)
+{
+	unsigned int i;
+
+	if (!cache->entries)
+		return;
+	for (i = 0; i < cache->count; i++)
+		free(cache->entries[i].data);
+	free(cache->entries);
+	cache->entries = NULL;
+}
+
+/*
+ * Look a block up by its disk position. On a miss the least recently used
+ * entry is returned with @len set to zero, for the caller to fill in.
+ */
+static struct sqfs_cache_entry *sqfs_cache_get(struct sqfs_cache *cache,
+					       u64 pos)
+{
+	struct sqfs_cache_entry *e, *victim = cache->entries;
+	unsigned int i;
+
+	for (i = 0, e = cache->entries; i < cache->count; i++, e++) {
+		if (e->len && e->pos == pos) {
+			e->age = ++cache->clock;
+			return e;
+		}
+		if (!e->len || (victim->len && e->age < victim->age))
+			victim = e;
+	}
+
+	victim->pos = pos;
+	victim->len = 0;
+	victim->age = ++cache->clock;
+
+	return victim;
+}
+
+static struct sqfs_cache_entry *sqfs_meta_block(u64 pos)
+{
+	struct sqfs_cache_entry *e;
+	__le16 hdr;
+	u32 size;
+	int ret;
+
+	e = sqfs_cache_get(&sqfs.meta, pos);
+	if (e->len)
+		return e;
+
+	ret = sqfs_disk_read(pos, sizeof(hdr), &hdr);
+	if (ret)
+		return NULL;
+	size = SQFS_META_LEN(le16_to_cpu(hdr));
+	ret = sqfs_read_block(pos + sizeof(hdr), size,
+			      !(le16_to_cpu(hdr) & SQFS_META_UNCOMPRESSED),
+			      e->data, SQFS_METADATA_SIZE, &e->len);
+	if (ret || !e->len) {
+		e->len = 0;
+		return NULL;
+	}
+	e->next = pos + sizeof(hdr) + size;
+
+	return e;
+}
+
+/* Read @len bytes of metadata, which may span several blocks */
+static int sqfs_meta_read(struct sqfs_mpos *mp, void *buf, u32 len)
+{
+	struct sqfs_cache_entry *e;
+	u8 *p = buf;
+	u32 n;
+
+	while (len) {
+		e = sqfs_meta_block(mp->block);
+		if (!e)
+			return -EIO;
+		if (mp->offset >= e->len) {
+			if (mp->offset > e->len)
+				return -EINVAL;
+			mp->block = e->next;
+			mp->offset = 0;
+			continue;
+		}
+
+		n = min(len, e->len - mp->offset);
+		memcpy(p, e->data + mp->offset, n);
+		p += n;
+		len -= n;
+		mp->offset += n;
+	}
+
+	return 0;
+}
+
+static void sqfs_ref_pos(struct sqfs_mpos *mp, u64 table, u64 ref)
+{
+	mp->block = table + SQFS_REF_BLOCK(ref);
+	mp->offset = SQFS_REF_OFFSET(ref);
+}
+
+static int sqfs_read_inode(u64 ref, struct sqfs_inode *ino)
+{
+	struct sqfs_base_inode base;
+	struct sqfs_mpos mp;
+	int ret;
+
+	sqfs_ref_pos(&mp, sqfs.inode_table, ref);
+	ret = sqfs_meta_read(&mp, &base, sizeof(base));
+	if (ret)
+		return ret;
+
+	memset(ino, '\0', sizeof(*ino));
+	ino->type = le16_to_cpu(base.inode_type);
+	ino->number = le32_to_cpu(base.inode_number);
+	ino->frag = SQFS_INVALID_FRAG;
+
+	switch (ino->type) {
+	case SQFS_DIR_TYPE: {
+		struct sqfs_dir_inode dir;
+
+		ret = sqfs_meta_read(&mp, &dir, sizeof(dir));
+		if (ret)
+			return ret;
+		/* The size counts the "." and ".." entries, which are implied */
+		ino->size = max_t(u32, le16_to_cpu(dir.file_size), 3) - 3;
+		ino->listing.block = sqfs.dir_table +
+				     le32_to_cpu(dir.start_block);
+		ino->listing.offset = le16_to_cpu(dir.offset);
+		break;
+	}
+	case SQFS_LDIR_TYPE: {
+		struct sqfs_ldir_inode dir;
+
+		ret = sqfs_meta_read(&mp, &dir, sizeof(dir));
+		if (ret)
+			return ret;
+		ino->size = max(le32_to_cpu(dir.file_size), 3U) - 3;
+		ino->listing.block = sqfs.dir_table +
+				     le32_to_cpu(dir.start_block);
+		ino->listing.offset = le16_to_cpu(dir.offset);
+		break;
+	}
+	case SQFS_REG_TYPE: {
+		struct sqfs_reg_inode reg;
+
+		ret = sqfs_meta_read(&mp, &reg, sizeof(reg));
+		if (ret)
+			return ret;
+		ino->start = le32_to_cpu(reg.start_block);
+		ino->size = le32_to_cpu(reg.file_size);
+		ino->frag = le32_to_cpu(reg.fragment);
+		ino->frag_offset = le32_to_cpu(reg.offset);
+		ino->blist = mp;
+		break;
+	}
+	case SQFS_LREG_TYPE: {
+		struct sqfs_lreg_inode reg;
+
+		ret = sqfs_meta_read(&mp, &reg, sizeof(reg));
+		if (ret)
+			return ret;
+		ino->start = le64_to_cpu(reg.start_block);
+		ino->size = le64_to_cpu(reg.file_size);
+		ino->frag = le32_to_cpu(reg.fragment);
+		ino->frag_offset = le32_to_cpu(reg.offset);
+		ino->blist = mp;
+		break;
+	}
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE: {
+		struct sqfs_symlink_inode link;
+
+		ret = sqfs_meta_read(&mp, &link, sizeof(link));
+		if (ret)
+			return ret;
+		ino->size = le32_to_cpu(link.symlink_size);
+		if (ino->size > SQFS_SYMLINK_MAX)
+			return -EINVAL;
+		ino->target = mp;
+		break;
+	}
+	default:
+		/* Devices, FIFOs and sockets have nothing to read */
+		break;
+	}
+
+	return 0;
+}
+
+static bool sqfs_is_dir(const struct sqfs_inode *ino)
+{
+	return ino->type == SQFS_DIR_TYPE || ino->type == SQFS_LDIR_TYPE;
+}
+
+static bool sqfs_is_reg(const struct sqfs_inode *ino)
+{
+	return ino->type == SQFS_REG_TYPE || ino->type == SQFS_LREG_TYPE;
+}
+
+static bool sqfs_is_symlink(const struct sqfs_inode *ino)
+{
+	return ino->type == SQFS_SYMLINK_TYPE ||
+	       ino->type == SQFS_LSYMLINK_TYPE;
+}
+
+static void sqfs_dir_open(struct sqfs_dir_iter *it,
+			  const struct sqfs_inode *dir)
+{
+	memset(it, '\0', sizeof(*it));
+	it->pos = dir->listing;
+	it->remaining = dir->size;
+}
+
+/* Move to the next entry. Returns 1 if there is one, 0 at the end */
+static int sqfs_dir_next(struct sqfs_dir_iter *it)
+{
+	struct sqfs_dir_header hdr;
+	struct sqfs_dir_entry ent;
+	u32 len;
+	int ret;
+
+	if (!it->count) {
+		if (it->remaining < sizeof(hdr) + sizeof(ent))
+			return 0;
+		ret = sqfs_meta_read(&it->pos, &hdr, sizeof(hdr));
+		if (ret)
+			return ret;
+		it->remaining -= sizeof(hdr);
+		it->count = le32_to_cpu(hdr.count) + 1;
+		if (it->count > SQFS_DIR_COUNT)
+			return -EINVAL;
+		it->start_block = le32_to_cpu(hdr.start_block);
+		it->inode_number = le32_to_cpu(hdr.inode_number);
+	}
+
+	if (it->remaining < sizeof(ent))
+		return -EINVAL;
+	ret = sqfs_meta_read(&it->pos, &ent, sizeof(ent));
+	if (ret)
+		return ret;
+	len = le16_to_cpu(ent.size) + 1;
+	if (len > SQFS_NAME_LEN || it->remaining < sizeof(ent) + len)
+		return -EINVAL;
+	ret = sqfs_meta_read(&it->pos, it->name, len);
+	if (ret)
+		return ret;
+	it->name[len] = '\0';
+	it->remaining -= sizeof(ent) + len;
+	it->count--;
+
+	it->ref = ((u64)it->start_block << 16) | le16_to_cpu(ent.offset);
+	it->type = le16_to_cpu(ent.type);
+
+	return 1;
+}
+
+static int sqfs_dir_lookup(const struct sqfs_inode *dir, const char *name,
+			   size_t len, u64 *ref)
+{
+	struct sqfs_dir_iter it;
+	int ret;
+
+	sqfs_dir_open(&it, dir);
+	while ((ret = sqfs_dir_next(&it)) > 0) {
+		if (strlen(it.name) == len && !memcmp(it.name, name, len)) {
+			*ref = it.ref;
+			return 0;
+		}
+	}
+
+	return ret ? ret : -ENOENT;
+}
+
+/*
+ * Find the inode at @path, following symbolic links. ".." is resolved by
+ * keeping the inodes of the directories walked through, as a directory
+ * inode only gives the number of its parent, not where it is stored.
+ */
+static int sqfs_resolve(const char *path, struct sqfs_inode *ino)
+{
+	u64 *refs, ref;
+	char *buf, *p, *next;
+	int depth = 0, links = 0, ret;
+	size_t len;
+
+	refs = malloc(SQFS_MAX_DEPTH * sizeof(*refs));
+	buf = strdup(path);
+	if (!refs || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	refs[0] = sqfs.root_inode;
+	p = buf;
+
+	for (;;) {
+		while (*p == '/')
+			p++;
+		if (!*p)
+			break;
+		len = strcspn(p, "/");
+		next = p + len;
+
+		if (len == 1 && *p == '.') {
+			p = next;
+			continue;
+		}
+		if (len == 2 && p[0] == '.' && p[1] == '.') {
+			if (depth)
+				depth--;
+			p = next;
+			continue;
+		}
+
+		ret = sqfs_read_inode(refs[depth], ino);
+		if (ret)
+			goto out;
+		if (!sqfs_is_dir(ino)) {
+			ret = -ENOTDIR;
+			goto out;
+		}
+		ret = sqfs_dir_lookup(ino, p, len, &ref);
+		if (ret)
+			goto out;
+		ret = sqfs_read_inode(ref, ino);
+		if (ret)
+			goto out;
+
+		if (sqfs_is_symlink(ino)) {
+			char *target;
+
+			if (++links > SQFS_MAX_LINKS) {
+				ret = -ELOOP;
+				goto out;
+			}
+
+			/* Carry on with the target followed by the rest */
+			len = strlen(next);
+			target = malloc(ino->size + len + 1);
+			if (!target) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			ret = sqfs_meta_read(&ino->target, target, ino->size);
+			if (ret) {
+				free(target);
+				goto out;
+			}
+			memcpy(target + ino->size, next, len + 1);
+			free(buf);
+			buf = target;
+			p = buf;
+			if (*p == '/')
+				depth = 0;
+			continue;
+		}
+
+		if (++depth == SQFS_MAX_DEPTH) {
+			ret = -ENAMETOOLONG;
+			goto out;
+		}
+		refs[depth] = ref;
+		p = next;
+	}
+
+	ret = sqfs_read_inode(refs[depth], ino);
+out:
+	free(buf);
+	free(refs);
+
+	return ret;
+}
+
+static int sqfs_frag_block(u32 frag, struct sqfs_cache_entry **ep)
+{
+	struct sqfs_fragment_entry entry;
+	struct sqfs_cache_entry *e;
+	struct sqfs_mpos mp;
+	u32 size;
+	u64 pos;
+	int ret;
+
+	if (frag >= sqfs.fragments)
+		return -EINVAL;
+
+	mp.block = sqfs.frag_index[frag / SQFS_FRAG_ENTRIES_PER_BLOCK];
+	mp.offset = frag % SQFS_FRAG_ENTRIES_PER_BLOCK * sizeof(entry);
+	ret = sqfs_meta_read(&mp, &entry, sizeof(entry));
+	if (ret)
+		return ret;
+	pos = le64_to_cpu(entry.start_block);
+	size = le32_to_cpu(entry.size);
+
+	e = sqfs_cache_get(&sqfs.frag, pos);
+	if (!e->len) {
+		ret = sqfs_read_block(pos, SQFS_BLOCK_LEN(size),
+				      !(size & SQFS_BLOCK_UNCOMPRESSED),
+				      e->data, sqfs.block_size, &e->len);
+		if (ret) {
+			e->len = 0;
+			return ret;
+		}
+	}
+	*ep = e;
+
+	return 0;
+}
+
+/* Copy @len bytes from offset @off of the block stored at @pos */
+static int sqfs_read_data(u64 pos, u32 size, u32 blen, u32 off, u32 len,
+			  u8 *dst)
+{
+	u32 n;
+	int ret;
+
+	/* Sparse blocks are not stored */
+	if (!size) {
+		memset(dst, '\0', len);
+		return 0;
+	}
+
+	if (size & SQFS_BLOCK_UNCOMPRESSED) {
+		if (off + len > SQFS_BLOCK_LEN(size))
+			return -EINVAL;
+		return sqfs_disk_read(pos + off, len, dst);
+	}
+
+	/* Whole blocks are decompressed in place */
+	if (!off && len == blen) {
+		ret = sqfs_read_block(pos, size, true, dst, len, &n);
+		return ret ? ret : n == len ? 0 : -EINVAL;
+	}
+
+	/* Streamed reads may split a block, so keep the last one around */
+	if (sqfs.dbuf_pos != pos) {
+		sqfs.dbuf_pos = 0;
+		ret = sqfs_read_block(pos, size, true, sqfs.dbuf,
+				      sqfs.block_size, &n);
+		if (ret)
+			return ret;
+		if (n != blen)
+			return -EINVAL;
+		sqfs.dbuf_pos = pos;
+	}
+	memcpy(dst, sqfs.dbuf + off, len);
+
+	return 0;
+}
+
+static int sqfs_read_file(struct sqfs_inode *ino, u8 *buf, u64 offset,
+			  u64 len)
+{
+	u32 bs = sqfs.block_size, nblocks, first, last, i, n, off, blen;
+	struct sqfs_cache_entry *e;
+	__le32 sizes[SQFS_BLIST_BATCH];
+	u64 pos = ino->start;
+	u32 size;
+	int ret;
+
+	if (!len)
+		return 0;
+
+	nblocks = ino->frag == SQFS_INVALID_FRAG ? DIV_ROUND_UP(ino->size, bs) :
+		  ino->size / bs;
+	first = offset / bs;
+	last = (offset + len - 1) / bs;
+
+	for (i = 0; i < nblocks && i <= last; i++) {
+		if (!(i % SQFS_BLIST_BATCH)) {
+			n = min(nblocks - i, (u32)SQFS_BLIST_BATCH);
+			ret = sqfs_meta_read(&ino->blist, sizes,
+					     n * sizeof(*sizes));
+			if (ret)
+				return ret;
+		}
+		size = le32_to_cpu(sizes[i % SQFS_BLIST_BATCH]);
+		if (SQFS_BLOCK_LEN(size) > bs)
+			return -EINVAL;
+
+		if (i >= first) {
+			blen = min_t(u64, bs, ino->size - (u64)i * bs);
+			off = i == first ? offset % bs : 0;
+			n = min_t(u64, blen - off, len);
+			ret = sqfs_read_data(pos, size, blen, off, n, buf);
+			if (ret)
+				return ret;
+			buf += n;
+			len -= n;
+		}
+		pos += SQFS_BLOCK_LEN(size);
+	}
+
+	/* The tail of the file is packed in a fragment block */
+	if (len) {
+		if (ino->frag == SQFS_INVALID_FRAG)
+			return -EINVAL;
+		ret = sqfs_frag_block(ino->frag, &e);
+		if (ret)
+			return ret;
+		off = ino->frag_offset;
+		if (first >= nblocks)
+			off += offset - (u64)nblocks * bs;
+		if (off + len > e->len)
+			return -EINVAL;
+		memcpy(buf, e->data + off, len);
+	}
+
+	return 0;
+}
+
+int sqfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition)
+{
+	struct sqfs_super_block sb;
+	u32 block_log, nindex;
+	int ret;
+
+	sqfs_close();
+	sqfs.desc = fs_dev_desc;
+	sqfs.part = *fs_partition;
+	sqfs.bytes_used = sizeof(sb);
+
+	if (sqfs_disk_read(0, sizeof(sb), &sb) ||
+	    le32_to_cpu(sb.s_magic) != SQFS_MAGIC)
+		goto err;
+
+	if (le16_to_cpu(sb.s_major) != SQFS_MAJOR ||
+	    le16_to_cpu(sb.s_minor) != SQFS_MINOR) {
+		printf("SquashFS: unsupported version %u.%u\n",
+		       le16_to_cpu(sb.s_major), le16_to_cpu(sb.s_minor));
+		goto err;
+	}
+
+	block_log = le16_to_cpu(sb.block_log);
+	sqfs.block_size = le32_to_cpu(sb.block_size);
+	if (block_log < SQFS_BLOCK_LOG_MIN || block_log > SQFS_BLOCK_LOG_MAX ||
+	    sqfs.block_size != 1 << block_log)
+		goto err;
+
+	sqfs.comp = le16_to_cpu(sb.compression);
+	if (!sqfs_comp_supported(sqfs.comp)) {
+		printf("SquashFS: %s compression is not supported\n",
+		       sqfs_comp_name(sqfs.comp));
+		goto err;
+	}
+
+	sqfs.bytes_used = le64_to_cpu(sb.bytes_used);
+	sqfs.root_inode = le64_to_cpu(sb.root_inode);
+	sqfs.inode_table = le64_to_cpu(sb.inode_table_start);
+	sqfs.dir_table = le64_to_cpu(sb.directory_table_start);
+	sqfs.fragments = le32_to_cpu(sb.fragments);
+
+	/* Compressed metadata blocks may be larger than a 4KiB data block */
+	sqfs.cbuf = malloc_cache_aligned(max_t(u32, sqfs.block_size,
+					       SQFS_METADATA_SIZE));
+	sqfs.dbuf = malloc(sqfs.block_size);
+	if (!sqfs.cbuf || !sqfs.dbuf)
+		goto err;
+	ret = sqfs_cache_init(&sqfs.meta, SQFS_META_CACHE_ENTRIES,
+			      SQFS_METADATA_SIZE);
+	if (!ret)
+		ret = sqfs_cache_init(&sqfs.frag, SQFS_FRAG_CACHE_ENTRIES,
+				      sqfs.block_size);
+	if (ret)
+		goto err;
+
+	if (sqfs.fragments) {
+		nindex = DIV_ROUND_UP(sqfs.fragments,
+				      SQFS_FRAG_ENTRIES_PER_BLOCK);
+		sqfs.frag_index = malloc(nindex * sizeof(u64));
+		if (!sqfs.frag_index ||
+		    sqfs_disk_read(le64_to_cpu(sb.fragment_table_start),
+				   nindex * sizeof(u64), sqfs.frag_index))
+			goto err;
+		while (nindex--)
+			sqfs.frag_index[nindex] =
+				le64_to_cpu(sqfs.frag_index[nindex]);
+	}
+
+	return 0;
+
+err:
+	sqfs_close();
+	return -1;
+}
+
+bool sqfs_mounted(struct blk_desc *fs_dev_desc,
+		  disk_partition_t *fs_partition)
+{
+	return sqfs.desc && sqfs.desc == fs_dev_desc &&
+	       sqfs.part.start == fs_partition->start &&
+	       sqfs.part.size == fs_partition->size;
+}
+
+void sqfs_close(void)
+{
+	sqfs_cache_free(&sqfs.meta);
+	sqfs_cache_free(&sqfs.frag);
+	free(sqfs.frag_index);
+	free(sqfs.cbuf);
+	free(sqfs.dbuf);
+	memset(&sqfs, '\0', sizeof(sqfs));
+}
+
+int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
+{
+	struct sqfs_dir_stream *dirs;
+	struct sqfs_inode ino;
+	int ret;
+
+	ret = sqfs_resolve(filename, &ino);
+	if (ret)
+		return ret;
+	if (!sqfs_is_dir(&ino))
+		return -ENOTDIR;
+
+	dirs = calloc(1, sizeof(*dirs));
+	if (!dirs)
+		return -ENOMEM;
+	sqfs_dir_open(&dirs->iter, &ino);
+	*dirsp = &dirs->parent;
+
+	return 0;
+}
+
+int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
+{
+	struct sqfs_dir_stream *dirs;
+	struct fs_dirent *dent;
+	struct sqfs_inode ino;
+	int ret;
+
+	dirs = container_of(fs_dirs, struct sqfs_dir_stream, parent);
+	dent = &dirs->dirent;
+
+	ret = sqfs_dir_next(&dirs->iter);
+	if (ret <= 0)
+		return ret ? ret : -ENOENT;
+	ret = sqfs_read_inode(dirs->iter.ref, &ino);
+	if (ret)
+		return ret;
+
+	memset(dent, '\0', sizeof(*dent));
+	strcpy(dent->name, dirs->iter.name);
+	if (sqfs_is_dir(&ino)) {
+		dent->type = FS_DT_DIR;
+	} else if (sqfs_is_symlink(&ino)) {
+		dent->type = FS_DT_LNK;
+		dent->size = ino.size;
+	} else {
+		dent->type = FS_DT_REG;
+		dent->size = ino.size;
+	}
+	*dentp = dent;
+
+	return 0;
+}
+
+void sqfs_closedir(struct fs_dir_stream *fs_dirs)
+{
+	free(container_of(fs_dirs, struct sqfs_dir_stream, parent));
+}
+
+int sqfs_exists(const char *filename)
+{
+	struct sqfs_inode ino;
+
+	return !sqfs_resolve(filename, &ino);
+}
+
+int sqfs_size(const char *filename, loff_t *size)
+{
+	struct sqfs_inode ino;
+
+	if (sqfs_resolve(filename, &ino))
+		return -1;
+	*size = ino.size;
+
+	return 0;
+}
+
+int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	      loff_t *actread)
+{
+	struct sqfs_inode ino;
+	int ret;
+
+	ret = sqfs_resolve(filename, &ino);
+	if (ret) {
+		printf("** File not found %s **\n", filename);
+		return -1;
+	}
+	if (!sqfs_is_reg(&ino)) {
+		printf("** %s is not a regular file **\n", filename);
+		return -1;
+	}
+
+	if (offset > ino.size) {
+		printf("** Offset beyond the end of %s **\n", filename);
+		return -1;
+	}
+	if (!len || len > ino.size - offset)
+		len = ino.size - offset;
+
+	ret = sqfs_read_file(&ino, buf, offset, len);
+	if (ret) {
+		printf("** Error %d reading %s **\n", ret, filename);
+		return -1;
+	}
+	*actread = len;
+
+	return 0;
+}
+
+static int sqfs_stream_read(void *ctx, void *buf, loff_t pos, loff_t len,
+			    loff_t *actread)
+{
+	/* sqfs_read_file() walks the block list, so start from a fresh copy */
+	struct sqfs_inode ino = *(struct sqfs_inode *)ctx;
+	int ret;
+
+	ret = sqfs_read_file(&ino, buf, pos, len);
+	if (ret)
+		return ret;
+	*actread = len;
+
+	return 0;
+}
+
+int sqfs_read_stream(const char *filename, loff_t offset, loff_t len,
+		     int (*consume)(void *priv, const void *buf, size_t len),
+		     void *priv, loff_t *actread)
+{
+	struct sqfs_inode ino;
+
+	if (sqfs_resolve(filename, &ino)) {
+		printf("** File not found %s **\n", filename);
+		return -ENOENT;
+	}
+	if (!sqfs_is_reg(&ino)) {
+		printf("** %s is not a regular file **\n", filename);
+		return -EISDIR;
+	}
+
+	return fs_stream_chunks(ino.size, offset, len, sqfs_stream_read, &ino,
+				consume, priv, actread);
+}
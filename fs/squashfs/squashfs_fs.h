@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * SquashFS 4.0 on-disk format
+ *
+ * All values are little endian. Metadata (inodes, directories and the
+ * fragment table) is stored in blocks of up to 8KiB, each preceded by a
+ * 16-bit length. Inodes and directory listings are addressed by the
+ * position of their metadata block relative to the start of the table,
+ * and their offset within the uncompressed block.
+ */
+
+#ifndef __SQUASHFS_FS_H__
+#define __SQUASHFS_FS_H__
+
+#include <linux/types.h>
+
+#define SQFS_MAGIC			0x73717368
+#define SQFS_MAJOR			4
+#define SQFS_MINOR			0
+
+#define SQFS_METADATA_SIZE		8192
+#define SQFS_META_UNCOMPRESSED		BIT(15)
+#define SQFS_META_LEN(hdr)		((hdr) & ~SQFS_META_UNCOMPRESSED)
+
+#define SQFS_BLOCK_UNCOMPRESSED		BIT(24)
+#define SQFS_BLOCK_LEN(size)		((size) & ~SQFS_BLOCK_UNCOMPRESSED)
+
+#define SQFS_BLOCK_LOG_MIN		12
+#define SQFS_BLOCK_LOG_MAX		20
+
+#define SQFS_INVALID_FRAG		0xffffffff
+#define SQFS_FRAG_ENTRIES_PER_BLOCK	\
+	(SQFS_METADATA_SIZE / sizeof(struct sqfs_fragment_entry))
+
+#define SQFS_NAME_LEN			256
+#define SQFS_DIR_COUNT			256
+
+/* Inode and table references: metadata block position and offset */
+#define SQFS_REF_BLOCK(ref)		((ref) >> 16)
+#define SQFS_REF_OFFSET(ref)		((ref) & 0xffff)
+
+/* Superblock flags */
+#define SQFS_FLAG_COMPRESSOR_OPTIONS	BIT(10)
+
+enum sqfs_compression {
+	SQFS_COMP_GZIP = 1,
+	SQFS_COMP_LZMA = 2,
+	SQFS_COMP_LZO = 3,
+	SQFS_COMP_XZ = 4,
+	SQFS_COMP_LZ4 = 5,
+	SQFS_COMP_ZSTD = 6,
+};
+
+enum sqfs_inode_type {
+	SQFS_DIR_TYPE = 1,
+	SQFS_REG_TYPE,
+	SQFS_SYMLINK_TYPE,
+	SQFS_BLKDEV_TYPE,
+	SQFS_CHRDEV_TYPE,
+	SQFS_FIFO_TYPE,
+	SQFS_SOCKET_TYPE,
+	SQFS_LDIR_TYPE,
+	SQFS_LREG_TYPE,
+	SQFS_LSYMLINK_TYPE,
+	SQFS_LBLKDEV_TYPE,
+	SQFS_LCHRDEV_TYPE,
+	SQFS_LFIFO_TYPE,
+	SQFS_LSOCKET_TYPE,
+};
+
+struct sqfs_super_block {
+	__le32 s_magic;
+	__le32 inodes;
+	__le32 mkfs_time;
+	__le32 block_size;
+	__le32 fragments;
+	__le16 compression;
+	__le16 block_log;
+	__le16 flags;
+	__le16 no_ids;
+	__le16 s_major;
+	__le16 s_minor;
+	__le64 root_inode;
+	__le64 bytes_used;
+	__le64 id_table_start;
+	__le64 xattr_id_table_start;
+	__le64 inode_table_start;
+	__le64 directory_table_start;
+	__le64 fragment_table_start;
+	__le64 lookup_table_start;
+} __packed;
+
+struct sqfs_base_inode {
+	__le16 inode_type;
+	__le16 mode;
+	__le16 uid;
+	__le16 guid;
+	__le32 mtime;
+	__le32 inode_number;
+} __packed;
+
+struct sqfs_dir_inode {
+	__le32 start_block;
+	__le32 nlink;
+	__le16 file_size;
+	__le16 offset;
+	__le32 parent_inode;
+} __packed;
+
+struct sqfs_ldir_inode {
+	__le32 nlink;
+	__le32 file_size;
+	__le32 start_block;
+	__le32 parent_inode;
+	__le16 i_count;
+	__le16 offset;
+	__le32 xattr;
+	/* + i_count directory index entries */
+} __packed;
+
+struct sqfs_reg_inode {
+	__le32 start_block;
+	__le32 fragment;
+	__le32 offset;
+	__le32 file_size;
+	/* + block list */
+} __packed;
+
+struct sqfs_lreg_inode {
+	__le64 start_block;
+	__le64 file_size;
+	__le64 sparse;
+	__le32 nlink;
+	__le32 fragment;
+	__le32 offset;
+	__le32 xattr;
+	/* + block list */
+} __packed;
+
+struct sqfs_symlink_inode {
+	__le32 nlink;
+	__le32 symlink_size;
+	/* + target, not NUL terminated */
+} __packed;
+
+/* Directory listings: a header for each run of entries in one block */
+struct sqfs_dir_header {
+	__le32 count;		/* entries following, minus one */
+	__le32 start_block;	/* inode block of the entries */
+	__le32 inode_number;	/* base for the inode number deltas */
+} __packed;
+
+struct sqfs_dir_entry {
+	__le16 offset;
+	__le16 inode_number;	/* signed delta */
+	__le16 type;
+	__le16 size;		/* name length, minus one */
+	/* + name, not NUL terminated */
+} __packed;
+
+struct sqfs_fragment_entry {
+	__le64 start_block;
+	__le32 size;
+	__le32 unused;
+} __packed;
+
+#endif /* __SQUASHFS_FS_H__ */
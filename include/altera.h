@@ -87,6 +87,10 @@ typedef struct {
 extern int altera_load(Altera_desc *desc, const void *image, size_t size);
 extern int altera_dump(Altera_desc *desc, const void *buf, size_t bsize);
 extern int altera_info(Altera_desc *desc);
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+int altera_loadfs(Altera_desc *desc, const void *buf, size_t bsize,
+		  fpga_fs_info *fpga_fsinfo);
+#endif
 
 /* Board specific implementation specific function types
  *********************************************************************/
@@ -114,6 +118,10 @@ typedef struct {
 
 #ifdef CONFIG_FPGA_SOCFPGA
 int socfpga_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size);
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+int socfpga_loadfs(Altera_desc *desc, const void *buf, size_t bsize,
+		   fpga_fs_info *fpga_fsinfo);
+#endif
 #endif
 
 #ifdef CONFIG_FPGA_STRATIX_V
@@ -123,6 +131,13 @@ int stratixv_load(Altera_desc *desc, const void *rbf_data, size_t rbf_size);
 #ifdef CONFIG_FPGA_INTEL_SDM_MAILBOX
 int intel_sdm_mb_load(Altera_desc *desc, const void *rbf_data,
 		      size_t rbf_size);
+int intel_sdm_mb_load_stream(Altera_desc *desc,
+			     int (*produce)(void *priv, void *buf, size_t size),
+			     void *priv, size_t buf_size);
+#if defined(CONFIG_CMD_FPGA_LOADFS)
+int intel_sdm_mb_loadfs(Altera_desc *desc, const void *buf, size_t bsize,
+			fpga_fs_info *fpga_fsinfo);
+#endif
 #endif
 
 #endif /* _ALTERA_H_ */
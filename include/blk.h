@@ -8,6 +8,7 @@
 #define BLK_H
 
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -112,6 +113,14 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/*
+ * blkcache_read_func - device read used by blkcache_dread(), with the same
+ * arguments and return value as blk_dread()
+ */
+typedef unsigned long (*blkcache_read_func)(struct blk_desc *block_dev,
+					    lbaint_t start, lbaint_t blkcnt,
+					    void *buffer);
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 /**
  * blkcache_read() - attempt to read a set of blocks from cache
@@ -133,6 +142,8 @@ int blkcache_read(int iftype, int dev,
  * blkcache_fill() - make data read from a block device available
  * to the block cache
  *
+ * Only the whole cache lines contained in the buffer are kept.
+ *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
  * @param start - starting block number
@@ -145,6 +156,40 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_dread() - read blocks through the block cache
+ *
+ * Small reads are served from the cache when possible. On a miss, whole
+ * cache lines are read from the device with @read and kept, together
+ * with the lines that follow them when the device is read sequentially.
+ * Large reads go straight to the device.
+ *
+ * @param block_dev - block device descriptor
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to read
+ * @param buffer - buffer to contain the data
+ * @param read - function reading from the device
+ *
+ * @return - number of blocks read, as returned by @read
+ */
+unsigned long blkcache_dread(struct blk_desc *block_dev, lbaint_t start,
+			     lbaint_t blkcnt, void *buffer,
+			     blkcache_read_func read);
+
+/**
+ * blkcache_write() - update the cache with blocks written to a device
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks written
+ * @param blksz - size in bytes of each block
+ * @param buf - buffer containing the data written
+ */
+void blkcache_write(int iftype, int dev,
+		    lbaint_t start, lbaint_t blkcnt,
+		    unsigned long blksz, void const *buffer);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
  * because of a write or device (re)initialization.
@@ -159,8 +204,11 @@ void blkcache_invalidate(int iftype, int dev);
  *
  * @param blocks - maximum blocks per entry
  * @param entries - maximum entries in cache
+ * @param ways - number of entries in each set
+ * @param read_ahead - blocks read ahead on sequential access
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned blocks, unsigned entries, unsigned ways,
+			unsigned read_ahead);
 
 /*
  * statistics of the block cache
@@ -171,6 +219,20 @@ struct block_cache_stats {
 	unsigned entries; /* current entry count */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	unsigned ways;
+	unsigned read_ahead;
+};
+
+/*
+ * statistics of the block cache for one device
+ */
+struct block_cache_dev_stats {
+	int iftype;
+	int devnum;
+	unsigned hits;
+	unsigned misses;
+	unsigned read_ahead_blocks; /* blocks read ahead */
+	unsigned read_ahead_hits; /* hits on blocks read ahead */
 };
 
 /**
@@ -180,6 +242,16 @@ struct block_cache_stats {
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics of a device and reset them
+ *
+ * @param index - index of the device, in the order they were first read
+ * @param stats - statistics are copied here
+ *
+ * @return - 0 if OK, -ENOENT if there is no device at @index
+ */
+int blkcache_dev_stats(int index, struct block_cache_dev_stats *stats);
+
 #else
 
 static inline int blkcache_read(int iftype, int dev,
@@ -193,6 +265,18 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline unsigned long blkcache_dread(struct blk_desc *block_dev,
+					   lbaint_t start, lbaint_t blkcnt,
+					   void *buffer,
+					   blkcache_read_func read)
+{
+	return read(block_dev, start, blkcnt, buffer);
+}
+
+static inline void blkcache_write(int iftype, int dev,
+				  lbaint_t start, lbaint_t blkcnt,
+				  unsigned long blksz, void const *buffer) {}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
@@ -200,6 +284,52 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+/**
+ * enum blk_req_op - operation of an asynchronous block request
+ *
+ * @BLK_REQ_READ:	Read from the device into the buffer
+ * @BLK_REQ_WRITE:	Write the buffer to the device
+ */
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+/**
+ * struct blk_req - an asynchronous block request
+ *
+ * The caller fills in the first fields and passes the request to
+ * blk_submit(). The request and its buffer must stay valid until it has
+ * completed, that is until blk_wait() returns for it or its @complete
+ * function has been called.
+ *
+ * @op:		Operation to perform
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Buffer to read into, or to write from
+ * @complete:	Called by blk_poll() once the request has completed, or
+ *		NULL. It may submit further requests but must not poll.
+ * @priv:	Private data for the caller
+ * @result:	Number of blocks transferred, or -ve error number, set by the
+ *		driver before @done
+ * @done:	Set by the driver once the transfer has finished
+ * @queue:	For use by the driver while the request is in flight
+ * @node:	Entry in the list of requests of the device, for the uclass
+ */
+struct blk_req {
+	enum blk_req_op op;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	void (*complete)(struct blk_req *req);
+	void *priv;
+
+	long result;
+	bool done;
+	struct list_head queue;
+	struct list_head node;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -258,6 +388,49 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start an asynchronous request
+	 *
+	 * The driver starts the transfer, or queues it behind the ones in
+	 * flight, and returns without waiting for it. Once the transfer has
+	 * finished it sets @req->result and then @req->done, either here or
+	 * from poll(). Drivers implementing submit() must implement poll()
+	 * unless they always complete the request before returning.
+	 *
+	 * Devices without this operation get synchronous transfers through
+	 * read() and write() instead.
+	 *
+	 * @dev:	Device to use
+	 * @req:	Request to start, see struct blk_req
+	 * @return 0 if OK, -ve on error, in which case the request was not
+	 * started
+	 */
+	int (*submit)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * poll() - make progress on the requests submitted to a device
+	 *
+	 * This must not wait for a transfer to finish: it marks the requests
+	 * which have finished as done and starts the queued ones.
+	 *
+	 * @dev:	Device to poll
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
+
+	/**
+	 * cancel() - give up on a request in flight
+	 *
+	 * Called when the device is removed while @req has not completed,
+	 * usually because it timed out. The driver forgets the request,
+	 * stopping the transfer if it can, and must not set @req->done
+	 * afterwards. Optional.
+	 *
+	 * @dev:	Device to use
+	 * @req:	Request previously passed to submit()
+	 */
+	void (*cancel)(struct udevice *dev, struct blk_req *req);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -275,6 +448,43 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_submit() - start an asynchronous block request
+ *
+ * Reads submitted this way bypass the block cache and are meant for bulk
+ * data. A later blk_dread() waits for the writes still in flight on the
+ * device, and blk_dwrite() and blk_derase() wait for all requests.
+ *
+ * @block_dev:	Block device descriptor
+ * @req:	Request to start, with @op, @start, @blkcnt, @buffer and
+ *		optionally @complete and @priv filled in
+ * @return 0 if OK, -ve on error, in which case the request was not started
+ */
+int blk_submit(struct blk_desc *block_dev, struct blk_req *req);
+
+/**
+ * blk_poll() - make progress on the requests submitted to a device
+ *
+ * The completion function of each request which has finished is called.
+ *
+ * @block_dev:	Block device descriptor
+ * @return number of requests still in flight, or -ve on error
+ */
+int blk_poll(struct blk_desc *block_dev);
+
+/**
+ * blk_wait() - wait for an asynchronous block request to complete
+ *
+ * This polls the device until @req has completed.
+ *
+ * @block_dev:	Block device descriptor
+ * @req:	Request previously passed to blk_submit()
+ * @return 0 if all blocks were transferred, -EIO on a short transfer,
+ * -ETIMEDOUT if the device stopped completing requests (@req is then still
+ * in flight), or other -ve error
+ */
+int blk_wait(struct blk_desc *block_dev, struct blk_req *req);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -428,29 +638,29 @@ struct blk_desc *blk_get_by_device(struct udevice *dev);
 static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			      lbaint_t blkcnt, void *buffer)
 {
-	ulong blks_read;
-	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
-		return blkcnt;
-
 	/*
 	 * We could check if block_read is NULL and return -ENOSYS. But this
 	 * bloats the code slightly (cause some board to fail to build), and
 	 * it would be an error to try an operation that does not exist.
 	 */
-	blks_read = block_dev->block_read(block_dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(block_dev->if_type, block_dev->devnum,
-			      start, blkcnt, block_dev->blksz, buffer);
-
-	return blks_read;
+	return blkcache_dread(block_dev, start, blkcnt, buffer,
+			      block_dev->block_read);
 }
 
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
-	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
-	return block_dev->block_write(block_dev, start, blkcnt, buffer);
+	ulong blks_written;
+
+	blks_written = block_dev->block_write(block_dev, start, blkcnt,
+					      buffer);
+	if (blks_written == blkcnt)
+		blkcache_write(block_dev->if_type, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	else
+		blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+
+	return blks_written;
 }
 
 static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
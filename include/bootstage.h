@@ -196,6 +196,11 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_DECOMP,
 	BOOTSTAGE_ID_ACCUM_OF_LIVE,
 	BOOTSTAGE_ID_FPGA_INIT,
+	BOOTSTAGE_ID_ACCUM_FPGA_CPU,
+	BOOTSTAGE_ID_ACCUM_FPGA_DMA,
+	BOOTSTAGE_ID_ACCUM_FPGA_SDM_FILL,
+	BOOTSTAGE_ID_ACCUM_FPGA_SDM_WAIT,
+	BOOTSTAGE_ID_ACCUM_FPGA_SDM_XFER,
 	BOOTSTATE_ID_ACCUM_DM_SPL,
 	BOOTSTATE_ID_ACCUM_DM_F,
 	BOOTSTATE_ID_ACCUM_DM_R,
@@ -304,6 +309,20 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * Add a duration to an accumulator
+ *
+ * This is for activities which overlap, e.g. several DMA transfers in
+ * flight, so cannot be bracketed with bootstage_start()/bootstage_accum().
+ *
+ * @param id	Bootstage id to record this time against
+ * @param name	Textual name to display for this id in the report (maybe NULL)
+ * @param duration	Time to add, in microseconds
+ * @return total time accumulated for this id
+ */
+uint32_t bootstage_accum_time(enum bootstage_id id, const char *name,
+			      uint32_t duration);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
@@ -403,6 +422,13 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline uint32_t bootstage_accum_time(enum bootstage_id id,
+					    const char *name,
+					    uint32_t duration)
+{
+	return 0;
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
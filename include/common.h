@@ -434,6 +434,63 @@ int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
 
+/**
+ * gunzip_stream() - decompress a gzip image one output window at a time
+ *
+ * Instead of inflating the whole image into memory, each time a window of
+ * @szbuf bytes has been filled (and once more for the tail) it is passed to
+ * @consume, so the data can be pushed straight into a device.
+ *
+ * @src:	compressed image address
+ * @len:	compressed image length in bytes, including the gzip trailer
+ * @szbuf:	size of the output window in bytes
+ * @consume:	called with each chunk of output; a non-zero return value
+ *		aborts the decompression and is returned
+ * @priv:	private pointer passed to @consume
+ * @return 0 if OK, -ve on error
+ */
+int gunzip_stream(unsigned char *src, unsigned long len, unsigned long szbuf,
+		  int (*consume)(void *priv, const void *buf, size_t len),
+		  void *priv);
+
+/**
+ * gunzip_push_start() - start decompressing a gzip image fed in pieces
+ *
+ * This is the counterpart of gunzip_stream(): the compressed image is pushed
+ * in with gunzip_push(), in pieces of any size, as it is read, and inflated
+ * into a single output buffer.
+ *
+ * @dst:	output buffer
+ * @dstlen:	size of the output buffer in bytes
+ * @return context to pass to gunzip_push() and gunzip_push_end(), or NULL
+ * on error
+ */
+void *gunzip_push_start(void *dst, unsigned long dstlen);
+
+/**
+ * gunzip_push() - decompress the next piece of a gzip image
+ *
+ * The arguments are those of a gunzip_stream() or fs_read_stream()
+ * consumer, so it can be handed the compressed data directly.
+ *
+ * @priv:	context returned by gunzip_push_start()
+ * @buf:	next piece of the compressed image
+ * @len:	length of the piece in bytes
+ * @return 0 if OK, -ENOSPC if the output buffer is full, -1 on bad data
+ */
+int gunzip_push(void *priv, const void *buf, size_t len);
+
+/**
+ * gunzip_push_end() - finish decompressing a gzip image
+ *
+ * Always frees the context, whether the image was complete or not.
+ *
+ * @priv:	context returned by gunzip_push_start()
+ * @lenp:	returns the decompressed length, if not NULL
+ * @return 0 if the whole image was inflated and its CRC matched, -1 if not
+ */
+int gunzip_push_end(void *priv, unsigned long *lenp);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
@@ -476,6 +533,99 @@ int gzwrite(unsigned char *src, int len,
 /* lib/lz4_wrapper.c */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * ulz4fn_block() - decompress a single raw LZ4 block
+ *
+ * The block has no frame header, as stored by SquashFS for example.
+ *
+ * @src:	compressed block address
+ * @srcn:	compressed block length in bytes
+ * @dst:	output buffer
+ * @dstn:	size of the output buffer; updated to the decompressed length
+ * @return 0 if OK, -ve on error
+ */
+int ulz4fn_block(const void *src, size_t srcn, void *dst, size_t *dstn);
+
+/**
+ * ulz4fn_stream() - decompress an LZ4 frame one block at a time
+ *
+ * Each decompressed block is passed to @consume instead of being stored in a
+ * single output buffer. Every chunk except the last one is a multiple of
+ * four bytes long; up to three trailing bytes of a block are carried over
+ * to the next chunk.
+ *
+ * @src:	compressed frame address
+ * @srcn:	compressed frame length in bytes
+ * @consume:	called with each chunk of output; a non-zero return value
+ *		aborts the decompression and is returned
+ * @priv:	private pointer passed to @consume
+ * @return 0 if OK, -ve on error
+ */
+int ulz4fn_stream(const void *src, size_t srcn,
+		  int (*consume)(void *priv, const void *buf, size_t len),
+		  void *priv);
+
+/* lib/zstd/zstd.c */
+
+/**
+ * zstd_is_compressed() - check for a Zstandard frame
+ *
+ * @src:	data address
+ * @srcn:	data length in bytes
+ * @return true if the data starts with a Zstandard or skippable frame
+ */
+bool zstd_is_compressed(const void *src, size_t srcn);
+
+/**
+ * zstd_decompress() - decompress a sequence of Zstandard frames
+ *
+ * Skippable frames are ignored. Frames which need a dictionary are not
+ * supported.
+ *
+ * @src:	compressed data address
+ * @srcn:	compressed data length in bytes
+ * @dst:	output buffer
+ * @dstn:	on entry the size of @dst, on exit the number of bytes written,
+ *		or the size of @dst if it was too small
+ * @return 0 if OK, -ENOSPC if @dst is too small, other -ve on error
+ */
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn);
+
+/**
+ * zstd_decompress_frame() - decompress a single Zstandard frame
+ *
+ * Unlike zstd_decompress() anything after the frame is left alone, which
+ * suits containers padding the compressed data.
+ *
+ * @src:	compressed frame address
+ * @srcn:	on entry the length of @src, on exit the length of the frame
+ * @dst:	output buffer
+ * @dstn:	on entry the size of @dst, on exit the number of bytes written
+ * @return 0 if OK, -ve on error
+ */
+int zstd_decompress_frame(const void *src, size_t *srcn, void *dst,
+			  size_t *dstn);
+
+/**
+ * zstd_decompress_stream() - decompress Zstandard frames block by block
+ *
+ * Only the window of each frame is kept in memory, so frames whose window
+ * exceeds CONFIG_ZSTD_STREAM_WINDOW_LOG are refused with -EFBIG. Every
+ * chunk passed to @consume except the last one is a multiple of four bytes
+ * long.
+ *
+ * @src:	compressed data address
+ * @srcn:	compressed data length in bytes
+ * @consume:	called with each chunk of output; a non-zero return value
+ *		aborts the decompression and is returned
+ * @priv:	private pointer passed to @consume
+ * @return 0 if OK, -ve on error
+ */
+int zstd_decompress_stream(const void *src, size_t srcn,
+			   int (*consume)(void *priv, const void *buf,
+					  size_t len),
+			   void *priv);
+
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
 	   int(*compar)(const void *, const void *));
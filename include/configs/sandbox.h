@@ -72,6 +72,7 @@
 #define CONFIG_BOOTP_SEND_HOSTNAME
 #define CONFIG_BOOTP_SERVERIP
 #define CONFIG_IP_DEFRAG
+#define CONFIG_TFTP_PORT
 
 #ifndef SANDBOX_NO_SDL
 #define CONFIG_SANDBOX_SDL
@@ -44,6 +44,11 @@
 					sizeof(CONFIG_SYS_PROMPT) + 16)
 #define CONFIG_SYS_BARGSIZE		CONFIG_SYS_CBSIZE
 
+/* Initialize the SDRAM ECC bits while the console is idle */
+#if defined(CONFIG_ALTERA_SDRAM_ECC_LAZY) && !defined(CONFIG_SPL_BUILD)
+#define CONFIG_SHOW_ACTIVITY
+#endif
+
 /* Extend size of kernel image for uncompression */
 #define CONFIG_SYS_BOOTM_LEN		(32 * 1024 * 1024)
 
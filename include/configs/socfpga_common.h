@@ -41,7 +41,13 @@
  * at this address to not overwrite the bootcounter by checking, if the
  * bootcounter address is located in the internal SRAM.
  */
-#if ((CONFIG_SYS_BOOTCOUNT_ADDR > CONFIG_SYS_INIT_RAM_ADDR) &&	\
+#if defined(CONFIG_FPGA_SOCFPGA_SKIP_LOADED_ADDR) &&		\
+    ((CONFIG_FPGA_SOCFPGA_SKIP_LOADED_ADDR > CONFIG_SYS_INIT_RAM_ADDR) && \
+     (CONFIG_FPGA_SOCFPGA_SKIP_LOADED_ADDR < (CONFIG_SYS_INIT_RAM_ADDR + \
+					     CONFIG_SYS_INIT_RAM_SIZE)))
+/* Keep the record of the loaded bitstream, see drivers/fpga/socfpga.c */
+#define CONFIG_SPL_STACK		CONFIG_FPGA_SOCFPGA_SKIP_LOADED_ADDR
+#elif ((CONFIG_SYS_BOOTCOUNT_ADDR > CONFIG_SYS_INIT_RAM_ADDR) &&	\
      (CONFIG_SYS_BOOTCOUNT_ADDR < (CONFIG_SYS_INIT_RAM_ADDR +	\
 				   CONFIG_SYS_INIT_RAM_SIZE)))
 #define CONFIG_SPL_STACK		CONFIG_SYS_BOOTCOUNT_ADDR
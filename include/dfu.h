@@ -22,6 +22,7 @@ enum dfu_device_type {
 	DFU_DEV_NAND,
 	DFU_DEV_RAM,
 	DFU_DEV_SF,
+	DFU_DEV_RSU,
 };
 
 enum dfu_layout {
@@ -79,6 +80,15 @@ struct sf_internal_data {
 	u64 size;
 };
 
+struct rsu_internal_data {
+	int slot;
+	int rawdata;
+
+	/* stream state */
+	int open;
+	int initialized;
+};
+
 #define DFU_NAME_SIZE			32
 #ifndef CONFIG_SYS_DFU_DATA_BUF_SIZE
 #define CONFIG_SYS_DFU_DATA_BUF_SIZE		(1024*1024*8)	/* 8 MiB */
@@ -106,6 +116,7 @@ struct dfu_entity {
 		struct nand_internal_data nand;
 		struct ram_internal_data ram;
 		struct sf_internal_data sf;
+		struct rsu_internal_data rsu;
 	} data;
 
 	int (*get_medium_size)(struct dfu_entity *dfu, u64 *size);
@@ -245,6 +256,17 @@ static inline int dfu_fill_entity_sf(struct dfu_entity *dfu, char *devstr,
 }
 #endif
 
+#if CONFIG_IS_ENABLED(DFU_RSU)
+extern int dfu_fill_entity_rsu(struct dfu_entity *dfu, char *devstr, char *s);
+#else
+static inline int dfu_fill_entity_rsu(struct dfu_entity *dfu, char *devstr,
+				      char *s)
+{
+	puts("RSU support not available!\n");
+	return -1;
+}
+#endif
+
 /**
  * dfu_tftp_write - Write TFTP data to DFU medium
  *
@@ -30,9 +30,12 @@
 
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
+#define EXT_INIT_MAX_LEN	(1UL << 15) /* Longer extents are unwritten */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER 0x0001
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_RO_COMPAT_METADATA_CSUM 0x0400
+#define EXT4_FEATURE_INCOMPAT_META_BG	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
 #define EXT4_INDIRECT_BLOCKS		12
@@ -103,6 +106,8 @@ struct ext_filesystem {
 
 	/* Block Bitmap Related */
 	unsigned char **blk_bmaps;
+	/* Groups whose block bitmap is journalled, one bit each */
+	unsigned char *blk_bmaps_logged;
 	long int curr_blkno;
 	uint16_t first_pass_bbmap;
 
@@ -123,6 +128,22 @@ struct ext_block_cache {
 	int size;
 };
 
+#define EXT_EXTENT_CACHE_SIZE	16
+
+struct ext_cached_extent {
+	uint32_t block;		/* first file block */
+	uint32_t len;		/* number of blocks */
+	uint64_t start;		/* first fs block, 0 if unwritten */
+};
+
+/* Extents of a file, copied from the extent tree leaf looked up last */
+struct ext_extent_cache {
+	struct ext_block_cache blocks;	/* tree block read last */
+	uint32_t first;			/* first file block mapped */
+	int count;
+	struct ext_cached_extent ext[EXT_EXTENT_CACHE_SIZE];
+};
+
 extern struct ext2_data *ext4fs_root;
 extern struct ext2fs_node *ext4fs_file;
 
@@ -145,6 +166,7 @@ int ext4fs_open(const char *filename, loff_t *len);
 int ext4fs_read(char *buf, loff_t offset, loff_t len, loff_t *actread);
 int ext4fs_mount(unsigned part_length);
 void ext4fs_close(void);
+void ext4fs_release(void);
 void ext4fs_reinit_global(void);
 int ext4fs_ls(const char *dirname);
 int ext4fs_exists(const char *filename);
@@ -152,15 +174,24 @@ int ext4fs_size(const char *filename, loff_t *size);
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot);
 int ext4fs_devread(lbaint_t sector, int byte_offset, int byte_len, char *buf);
 void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info);
+bool ext4fs_mounted(struct blk_desc *rbdd, disk_partition_t *info);
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache);
+int ext4fs_map_blocks(struct ext2_inode *inode, uint32_t fileblock,
+		      uint32_t max, struct ext_extent_cache *cache,
+		      uint64_t *blknr, uint32_t *count);
 int ext4fs_probe(struct blk_desc *fs_dev_desc,
 		 disk_partition_t *fs_partition);
 int ext4_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		   loff_t *actread);
+int ext4_read_stream(const char *filename, loff_t offset, loff_t len,
+		     int (*consume)(void *priv, const void *buf, size_t len),
+		     void *priv, loff_t *actread);
 int ext4_read_superblock(char *buffer);
 int ext4fs_uuid(char *uuid_str);
 void ext_cache_init(struct ext_block_cache *cache);
 void ext_cache_fini(struct ext_block_cache *cache);
 int ext_cache_read(struct ext_block_cache *cache, lbaint_t block, int size);
+void ext_extent_cache_init(struct ext_extent_cache *cache);
+void ext_extent_cache_fini(struct ext_extent_cache *cache);
 #endif
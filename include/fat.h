@@ -29,6 +29,13 @@
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+/* FAT windows kept besides the current one in fatbuf */
+#ifdef CONFIG_FS_FAT_CACHE_WINDOWS
+#define FATCACHE_SLOTS	(CONFIG_FS_FAT_CACHE_WINDOWS - 1)
+#else
+#define FATCACHE_SLOTS	1
+#endif
+
 /* Maximum number of entry for long file name according to spec */
 #define MAX_LFN_SLOT	20
 
@@ -159,6 +166,9 @@ typedef struct dir_slot {
  *
  * Note: FAT buffer has to be 32 bit aligned
  * (see FAT32 accesses)
+ *
+ * fatbuf holds CONFIG_FS_FAT_CACHE_WINDOWS windows of FATBUFSIZE bytes.
+ * The first one is the current window, the others are cache slots.
  */
 typedef struct {
 	__u8	*fatbuf;	/* Current FAT buffer */
@@ -175,6 +185,9 @@ typedef struct {
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	int	fatcache_num[FATCACHE_SLOTS];	/* FAT window in each slot */
+	u32	fatcache_lru[FATCACHE_SLOTS];	/* Last use of each slot */
+	u32	fatcache_tick;	/* Use counter for fatcache_lru */
 } fsdata;
 
 static inline u32 clust_to_sect(fsdata *fsdata, u32 clust)
@@ -194,12 +207,16 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 		     loff_t maxsize, loff_t *actread);
 int file_fat_read(const char *filename, void *buffer, int maxsize);
 int fat_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info);
+bool fat_mounted(struct blk_desc *rbdd, disk_partition_t *info);
 int fat_register_device(struct blk_desc *dev_desc, int part_no);
 
 int file_fat_write(const char *filename, void *buf, loff_t offset, loff_t len,
 		   loff_t *actwrite);
 int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		  loff_t *actread);
+int fat_read_stream(const char *filename, loff_t offset, loff_t len,
+		    int (*consume)(void *priv, const void *buf, size_t len),
+		    void *priv, loff_t *actread);
 int fat_opendir(const char *filename, struct fs_dir_stream **dirsp);
 int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
 void fat_closedir(struct fs_dir_stream *dirs);
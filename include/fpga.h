@@ -61,6 +61,8 @@ typedef enum {
 void fpga_init(void);
 int fpga_add(fpga_type devtype, void *desc);
 int fpga_count(void);
+void fpga_set_force(bool force);
+bool fpga_get_force(void);
 const fpga_desc *const fpga_get_desc(int devnum);
 int fpga_is_partial_data(int devnum, size_t img_len);
 int fpga_load(int devnum, const void *buf, size_t bsize,
@@ -76,4 +78,31 @@ int fpga_info(int devnum);
 const fpga_desc *const fpga_validate(int devnum, const void *buf,
 				     size_t bsize, char *fn);
 
+/**
+ * fpga_is_compressed() - check whether a bitstream is gzip or LZ4 compressed
+ *
+ * @buf:	bitstream address
+ * @bsize:	bitstream size in bytes
+ * @return true if fpga_decompress() can handle the bitstream
+ */
+bool fpga_is_compressed(const void *buf, size_t bsize);
+
+/**
+ * fpga_decompress() - decompress a bitstream straight into an FPGA driver
+ *
+ * The bitstream is decompressed one window at a time and each window is
+ * passed to @write, so the uncompressed bitstream never needs to be held
+ * in memory as a whole. Every chunk but the last is word aligned in size
+ * and address.
+ *
+ * @buf:	compressed bitstream address
+ * @bsize:	compressed bitstream size in bytes
+ * @write:	called with each decompressed chunk, returns 0 on success
+ * @priv:	private pointer passed to @write
+ * @return 0 if OK, -ve on error
+ */
+int fpga_decompress(const void *buf, size_t bsize,
+		    int (*write)(void *priv, const void *data, size_t len),
+		    void *priv);
+
 #endif	/* _FPGA_H_ */
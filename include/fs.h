@@ -13,6 +13,7 @@
 #define FS_TYPE_SANDBOX	3
 #define FS_TYPE_UBIFS	4
 #define FS_TYPE_BTRFS	5
+#define FS_TYPE_SQUASHFS	6
 
 /*
  * Tell the fs layer which block device an partition to use for future
@@ -37,6 +38,21 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype);
  */
 int fs_set_blk_dev_with_part(struct blk_desc *desc, int part);
 
+/*
+ * fs_mount_invalidate - Forget the filesystem kept mounted on a device
+ *
+ * With CONFIG_FS_MOUNT_CACHE the filesystem used by a command stays mounted
+ * for the next command on the same partition. This must be called when the
+ * device is written to outside the filesystem, re-initialised or removed.
+ *
+ * @desc: Block device, or NULL for any device
+ */
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+void fs_mount_invalidate(struct blk_desc *desc);
+#else
+static inline void fs_mount_invalidate(struct blk_desc *desc) {}
+#endif
+
 /**
  * fs_get_type_name() - Get type of current filesystem
  *
@@ -85,6 +101,35 @@ int fs_size(const char *filename, loff_t *size);
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread);
 
+/**
+ * fs_read_stream() - pass a file on to a consumer as it is read
+ *
+ * Reads a file from the partition previously set by fs_set_blk_dev() in
+ * chunks of CONFIG_FS_STREAM_BUFSIZE bytes, handing each one to @consume
+ * while it is still in the cache. This lets a file be hashed, decompressed
+ * or written to a device in a single pass, without loading it first.
+ * Every chunk but the last one is CONFIG_FS_STREAM_BUFSIZE bytes long.
+ * Chunks are read into two buffers in turn, and a chunk stays in place
+ * until @consume has been called with the next one, so that @consume can
+ * start e.g. a DMA from it and only wait for that on its next call. The
+ * last chunk, which completes @len, must be finished with before @consume
+ * returns, as the buffers are freed then.
+ *
+ * @filename:	name of the file to read
+ * @offset:	offset in the file to start from
+ * @len:	number of bytes to read, or 0 to read up to the end of the file;
+ *		-EINVAL is returned before anything is read if the file is
+ *		shorter
+ * @consume:	called with each chunk; a non-zero return value stops the
+ *		read and is returned
+ * @priv:	private pointer passed to @consume
+ * @actread:	returns the number of bytes passed on
+ * @return 0 if OK, -ve on error
+ */
+int fs_read_stream(const char *filename, loff_t offset, loff_t len,
+		   int (*consume)(void *priv, const void *buf, size_t len),
+		   void *priv, loff_t *actread);
+
 /*
  * fs_write - Write file to the partition previously set by fs_set_blk_dev()
  * Note that not all filesystem types support offset!=0.
@@ -13,4 +13,34 @@
 int fs_devread(struct blk_desc *, disk_partition_t *, lbaint_t, int, int,
 	       char *);
 
+/**
+ * fs_stream_chunks() - pass part of a file on to a consumer, chunk by chunk
+ *
+ * Helper for the read_stream operation of the filesystems: the file is read
+ * into two buffers of CONFIG_FS_STREAM_BUFSIZE bytes in turn by @read,
+ * which reads from the file the filesystem has looked up already, and each
+ * chunk is handed to @consume while it is still in the cache. Every chunk
+ * but the last one is CONFIG_FS_STREAM_BUFSIZE bytes long. A chunk stays in
+ * its buffer until @consume has been called with the next one; the buffers
+ * are freed after the last one.
+ *
+ * @size:	size of the file
+ * @offset:	where to start in the file
+ * @len:	number of bytes to read, or 0 to read up to the end of the file;
+ *		-EINVAL is returned at once if the file is shorter
+ * @read:	reads @len bytes at @pos of the file into @buf; returns 0 if OK
+ * @ctx:	private pointer passed to @read
+ * @consume:	called with each chunk; a non-zero return value stops the
+ *		read and is returned
+ * @priv:	private pointer passed to @consume
+ * @actread:	returns the number of bytes passed on
+ * @return 0 if OK, -ve on error
+ */
+int fs_stream_chunks(loff_t size, loff_t offset, loff_t len,
+		     int (*read)(void *ctx, void *buf, loff_t pos, loff_t len,
+				 loff_t *actread),
+		     void *ctx,
+		     int (*consume)(void *priv, const void *buf, size_t len),
+		     void *priv, loff_t *actread);
+
 #endif /* __U_BOOT_FS_INTERNAL_H__ */
@@ -88,6 +88,22 @@ struct hash_algo {
 int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		 int argc, char * const argv[]);
 
+/**
+ * hash_file_command: Process a hash command for a file on a filesystem
+ *
+ * The file is hashed as it is read, so it is not loaded into memory.
+ *
+ * @algo_name:		Hash algorithm being used (lower case!)
+ * @flags:		Flags value (HASH_FLAG_...)
+ * @argc:		Number of arguments
+ * @argv:		Arguments: interface, device[:partition] and file name,
+ *			followed by the hash to verify against or where to
+ *			store the result
+ * @return 0 if ok, 1 on error, CMD_RET_USAGE on bad arguments
+ */
+int hash_file_command(const char *algo_name, int flags, int argc,
+		      char * const argv[]);
+
 /**
  * hash_block() - Hash a block according to the requested algorithm
  *
@@ -7,9 +7,11 @@
 #ifdef CONFIG_HAVE_ARCH_BITREVERSE
 #include <asm/bitrev.h>
 
+#define __bitrev64 __arch_bitrev64
 #define __bitrev32 __arch_bitrev32
 #define __bitrev16 __arch_bitrev16
 #define __bitrev8 __arch_bitrev8
+#define __bitrev8x8 __arch_bitrev8x8
 
 #else
 extern u8 const byte_rev_table[256];
@@ -28,6 +30,23 @@ static inline u32 __bitrev32(u32 x)
 	return (__bitrev16(x & 0xffff) << 16) | __bitrev16(x >> 16);
 }
 
+static inline u64 __bitrev64(u64 x)
+{
+	return ((u64)__bitrev32(x & 0xffffffff) << 32) | __bitrev32(x >> 32);
+}
+
+/* Reverse the bits of each byte, keeping the byte order */
+static inline u64 __bitrev8x8(u64 x)
+{
+	x = ((x & 0xF0F0F0F0F0F0F0F0ULL) >> 4) |
+	    ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	x = ((x & 0xCCCCCCCCCCCCCCCCULL) >> 2) |
+	    ((x & 0x3333333333333333ULL) << 2);
+	x = ((x & 0xAAAAAAAAAAAAAAAAULL) >> 1) |
+	    ((x & 0x5555555555555555ULL) << 1);
+	return x;
+}
+
 #endif /* CONFIG_HAVE_ARCH_BITREVERSE */
 
 #define __bitrev8x4(x)	(__bitrev32(swab32(x)))
@@ -95,6 +114,10 @@ static inline u32 __bitrev32(u32 x)
 	__bitrev8x4(__x);		\
 })
 
+#define bitrev64(x)			__bitrev64(x)
+
+#define bitrev8x8(x)			__bitrev8x8(x)
+
 #define bitrev8(x)			\
 ({					\
 	u8 __x = x;			\
@@ -102,4 +125,14 @@ static inline u32 __bitrev32(u32 x)
 	__constant_bitrev8(__x) :	\
 	__bitrev8(__x)	;		\
 })
+/**
+ * bitrev8_buf() - reverse the bits of each byte in a buffer
+ * @buf: buffer to be processed in place
+ * @len: size of the buffer in bytes
+ *
+ * This is how FPGA bitstreams are converted between the LSB first order of
+ * the configuration data and the MSB first order CRCs are computed on.
+ */
+void bitrev8_buf(void *buf, size_t len);
+
 #endif /* _LINUX_BITREV_H */
@@ -84,6 +84,25 @@ enum eth_state_t {
 	ETH_STATE_ACTIVE
 };
 
+/**
+ * struct eth_stats - Packet counters of an Ethernet device
+ *
+ * @rx_packets:	Frames passed to the network stack
+ * @rx_errors:	Bad frames dropped by the driver
+ * @rx_missed:	Frames lost because no receive buffer was free
+ * @rx_overruns: Frames lost because the receive FIFO overflowed
+ * @tx_packets:	Frames sent
+ * @tx_errors:	Frames which could not be sent
+ */
+struct eth_stats {
+	ulong rx_packets;
+	ulong rx_errors;
+	ulong rx_missed;
+	ulong rx_overruns;
+	ulong tx_packets;
+	ulong tx_errors;
+};
+
 #ifdef CONFIG_DM_ETH
 /**
  * struct eth_pdata - Platform data for Ethernet MAC controllers
@@ -117,7 +136,10 @@ enum eth_recv_flags {
  *	 packet buffer in the packetp parameter. If not, return an error or 0 to
  *	 indicate that the hardware receive FIFO is empty. If 0 is returned, the
  *	 network stack will not process the empty packet, but free_pkt() will be
- *	 called if supplied
+ *	 called if supplied. The protocol handlers consume the packet in place
+ *	 (e.g. TFTP and NFS store their payload straight from it), so there is
+ *	 no need to copy it into net_rx_packets; it must stay valid until
+ *	 free_pkt() is called
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
@@ -133,6 +155,9 @@ enum eth_recv_flags {
  *		    ROM on the board. This is how the driver should expose it
  *		    to the network stack. This function should fill in the
  *		    eth_pdata::enetaddr field - optional
+ * get_stats: Fill in the packet counters of the device, which start at zero
+ *	      when it is probed. Counters the driver does not keep are left
+ *	      at zero - optional
  */
 struct eth_ops {
 	int (*start)(struct udevice *dev);
@@ -143,6 +168,7 @@ struct eth_ops {
 	int (*mcast)(struct udevice *dev, const u8 *enetaddr, int join);
 	int (*write_hwaddr)(struct udevice *dev);
 	int (*read_rom_hwaddr)(struct udevice *dev);
+	int (*get_stats)(struct udevice *dev, struct eth_stats *stats);
 };
 
 #define eth_get_ops(dev) ((struct eth_ops *)(dev)->driver->ops)
@@ -155,6 +181,16 @@ struct udevice *eth_get_dev(void); /* get the current device */
 struct udevice *eth_get_dev_by_name(const char *devname);
 unsigned char *eth_get_ethaddr(void); /* get the current device MAC */
 
+/**
+ * eth_get_stats() - Read the packet counters of a device
+ *
+ * @dev:	Ethernet device
+ * @stats:	Returns the counters
+ * @return 0 if OK, -ENOSYS if the driver keeps no counters, or other -ve
+ *	error
+ */
+int eth_get_stats(struct udevice *dev, struct eth_stats *stats);
+
 /* Used only when NetConsole is enabled */
 int eth_is_active(struct udevice *dev); /* Test device for active state */
 int eth_init_state_only(void); /* Set active state */
@@ -343,6 +379,7 @@ struct vlan_ethernet_hdr {
 #define PROT_PPP_SES	0x8864		/* PPPoE session messages	*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -392,6 +429,11 @@ struct ip_udp_hdr {
 #define IP_UDP_HDR_SIZE		(sizeof(struct ip_udp_hdr))
 #define UDP_HDR_SIZE		(IP_UDP_HDR_SIZE - IP_HDR_SIZE)
 
+/* Largest IP packet, headers included, reassembled from fragments */
+#if defined(CONFIG_IP_DEFRAG) && !defined(CONFIG_NET_MAXDEFRAG)
+#define CONFIG_NET_MAXDEFRAG	16384
+#endif
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -528,7 +570,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL
+	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, WGET
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client, for downloads
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+/*
+ *	IP + TCP header, without options
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgment number	*/
+	u8		tcp_hlen;	/* Header length, in the top nibble */
+	u8		tcp_flags;	/* Control flags		*/
+	u16		tcp_win;	/* Receive window		*/
+	u16		tcp_xsum;	/* Checksum			*/
+	u16		tcp_urg;	/* Urgent pointer		*/
+} __packed;
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+/* Control flags */
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+/* Options */
+#define TCP_OPT_END	0
+#define TCP_OPT_NOP	1
+#define TCP_OPT_MSS	2
+#define TCP_OPT_MSS_LEN	4
+
+/* Largest segment we accept: a full Ethernet frame */
+#define TCP_MSS		(ETH_DATA_LEN - IP_TCP_HDR_SIZE)
+
+/**
+ * struct tcp_ops - Callbacks for the user of a connection
+ *
+ * They are called from the network loop, so may send data or close the
+ * connection, but must not start a new one.
+ *
+ * @connected:	The connection is open and data may be sent
+ * @receive:	Data arrived, in order. Return 0 to carry on, or an error to
+ *		reset the connection, which is then closed with that error
+ * @closed:	The connection is gone: @err is 0 once both sides have
+ *		closed it, or -ve if it was refused, reset or timed out
+ * @rx_space:	Return the number of bytes @receive can still take, which
+ *		limits the window we advertise. NULL if there is no limit
+ */
+struct tcp_ops {
+	void (*connected)(void);
+	int (*receive)(const uchar *data, unsigned int len);
+	void (*closed)(int err);
+	ulong (*rx_space)(void);
+};
+
+/**
+ * tcp_connect() - Open a connection
+ *
+ * Only one connection exists at a time, so any earlier one is forgotten.
+ * @ops->closed is called if the connection cannot be made.
+ *
+ * @dest:	Address of the server
+ * @dport:	Port of the server
+ * @ops:	Callbacks for the connection
+ */
+void tcp_connect(struct in_addr dest, int dport, const struct tcp_ops *ops);
+
+/**
+ * tcp_send() - Send data on the connection
+ *
+ * The data is sent as the peer's window allows and kept for retransmission,
+ * so @data must stay valid until the connection is closed.
+ *
+ * @data:	Data to send
+ * @len:	Number of bytes to send
+ * @return 0 if OK, -EBUSY if earlier data is still unacknowledged,
+ *	-ENOTCONN if the connection is not open
+ */
+int tcp_send(const void *data, unsigned int len);
+
+/**
+ * tcp_close() - Close our side of the connection
+ *
+ * A FIN is sent once all our data is acknowledged. @ops->closed follows
+ * when the peer has acknowledged it.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_reset() - Forget the connection, without telling the peer
+ *
+ * This is used when the network loop ends, so that stray segments are not
+ * passed on to a user which has gone.
+ */
+void tcp_reset(void);
+
+/**
+ * tcp_set_tcp_header() - Fill in the IP and TCP headers of a segment
+ *
+ * The payload must already be in place after the headers.
+ *
+ * @pkt:	Start of the IP header
+ * @dest:	Destination address
+ * @dport:	Destination port
+ * @sport:	Source port
+ * @payload_len: Number of bytes of payload
+ * @flags:	TCP_... control flags
+ * @seq:	Sequence number
+ * @ack:	Acknowledgment number
+ * @return size of the IP and TCP headers
+ */
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 flags, u32 seq, u32 ack);
+
+/**
+ * tcp_receive() - Handle a received TCP segment
+ *
+ * @ip:		IP header of the segment
+ * @len:	Length of the IP packet
+ */
+void tcp_receive(struct ip_udp_hdr *ip, int len);
+
+#endif /* __TCP_H__ */
@@ -18,6 +18,21 @@
 /* tftp.c */
 void tftp_start(enum proto_t protocol);	/* Begin TFTP get/put */
 
+/**
+ * tftp_set_consumer() - Pass downloaded data to a function
+ *
+ * Instead of writing the file to memory, hand it to @consume as it
+ * arrives, in order. This stays in effect until it is set to NULL. A
+ * transfer which has to be restarted part way through fails, since the
+ * data already consumed cannot be taken back.
+ *
+ * @consume:	Function to call with each block. It returns 0 if OK, or an
+ *		error, which aborts the download
+ * @priv:	Private data for @consume
+ */
+void tftp_set_consumer(int (*consume)(void *priv, const void *buf,
+				      size_t len), void *priv);
+
 #ifdef CONFIG_CMD_TFTPSRV
 void tftp_start_server(void);	/* Wait for incoming TFTP put */
 #endif
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * HTTP download client
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+#define WGET_HTTP_PORT	80
+
+/**
+ * wget_start() - Start downloading the file named by net_boot_file_name
+ *
+ * The name is either "http://hostIPaddr[:port]/path" or, as for TFTP,
+ * "[hostIPaddr:]path". The response body goes to load_addr, or to the
+ * consumer if one is set.
+ */
+void wget_start(void);
+
+/**
+ * wget_set_consumer() - Pass downloaded data to a function
+ *
+ * Instead of writing the response body to memory, hand it to @consume as
+ * it arrives, in order. This applies to the next download only: the
+ * consumer is forgotten when it ends, whether or not it succeeds.
+ *
+ * @consume:	Function to call with each piece of data. It returns 0 if OK,
+ *		or an error, which aborts the download
+ * @priv:	Private data for @consume
+ */
+void wget_set_consumer(int (*consume)(void *priv, const void *buf,
+				      size_t len), void *priv);
+
+#endif /* __WGET_H__ */
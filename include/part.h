@@ -201,6 +201,20 @@ int part_get_info_by_name_type(struct blk_desc *dev_desc, const char *name,
 int part_get_info_by_name(struct blk_desc *dev_desc,
 			      const char *name, disk_partition_t *info);
 
+/**
+ * part_get_info_by_uuid() - Search for a partition by its unique UUID
+ *                           among all available registered partitions
+ *
+ * @param dev_desc - block device descriptor
+ * @param uuid - the partition UUID string
+ * @param info - returns the disk partition info
+ *
+ * @return - the partition number on match (starting on 1), -1 on no match,
+ * otherwise error
+ */
+int part_get_info_by_uuid(struct blk_desc *dev_desc, const char *uuid,
+			  disk_partition_t *info);
+
 /**
  * part_set_generic_name() - create generic partition like hda1 or sdb2
  *
@@ -273,6 +287,30 @@ struct part_driver {
 	int (*get_info)(struct blk_desc *dev_desc, int part,
 			disk_partition_t *info);
 
+	/**
+	 * get_info_by_name() - Find a partition by name (optional)
+	 *
+	 * Without this, part_get_info_by_name() tries every partition.
+	 *
+	 * @dev_desc:	Block device descriptor
+	 * @name:	Partition name
+	 * @info:	Returns partition information
+	 * @return partition number (1 = first), or -1 if not found
+	 */
+	int (*get_info_by_name)(struct blk_desc *dev_desc, const char *name,
+				disk_partition_t *info);
+
+	/**
+	 * get_info_by_uuid() - Find a partition by its unique UUID (optional)
+	 *
+	 * @dev_desc:	Block device descriptor
+	 * @uuid:	Partition UUID string
+	 * @info:	Returns partition information
+	 * @return partition number (1 = first), or -1 if not found
+	 */
+	int (*get_info_by_uuid)(struct blk_desc *dev_desc, const char *uuid,
+				disk_partition_t *info);
+
 	/**
 	 * print() - Print partition information
 	 *
@@ -422,6 +460,36 @@ int get_disk_guid(struct blk_desc *dev_desc, char *guid);
 
 #endif
 
+#if CONFIG_IS_ENABLED(EFI_PARTITION_CACHE)
+/**
+ * part_cache_invalidate() - Forget the partition table kept for a device
+ *
+ * With CONFIG_EFI_PARTITION_CACHE the validated GPT of a device is kept for
+ * the following lookups. This must be called when the device is
+ * re-initialised or removed.
+ *
+ * @dev_desc:	Block device, or NULL for any device
+ */
+void part_cache_invalidate(struct blk_desc *dev_desc);
+
+/**
+ * part_cache_write() - Note a write to a device for the partition cache
+ *
+ * Forgets the partition table kept for the device unless all the blocks
+ * written are in the area usable by partitions, where the table is not.
+ *
+ * @dev_desc:	Block device written to
+ * @start:	First block written
+ * @blkcnt:	Number of blocks written
+ */
+void part_cache_write(struct blk_desc *dev_desc, lbaint_t start,
+		      lbaint_t blkcnt);
+#else
+static inline void part_cache_invalidate(struct blk_desc *dev_desc) {}
+static inline void part_cache_write(struct blk_desc *dev_desc,
+				    lbaint_t start, lbaint_t blkcnt) {}
+#endif
+
 #if CONFIG_IS_ENABLED(DOS_PARTITION)
 /**
  * is_valid_dos_buf() - Ensure that a DOS MBR image is valid
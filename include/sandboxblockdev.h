@@ -12,6 +12,10 @@ struct host_block_dev {
 #endif
 	char *filename;
 	int fd;
+	ulong reads;		/* read operations carried out, for tests */
+#ifdef CONFIG_BLK
+	struct list_head reqs;	/* asynchronous requests not yet carried out */
+#endif
 };
 
 int host_dev_bind(int dev, char *filename);
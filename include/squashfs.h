@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Read-only SquashFS filesystem
+ */
+
+#ifndef __SQUASHFS_H__
+#define __SQUASHFS_H__
+
+struct fs_dir_stream;
+struct fs_dirent;
+
+int sqfs_probe(struct blk_desc *fs_dev_desc, disk_partition_t *fs_partition);
+bool sqfs_mounted(struct blk_desc *fs_dev_desc,
+		  disk_partition_t *fs_partition);
+void sqfs_close(void);
+int sqfs_exists(const char *filename);
+int sqfs_size(const char *filename, loff_t *size);
+int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
+	      loff_t *actread);
+int sqfs_read_stream(const char *filename, loff_t offset, loff_t len,
+		     int (*consume)(void *priv, const void *buf, size_t len),
+		     void *priv, loff_t *actread);
+int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp);
+int sqfs_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp);
+void sqfs_closedir(struct fs_dir_stream *dirs);
+
+#endif /* __SQUASHFS_H__ */
@@ -1,10 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0
 
-#ifndef CONFIG_HAVE_ARCH_BITREVERSE
 #include <linux/types.h>
 #include <linux/compat.h>
 #include <linux/bitrev.h>
 
+#ifndef CONFIG_HAVE_ARCH_BITREVERSE
+
 MODULE_AUTHOR("Akinobu Mita <akinobu.mita@gmail.com>");
 MODULE_DESCRIPTION("Bit ordering reversal functions");
 MODULE_LICENSE("GPL");
@@ -46,3 +47,17 @@ const u8 byte_rev_table[256] = {
 EXPORT_SYMBOL_GPL(byte_rev_table);
 
 #endif /* CONFIG_HAVE_ARCH_BITREVERSE */
+
+void bitrev8_buf(void *buf, size_t len)
+{
+	u8 *p = buf;
+
+	for (; len && ((uintptr_t)p & (sizeof(u64) - 1)); len--, p++)
+		*p = __bitrev8(*p);
+
+	for (; len >= sizeof(u64); len -= sizeof(u64), p += sizeof(u64))
+		*(u64 *)p = __bitrev8x8(*(u64 *)p);
+
+	for (; len; len--, p++)
+		*p = __bitrev8(*p);
+}
@@ -79,6 +79,155 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 	return zunzip(dst, dstlen, src, lenp, 1, offset);
 }
 
+int gunzip_stream(unsigned char *src, unsigned long len, unsigned long szbuf,
+		  int (*consume)(void *priv, const void *buf, size_t len),
+		  void *priv)
+{
+	z_stream s;
+	unsigned char *buf;
+	unsigned crc = 0;
+	u32 expected_crc;
+	size_t numfilled;
+	int offset, r, ret = 0;
+
+	offset = gzip_parse_header(src, len);
+	if (offset < 0)
+		return offset;
+
+	if (offset + 8 > len) {
+		puts("Error: gunzip out of data in header\n");
+		return -1;
+	}
+
+	memcpy(&expected_crc, src + len - 8, sizeof(expected_crc));
+	expected_crc = le32_to_cpu(expected_crc);
+
+	buf = malloc_cache_aligned(szbuf);
+	if (!buf)
+		return -ENOMEM;
+
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+
+	r = inflateInit2(&s, -MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(buf);
+		return -1;
+	}
+
+	s.next_in = src + offset;
+	s.avail_in = len - offset;
+
+	/* hand each full output window over as soon as it is inflated */
+	do {
+		s.next_out = buf;
+		s.avail_out = szbuf;
+		r = inflate(&s, Z_SYNC_FLUSH);
+		if (r != Z_OK && r != Z_STREAM_END) {
+			printf("Error: inflate() returned %d\n", r);
+			ret = -1;
+			break;
+		}
+
+		numfilled = szbuf - s.avail_out;
+		if (numfilled) {
+			crc = crc32(crc, buf, numfilled);
+			ret = consume(priv, buf, numfilled);
+			if (ret)
+				break;
+		}
+		WATCHDOG_RESET();
+	} while (r != Z_STREAM_END);
+
+	if (!ret && crc != expected_crc) {
+		printf("Error: gunzip crc 0x%08x, expected 0x%08x\n", crc,
+		       expected_crc);
+		ret = -1;
+	}
+
+	inflateEnd(&s);
+	free(buf);
+
+	return ret;
+}
+
+struct gunzip_push_ctx {
+	z_stream s;
+	int r;			/* last value returned by inflate() */
+};
+
+void *gunzip_push_start(void *dst, unsigned long dstlen)
+{
+	struct gunzip_push_ctx *ctx;
+	int r;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+
+	ctx->s.zalloc = gzalloc;
+	ctx->s.zfree = gzfree;
+
+	/* zlib parses the gzip header and checks the trailer itself */
+	r = inflateInit2(&ctx->s, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(ctx);
+		return NULL;
+	}
+	ctx->s.next_out = dst;
+	ctx->s.avail_out = dstlen;
+	ctx->r = Z_OK;
+
+	return ctx;
+}
+
+int gunzip_push(void *priv, const void *buf, size_t len)
+{
+	struct gunzip_push_ctx *ctx = priv;
+
+	/* Anything after the end of the image is ignored, as by gunzip() */
+	if (ctx->r == Z_STREAM_END)
+		return 0;
+
+	ctx->s.next_in = (unsigned char *)buf;
+	ctx->s.avail_in = len;
+	while (ctx->s.avail_in) {
+		ctx->r = inflate(&ctx->s, Z_NO_FLUSH);
+		if (ctx->r == Z_STREAM_END)
+			return 0;
+		if (ctx->r == Z_BUF_ERROR && !ctx->s.avail_out) {
+			puts("Error: gunzip output does not fit\n");
+			return -ENOSPC;
+		}
+		if (ctx->r != Z_OK) {
+			printf("Error: inflate() returned %d\n", ctx->r);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int gunzip_push_end(void *priv, unsigned long *lenp)
+{
+	struct gunzip_push_ctx *ctx = priv;
+	int ret = 0;
+
+	if (ctx->r != Z_STREAM_END) {
+		if (ctx->r == Z_OK)
+			puts("Error: gunzip out of data\n");
+		ret = -1;
+	}
+	if (lenp)
+		*lenp = ctx->s.total_out;
+	inflateEnd(&ctx->s);
+	free(ctx);
+
+	return ret;
+}
+
 #ifdef CONFIG_CMD_UNZIP
 __weak
 void gzwrite_progress_init(u64 expectedsize)
@@ -113,6 +262,59 @@ void gzwrite_progress_finish(int returnval,
 	}
 }
 
+/*
+ * A buffer of gzwrite(). With driver model, the next buffer is inflated
+ * while the previous one is still being written out.
+ */
+struct gzwrite_buf {
+	unsigned char *data;
+#if CONFIG_IS_ENABLED(BLK)
+	struct blk_req req;
+	bool busy;
+#endif
+};
+
+#if CONFIG_IS_ENABLED(BLK)
+#define GZWRITE_BUFS	2
+#else
+#define GZWRITE_BUFS	1
+#endif
+
+/* Start writing out the first @blkcnt blocks of a buffer at @start */
+static int gzwrite_start(struct blk_desc *dev, struct gzwrite_buf *buf,
+			 lbaint_t start, lbaint_t blkcnt)
+{
+#if CONFIG_IS_ENABLED(BLK)
+	int ret;
+
+	memset(&buf->req, '\0', sizeof(buf->req));
+	buf->req.op = BLK_REQ_WRITE;
+	buf->req.start = start;
+	buf->req.blkcnt = blkcnt;
+	buf->req.buffer = buf->data;
+	ret = blk_submit(dev, &buf->req);
+	buf->busy = !ret;
+
+	return ret;
+#else
+	return blk_dwrite(dev, start, blkcnt, buf->data) == blkcnt ? 0 : -EIO;
+#endif
+}
+
+/* Wait until a buffer has been written out, if it is being */
+static int gzwrite_wait(struct blk_desc *dev, struct gzwrite_buf *buf)
+{
+#if CONFIG_IS_ENABLED(BLK)
+	if (!buf->busy)
+		return 0;
+
+	buf->busy = false;
+	return blk_wait(dev, &buf->req);
+#else
+	return 0;
+#endif
+}
+
 int gzwrite(unsigned char *src, int len,
 	    struct blk_desc *dev,
 	    unsigned long szwritebuf,
@@ -122,7 +324,9 @@ int gzwrite(unsigned char *src, int len,
 	int i, flags;
 	z_stream s;
 	int r = 0;
+	struct gzwrite_buf buf[GZWRITE_BUFS];
 	unsigned char *writebuf;
+	int cur = 0;
 	unsigned crc = 0;
 	u64 totalfilled = 0;
 	lbaint_t blksperbuf, outblock;
@@ -202,7 +406,15 @@ int gzwrite(unsigned char *src, int len,
 
 	s.next_in = src + i;
 	s.avail_in = payload_size+8;
-	writebuf = (unsigned char *)malloc_cache_aligned(szwritebuf);
+	memset(buf, '\0', sizeof(buf));
+	for (i = 0; i < GZWRITE_BUFS; i++) {
+		buf[i].data = malloc_cache_aligned(szwritebuf);
+		if (!buf[i].data) {
+			puts("Error: out of memory\n");
+			r = -1;
+			goto out;
+		}
+	}
 
 	/* decompress until deflate stream ends or end of file */
 	do {
@@ -214,10 +426,17 @@ int gzwrite(unsigned char *src, int len,
 
 		/* run inflate() on input until output buffer not full */
 		do {
-			unsigned long blocks_written;
 			int numfilled;
 			lbaint_t writeblocks;
 
+			/* Reuse the buffer once it has been written out */
+			if (gzwrite_wait(dev, &buf[cur])) {
+				printf("%s: write error\n", __func__);
+				r = -1;
+				goto out;
+			}
+			writebuf = buf[cur].data;
+
 			s.avail_out = szwritebuf;
 			s.next_out = writebuf;
 			r = inflate(&s, Z_SYNC_FLUSH);
@@ -241,9 +460,14 @@ int gzwrite(unsigned char *src, int len,
 			gzwrite_progress(iteration++,
 					 totalfilled,
 					 szexpected);
-			blocks_written = blk_dwrite(dev, outblock,
-						    writeblocks, writebuf);
-			outblock += blocks_written;
+			if (gzwrite_start(dev, &buf[cur], outblock,
+					  writeblocks)) {
+				printf("%s: write error\n", __func__);
+				r = -1;
+				goto out;
+			}
+			outblock += writeblocks;
+			cur = (cur + 1) % GZWRITE_BUFS;
 			if (ctrlc()) {
 				puts("abort\n");
 				goto out;
@@ -260,9 +484,16 @@ int gzwrite(unsigned char *src, int len,
 		r = 0;
 
 out:
+	for (i = 0; i < GZWRITE_BUFS; i++) {
+		if (gzwrite_wait(dev, &buf[i]) && !r) {
+			printf("%s: write error\n", __func__);
+			r = -1;
+		}
+	}
 	gzwrite_progress_finish(r, totalfilled, szexpected,
 				expected_crc, crc);
-	free(writebuf);
+	for (i = 0; i < GZWRITE_BUFS; i++)
+		free(buf[i].data);
 	inflateEnd(&s);
 
 	return r;
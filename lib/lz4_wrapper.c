@@ -5,6 +5,9 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <watchdog.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 
@@ -62,35 +65,55 @@ struct lz4_block_header {
 	/* + u32 block_checksum iff has_block_checksum is set */
 } __packed;
 
+/*
+ * Check the frame header at @src. Returns the header length, or a negative
+ * error code, and sets @has_block_checksum and @block_max.
+ */
+static int lz4_parse_frame_header(const void *src, size_t srcn,
+				  int *has_block_checksum, size_t *block_max)
+{
+	const struct lz4_frame_header *h = src;
+	int len = sizeof(*h);
+
+	if (srcn < sizeof(*h) + sizeof(u64) + sizeof(u8))
+		return -EINVAL;	/* input overrun */
+
+	/* We assume there's always only a single, standard frame. */
+	if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if (h->reserved0 || h->reserved1 || h->reserved2)
+		return -EINVAL;	/* reserved must be zero */
+	if (!h->independent_blocks)
+		return -EPROTONOSUPPORT; /* we can't support this yet */
+	if (h->max_block_size < 4)
+		return -EINVAL;	/* 64KB, 256KB, 1MB and 4MB only */
+
+	*has_block_checksum = h->has_block_checksum;
+	*block_max = 1 << (8 + 2 * h->max_block_size);
+
+	if (h->has_content_size)
+		len += sizeof(u64);
+	len += sizeof(u8);
+
+	return len;
+}
+
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 {
 	const void *end = dst + *dstn;
 	const void *in = src;
 	void *out = dst;
 	int has_block_checksum;
+	size_t block_max;
 	int ret;
 	*dstn = 0;
 
-	{ /* With in-place decompression the header may become invalid later. */
-		const struct lz4_frame_header *h = in;
-
-		if (srcn < sizeof(*h) + sizeof(u64) + sizeof(u8))
-			return -EINVAL;	/* input overrun */
-
-		/* We assume there's always only a single, standard frame. */
-		if (le32_to_cpu(h->magic) != LZ4F_MAGIC || h->version != 1)
-			return -EPROTONOSUPPORT;	/* unknown format */
-		if (h->reserved0 || h->reserved1 || h->reserved2)
-			return -EINVAL;	/* reserved must be zero */
-		if (!h->independent_blocks)
-			return -EPROTONOSUPPORT; /* we can't support this yet */
-		has_block_checksum = h->has_block_checksum;
-
-		in += sizeof(*h);
-		if (h->has_content_size)
-			in += sizeof(u64);
-		in += sizeof(u8);
-	}
+	/* With in-place decompression the header may become invalid later. */
+	ret = lz4_parse_frame_header(in, srcn, &has_block_checksum,
+				     &block_max);
+	if (ret < 0)
+		return ret;
+	in += ret;
 
 	while (1) {
 		struct lz4_block_header b;
@@ -136,3 +159,99 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 	*dstn = out - dst;
 	return ret;
 }
+
+int ulz4fn_block(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	int ret;
+
+	/* constant folding essential, do not touch params! */
+	ret = LZ4_decompress_generic(src, dst, srcn, *dstn, endOnInputSize,
+				     full, 0, noDict, dst, NULL, 0);
+	if (ret < 0) {
+		*dstn = 0;
+		return -EPROTO;
+	}
+
+	*dstn = ret;
+	return 0;
+}
+
+int ulz4fn_stream(const void *src, size_t srcn,
+		  int (*consume)(void *priv, const void *buf, size_t len),
+		  void *priv)
+{
+	const void *in = src;
+	int has_block_checksum;
+	size_t block_max, fill = 0, size;
+	void *buf, *out;
+	int ret;
+
+	ret = lz4_parse_frame_header(in, srcn, &has_block_checksum,
+				     &block_max);
+	if (ret < 0)
+		return ret;
+	in += ret;
+
+	/* Room for one block plus the bytes carried over from the last one */
+	buf = malloc_cache_aligned(block_max + sizeof(u32));
+	if (!buf)
+		return -ENOMEM;
+
+	while (1) {
+		struct lz4_block_header b;
+
+		b.raw = le32_to_cpu(*(u32 *)in);
+		in += sizeof(struct lz4_block_header);
+
+		if (in - src + b.size > srcn) {
+			ret = -EINVAL;		/* input overrun */
+			break;
+		}
+
+		if (!b.size) {
+			ret = 0;	/* decompression successful */
+			break;
+		}
+
+		out = buf + fill;
+		if (b.not_compressed) {
+			if (b.size > block_max) {
+				ret = -ENOBUFS;	/* output overrun */
+				break;
+			}
+			memcpy(out, in, b.size);
+			fill += b.size;
+		} else {
+			/* constant folding essential, do not touch params! */
+			ret = LZ4_decompress_generic(in, out, b.size,
+					block_max, endOnInputSize,
+					full, 0, noDict, out, NULL, 0);
+			if (ret < 0) {
+				ret = -EPROTO;	/* decompression error */
+				break;
+			}
+			fill += ret;
+		}
+
+		/* Pass on whole words, keep the tail for the next block */
+		size = fill & ~(sizeof(u32) - 1);
+		if (size) {
+			ret = consume(priv, buf, size);
+			if (ret)
+				break;
+			memmove(buf, buf + size, fill - size);
+			fill -= size;
+		}
+
+		in += b.size;
+		if (has_block_checksum)
+			in += sizeof(u32);
+		WATCHDOG_RESET();
+	}
+
+	if (!ret && fill)
+		ret = consume(priv, buf, fill);
+
+	free(buf);
+	return ret;
+}
@@ -0,0 +1,1320 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Zstandard decompression
+ *
+ * A decoder for the frame format described in RFC 8878. Dictionaries are
+ * not supported. Each frame is decoded one block at a time, either
+ * straight into the caller's buffer or, for zstd_decompress_stream(), into
+ * a buffer holding only the window of the frame, from which the output is
+ * handed over after every block.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <asm/unaligned.h>
+#include <linux/bitops.h>
+#include <linux/errno.h>
+
+#define ZSTD_MAGIC			0xfd2fb528
+#define ZSTD_SKIPPABLE_MAGIC		0x184d2a50
+#define ZSTD_SKIPPABLE_MASK		0xfffffff0
+
+#define ZSTD_BLOCK_MAX			(128 * 1024)
+#define ZSTD_WINDOW_LOG_MIN		10
+#define ZSTD_WINDOW_LOG_MAX		31
+
+enum {
+	ZSTD_BLOCK_RAW,
+	ZSTD_BLOCK_RLE,
+	ZSTD_BLOCK_COMPRESSED,
+	ZSTD_BLOCK_RESERVED,
+};
+
+enum {
+	ZSTD_LIT_RAW,
+	ZSTD_LIT_RLE,
+	ZSTD_LIT_COMPRESSED,
+	ZSTD_LIT_TREELESS,
+};
+
+enum {
+	ZSTD_MODE_PREDEFINED,
+	ZSTD_MODE_RLE,
+	ZSTD_MODE_FSE,
+	ZSTD_MODE_REPEAT,
+};
+
+#define HUF_LOG_MAX			11
+#define HUF_WEIGHT_LOG_MAX		6
+#define HUF_SYMBOLS_MAX			256
+
+#define LL_LOG_MAX			9
+#define ML_LOG_MAX			9
+#define OF_LOG_MAX			8
+#define LL_SYMBOL_MAX			35
+#define ML_SYMBOL_MAX			52
+#define OF_SYMBOL_MAX			31
+#define FSE_SYMBOL_MAX			ML_SYMBOL_MAX
+
+struct fse_entry {
+	u16 new_state;
+	u8 symbol;
+	u8 nbits;
+};
+
+struct huf_entry {
+	u8 symbol;
+	u8 nbits;
+};
+
+struct fse_table {
+	struct fse_entry *entries;
+	unsigned int log;
+	bool valid;
+};
+
+struct xxh64_state {
+	u64 total_len;
+	u64 v[4];
+	u8 mem[32];
+	unsigned int memsize;
+};
+
+/* Decoder state, kept between the blocks of a frame */
+struct zstd_dctx {
+	struct huf_entry huf[1 << HUF_LOG_MAX];
+	unsigned int huf_log;
+	bool huf_valid;
+
+	struct fse_entry ll_entries[1 << LL_LOG_MAX];
+	struct fse_entry of_entries[1 << OF_LOG_MAX];
+	struct fse_entry ml_entries[1 << ML_LOG_MAX];
+	struct fse_table ll, of, ml;
+
+	u32 rep[3];
+	struct xxh64_state xxh;
+	u8 literals[ZSTD_BLOCK_MAX];
+};
+
+struct zstd_frame {
+	u64 window_size;
+	u64 content_size;
+	bool has_content_size;
+	bool checksum;
+};
+
+/* Where a frame is decoded to */
+struct zstd_out {
+	u8 *buf;	/* start of the buffer */
+	u8 *base;	/* oldest byte matches may refer to */
+	u8 *op;		/* next byte to write */
+	u8 *end;	/* end of the buffer */
+	/* streaming only */
+	u8 *flushed;	/* first byte not yet passed to @consume */
+	size_t window;
+	int (*consume)(void *priv, const void *buf, size_t len);
+	void *priv;
+};
+
+/* Baselines and extra bits of literal length codes 16 to 35 */
+static const u32 ll_base[] = {
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048,
+	4096, 8192, 16384, 32768, 65536,
+};
+
+static const u8 ll_bits[] = {
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+/* Baselines and extra bits of match length codes 32 to 52 */
+static const u32 ml_base[] = {
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+	4099, 8195, 16387, 32771, 65539,
+};
+
+static const u8 ml_bits[] = {
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+static const s16 ll_default[LL_SYMBOL_MAX + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2,
+	2, 3, 2, 1, 1, 1, 1, 1, -1, -1, -1, -1,
+};
+
+static const s16 ml_default[ML_SYMBOL_MAX + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1,
+	-1, -1, -1, -1, -1, -1,
+};
+
+static const s16 of_default[] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1, -1,
+};
+
+#define PRIME64_1	11400714785074694791ULL
+#define PRIME64_2	14029467366897019727ULL
+#define PRIME64_3	1609587929392839161ULL
+#define PRIME64_4	9650029242287828579ULL
+#define PRIME64_5	2870177450012600261ULL
+
+static u64 rotl64(u64 x, unsigned int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static u64 xxh64_round(u64 acc, u64 input)
+{
+	acc += input * PRIME64_2;
+	acc = rotl64(acc, 31);
+
+	return acc * PRIME64_1;
+}
+
+static u64 xxh64_merge_round(u64 acc, u64 val)
+{
+	acc ^= xxh64_round(0, val);
+
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+static void xxh64_reset(struct xxh64_state *state)
+{
+	memset(state, '\0', sizeof(*state));
+	state->v[0] = PRIME64_1 + PRIME64_2;
+	state->v[1] = PRIME64_2;
+	state->v[2] = 0;
+	state->v[3] = -PRIME64_1;
+}
+
+static void xxh64_update(struct xxh64_state *state, const u8 *p, size_t len)
+{
+	const u8 *end = p + len;
+	unsigned int i, n;
+	u64 val;
+
+	state->total_len += len;
+
+	if (state->memsize) {
+		n = min_t(size_t, len, 32 - state->memsize);
+		memcpy(state->mem + state->memsize, p, n);
+		state->memsize += n;
+		p += n;
+		if (state->memsize < 32)
+			return;
+		for (i = 0; i < 4; i++) {
+			val = get_unaligned_le64(state->mem + i * 8);
+			state->v[i] = xxh64_round(state->v[i], val);
+		}
+		state->memsize = 0;
+	}
+
+	for (; p + 32 <= end; p += 32) {
+		for (i = 0; i < 4; i++) {
+			val = get_unaligned_le64(p + i * 8);
+			state->v[i] = xxh64_round(state->v[i], val);
+		}
+	}
+
+	if (p < end) {
+		memcpy(state->mem, p, end - p);
+		state->memsize = end - p;
+	}
+}
+
+static u64 xxh64_digest(const struct xxh64_state *state)
+{
+	const u8 *p = state->mem;
+	const u8 *end = p + state->memsize;
+	unsigned int i;
+	u64 h;
+
+	if (state->total_len >= 32) {
+		h = rotl64(state->v[0], 1) + rotl64(state->v[1], 7) +
+		    rotl64(state->v[2], 12) + rotl64(state->v[3], 18);
+		for (i = 0; i < 4; i++)
+			h = xxh64_merge_round(h, state->v[i]);
+	} else {
+		h = state->v[2] + PRIME64_5;
+	}
+	h += state->total_len;
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= xxh64_round(0, get_unaligned_le64(p));
+		h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if (p + 4 <= end) {
+		h ^= (u64)get_unaligned_le32(p) * PRIME64_1;
+		h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= *p * PRIME64_5;
+		h = rotl64(h, 11) * PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+/*
+ * Backward bit stream, as used by the Huffman and FSE coded sections. The
+ * stream is read from its last byte towards its first, starting below the
+ * highest set bit of the last byte.
+ */
+struct bitrd {
+	u64 container;
+	unsigned int consumed;	/* bits used from the top of container */
+	const u8 *ptr;		/* where container was loaded from */
+	const u8 *start;
+};
+
+static int bitrd_init(struct bitrd *br, const u8 *src, size_t size)
+{
+	unsigned int i;
+	u8 last;
+
+	if (!size)
+		return -EINVAL;
+	last = src[size - 1];
+	if (!last)
+		return -EINVAL;
+
+	br->start = src;
+	if (size >= 8) {
+		br->ptr = src + size - 8;
+		br->container = get_unaligned_le64(br->ptr);
+		br->consumed = 9 - fls(last);
+	} else {
+		br->ptr = src;
+		br->container = 0;
+		for (i = 0; i < size; i++)
+			br->container |= (u64)src[i] << (i * 8);
+		br->consumed = 9 - fls(last) + (8 - size) * 8;
+	}
+
+	return 0;
+}
+
+/* Refill the container so that at least 57 bits can be read */
+static void bitrd_reload(struct bitrd *br)
+{
+	unsigned int nbytes;
+
+	if (br->consumed > 64 || br->ptr == br->start)
+		return;
+
+	nbytes = br->consumed >> 3;
+	if (nbytes > br->ptr - br->start)
+		nbytes = br->ptr - br->start;
+	br->ptr -= nbytes;
+	br->consumed -= nbytes * 8;
+	br->container = get_unaligned_le64(br->ptr);
+}
+
+static inline unsigned int bitrd_peek(const struct bitrd *br, unsigned int n)
+{
+	if (br->consumed >= 64)
+		return 0;
+
+	return (br->container << br->consumed) >> (64 - n);
+}
+
+static inline u32 bitrd_read(struct bitrd *br, unsigned int n)
+{
+	u32 val;
+
+	if (!n)
+		return 0;
+	val = bitrd_peek(br, n);
+	br->consumed += n;
+
+	return val;
+}
+
+static inline bool bitrd_overflow(const struct bitrd *br)
+{
+	return br->consumed > 64;
+}
+
+/* Check that exactly all the bits of the stream have been read */
+static inline bool bitrd_finished(const struct bitrd *br)
+{
+	return br->ptr == br->start && br->consumed == 64;
+}
+
+/* Read bits from a forward stream, zeros past the end */
+static u32 fwd_bits(const u8 *src, size_t size, u32 pos, unsigned int n)
+{
+	u32 byte = pos >> 3;
+	u64 val = 0;
+	unsigned int i;
+
+	for (i = 0; i < 5 && byte + i < size; i++)
+		val |= (u64)src[byte + i] << (i * 8);
+
+	return (val >> (pos & 7)) & ((1U << n) - 1);
+}
+
+/*
+ * Read an FSE table description: the normalised probability of each
+ * symbol. Returns the number of bytes used, or -ve on error.
+ */
+static int fse_read_ncount(const u8 *src, size_t size, s16 *norm,
+			   unsigned int *max_sym, unsigned int *log,
+			   unsigned int max_log)
+{
+	unsigned int sym = 0, nbits, n0, r;
+	int remaining, threshold, max, count;
+	bool prev0 = false;
+	u32 pos = 0, val;
+
+	if (!size)
+		return -EINVAL;
+
+	*log = fwd_bits(src, size, pos, 4) + 5;
+	pos += 4;
+	if (*log > max_log)
+		return -EINVAL;
+
+	remaining = (1 << *log) + 1;
+	threshold = 1 << *log;
+	nbits = *log + 1;
+
+	while (remaining > 1 && sym <= *max_sym) {
+		if (prev0) {
+			n0 = sym;
+			do {
+				r = fwd_bits(src, size, pos, 2);
+				pos += 2;
+				n0 += r;
+			} while (r == 3 && pos <= size * 8);
+			if (n0 > *max_sym)
+				return -EINVAL;
+			while (sym < n0)
+				norm[sym++] = 0;
+		}
+
+		max = 2 * threshold - 1 - remaining;
+		val = fwd_bits(src, size, pos, nbits);
+		if ((val & (threshold - 1)) < max) {
+			count = val & (threshold - 1);
+			pos += nbits - 1;
+		} else {
+			count = val & (2 * threshold - 1);
+			if (count >= threshold)
+				count -= max;
+			pos += nbits;
+		}
+
+		/* A value of 0 stands for probability "less than one" */
+		count--;
+		remaining -= count < 0 ? -count : count;
+		norm[sym++] = count;
+		prev0 = !count;
+		while (remaining < threshold) {
+			nbits--;
+			threshold >>= 1;
+		}
+	}
+
+	if (remaining != 1 || pos > size * 8)
+		return -EINVAL;
+	*max_sym = sym - 1;
+
+	return (pos + 7) >> 3;
+}
+
+static int fse_build(struct fse_table *table, const s16 *norm,
+		     unsigned int max_sym, unsigned int log)
+{
+	struct fse_entry *dt = table->entries;
+	unsigned int size = 1 << log;
+	unsigned int high = size - 1;
+	unsigned int step = (size >> 1) + (size >> 3) + 3;
+	unsigned int pos = 0, s, i, nbits;
+	u16 next[FSE_SYMBOL_MAX + 1];
+	u16 n;
+
+	for (s = 0; s <= max_sym; s++) {
+		if (norm[s] == -1) {
+			dt[high--].symbol = s;
+			next[s] = 1;
+		} else {
+			next[s] = norm[s];
+		}
+	}
+
+	for (s = 0; s <= max_sym; s++) {
+		if (norm[s] <= 0)
+			continue;
+		for (i = 0; i < norm[s]; i++) {
+			dt[pos].symbol = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+	if (pos)
+		return -EINVAL;
+
+	for (i = 0; i < size; i++) {
+		n = next[dt[i].symbol]++;
+		nbits = log - (fls(n) - 1);
+		dt[i].nbits = nbits;
+		dt[i].new_state = (n << nbits) - size;
+	}
+	table->log = log;
+	table->valid = true;
+
+	return 0;
+}
+
+static void fse_build_rle(struct fse_table *table, u8 symbol)
+{
+	table->entries[0].symbol = symbol;
+	table->entries[0].nbits = 0;
+	table->entries[0].new_state = 0;
+	table->log = 0;
+	table->valid = true;
+}
+
+static inline unsigned int fse_symbol(const struct fse_table *table,
+				      unsigned int state)
+{
+	return table->entries[state].symbol;
+}
+
+static inline unsigned int fse_update(const struct fse_table *table,
+				      unsigned int state, struct bitrd *br)
+{
+	const struct fse_entry *e = &table->entries[state];
+
+	return e->new_state + bitrd_read(br, e->nbits);
+}
+
+/* Decode the FSE compressed Huffman weights, two interleaved states */
+static int huf_read_fse_weights(const u8 *src, size_t size, u8 *weights)
+{
+	struct fse_entry entries[1 << HUF_WEIGHT_LOG_MAX];
+	struct fse_table table = { .entries = entries };
+	unsigned int max_sym = HUF_LOG_MAX, log, s1, s2, n = 0;
+	s16 norm[HUF_LOG_MAX + 1];
+	struct bitrd br;
+	int ret;
+
+	ret = fse_read_ncount(src, size, norm, &max_sym, &log,
+			      HUF_WEIGHT_LOG_MAX);
+	if (ret < 0)
+		return ret;
+	if (fse_build(&table, norm, max_sym, log) ||
+	    bitrd_init(&br, src + ret, size - ret))
+		return -EINVAL;
+
+	s1 = bitrd_read(&br, log);
+	s2 = bitrd_read(&br, log);
+	for (;;) {
+		if (n + 2 > HUF_SYMBOLS_MAX - 1)
+			return -EINVAL;
+
+		weights[n++] = fse_symbol(&table, s1);
+		s1 = fse_update(&table, s1, &br);
+		bitrd_reload(&br);
+		if (bitrd_overflow(&br)) {
+			weights[n++] = fse_symbol(&table, s2);
+			break;
+		}
+
+		weights[n++] = fse_symbol(&table, s2);
+		s2 = fse_update(&table, s2, &br);
+		bitrd_reload(&br);
+		if (bitrd_overflow(&br)) {
+			weights[n++] = fse_symbol(&table, s1);
+			break;
+		}
+	}
+
+	return n;
+}
+
+/* Read a Huffman tree description, returning the number of bytes used */
+static int huf_read_table(struct zstd_dctx *dc, const u8 *src, size_t size)
+{
+	unsigned int rank_count[HUF_LOG_MAX + 2] = { 0 };
+	unsigned int rank_start[HUF_LOG_MAX + 2];
+	unsigned int nweights, max_bits, rest, i, j, w, pos, len;
+	u8 weights[HUF_SYMBOLS_MAX];
+	struct huf_entry e;
+	u32 sum = 0;
+	int ret, used;
+
+	if (!size)
+		return -EINVAL;
+
+	if (src[0] >= 128) {
+		nweights = src[0] - 127;
+		used = 1 + (nweights + 1) / 2;
+		if (used > size)
+			return -EINVAL;
+		for (i = 0; i < nweights; i++)
+			weights[i] = i & 1 ? src[1 + i / 2] & 0xf :
+				     src[1 + i / 2] >> 4;
+	} else {
+		used = 1 + src[0];
+		if (used > size)
+			return -EINVAL;
+		ret = huf_read_fse_weights(src + 1, src[0], weights);
+		if (ret < 0)
+			return ret;
+		nweights = ret;
+	}
+
+	for (i = 0; i < nweights; i++) {
+		if (weights[i] > HUF_LOG_MAX)
+			return -EINVAL;
+		if (weights[i])
+			sum += 1 << (weights[i] - 1);
+	}
+	if (!sum)
+		return -EINVAL;
+
+	/* The weight of the last symbol brings the total to a power of 2 */
+	max_bits = fls(sum);
+	if (max_bits > HUF_LOG_MAX)
+		return -EINVAL;
+	rest = (1 << max_bits) - sum;
+	if (rest & (rest - 1))
+		return -EINVAL;
+	weights[nweights++] = fls(rest);
+
+	for (i = 0; i < nweights; i++)
+		rank_count[weights[i]]++;
+	pos = 0;
+	for (w = 1; w <= max_bits; w++) {
+		rank_start[w] = pos;
+		pos += rank_count[w] << (w - 1);
+	}
+
+	for (i = 0; i < nweights; i++) {
+		w = weights[i];
+		if (!w)
+			continue;
+		len = 1 << (w - 1);
+		e.symbol = i;
+		e.nbits = max_bits + 1 - w;
+		for (j = 0; j < len; j++)
+			dc->huf[rank_start[w] + j] = e;
+		rank_start[w] += len;
+	}
+	dc->huf_log = max_bits;
+	dc->huf_valid = true;
+
+	return used;
+}
+
+static int huf_decode_stream(struct zstd_dctx *dc, const u8 *src,
+			     size_t size, u8 *dst, size_t len)
+{
+	unsigned int log = dc->huf_log;
+	const struct huf_entry *e;
+	struct bitrd br;
+	size_t i;
+
+	if (bitrd_init(&br, src, size))
+		return -EINVAL;
+
+	for (i = 0; i < len; i++) {
+		/* Symbols are at most 11 bits, so four fit in a refill */
+		if (!(i & 3))
+			bitrd_reload(&br);
+		e = &dc->huf[bitrd_peek(&br, log)];
+		dst[i] = e->symbol;
+		br.consumed += e->nbits;
+	}
+
+	return bitrd_finished(&br) ? 0 : -EINVAL;
+}
+
+/*
+ * Decode the literals section of a block. On success *lit points to the
+ * literals and *nlit is their count; the number of bytes used is returned.
+ */
+static int zstd_literals(struct zstd_dctx *dc, const u8 *src, size_t size,
+			 const u8 **lit, size_t *nlit)
+{
+	unsigned int type, format, hsize, bits, i;
+	size_t regen, csize, seg, ssize[4];
+	const u8 *p, *end;
+	u64 h;
+	int ret;
+
+	if (!size)
+		return -EINVAL;
+	type = src[0] & 3;
+	format = (src[0] >> 2) & 3;
+
+	if (type == ZSTD_LIT_RAW || type == ZSTD_LIT_RLE) {
+		switch (format) {
+		case 1:
+			hsize = 2;
+			break;
+		case 3:
+			hsize = 3;
+			break;
+		default:
+			hsize = 1;
+			break;
+		}
+		if (hsize > size)
+			return -EINVAL;
+		if (hsize == 1)
+			regen = src[0] >> 3;
+		else if (hsize == 2)
+			regen = (src[0] >> 4) | (src[1] << 4);
+		else
+			regen = (src[0] >> 4) | (src[1] << 4) | (src[2] << 12);
+		if (regen > ZSTD_BLOCK_MAX)
+			return -EINVAL;
+
+		*nlit = regen;
+		if (type == ZSTD_LIT_RAW) {
+			if (hsize + regen > size)
+				return -EINVAL;
+			*lit = src + hsize;
+			return hsize + regen;
+		}
+
+		if (hsize + 1 > size)
+			return -EINVAL;
+		memset(dc->literals, src[hsize], regen);
+		*lit = dc->literals;
+		return hsize + 1;
+	}
+
+	hsize = format < 2 ? 3 : format + 2;
+	bits = format < 2 ? 10 : format == 2 ? 14 : 18;
+	if (hsize > size)
+		return -EINVAL;
+	h = 0;
+	for (i = 0; i < hsize; i++)
+		h |= (u64)src[i] << (i * 8);
+	regen = (h >> 4) & ((1 << bits) - 1);
+	csize = (h >> (4 + bits)) & ((1 << bits) - 1);
+	if (regen > ZSTD_BLOCK_MAX || hsize + csize > size)
+		return -EINVAL;
+
+	p = src + hsize;
+	end = p + csize;
+	if (type == ZSTD_LIT_COMPRESSED) {
+		ret = huf_read_table(dc, p, csize);
+		if (ret < 0)
+			return ret;
+		p += ret;
+	} else if (!dc->huf_valid) {
+		return -EINVAL;
+	}
+
+	if (!format) {
+		ret = huf_decode_stream(dc, p, end - p, dc->literals, regen);
+		if (ret)
+			return ret;
+	} else {
+		if (end - p < 6)
+			return -EINVAL;
+		ssize[0] = get_unaligned_le16(p);
+		ssize[1] = get_unaligned_le16(p + 2);
+		ssize[2] = get_unaligned_le16(p + 4);
+		p += 6;
+		if (ssize[0] + ssize[1] + ssize[2] > end - p)
+			return -EINVAL;
+		ssize[3] = end - p - ssize[0] - ssize[1] - ssize[2];
+
+		seg = (regen + 3) / 4;
+		if (3 * seg > regen)
+			return -EINVAL;
+		for (i = 0; i < 4; i++) {
+			ret = huf_decode_stream(dc, p, ssize[i],
+						dc->literals + i * seg,
+						i < 3 ? seg : regen - 3 * seg);
+			if (ret)
+				return ret;
+			p += ssize[i];
+		}
+	}
+
+	*lit = dc->literals;
+	*nlit = regen;
+
+	return hsize + csize;
+}
+
+static int zstd_seq_table(struct fse_table *table, unsigned int mode,
+			  const u8 **src, const u8 *end, const s16 *def,
+			  unsigned int def_max, unsigned int def_log,
+			  unsigned int max_sym, unsigned int max_log)
+{
+	s16 norm[FSE_SYMBOL_MAX + 1];
+	unsigned int log;
+	int ret;
+
+	switch (mode) {
+	case ZSTD_MODE_PREDEFINED:
+		return fse_build(table, def, def_max, def_log);
+	case ZSTD_MODE_RLE:
+		if (*src >= end || **src > max_sym)
+			return -EINVAL;
+		fse_build_rle(table, **src);
+		(*src)++;
+		return 0;
+	case ZSTD_MODE_FSE:
+		ret = fse_read_ncount(*src, end - *src, norm, &max_sym, &log,
+				      max_log);
+		if (ret < 0)
+			return ret;
+		*src += ret;
+		return fse_build(table, norm, max_sym, log);
+	default:
+		return table->valid ? 0 : -EINVAL;
+	}
+}
+
+/* Copy a match, which may overlap the bytes it produces */
+static inline void zstd_copy_match(u8 *op, u32 offset, u32 len)
+{
+	const u8 *match = op - offset;
+
+	if (offset >= len) {
+		memcpy(op, match, len);
+		return;
+	}
+
+	while (len--)
+		*op++ = *match++;
+}
+
+/* Decode the sequences section and execute the sequences */
+static int zstd_sequences(struct zstd_dctx *dc, const u8 *src, size_t size,
+			  const u8 *lit, size_t nlit, struct zstd_out *out,
+			  u8 *oend)
+{
+	const u8 *p = src, *end = src + size, *lit_end = lit + nlit;
+	unsigned int ll_state, of_state, ml_state;
+	unsigned int ll_code, of_code, ml_code;
+	u32 nseq, i, ll, ml, offset, ofv;
+	u8 *op = out->op;
+	struct bitrd br;
+	int ret;
+
+	if (p >= end)
+		return -EINVAL;
+	nseq = *p++;
+	if (nseq >= 128) {
+		if (nseq == 255) {
+			if (end - p < 2)
+				return -EINVAL;
+			nseq = get_unaligned_le16(p) + 0x7f00;
+			p += 2;
+		} else {
+			if (p >= end)
+				return -EINVAL;
+			nseq = ((nseq - 128) << 8) + *p++;
+		}
+	}
+
+	if (nseq) {
+		if (p >= end || (*p & 3))
+			return -EINVAL;
+		ofv = *p++;
+
+		ret = zstd_seq_table(&dc->ll, ofv >> 6, &p, end, ll_default,
+				     LL_SYMBOL_MAX, 6, LL_SYMBOL_MAX,
+				     LL_LOG_MAX);
+		if (!ret)
+			ret = zstd_seq_table(&dc->of, (ofv >> 4) & 3, &p, end,
+					     of_default,
+					     ARRAY_SIZE(of_default) - 1, 5,
+					     OF_SYMBOL_MAX, OF_LOG_MAX);
+		if (!ret)
+			ret = zstd_seq_table(&dc->ml, (ofv >> 2) & 3, &p, end,
+					     ml_default, ML_SYMBOL_MAX, 6,
+					     ML_SYMBOL_MAX, ML_LOG_MAX);
+		if (ret || bitrd_init(&br, p, end - p))
+			return -EINVAL;
+
+		ll_state = bitrd_read(&br, dc->ll.log);
+		of_state = bitrd_read(&br, dc->of.log);
+		ml_state = bitrd_read(&br, dc->ml.log);
+	}
+
+	for (i = 0; i < nseq; i++) {
+		ll_code = fse_symbol(&dc->ll, ll_state);
+		of_code = fse_symbol(&dc->of, of_state);
+		ml_code = fse_symbol(&dc->ml, ml_state);
+
+		bitrd_reload(&br);
+		ofv = (1U << of_code) + bitrd_read(&br, of_code);
+		bitrd_reload(&br);
+		ml = ml_code < 32 ? ml_code + 3 :
+		     ml_base[ml_code - 32] +
+		     bitrd_read(&br, ml_bits[ml_code - 32]);
+		ll = ll_code < 16 ? ll_code :
+		     ll_base[ll_code - 16] +
+		     bitrd_read(&br, ll_bits[ll_code - 16]);
+
+		if (ofv > 3) {
+			offset = ofv - 3;
+			dc->rep[2] = dc->rep[1];
+			dc->rep[1] = dc->rep[0];
+			dc->rep[0] = offset;
+		} else {
+			/* Repeat offsets shift by one after no literals */
+			ofv += !ll;
+			if (ofv == 1) {
+				offset = dc->rep[0];
+			} else {
+				offset = ofv == 4 ? dc->rep[0] - 1 :
+					 dc->rep[ofv - 1];
+				if (ofv != 2)
+					dc->rep[2] = dc->rep[1];
+				dc->rep[1] = dc->rep[0];
+				dc->rep[0] = offset;
+			}
+		}
+
+		if (i + 1 < nseq) {
+			bitrd_reload(&br);
+			ll_state = fse_update(&dc->ll, ll_state, &br);
+			ml_state = fse_update(&dc->ml, ml_state, &br);
+			of_state = fse_update(&dc->of, of_state, &br);
+		}
+
+		if (ll > lit_end - lit)
+			return -EINVAL;
+		if (ll + ml > oend - op)
+			return -ENOSPC;
+		memcpy(op, lit, ll);
+		op += ll;
+		lit += ll;
+
+		if (!offset || offset > op - out->base)
+			return -EINVAL;
+		zstd_copy_match(op, offset, ml);
+		op += ml;
+	}
+
+	if (nseq) {
+		bitrd_reload(&br);
+		if (!bitrd_finished(&br))
+			return -EINVAL;
+	}
+
+	if (lit_end - lit > oend - op)
+		return -ENOSPC;
+	memcpy(op, lit, lit_end - lit);
+	op += lit_end - lit;
+	out->op = op;
+
+	return 0;
+}
+
+static int zstd_block(struct zstd_dctx *dc, const u8 *src, size_t size,
+		      struct zstd_out *out)
+{
+	u8 *oend = out->end;
+	const u8 *lit = NULL;
+	size_t nlit = 0;
+	int ret;
+
+	if (oend - out->op > ZSTD_BLOCK_MAX)
+		oend = out->op + ZSTD_BLOCK_MAX;
+
+	ret = zstd_literals(dc, src, size, &lit, &nlit);
+	if (ret < 0)
+		return ret;
+
+	return zstd_sequences(dc, src + ret, size - ret, lit, nlit, out, oend);
+}
+
+/* Parse a frame header, returning its size */
+static int zstd_frame_header(const u8 *src, size_t size, struct zstd_frame *f)
+{
+	static const u8 fcs_size[] = { 0, 2, 4, 8 };
+	static const u8 did_size[] = { 0, 1, 2, 4 };
+	unsigned int desc, single, hsize, fsize, exp;
+	const u8 *p;
+
+	if (size < 5)
+		return -EINVAL;
+	desc = src[4];
+	single = (desc >> 5) & 1;
+	if (desc & 0x08)
+		return -EINVAL;
+	/* Dictionaries are not supported */
+	if (desc & 3)
+		return -EOPNOTSUPP;
+
+	fsize = fcs_size[desc >> 6];
+	if (!fsize && single)
+		fsize = 1;
+	hsize = 5 + !single + did_size[desc & 3] + fsize;
+	if (hsize > size)
+		return -EINVAL;
+
+	p = src + 5;
+	if (!single) {
+		exp = (*p >> 3) + ZSTD_WINDOW_LOG_MIN;
+		if (exp > ZSTD_WINDOW_LOG_MAX)
+			return -EINVAL;
+		f->window_size = (1ULL << exp) +
+				 ((1ULL << exp) >> 3) * (*p & 7);
+		p++;
+	}
+	p += did_size[desc & 3];
+
+	f->has_content_size = fsize != 0;
+	switch (fsize) {
+	case 1:
+		f->content_size = *p;
+		break;
+	case 2:
+		f->content_size = get_unaligned_le16(p) + 256;
+		break;
+	case 4:
+		f->content_size = get_unaligned_le32(p);
+		break;
+	case 8:
+		f->content_size = get_unaligned_le64(p);
+		break;
+	default:
+		f->content_size = 0;
+		break;
+	}
+	if (single)
+		f->window_size = f->content_size;
+	f->checksum = (desc >> 2) & 1;
+
+	return hsize;
+}
+
+/* Hand the decoded bytes over in whole words, and make room for a block */
+static int zstd_stream_flush(struct zstd_out *out, bool last)
+{
+	size_t len = out->op - out->flushed, keep;
+	int ret;
+
+	if (!last)
+		len &= ~3;
+	if (len) {
+		ret = out->consume(out->priv, out->flushed, len);
+		if (ret)
+			return ret;
+		out->flushed += len;
+	}
+
+	if (last || out->end - out->op >= ZSTD_BLOCK_MAX)
+		return 0;
+
+	keep = min_t(size_t, out->window, out->op - out->buf);
+	keep = max_t(size_t, keep, out->op - out->flushed);
+	memmove(out->buf, out->op - keep, keep);
+	out->flushed -= out->op - keep - out->buf;
+	out->op = out->buf + keep;
+	out->base = out->buf;
+
+	return 0;
+}
+
+/* Decode the frame at @src, returning the number of bytes it used */
+static int zstd_frame(struct zstd_dctx *dc, const u8 *src, size_t size,
+		      const struct zstd_frame *f, int hsize,
+		      struct zstd_out *out)
+{
+	const u8 *p = src + hsize, *end = src + size;
+	u64 produced = 0;
+	u32 header, bsize;
+	u8 *start;
+	bool last;
+	int ret;
+
+	dc->huf_valid = false;
+	dc->ll.valid = false;
+	dc->of.valid = false;
+	dc->ml.valid = false;
+	dc->rep[0] = 1;
+	dc->rep[1] = 4;
+	dc->rep[2] = 8;
+	xxh64_reset(&dc->xxh);
+
+	do {
+		if (end - p < 3)
+			return -EINVAL;
+		header = p[0] | (p[1] << 8) | (p[2] << 16);
+		p += 3;
+		last = header & 1;
+		bsize = header >> 3;
+		start = out->op;
+		if (bsize > ZSTD_BLOCK_MAX)
+			return -EINVAL;
+
+		switch ((header >> 1) & 3) {
+		case ZSTD_BLOCK_RAW:
+			if (bsize > end - p)
+				return -EINVAL;
+			if (bsize > out->end - out->op)
+				return -ENOSPC;
+			memcpy(out->op, p, bsize);
+			out->op += bsize;
+			p += bsize;
+			break;
+		case ZSTD_BLOCK_RLE:
+			if (p >= end)
+				return -EINVAL;
+			if (bsize > out->end - out->op)
+				return -ENOSPC;
+			memset(out->op, *p, bsize);
+			out->op += bsize;
+			p++;
+			break;
+		case ZSTD_BLOCK_COMPRESSED:
+			if (bsize > end - p)
+				return -EINVAL;
+			ret = zstd_block(dc, p, bsize, out);
+			if (ret)
+				return ret;
+			p += bsize;
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		produced += out->op - start;
+		if (f->checksum)
+			xxh64_update(&dc->xxh, start, out->op - start);
+		if (out->consume) {
+			ret = zstd_stream_flush(out, false);
+			if (ret)
+				return ret;
+		}
+	} while (!last);
+
+	if (f->has_content_size && produced != f->content_size)
+		return -EINVAL;
+	if (f->checksum) {
+		if (end - p < 4)
+			return -EINVAL;
+		if (get_unaligned_le32(p) != (u32)xxh64_digest(&dc->xxh))
+			return -EBADMSG;
+		p += 4;
+	}
+
+	return p - src;
+}
+
+/* Skip a skippable frame, or return 0 if @src is not one */
+static int zstd_skippable(const u8 *src, size_t size)
+{
+	u32 len;
+
+	if (size < 4 ||
+	    (get_unaligned_le32(src) & ZSTD_SKIPPABLE_MASK) !=
+	    ZSTD_SKIPPABLE_MAGIC)
+		return 0;
+	if (size < 8)
+		return -EINVAL;
+	len = get_unaligned_le32(src + 4);
+	if (len > size - 8)
+		return -EINVAL;
+
+	return 8 + len;
+}
+
+bool zstd_is_compressed(const void *src, size_t srcn)
+{
+	return srcn >= 4 && (get_unaligned_le32(src) == ZSTD_MAGIC ||
+			     (get_unaligned_le32(src) & ZSTD_SKIPPABLE_MASK) ==
+			     ZSTD_SKIPPABLE_MAGIC);
+}
+
+static int zstd_decompress_frame_dctx(struct zstd_dctx *dc, const u8 *src,
+				      size_t *srcn, u8 *dst, size_t *dstn)
+{
+	struct zstd_out out = {
+		.buf = dst,
+		.base = dst,
+		.op = dst,
+		.end = dst + *dstn,
+	};
+	struct zstd_frame f;
+	int ret;
+
+	if (*srcn < 4 || get_unaligned_le32(src) != ZSTD_MAGIC)
+		return -EINVAL;
+	ret = zstd_frame_header(src, *srcn, &f);
+	if (ret < 0)
+		return ret;
+	/* Leave *dstn at the size of @dst to show that it was filled */
+	if (f.has_content_size && f.content_size > *dstn)
+		return -ENOSPC;
+
+	ret = zstd_frame(dc, src, *srcn, &f, ret, &out);
+	if (ret == -ENOSPC)
+		return ret;
+	*dstn = out.op - dst;
+	if (ret < 0)
+		return ret;
+	*srcn = ret;
+
+	return 0;
+}
+
+int zstd_decompress_frame(const void *src, size_t *srcn, void *dst,
+			  size_t *dstn)
+{
+	struct zstd_dctx *dc;
+	int ret;
+
+	dc = malloc(sizeof(*dc));
+	if (!dc)
+		return -ENOMEM;
+	dc->ll.entries = dc->ll_entries;
+	dc->of.entries = dc->of_entries;
+	dc->ml.entries = dc->ml_entries;
+
+	ret = zstd_decompress_frame_dctx(dc, src, srcn, dst, dstn);
+	free(dc);
+
+	return ret;
+}
+
+int zstd_decompress(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	const u8 *p = src, *end = p + srcn;
+	size_t out = 0, len, used;
+	struct zstd_dctx *dc;
+	int ret = -EINVAL;
+
+	dc = malloc(sizeof(*dc));
+	if (!dc)
+		return -ENOMEM;
+	dc->ll.entries = dc->ll_entries;
+	dc->of.entries = dc->of_entries;
+	dc->ml.entries = dc->ml_entries;
+
+	while (p < end) {
+		ret = zstd_skippable(p, end - p);
+		if (ret < 0)
+			break;
+		if (ret) {
+			p += ret;
+			ret = 0;
+			continue;
+		}
+
+		used = end - p;
+		len = *dstn - out;
+		ret = zstd_decompress_frame_dctx(dc, p, &used, (u8 *)dst + out,
+						 &len);
+		out += len;
+		if (ret)
+			break;
+		p += used;
+	}
+	free(dc);
+	*dstn = out;
+
+	return ret;
+}
+
+int zstd_decompress_stream(const void *src, size_t srcn,
+			   int (*consume)(void *priv, const void *buf,
+					  size_t len),
+			   void *priv)
+{
+	const u8 *p = src, *end = p + srcn;
+	struct zstd_out out = {
+		.consume = consume,
+		.priv = priv,
+	};
+	struct zstd_dctx *dc;
+	size_t window, carry, bufsize = 0;
+	struct zstd_frame f;
+	int ret = -EINVAL;
+	u8 *buf;
+
+	dc = malloc(sizeof(*dc));
+	if (!dc)
+		return -ENOMEM;
+	dc->ll.entries = dc->ll_entries;
+	dc->of.entries = dc->of_entries;
+	dc->ml.entries = dc->ml_entries;
+
+	while (p < end) {
+		ret = zstd_skippable(p, end - p);
+		if (ret < 0)
+			break;
+		if (ret) {
+			p += ret;
+			ret = 0;
+			continue;
+		}
+
+		ret = -EINVAL;
+		if (end - p < 4 || get_unaligned_le32(p) != ZSTD_MAGIC)
+			break;
+		ret = zstd_frame_header(p, end - p, &f);
+		if (ret < 0)
+			break;
+
+		window = f.window_size;
+		if (f.has_content_size && f.content_size < window)
+			window = f.content_size;
+		if (window > (1ULL << CONFIG_ZSTD_STREAM_WINDOW_LOG)) {
+			printf("zstd: window of %llu bytes is too large\n",
+			       (unsigned long long)window);
+			ret = -EFBIG;
+			break;
+		}
+
+		/*
+		 * Room for the window, one more block and the bytes of the
+		 * previous frame which did not make up a whole word
+		 */
+		carry = out.op - out.flushed;
+		if (window + ZSTD_BLOCK_MAX + 4 > bufsize) {
+			bufsize = window + ZSTD_BLOCK_MAX + 4;
+			buf = malloc(bufsize);
+			if (!buf) {
+				ret = -ENOMEM;
+				break;
+			}
+			if (carry)
+				memcpy(buf, out.flushed, carry);
+			free(out.buf);
+			out.buf = buf;
+		} else {
+			memmove(out.buf, out.flushed, carry);
+		}
+		out.flushed = out.buf;
+		out.base = out.buf + carry;
+		out.op = out.base;
+		out.end = out.buf + bufsize;
+		out.window = window;
+
+		ret = zstd_frame(dc, p, end - p, &f, ret, &out);
+		if (ret < 0)
+			break;
+		p += ret;
+		ret = 0;
+	}
+	if (!ret && out.op > out.flushed)
+		ret = zstd_stream_flush(&out, true);
+	free(out.buf);
+	free(dc);
+
+	return ret;
+}
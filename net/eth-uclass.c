@@ -141,6 +141,16 @@ unsigned char *eth_get_ethaddr(void)
 	return NULL;
 }
 
+int eth_get_stats(struct udevice *dev, struct eth_stats *stats)
+{
+	if (!eth_get_ops(dev)->get_stats)
+		return -ENOSYS;
+
+	memset(stats, '\0', sizeof(*stats));
+
+	return eth_get_ops(dev)->get_stats(dev, stats);
+}
+
 /* Set active state without calling start on the driver */
 int eth_init_state_only(void)
 {
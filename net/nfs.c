@@ -31,6 +31,9 @@
 #include <net.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <time.h>
+#include <asm/unaligned.h>
+#include <linux/log2.h>
 #include "nfs.h"
 #include "bootp.h"
 
@@ -45,12 +48,58 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* Bytes loaded per hash mark */
+#define NFS_HASH_BYTES	(NFS_READ_SIZE / 2 * 10)
+
+/* Smallest timeout for a READ, once the round trip time is known */
+#define NFS_RTO_MIN	200UL
+
+/*
+ * Replies to reads larger than NFS_READ_SIZE are IP fragments. The whole
+ * reply, with its RPC, UDP and IP headers, must fit in the buffer they are
+ * reassembled in.
+ */
+#if defined(CONFIG_IP_DEFRAG) && defined(CONFIG_NFS_RSIZE)
+# define NFS_RSIZE	CONFIG_NFS_RSIZE
+# define NFS_RSIZE_MAX	(CONFIG_NET_MAXDEFRAG - IP_UDP_HDR_SIZE - \
+			 (sizeof(struct rpc_t) - NFS_READ_SIZE))
+#else
+# define NFS_RSIZE	NFS_READ_SIZE
+# define NFS_RSIZE_MAX	NFS_READ_SIZE
+#endif
+
+#ifdef CONFIG_NFS_READ_WINDOW
+# define NFS_READ_WINDOW CONFIG_NFS_READ_WINDOW
+#else
+# define NFS_READ_WINDOW 1
+#endif
+
+/*
+ * A READ request in flight. Replies are matched to it by their xid, so
+ * they may arrive in any order.
+ */
+struct nfs_read {
+	ulong id;		/* xid of the request, 0 if the slot is free */
+	int offset;		/* file offset asked for */
+	int len;		/* number of bytes asked for */
+	ulong sent;		/* get_timer() value when sent */
+	int retries;		/* number of times it was sent again */
+};
+
 static int fs_mounted;
 static unsigned long rpc_id;
-static int nfs_offset = -1;
-static int nfs_len;
+static int nfs_offset = -1;	/* offset of the next READ to send */
+static int nfs_len;		/* size of each READ */
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+static struct nfs_read nfs_reads[NFS_READ_WINDOW];
+static bool nfs_eof;		/* a reply has shown where the file ends */
+static ulong nfs_read_bytes;	/* bytes stored so far */
+static ulong nfs_hashes;	/* hash marks printed so far */
+static ulong nfs_srtt;		/* smoothed READ round trip time, in ms */
+static ulong nfs_rttvar;	/* its variation */
+static ulong nfs_rto;		/* timeout for a READ, in ms */
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -386,6 +435,128 @@ static void nfs_read_req(int offset, int readlen)
 	rpc_req(PROG_NFS, NFS_READ, data, len);
 }
 
+static void nfs_timeout_handler(void);
+static void nfs_read_timeout_handler(void);
+
+/* Send the READ in a slot, with a new xid */
+static void nfs_read_send(struct nfs_read *rd)
+{
+	nfs_read_req(rd->offset, rd->len);
+	rd->id = rpc_id;
+	rd->sent = get_timer(0);
+}
+
+/* Arrange for nfs_read_timeout_handler() to run at the first deadline */
+static void nfs_read_set_timer(void)
+{
+	ulong now = get_timer(0);
+	ulong at = 0;
+	bool busy = false;
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		struct nfs_read *rd = &nfs_reads[i];
+		ulong deadline = rd->sent + nfs_rto * (rd->retries + 1);
+
+		if (!rd->id)
+			continue;
+		if (!busy || time_before(deadline, at))
+			at = deadline;
+		busy = true;
+	}
+
+	/* A zero interval would cancel the handler, so use 1ms when late */
+	if (busy)
+		net_set_timeout_handler(time_after(at, now) ? at - now : 1,
+					nfs_read_timeout_handler);
+}
+
+/* Send READs for the rest of the file until the window is full */
+static void nfs_read_fill(void)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW && !nfs_eof; i++) {
+		struct nfs_read *rd = &nfs_reads[i];
+
+		if (rd->id)
+			continue;
+		rd->offset = nfs_offset;
+		rd->len = nfs_len;
+		rd->retries = 0;
+		nfs_read_send(rd);
+		nfs_offset += nfs_len;
+	}
+	nfs_read_set_timer();
+}
+
+/* Start reading the file from the beginning */
+static void nfs_read_start(void)
+{
+	memset(nfs_reads, '\0', sizeof(nfs_reads));
+	nfs_offset = 0;
+	nfs_len = NFS_RSIZE;
+	if (nfs_len > NFS_RSIZE_MAX)
+		nfs_len = rounddown_pow_of_two(NFS_RSIZE_MAX);
+	/* NFSv2 cannot read more than this at once */
+	if (supported_nfs_versions & NFSV2_FLAG)
+		nfs_len = min(nfs_len, NFS2_MAXDATA);
+	nfs_eof = false;
+	nfs_read_bytes = 0;
+	nfs_hashes = 0;
+	nfs_srtt = 0;
+	nfs_rttvar = 0;
+	nfs_rto = nfs_timeout;
+	nfs_read_fill();
+}
+
+/* Forget the READs in flight, so that late replies are dropped */
+static void nfs_read_stop(void)
+{
+	memset(nfs_reads, '\0', sizeof(nfs_reads));
+	net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
+}
+
+static struct nfs_read *nfs_read_find(ulong id)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		if (nfs_reads[i].id && nfs_reads[i].id == id)
+			return &nfs_reads[i];
+	}
+
+	return NULL;
+}
+
+static bool nfs_read_busy(void)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		if (nfs_reads[i].id)
+			return true;
+	}
+
+	return false;
+}
+
+/* Update the round trip time estimate, as in RFC 6298 */
+static void nfs_rtt_update(ulong rtt)
+{
+	if (!nfs_srtt) {
+		nfs_srtt = rtt ? rtt : 1;
+		nfs_rttvar = rtt / 2;
+	} else {
+		ulong delta = rtt > nfs_srtt ? rtt - nfs_srtt : nfs_srtt - rtt;
+
+		nfs_rttvar = (3 * nfs_rttvar + delta) / 4;
+		nfs_srtt = (7 * nfs_srtt + rtt) / 8;
+	}
+	nfs_rto = clamp(nfs_srtt + max(4 * nfs_rttvar, 1UL),
+			min(NFS_RTO_MIN, nfs_timeout), nfs_timeout);
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -416,7 +587,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_fill();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -659,20 +830,23 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+/*
+ * Check a READ reply and store its data. The data is copied straight from
+ * the packet, so only the header goes through rpc_pkt and the reply may be
+ * bigger than struct rpc_t. Returns the number
+ * of bytes read, with *eofp set if the server says the file ends there.
+ */
+static int nfs_read_reply(struct nfs_read *rd, uchar *pkt, unsigned int len,
+			  bool *eofp)
 {
 	struct rpc_t rpc_pkt;
 	int rlen;
-	uchar *data_ptr;
+	int data_offset;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
-
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
-		return -NFS_RPC_DROP;
+	memcpy(&rpc_pkt.u.data[0], pkt,
+	       min_t(unsigned int, len, sizeof(rpc_pkt) - NFS_READ_SIZE));
 
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
@@ -685,34 +859,39 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
+	*eofp = false;
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		data_offset = 19;
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
-		/* Skip unused values :
-			EOF:		32 bits value,
+		*eofp = !!rpc_pkt.u.reply.data[2 + nfsv3_data_offset];
+		/* Skip unused value :
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		data_offset = 4 + nfsv3_data_offset;
 	}
+	data_offset = (uchar *)&rpc_pkt.u.reply.data[data_offset] -
+		      (uchar *)&rpc_pkt;
 
-	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
-			return -9999;
+	if (rlen < 0 || rlen > rd->len || data_offset + rlen > len)
+		return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	/* An empty read past the end must not grow the file size */
+	if (rlen && store_block(pkt + data_offset, rd->offset, rlen))
+		return -9999;
+
+	nfs_read_bytes += rlen;
+	while (nfs_hashes < nfs_read_bytes / NFS_HASH_BYTES) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
 
 	return rlen;
 }
@@ -734,18 +913,101 @@ static void nfs_timeout_handler(void)
 	}
 }
 
+/* Send again each READ whose reply is overdue */
+static void nfs_read_timeout_handler(void)
+{
+	ulong now = get_timer(0);
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		struct nfs_read *rd = &nfs_reads[i];
+
+		if (!rd->id ||
+		    time_before(now, rd->sent + nfs_rto * (rd->retries + 1)))
+			continue;
+		if (++rd->retries > NFS_RETRY_COUNT) {
+			puts("\nRetry count exceeded; starting again\n");
+			net_start_again();
+			return;
+		}
+		puts("T ");
+		nfs_read_send(rd);
+	}
+	nfs_read_set_timer();
+}
+
+/* Handle the reply to one of the READs in flight */
+static void nfs_read_handler(uchar *pkt, unsigned int len)
+{
+	struct nfs_read *rd;
+	bool eof;
+	int rlen;
+
+	rd = nfs_read_find(get_unaligned_be32(pkt));
+	if (!rd)
+		return;		/* a late or duplicate reply */
+
+	rlen = nfs_read_reply(rd, pkt, len, &eof);
+	if (rlen == -NFSERR_ISDIR || rlen == -NFSERR_INVAL) {
+		/* symbolic link */
+		nfs_read_stop();
+		nfs_state = STATE_READLINK_REQ;
+		nfs_send();
+		return;
+	} else if (rlen < 0) {
+		debug("NFS READ error (%d)\n", rlen);
+		nfs_read_stop();
+		nfs_state = STATE_UMOUNT_REQ;
+		nfs_send();
+		return;
+	}
+
+	/* Only a reply to the first transmission gives a clear sample */
+	if (!rd->retries)
+		nfs_rtt_update(get_timer(rd->sent));
+
+	if (!rlen || eof) {
+		nfs_eof = true;
+		rd->id = 0;
+	} else if (rlen < rd->len) {
+		/* The server reads less at once: ask for less from now on */
+		nfs_len = min(nfs_len, rlen);
+		rd->offset += rlen;
+		rd->len -= rlen;
+		rd->retries = 0;
+		nfs_read_send(rd);
+	} else {
+		rd->id = 0;
+	}
+
+	if (nfs_eof && !nfs_read_busy()) {
+		nfs_download_state = NETLOOP_SUCCESS;
+		nfs_read_stop();
+		nfs_state = STATE_UMOUNT_REQ;
+		nfs_send();
+		return;
+	}
+	nfs_read_fill();
+}
+
 static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			unsigned src, unsigned len)
 {
-	int rlen;
 	int reply;
 
 	debug("%s\n", __func__);
 
-	if (len > sizeof(struct rpc_t))
+	if (dest != nfs_our_port)
 		return;
 
-	if (dest != nfs_our_port)
+	/* Only READ replies may be larger, and they are checked later */
+	if (nfs_state == STATE_READ_REQ) {
+		if (len >= sizeof(uint32_t))
+			nfs_read_handler(pkt, len);
+		return;
+	}
+
+	if (len > sizeof(struct rpc_t))
 		return;
 
 	switch (nfs_state) {
@@ -809,9 +1071,7 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_send();
 		} else {
 			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			nfs_send();
+			nfs_read_start();
 		}
 		break;
 
@@ -833,27 +1093,6 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 		break;
 
-	case STATE_READ_REQ:
-		rlen = nfs_read_reply(pkt, len);
-		if (rlen == -NFS_RPC_DROP)
-			break;
-		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			nfs_send();
-		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
-			/* symbolic link */
-			nfs_state = STATE_READLINK_REQ;
-			nfs_send();
-		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
-				debug("NFS READ error (%d)\n", rlen);
-			nfs_state = STATE_UMOUNT_REQ;
-			nfs_send();
-		}
-		break;
 	}
 }
 
@@ -38,10 +38,12 @@
 /*
  * Block size used for NFS read accesses.  A RPC reply packet (including  all
  * headers) must fit within a single Ethernet frame to avoid fragmentation.
- * However, if CONFIG_IP_DEFRAG is set, a bigger value could be used.  In any
+ * However, if CONFIG_IP_DEFRAG is set, CONFIG_NFS_RSIZE can ask for more: such
+ * READ replies are not copied into struct rpc_t, so it keeps this size.  In any
  * case, most NFS servers are optimized for a power of 2.
  */
 #define NFS_READ_SIZE	1024	/* biggest power of two that fits Ether frame */
+#define NFS2_MAXDATA	8192	/* largest NFSv2 read */
 #define NFS_MAX_ATTRS	26
 
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
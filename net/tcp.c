@@ -0,0 +1,581 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Minimal TCP client
+ *
+ * This handles a single connection at a time, opened by us, which is all
+ * that downloads need. Data is received in order only: a segment which
+ * is not the next one expected is dropped and answered by an immediate
+ * duplicate ACK, so that the sender retransmits it quickly. In-order data
+ * is handed to the user and acknowledged at once, so the sender never
+ * waits on us to open the window. Our own data is retransmitted from the
+ * first unacknowledged byte when the retransmission timer, which follows
+ * RFC 6298, expires. There is no SACK, no window scaling and no TIME-WAIT
+ * state.
+ */
+
+#include <common.h>
+#include <net.h>
+#include <time.h>
+#include <net/tcp.h>
+
+/* Initial, smallest and largest retransmission timeouts, in ms */
+#define TCP_RTO_INIT		1000
+#define TCP_RTO_MIN		200
+#define TCP_RTO_MAX		10000
+/* Number of retransmissions before giving up */
+#define TCP_RETRIES		8
+/* Time without hearing from the peer before giving up, in ms */
+#define TCP_IDLE_MS		30000
+/* MSS to assume when the peer does not give one (RFC 1122) */
+#define TCP_DEFAULT_MSS		536
+/* Largest window we can advertise, without window scaling */
+#define TCP_MAX_WINDOW		0xffff
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_CLOSING,		/* our FIN is waiting to be sent or acked */
+};
+
+static enum tcp_state tcp_state;
+static const struct tcp_ops *tcp_ops;
+
+static struct in_addr tcp_remote_ip;
+static uchar tcp_remote_ethaddr[ARP_HLEN];
+static int tcp_remote_port;
+static int tcp_our_port;
+
+/* Send sequence space */
+static u32 tcp_iss;
+static u32 tcp_snd_una;		/* first unacknowledged */
+static u32 tcp_snd_nxt;		/* next to send */
+static u32 tcp_snd_max;		/* highest sent so far, plus one */
+static u32 tcp_snd_wnd;		/* peer's receive window */
+static unsigned int tcp_peer_mss;
+
+/* Data being sent, starting at sequence number tcp_tx_seq */
+static const uchar *tcp_tx_data;
+static unsigned int tcp_tx_len;
+static u32 tcp_tx_seq;
+
+/* Receive sequence space */
+static u32 tcp_rcv_nxt;
+static bool tcp_peer_fin;
+
+/* Timers, as get_timer(0) values; a zero deadline is not running */
+static ulong tcp_rtx_at;
+static ulong tcp_last_rx;
+
+/* Round trip time estimate, in ms */
+static ulong tcp_rto;
+static ulong tcp_srtt;
+static ulong tcp_rttvar;
+static ulong tcp_rtt_start;
+static u32 tcp_rtt_seq;
+static bool tcp_rtt_timing;
+static int tcp_retries;
+
+static inline bool seq_lt(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static inline bool seq_gt(u32 a, u32 b)
+{
+	return (s32)(a - b) > 0;
+}
+
+/*
+ * Work out the receive window. Data is handed to the user as it arrives,
+ * so this is limited only by the room the user has left, e.g. in its load
+ * area. Never offer less than a segment: anything after the stored data,
+ * such as the end of a chunked body, must still get through, and the user
+ * reports an overflow itself.
+ */
+static u32 tcp_rx_window(void)
+{
+	u32 win = TCP_MAX_WINDOW;
+
+	if (tcp_ops && tcp_ops->rx_space)
+		win = clamp_t(ulong, tcp_ops->rx_space(), TCP_MSS, win);
+
+	return win;
+}
+
+static unsigned int tcp_checksum(struct in_addr src, struct in_addr dest,
+			     const void *seg, unsigned int len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dest;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} __packed pseudo;
+
+	net_copy_ip(&pseudo.src, &src);
+	net_copy_ip(&pseudo.dest, &dest);
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(len);
+
+	return add_ip_checksums(sizeof(pseudo),
+				compute_ip_checksum(&pseudo, sizeof(pseudo)),
+				compute_ip_checksum(seg, len));
+}
+
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 flags, u32 seq, u32 ack)
+{
+	struct ip_tcp_hdr *ip = (struct ip_tcp_hdr *)pkt;
+	int hdr_len = TCP_HDR_SIZE;
+
+	/* Tell the peer how large a segment we can take */
+	if (flags & TCP_SYN) {
+		uchar *opt = pkt + IP_TCP_HDR_SIZE;
+
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = TCP_OPT_MSS_LEN;
+		opt[2] = TCP_MSS >> 8;
+		opt[3] = TCP_MSS & 0xff;
+		hdr_len += TCP_OPT_MSS_LEN;
+	}
+
+	net_set_ip_header(pkt, dest, net_ip,
+			  IP_HDR_SIZE + hdr_len + payload_len, IPPROTO_TCP);
+
+	ip->tcp_src = htons(sport);
+	ip->tcp_dst = htons(dport);
+	ip->tcp_seq = htonl(seq);
+	ip->tcp_ack = flags & TCP_ACK ? htonl(ack) : 0;
+	ip->tcp_hlen = (hdr_len / 4) << 4;
+	ip->tcp_flags = flags;
+	ip->tcp_win = htons(tcp_rx_window());
+	ip->tcp_xsum = 0;
+	ip->tcp_urg = 0;
+	ip->tcp_xsum = tcp_checksum(net_ip, dest, pkt + IP_HDR_SIZE,
+				    hdr_len + payload_len);
+
+	return IP_HDR_SIZE + hdr_len;
+}
+
+static void tcp_send_segment(u8 flags, u32 seq, const uchar *data,
+			     unsigned int len)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_TCP_HDR_SIZE;
+
+	if (len)
+		memcpy(pkt, data, len);
+	net_send_ip_packet(tcp_remote_ethaddr, tcp_remote_ip, tcp_remote_port,
+			   tcp_our_port, len, IPPROTO_TCP, flags, seq,
+			   tcp_rcv_nxt);
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+/* Sequence number just past our data, where the FIN goes */
+static u32 tcp_tx_end(void)
+{
+	return tcp_tx_seq + tcp_tx_len;
+}
+
+/* Check whether we have anything not yet acknowledged by the peer */
+static bool tcp_outstanding(void)
+{
+	u32 end = tcp_tx_end();
+
+	if (tcp_state == TCP_CLOSING)
+		end++;
+
+	return tcp_state == TCP_SYN_SENT || seq_lt(tcp_snd_una, end);
+}
+
+/* Send whatever the peer's window allows */
+static void tcp_output(void)
+{
+	u32 end = tcp_tx_end();
+	u32 wnd_end = tcp_snd_una + tcp_snd_wnd;
+
+	while (seq_lt(tcp_snd_nxt, end) && seq_lt(tcp_snd_nxt, wnd_end)) {
+		/* Compare distances, the sequence numbers may wrap */
+		unsigned int len = min(end - tcp_snd_nxt,
+				       wnd_end - tcp_snd_nxt);
+		u8 flags = TCP_ACK;
+
+		if (len > tcp_peer_mss)
+			len = tcp_peer_mss;
+		if (tcp_snd_nxt + len == end)
+			flags |= TCP_PSH;
+		tcp_send_segment(flags, tcp_snd_nxt,
+				 tcp_tx_data + (tcp_snd_nxt - tcp_tx_seq), len);
+		if (!tcp_rtt_timing) {
+			tcp_rtt_timing = true;
+			tcp_rtt_seq = tcp_snd_nxt + len;
+			tcp_rtt_start = get_timer(0);
+		}
+		tcp_snd_nxt += len;
+	}
+
+	if (tcp_state == TCP_CLOSING && tcp_snd_nxt == end) {
+		tcp_send_segment(TCP_FIN | TCP_ACK, end, NULL, 0);
+		tcp_snd_nxt++;
+	}
+
+	if (seq_gt(tcp_snd_nxt, tcp_snd_max))
+		tcp_snd_max = tcp_snd_nxt;
+	if (!tcp_rtx_at && tcp_outstanding())
+		tcp_rtx_at = get_timer(0) + tcp_rto;
+}
+
+static void tcp_timeout(void);
+
+/* Arrange for tcp_timeout() to run at the first deadline */
+static void tcp_set_timer(void)
+{
+	ulong now = get_timer(0);
+	ulong at = tcp_last_rx + TCP_IDLE_MS;
+
+	if (tcp_state == TCP_CLOSED) {
+		net_set_timeout_handler(0, NULL);
+		return;
+	}
+	if (tcp_rtx_at && time_before(tcp_rtx_at, at))
+		at = tcp_rtx_at;
+
+	/* A zero interval would cancel the handler, so use 1ms when late */
+	net_set_timeout_handler(time_after(at, now) ? at - now : 1,
+				tcp_timeout);
+}
+
+/* The connection has gone: tell the user */
+static void tcp_finish(int err)
+{
+	debug_cond(err, "TCP: connection closed: %d\n", err);
+	tcp_state = TCP_CLOSED;
+	net_set_timeout_handler(0, NULL);
+	if (tcp_ops && tcp_ops->closed)
+		tcp_ops->closed(err);
+}
+
+/* Reset the connection because of an error on our side */
+static void tcp_abort(int err)
+{
+	if (tcp_state != TCP_SYN_SENT)
+		tcp_send_segment(TCP_RST | TCP_ACK, tcp_snd_nxt, NULL, 0);
+	tcp_finish(err);
+}
+
+static void tcp_timeout(void)
+{
+	ulong now = get_timer(0);
+
+	if (tcp_rtx_at && time_after_eq(now, tcp_rtx_at)) {
+		if (++tcp_retries > TCP_RETRIES) {
+			tcp_abort(-ETIMEDOUT);
+			return;
+		}
+		/* Back off, and stop timing: the sample would be ambiguous */
+		tcp_rto = min(tcp_rto * 2, (ulong)TCP_RTO_MAX);
+		tcp_rtt_timing = false;
+		tcp_rtx_at = 0;
+
+		if (tcp_state == TCP_SYN_SENT) {
+			tcp_send_segment(TCP_SYN, tcp_iss, NULL, 0);
+			tcp_rtx_at = now + tcp_rto;
+		} else {
+			debug("TCP: retransmitting from %u\n",
+			      tcp_snd_una - tcp_iss);
+			/* Go back to the first unacked byte; also probe a
+			 * closed window
+			 */
+			tcp_snd_nxt = tcp_snd_una;
+			if (!tcp_snd_wnd)
+				tcp_snd_wnd = 1;
+			tcp_output();
+		}
+	} else if (time_after_eq(now, tcp_last_rx + TCP_IDLE_MS)) {
+		tcp_abort(-ETIMEDOUT);
+		return;
+	}
+
+	tcp_set_timer();
+}
+
+/* Update the round trip time estimate, as in RFC 6298 */
+static void tcp_rtt_update(ulong rtt)
+{
+	if (!tcp_srtt) {
+		tcp_srtt = rtt ? rtt : 1;
+		tcp_rttvar = rtt / 2;
+	} else {
+		ulong delta = rtt > tcp_srtt ? rtt - tcp_srtt : tcp_srtt - rtt;
+
+		tcp_rttvar = (3 * tcp_rttvar + delta) / 4;
+		tcp_srtt = (7 * tcp_srtt + rtt) / 8;
+	}
+	tcp_rto = clamp(tcp_srtt + max(4 * tcp_rttvar, 1UL),
+			(ulong)TCP_RTO_MIN, (ulong)TCP_RTO_MAX);
+}
+
+static void tcp_parse_options(const uchar *opt, int len)
+{
+	while (len > 0) {
+		if (opt[0] == TCP_OPT_END)
+			break;
+		if (opt[0] == TCP_OPT_NOP) {
+			opt++;
+			len--;
+			continue;
+		}
+		if (len < 2 || opt[1] < 2 || opt[1] > len)
+			break;
+		if (opt[0] == TCP_OPT_MSS && opt[1] == TCP_OPT_MSS_LEN) {
+			tcp_peer_mss = clamp(opt[2] << 8 | opt[3], 64,
+					     (int)TCP_MSS);
+		}
+		len -= opt[1];
+		opt += opt[1];
+	}
+}
+
+/* Handle the ACK field of a segment */
+static void tcp_ack_received(u32 ack, u32 win)
+{
+	if (seq_gt(ack, tcp_snd_max)) {
+		/* It acks something we never sent */
+		tcp_send_ack();
+		return;
+	}
+	tcp_snd_wnd = win;
+
+	if (seq_gt(ack, tcp_snd_una)) {
+		if (tcp_rtt_timing && !seq_lt(ack, tcp_rtt_seq)) {
+			tcp_rtt_update(get_timer(tcp_rtt_start));
+			tcp_rtt_timing = false;
+		}
+		tcp_snd_una = ack;
+		if (seq_lt(tcp_snd_nxt, ack))
+			tcp_snd_nxt = ack;
+		tcp_retries = 0;
+		tcp_rtx_at = 0;
+
+		if (tcp_state == TCP_CLOSING && ack == tcp_tx_end() + 1) {
+			tcp_finish(0);
+			return;
+		}
+	}
+
+	tcp_output();
+}
+
+/* Handle the data and FIN of a segment */
+static void tcp_data_received(u32 seq, const uchar *data, unsigned int len,
+			      bool fin)
+{
+	if (!len && !fin)
+		return;
+
+	if (seq != tcp_rcv_nxt || tcp_peer_fin) {
+		u32 old = tcp_rcv_nxt - seq;
+
+		/*
+		 * Out of order, or already seen: the sender learns from the
+		 * duplicate ACK what we are missing
+		 */
+		if (tcp_peer_fin || seq_gt(seq, tcp_rcv_nxt) || old > len ||
+		    (old == len && !fin)) {
+			tcp_send_ack();
+			return;
+		}
+		/* Only the start was seen before */
+		data += old;
+		len -= old;
+	}
+
+	if (len) {
+		tcp_rcv_nxt += len;
+		if (tcp_state == TCP_ESTABLISHED && tcp_ops->receive) {
+			int ret = tcp_ops->receive(data, len);
+
+			if (ret) {
+				tcp_abort(ret);
+				return;
+			}
+		}
+		if (!fin)
+			tcp_send_ack();
+	}
+
+	if (fin) {
+		tcp_rcv_nxt++;
+		tcp_peer_fin = true;
+		/* We have nothing more to say either */
+		if (tcp_state == TCP_ESTABLISHED)
+			tcp_state = TCP_CLOSING;
+		tcp_send_ack();
+		tcp_output();
+	}
+}
+
+void tcp_receive(struct ip_udp_hdr *ipu, int len)
+{
+	struct ip_tcp_hdr *ip = (struct ip_tcp_hdr *)ipu;
+	struct in_addr src;
+	int hdr_len;
+	u32 seq, ack;
+	u8 flags;
+
+	if (tcp_state == TCP_CLOSED || len < IP_TCP_HDR_SIZE)
+		return;
+	hdr_len = (ip->tcp_hlen >> 4) * 4;
+	if (hdr_len < TCP_HDR_SIZE || IP_HDR_SIZE + hdr_len > len)
+		return;
+
+	src = net_read_ip(&ip->ip_src);
+	if (src.s_addr != tcp_remote_ip.s_addr ||
+	    ntohs(ip->tcp_src) != tcp_remote_port ||
+	    ntohs(ip->tcp_dst) != tcp_our_port)
+		return;
+	if (tcp_checksum(src, net_read_ip(&ip->ip_dst),
+			 (uchar *)ip + IP_HDR_SIZE, len - IP_HDR_SIZE)) {
+		debug("TCP: bad checksum\n");
+		return;
+	}
+
+	seq = ntohl(ip->tcp_seq);
+	ack = ntohl(ip->tcp_ack);
+	flags = ip->tcp_flags;
+	tcp_last_rx = get_timer(0);
+
+	if (tcp_state == TCP_SYN_SENT) {
+		if (!(flags & TCP_ACK) || ack != tcp_iss + 1)
+			return;
+		if (flags & TCP_RST) {
+			tcp_finish(-ECONNREFUSED);
+			return;
+		}
+		if (!(flags & TCP_SYN))
+			return;
+
+		tcp_parse_options((uchar *)ip + IP_TCP_HDR_SIZE,
+				  hdr_len - TCP_HDR_SIZE);
+		if (tcp_rtt_timing)
+			tcp_rtt_update(get_timer(tcp_rtt_start));
+		tcp_rtt_timing = false;
+		tcp_rcv_nxt = seq + 1;
+		tcp_snd_una = ack;
+		tcp_snd_nxt = ack;
+		tcp_snd_max = ack;
+		tcp_tx_seq = ack;
+		tcp_snd_wnd = ntohs(ip->tcp_win);
+		tcp_retries = 0;
+		tcp_rtx_at = 0;
+		tcp_state = TCP_ESTABLISHED;
+		debug("TCP: connected to %pI4:%d, mss %u\n", &tcp_remote_ip,
+		      tcp_remote_port, tcp_peer_mss);
+
+		tcp_send_ack();
+		if (tcp_ops->connected)
+			tcp_ops->connected();
+		tcp_set_timer();
+		return;
+	}
+
+	if (flags & TCP_RST) {
+		/* Only believe a reset that is in our window */
+		if (seq - tcp_rcv_nxt < tcp_rx_window())
+			tcp_finish(-ECONNRESET);
+		return;
+	}
+	if (flags & TCP_SYN) {
+		/* Our ACK of the SYN was lost */
+		tcp_send_ack();
+		return;
+	}
+	if (!(flags & TCP_ACK))
+		return;
+
+	tcp_ack_received(ack, ntohs(ip->tcp_win));
+	if (tcp_state == TCP_CLOSED)
+		return;
+	tcp_data_received(seq, (uchar *)ip + IP_HDR_SIZE + hdr_len,
+			  len - IP_HDR_SIZE - hdr_len, flags & TCP_FIN);
+	if (tcp_state != TCP_CLOSED)
+		tcp_set_timer();
+}
+
+void tcp_connect(struct in_addr dest, int dport, const struct tcp_ops *ops)
+{
+	tcp_ops = ops;
+	tcp_remote_ip = dest;
+	tcp_remote_port = dport;
+	tcp_our_port = random_port();
+	memcpy(tcp_remote_ethaddr, net_null_ethaddr, ARP_HLEN);
+
+	tcp_iss = (u32)get_ticks();
+	tcp_snd_una = tcp_iss;
+	tcp_snd_nxt = tcp_iss + 1;
+	tcp_snd_max = tcp_snd_nxt;
+	tcp_snd_wnd = 0;
+	tcp_peer_mss = TCP_DEFAULT_MSS;
+	tcp_tx_data = NULL;
+	tcp_tx_len = 0;
+	tcp_tx_seq = tcp_snd_nxt;
+	tcp_peer_fin = false;
+
+	tcp_srtt = 0;
+	tcp_rttvar = 0;
+	tcp_rto = TCP_RTO_INIT;
+	tcp_retries = 0;
+	tcp_rtt_timing = true;
+	tcp_rtt_start = get_timer(0);
+	tcp_last_rx = tcp_rtt_start;
+	tcp_rtx_at = tcp_rtt_start + tcp_rto;
+
+	tcp_state = TCP_SYN_SENT;
+	tcp_send_segment(TCP_SYN, tcp_iss, NULL, 0);
+	tcp_set_timer();
+}
+
+int tcp_send(const void *data, unsigned int len)
+{
+	if (tcp_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+	if (tcp_snd_una != tcp_tx_end())
+		return -EBUSY;
+
+	tcp_tx_data = data;
+	tcp_tx_len = len;
+	tcp_tx_seq = tcp_snd_una;
+	tcp_output();
+	tcp_set_timer();
+
+	return 0;
+}
+
+void tcp_close(void)
+{
+	switch (tcp_state) {
+	case TCP_SYN_SENT:
+		tcp_state = TCP_CLOSED;
+		net_set_timeout_handler(0, NULL);
+		break;
+	case TCP_ESTABLISHED:
+		tcp_state = TCP_CLOSING;
+		tcp_output();
+		tcp_set_timer();
+		break;
+	default:
+		break;
+	}
+}
+
+void tcp_reset(void)
+{
+	tcp_state = TCP_CLOSED;
+	tcp_ops = NULL;
+}
@@ -78,6 +78,10 @@ static int	timeout_count;
 static ulong	tftp_cur_block;
 /* last packet sequence number received */
 static ulong	tftp_prev_block;
+/* packet sequence number after which the next ACK is due */
+static ulong	tftp_next_ack;
+/* last packet sequence number acknowledged again after a lost packet */
+static ulong	tftp_last_nack;
 /* count of sequence number wraparounds */
 static ulong	tftp_block_wrap;
 /* memory offset due to wrapping */
@@ -140,11 +144,50 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/* default TFTP window size (RFC 7440): one block for each ACK */
+#define TFTP_WINDOW_SIZE	1
+
+static unsigned short tftp_window_size = TFTP_WINDOW_SIZE;
+static unsigned short tftp_window_size_option = CONFIG_TFTP_WINDOWSIZE;
+
+static int (*tftp_consume)(void *priv, const void *buf, size_t len);
+static void *tftp_consume_priv;
+/* Bytes passed to tftp_consume, which cannot be taken back on a restart */
+static ulong tftp_consumed;
+
+void tftp_set_consumer(int (*consume)(void *priv, const void *buf,
+				      size_t len), void *priv)
+{
+	tftp_consume = consume;
+	tftp_consume_priv = priv;
+	tftp_consumed = 0;
+}
+
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
 	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
 	ulong newsize = offset + len;
 	ulong store_addr = tftp_load_addr + offset;
+
+	if (tftp_consume) {
+		int ret;
+
+		/* Blocks arrive in order, so only a restart can rewind */
+		if (offset != tftp_consumed) {
+			puts("\nTFTP error: ");
+			puts("cannot restart a streamed transfer\n");
+			return -1;
+		}
+		ret = tftp_consume(tftp_consume_priv, src, len);
+		if (ret) {
+			printf("\nTFTP error: consumer failed (%d)\n", ret);
+			return ret;
+		}
+		tftp_consumed = newsize;
+		net_boot_file_size = newsize;
+
+		return 0;
+	}
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 	int i, rc = 0;
 
@@ -192,6 +235,8 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 static void new_transfer(void)
 {
 	tftp_prev_block = 0;
+	tftp_next_ack = tftp_window_size;
+	tftp_last_nack = TFTP_SEQUENCE_SIZE;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
 #ifdef CONFIG_CMD_TFTPPUT
@@ -346,6 +391,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* ask for several blocks per ACK when downloading */
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+				       0, tftp_window_size_option, 0);
 		len = pkt - xp;
 		break;
 
@@ -416,6 +465,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 {
 	__be16 proto;
 	__be16 *s;
+	unsigned short block;
 	int i;
 
 	if (dest != tftp_our_port) {
@@ -490,6 +540,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_window_size = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				/* The server may only make it smaller */
+				if (!tftp_window_size ||
+				    tftp_window_size > tftp_window_size_option)
+					tftp_window_size = TFTP_WINDOW_SIZE;
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_window_size);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -512,9 +573,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (len < 2)
 			return;
 		len -= 2;
-		tftp_cur_block = ntohs(*(__be16 *)pkt);
-
-		update_block_number();
+		block = ntohs(*(__be16 *)pkt);
 
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
@@ -526,21 +585,38 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_remote_port = src;
 			new_transfer();
 
-			if (tftp_cur_block != 1) {	/* Assertion */
+			/* With a window, block 1 may still be on its way */
+			if (block != 1 && tftp_window_size == 1) {
 				puts("\nTFTP error: ");
-				printf("First block is not block 1 (%ld)\n",
-				       tftp_cur_block);
+				printf("First block is not block 1 (%d)\n",
+				       block);
 				puts("Starting again\n\n");
 				net_start_again();
 				break;
 			}
 		}
 
-		if (tftp_cur_block == tftp_prev_block) {
-			/* Same block again; ignore it. */
+		if (block != (unsigned short)(tftp_prev_block + 1)) {
+			/*
+			 * Same block again, or one that overtook a block lost
+			 * in the current window. In the second case,
+			 * acknowledge the last block received in order, once,
+			 * so that the server sends the window again from
+			 * there without waiting for its timeout.
+			 */
+			if ((unsigned short)(block - tftp_prev_block - 1) <
+			    tftp_window_size &&
+			    tftp_last_nack != tftp_prev_block) {
+				tftp_last_nack = tftp_prev_block;
+				tftp_next_ack = tftp_prev_block +
+						tftp_window_size;
+				tftp_send();
+			}
 			break;
 		}
 
+		tftp_cur_block = block;
+		update_block_number();
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
@@ -552,10 +628,14 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 
 		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	Acknowledge the last block of each window, which will
+		 *	prompt the remote for the next one.
 		 */
-		tftp_send();
+		if (len < tftp_block_size ||
+		    tftp_cur_block == (unsigned short)tftp_next_ack) {
+			tftp_next_ack = tftp_cur_block + tftp_window_size;
+			tftp_send();
+		}
 
 		if (len < tftp_block_size)
 			tftp_complete();
@@ -594,8 +674,11 @@ static void tftp_timeout_handler(void)
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
-		if (tftp_state != STATE_RECV_WRQ)
+		if (tftp_state != STATE_RECV_WRQ) {
+			/* The server sends a whole window after this ACK */
+			tftp_next_ack = tftp_cur_block + tftp_window_size;
 			tftp_send();
+		}
 	}
 }
 
@@ -632,6 +715,10 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = env_get("tftpwindowsize");
+	if (ep != NULL)
+		tftp_window_size_option = simple_strtol(ep, NULL, 10);
+
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -653,8 +740,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -713,14 +800,16 @@ void tftp_start(enum proto_t protocol)
 	} else
 #endif
 	{
-		if (tftp_init_load_addr()) {
-			eth_halt();
-			net_set_state(NETLOOP_FAIL);
-			puts("\nTFTP error: ");
-			puts("trying to overwrite reserved memory...\n");
-			return;
+		if (!tftp_consume) {
+			if (tftp_init_load_addr()) {
+				eth_halt();
+				net_set_state(NETLOOP_FAIL);
+				puts("\nTFTP error: trying to overwrite ");
+				puts("reserved memory...\n");
+				return;
+			}
+			printf("Load address: 0x%lx\n", tftp_load_addr);
 		}
-		printf("Load address: 0x%lx\n", tftp_load_addr);
 		puts("Loading: *\b");
 		tftp_state = STATE_SEND_RRQ;
 #ifdef CONFIG_CMD_BOOTEFI
@@ -753,8 +842,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_window_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_window_size = TFTP_WINDOW_SIZE;
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
 	tftp_tsize_num_hash = 0;
@@ -785,8 +875,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_window_size to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_window_size = TFTP_WINDOW_SIZE;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * HTTP/1.1 GET client
+ *
+ * The response body is stored at load_addr, or passed to a consumer, as
+ * it arrives: it is never buffered as a whole. Bodies delimited by
+ * Content-Length, by chunked transfer encoding or by the server closing
+ * the connection are supported. Redirects and authentication are not.
+ */
+
+#include <common.h>
+#include <lmb.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <net/wget.h>
+#include <linux/ctype.h>
+#include <linux/sizes.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define HASHES_PER_LINE	65
+#define HASH_BYTES	SZ_64K
+/* Longest header line we look at; the rest of a longer one is ignored */
+#define WGET_LINE_MAX	256
+
+enum wget_state {
+	WGET_STATUS,		/* status line */
+	WGET_HEADER,		/* header lines */
+	WGET_BODY,		/* body without chunked encoding */
+	WGET_CHUNK_SIZE,	/* chunk size line */
+	WGET_CHUNK_DATA,	/* chunk data */
+	WGET_CHUNK_END,		/* CRLF after chunk data */
+	WGET_TRAILER,		/* trailer lines, after the last chunk */
+	WGET_DONE,		/* the whole body has arrived */
+};
+
+static enum wget_state wget_state;
+static struct in_addr wget_server_ip;
+static int wget_server_port;
+static char wget_path[sizeof(net_boot_file_name) + 1];
+static char wget_request[sizeof(wget_path) + 128];
+
+static char wget_line[WGET_LINE_MAX];
+static unsigned int wget_line_len;
+static bool wget_chunked;
+static bool wget_has_length;
+static ulong wget_left;		/* of the body or the current chunk */
+static ulong wget_hashes;
+
+static ulong wget_load_addr;
+static ulong wget_load_size;
+static ulong time_start;
+
+/* Consumer for the next download, taken over by wget_start() */
+static int (*wget_next_consume)(void *priv, const void *buf, size_t len);
+static void *wget_next_consume_priv;
+/* Consumer for this download */
+static int (*wget_consume)(void *priv, const void *buf, size_t len);
+static void *wget_consume_priv;
+
+void wget_set_consumer(int (*consume)(void *priv, const void *buf,
+				      size_t len), void *priv)
+{
+	wget_next_consume = consume;
+	wget_next_consume_priv = priv;
+}
+
+/* The download is over, so its consumer must not see any more data */
+static void wget_end(enum net_loop_state state)
+{
+	wget_consume = NULL;
+	wget_consume_priv = NULL;
+	net_set_state(state);
+}
+
+static int wget_store(const uchar *data, unsigned int len)
+{
+	ulong offset = net_boot_file_size;
+
+	if (wget_consume) {
+		int ret = wget_consume(wget_consume_priv, data, len);
+
+		if (ret)
+			return ret;
+	} else {
+		void *ptr;
+
+#ifdef CONFIG_LMB
+		if (offset + len > wget_load_size) {
+			puts("\nwget error: ");
+			puts("trying to overwrite reserved memory...\n");
+			return -ENOSPC;
+		}
+#endif
+		ptr = map_sysmem(wget_load_addr + offset, len);
+		memcpy(ptr, data, len);
+		unmap_sysmem(ptr);
+	}
+	net_boot_file_size = offset + len;
+
+	while (wget_hashes < net_boot_file_size / HASH_BYTES) {
+		if (wget_hashes && !(wget_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		wget_hashes++;
+	}
+
+	return 0;
+}
+
+/* The whole body has arrived: we have no more use for the connection */
+static void wget_body_done(void)
+{
+	wget_state = WGET_DONE;
+	tcp_close();
+}
+
+static int wget_header(const char *line)
+{
+	if (!strncasecmp(line, "Content-Length:", 15)) {
+		line += 15;
+		while (*line == ' ' || *line == '\t')
+			line++;
+		wget_left = simple_strtoul(line, NULL, 10);
+		wget_has_length = true;
+	} else if (!strncasecmp(line, "Transfer-Encoding:", 18)) {
+		wget_chunked = !!strstr(line, "chunked");
+	} else if (!*line) {
+		/* A blank line ends the headers */
+		if (wget_chunked) {
+			wget_state = WGET_CHUNK_SIZE;
+		} else {
+			wget_state = WGET_BODY;
+			if (wget_has_length && !wget_left)
+				wget_body_done();
+		}
+	}
+
+	return 0;
+}
+
+/* Handle a line of the response head or of the chunked encoding */
+static int wget_line_done(char *line)
+{
+	char *p;
+
+	switch (wget_state) {
+	case WGET_STATUS:
+		p = strchr(line, ' ');
+		if (strncmp(line, "HTTP/1.", 7) || !p) {
+			printf("\nwget error: bad response '%s'\n", line);
+			return -EPROTO;
+		}
+		if (simple_strtoul(p + 1, NULL, 10) != 200) {
+			printf("\nHTTP error: %s\n", p + 1);
+			return -ENOENT;
+		}
+		wget_state = WGET_HEADER;
+		break;
+	case WGET_HEADER:
+		return wget_header(line);
+	case WGET_CHUNK_SIZE:
+		if (!isxdigit(*line)) {
+			printf("\nwget error: bad chunk size '%s'\n", line);
+			return -EPROTO;
+		}
+		wget_left = simple_strtoul(line, NULL, 16);
+		wget_state = wget_left ? WGET_CHUNK_DATA : WGET_TRAILER;
+		break;
+	case WGET_CHUNK_END:
+		if (*line) {
+			puts("\nwget error: bad chunk end\n");
+			return -EPROTO;
+		}
+		wget_state = WGET_CHUNK_SIZE;
+		break;
+	case WGET_TRAILER:
+		if (!*line)
+			wget_body_done();
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int wget_receive(const uchar *data, unsigned int len)
+{
+	while (len && wget_state != WGET_DONE) {
+		unsigned int n = len;
+		int ret;
+
+		if (wget_state == WGET_BODY || wget_state == WGET_CHUNK_DATA) {
+			bool counted = wget_has_length ||
+				       wget_state == WGET_CHUNK_DATA;
+
+			if (counted && n > wget_left)
+				n = wget_left;
+			ret = wget_store(data, n);
+			if (ret)
+				return ret;
+			if (counted) {
+				wget_left -= n;
+				if (!wget_left && wget_state == WGET_BODY)
+					wget_body_done();
+				else if (!wget_left)
+					wget_state = WGET_CHUNK_END;
+			}
+		} else {
+			const uchar *eol = memchr(data, '\n', len);
+			unsigned int room = WGET_LINE_MAX - 1 - wget_line_len;
+
+			if (eol)
+				n = eol - data + 1;
+			memcpy(wget_line + wget_line_len, data, min(n, room));
+			wget_line_len += min(n, room);
+			if (eol) {
+				/* Drop the line ending */
+				while (wget_line_len &&
+				       (wget_line[wget_line_len - 1] == '\n' ||
+					wget_line[wget_line_len - 1] == '\r'))
+					wget_line_len--;
+				wget_line[wget_line_len] = '\0';
+				wget_line_len = 0;
+				ret = wget_line_done(wget_line);
+				if (ret)
+					return ret;
+			}
+		}
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static void wget_connected(void)
+{
+	int len;
+
+	len = snprintf(wget_request, sizeof(wget_request),
+		       "GET %s HTTP/1.1\r\n"
+		       "Host: %pI4:%d\r\n"
+		       "User-Agent: U-Boot\r\n"
+		       "Connection: close\r\n"
+		       "\r\n", wget_path, &wget_server_ip, wget_server_port);
+	tcp_send(wget_request, len);
+}
+
+static void wget_closed(int err)
+{
+	/* Without a length or chunks, the body ends with the connection */
+	if (!err && wget_state == WGET_BODY && !wget_has_length)
+		wget_state = WGET_DONE;
+
+	if (wget_state == WGET_DONE) {
+		time_start = get_timer(time_start);
+		if (time_start > 0) {
+			puts("\n\t ");	/* Line up with "Loading: " */
+			print_size(net_boot_file_size /
+				time_start * 1000, "/s");
+		}
+		puts("\ndone\n");
+		wget_end(NETLOOP_SUCCESS);
+		return;
+	}
+
+	switch (err) {
+	case 0:
+		puts("\nwget error: connection closed early\n");
+		break;
+	case -ECONNREFUSED:
+		puts("\nwget error: connection refused\n");
+		break;
+	case -ECONNRESET:
+		puts("\nwget error: connection reset\n");
+		break;
+	case -ETIMEDOUT:
+		puts("\nwget error: timed out\n");
+		break;
+	default:
+		/* The reason has already been given */
+		break;
+	}
+	wget_end(NETLOOP_FAIL);
+}
+
+/* Only the load area limits what we can take; a consumer takes anything */
+static ulong wget_rx_space(void)
+{
+	if (wget_consume || !wget_load_size)
+		return ULONG_MAX;
+
+	return wget_load_size - net_boot_file_size;
+}
+
+static const struct tcp_ops wget_tcp_ops = {
+	.connected	= wget_connected,
+	.receive	= wget_receive,
+	.closed		= wget_closed,
+	.rx_space	= wget_rx_space,
+};
+
+/* Split the file name into server, port and path */
+static int wget_parse_name(void)
+{
+	const char *name = net_boot_file_name;
+	char *p = wget_path;
+
+	wget_server_ip = net_server_ip;
+	wget_server_port = WGET_HTTP_PORT;
+
+	if (!strncmp(name, "http://", 7)) {
+		const char *host = name + 7;
+
+		wget_server_ip = string_to_ip(host);
+		host += strcspn(host, ":/");
+		if (*host == ':')
+			wget_server_port = simple_strtoul(host + 1, NULL, 10);
+		name = strchr(host, '/');
+		if (!name)
+			name = "/";
+	} else if (net_parse_bootfile(&wget_server_ip, wget_path + 1,
+				      sizeof(wget_path) - 1)) {
+		name = wget_path + 1;
+	} else {
+		return -ENOENT;
+	}
+
+	if (*name != '/')
+		*p++ = '/';
+	memmove(p, name, strlen(name) + 1);
+	if (!wget_server_ip.s_addr || !wget_server_port)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int wget_init_load_addr(void)
+{
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+	phys_size_t max_size;
+
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+
+	max_size = lmb_get_free_size(&lmb, load_addr);
+	if (!max_size)
+		return -1;
+
+	wget_load_size = max_size;
+#endif
+	wget_load_addr = load_addr;
+	return 0;
+}
+
+void wget_start(void)
+{
+	wget_consume = wget_next_consume;
+	wget_consume_priv = wget_next_consume_priv;
+	wget_next_consume = NULL;
+	wget_next_consume_priv = NULL;
+
+	if (wget_parse_name()) {
+		printf("*** ERROR: bad or missing URL '%s'\n",
+		       net_boot_file_name);
+		wget_end(NETLOOP_FAIL);
+		return;
+	}
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4:%d; our IP address is %pI4\n",
+	       &wget_server_ip, wget_server_port, &net_ip);
+	printf("Filename '%s'.\n", wget_path);
+
+	if (!wget_consume) {
+		if (wget_init_load_addr()) {
+			puts("\nwget error: ");
+			puts("trying to overwrite reserved memory...\n");
+			wget_end(NETLOOP_FAIL);
+			return;
+		}
+		printf("Load address: 0x%lx\n", wget_load_addr);
+	}
+	puts("Loading: *\b");
+
+	wget_state = WGET_STATUS;
+	wget_line_len = 0;
+	wget_chunked = false;
+	wget_has_length = false;
+	wget_left = 0;
+	wget_hashes = 0;
+	time_start = get_timer(0);
+
+	tcp_connect(wget_server_ip, wget_server_port, &wget_tcp_ops);
+}
@@ -6,6 +6,7 @@
 #include <common.h>
 #include <bootm.h>
 #include <command.h>
+#include <hexdump.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
@@ -117,6 +118,67 @@ static const char lz4_compressed[] =
 	"\x9d\x12\x8c\x9d";
 static const unsigned long lz4_compressed_size = 276;
 
+/* zstd -19 /tmp/plain.txt -o /tmp/plain.zst */
+static const char zstd_compressed[] =
+	"\x28\xb5\x2f\xfd\x64\x5e\x00\xad\x05\x00\x42\x4e\x26\x17\x90\x3b"
+	"\x07\x04\x5a\x13\x8b\xa7\x65\x34\x12\x21\x6d\xb0\x39\xbb\xae\xe8"
+	"\xba\xc9\xcd\x5e\x02\x49\xd0\x2b\xa9\xfa\x96\x92\xe7\x1f\x19\x19"
+	"\x7c\x8f\xf1\x9d\x54\x37\xfc\xd6\x0a\xf3\x0c\x93\x56\xc7\x52\x4f"
+	"\x0a\x62\x3e\xd1\xa5\x83\x17\x31\xab\x5d\x8f\x57\xf3\xcc\x3b\x58"
+	"\xf8\x91\x8c\xf1\x2a\x5c\x89\xdd\xf2\x9b\x15\xb7\x92\x5b\xbe\xba"
+	"\xab\xd5\xd1\x34\xdf\xf0\x02\x0e\x61\xcd\x7b\xd6\x01\xfc\xc2\xa7"
+	"\xd4\xd1\x3d\x26\x9c\x10\x49\xb8\x5b\xcd\xba\x7c\xf7\xac\x4b\xad"
+	"\xb7\x31\x1c\xbc\xf9\xcb\x62\x8e\x2e\x9b\x0f\xd3\x87\x57\x45\x12"
+	"\x16\xfa\x3a\x79\xde\x65\xf8\xcc\x48\xd5\x43\xa6\xbd\xc3\x91\x29"
+	"\x65\x29\xa7\x5b\x9a\x08\x08\x00\x60\x13\x00\x63\xa3\x8e\x28\x94"
+	"\x79\x41\x2a\x78\xc2\x91\x70\x9f\xaa\x6a\x21\x7a\xa1\xaa\x0c\xe4"
+	"\xf4\x6e\xfa";
+static const unsigned long zstd_compressed_size = 195;
+
+/*
+ * 300000 bytes of "0123456789abcdef" over and over, zstd -3: three
+ * compressed blocks with raw literals, the last two only repeating the
+ * offset of the first
+ */
+static const char zstd_blocks_compressed[] =
+	"\x28\xb5\x2f\xfd\xa4\xe0\x93\x04\x00\xc4\x00\x00\x80\x30\x31\x32"
+	"\x33\x34\x35\x36\x37\x38\x39\x61\x62\x63\x64\x65\x66\x01\x00\xda"
+	"\xff\x27\x9f\x4b\x4c\x00\x00\x08\x30\x01\x00\xfc\xff\x39\x10\x02"
+	"\x4d\x00\x00\x08\x30\x01\x00\xdc\x13\x1d\x08\x01\xad\xbc\x3c\xcd";
+static const unsigned long zstd_blocks_compressed_size = 64;
+#define ZSTD_BLOCKS_SIZE	300000
+
+/*
+ * zstd -19 --no-check: the sequences use each of the three repeat offsets,
+ * and the first one less one
+ */
+static const char zstd_repeat_plain[] =
+	"bhbnnloj,,kmflpgnpaid,,bhbnnloj+kmflpgnpaidbhbnnloj/kmflpgnpaid//"
+	"bhbnnloj--kmflpgnpaid..kmflpgnpaid.bhbnnloj++bhbnnlojkmflpgnpaid"
+	"bhbnnlojkmflpgnpaidkmflpgnpaid,,kmflpgnpaidkmflpgnpaid//kmflpgnpa"
+	"idkmflpgnpaid";
+static const char zstd_repeat_compressed[] =
+	"\x28\xb5\x2f\xfd\x20\xcf\x35\x02\x00\x24\x02\x62\x68\x62\x6e\x6e"
+	"\x6c\x6f\x6a\x2c\x2c\x6b\x6d\x66\x6c\x70\x67\x6e\x70\x61\x69\x64"
+	"\x2c\x2c\x2b\x2f\x2f\x2f\x2d\x2d\x2e\x2e\x2b\x2f\x2f\x0e\x00\x40"
+	"\xc1\x1d\x25\x1a\xef\xc0\x33\x20\xc3\x09\x5a\xe4\xa0\x50\x04\x98"
+	"\x1c\xbf\x06\xbb\x04\x81\xe1\x9b\xc4\x72\x1a\x56\x89\x29\x06";
+static const unsigned long zstd_repeat_compressed_size = 79;
+
+/*
+ * Made by hand, as the reference encoder seldom emits them: a raw block,
+ * an RLE block, then compressed blocks with raw and with RLE literals and
+ * no sequences
+ */
+static const char zstd_literals_plain[] = "raw,-----lit!!!!!!";
+static const char zstd_literals_compressed[] =
+	"\x28\xb5\x2f\xfd\x20\x12"			/* single segment, 18 */
+	"\x20\x00\x00\x72\x61\x77\x2c"			/* raw, "raw," */
+	"\x2a\x00\x00\x2d"				/* RLE, 5 x '-' */
+	"\x2c\x00\x00\x18\x6c\x69\x74\x00"		/* raw "lit" */
+	"\x1d\x00\x00\x31\x21\x00";			/* last, 6 x '!' */
+static const unsigned long zstd_literals_compressed_size = 31;
+
 
 #define TEST_BUFFER_SIZE	512
 
@@ -292,6 +354,40 @@ static int uncompress_using_lz4(struct unit_test_state *uts,
 	return (ret != 0);
 }
 
+static int compress_using_zstd(struct unit_test_state *uts,
+			       void *in, unsigned long in_size,
+			       void *out, unsigned long out_max,
+			       unsigned long *out_size)
+{
+	/* There is no zstd compression in u-boot, so fake it. */
+	ut_asserteq(in_size,  strlen(plain));
+	ut_asserteq(0, memcmp(plain, in, in_size));
+
+	if (zstd_compressed_size > out_max)
+		return -1;
+
+	memcpy(out, zstd_compressed, zstd_compressed_size);
+	if (out_size)
+		*out_size = zstd_compressed_size;
+
+	return 0;
+}
+
+static int uncompress_using_zstd(struct unit_test_state *uts,
+				 void *in, unsigned long in_size,
+				 void *out, unsigned long out_max,
+				 unsigned long *out_size)
+{
+	int ret;
+	size_t output_size = out_max;
+
+	ret = zstd_decompress(in, in_size, out, &output_size);
+	if (out_size)
+		*out_size = output_size;
+
+	return (ret != 0);
+}
+
 #define errcheck(statement) if (!(statement)) { \
 	fprintf(stderr, "\tFailed: %s\n", #statement); \
 	ret = 1; \
@@ -436,6 +532,257 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+static int compression_test_zstd(struct unit_test_state *uts)
+{
+	return run_test(uts, "zstd", compress_using_zstd,
+			uncompress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_zstd, 0);
+
+struct stream_state {
+	char *buf;
+	size_t size;
+	size_t max;
+	int chunks;
+	bool misaligned;
+};
+
+static int stream_consume(void *priv, const void *buf, size_t len)
+{
+	struct stream_state *state = priv;
+
+	if (state->size + len > state->max)
+		return -ENOSPC;
+
+	/* Only the final chunk may end part-way through a word */
+	if (state->misaligned)
+		return -EINVAL;
+	state->misaligned = len & 3;
+
+	memcpy(state->buf + state->size, buf, len);
+	state->size += len;
+	state->chunks++;
+
+	return 0;
+}
+
+static int stream_fail(void *priv, const void *buf, size_t len)
+{
+	return -EIO;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	struct stream_state state = { 0 };
+	unsigned long size = TEST_BUFFER_SIZE;
+	void *compressed;
+
+	compressed = malloc(TEST_BUFFER_SIZE);
+	ut_assertnonnull(compressed);
+	state.max = TEST_BUFFER_SIZE;
+	state.buf = malloc(state.max);
+	ut_assertnonnull(state.buf);
+
+	ut_assertok(gzip(compressed, &size, (void *)plain, strlen(plain)));
+
+	/* A small window forces the output to be handed over in pieces */
+	ut_assertok(gunzip_stream(compressed, size, 64, stream_consume,
+				  &state));
+	ut_asserteq(strlen(plain), state.size);
+	ut_asserteq_mem(plain, state.buf, state.size);
+	ut_asserteq(DIV_ROUND_UP(strlen(plain), 64), state.chunks);
+
+	/* Consumer errors are passed back */
+	ut_asserteq(-EIO, gunzip_stream(compressed, size, 64, stream_fail,
+					NULL));
+
+	free(state.buf);
+	free(compressed);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	struct stream_state state = { 0 };
+
+	state.max = TEST_BUFFER_SIZE;
+	state.buf = malloc(state.max);
+	ut_assertnonnull(state.buf);
+
+	ut_assertok(ulz4fn_stream(lz4_compressed, lz4_compressed_size,
+				  stream_consume, &state));
+	ut_asserteq(strlen(plain), state.size);
+	ut_asserteq_mem(plain, state.buf, state.size);
+
+	/* A truncated frame is rejected */
+	ut_asserteq(-EINVAL, ulz4fn_stream(lz4_compressed, 16, stream_consume,
+					   &state));
+	ut_asserteq(-EIO, ulz4fn_stream(lz4_compressed, lz4_compressed_size,
+					stream_fail, NULL));
+
+	free(state.buf);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_stream_lz4, 0);
+
+static int compression_test_stream_zstd(struct unit_test_state *uts)
+{
+	struct stream_state state = { 0 };
+	size_t len = zstd_compressed_size;
+	char *frames;
+
+	state.max = 2 * TEST_BUFFER_SIZE;
+	state.buf = malloc(state.max);
+	ut_assertnonnull(state.buf);
+	frames = malloc(2 * len);
+	ut_assertnonnull(frames);
+
+	ut_assertok(zstd_decompress_stream(zstd_compressed, len,
+					   stream_consume, &state));
+	ut_asserteq(strlen(plain), state.size);
+	ut_asserteq_mem(plain, state.buf, state.size);
+
+	/* Bytes left over from a frame are carried into the next one */
+	memcpy(frames, zstd_compressed, len);
+	memcpy(frames + len, zstd_compressed, len);
+	state.size = 0;
+	state.chunks = 0;
+	state.misaligned = false;
+	ut_assertok(zstd_decompress_stream(frames, 2 * len, stream_consume,
+					   &state));
+	ut_asserteq(2 * strlen(plain), state.size);
+	ut_asserteq_mem(plain, state.buf + strlen(plain), strlen(plain));
+
+	/* Truncated and corrupted frames are rejected */
+	ut_asserteq(-EINVAL, zstd_decompress_stream(zstd_compressed, 16,
+						    stream_consume, &state));
+	frames[len - 1] ^= 1;
+	ut_asserteq(-EBADMSG, zstd_decompress_stream(frames, len,
+						     stream_consume, &state));
+	ut_asserteq(-EIO, zstd_decompress_stream(zstd_compressed, len,
+						 stream_fail, NULL));
+
+	free(frames);
+	free(state.buf);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_stream_zstd, 0);
+
+/* Decompress @src both at once and block by block, and check the output */
+static int zstd_check(struct unit_test_state *uts, const char *src,
+		      size_t srcn, const char *plain, size_t len,
+		      int min_chunks)
+{
+	struct stream_state state = { 0 };
+	size_t size = len;
+	char *out;
+
+	out = malloc(len);
+	ut_assertnonnull(out);
+	ut_assertok(zstd_decompress(src, srcn, out, &size));
+	ut_asserteq(len, size);
+	ut_asserteq_mem(plain, out, len);
+
+	state.max = len;
+	state.buf = out;
+	memset(out, '\0', len);
+	ut_assertok(zstd_decompress_stream(src, srcn, stream_consume, &state));
+	ut_asserteq(len, state.size);
+	ut_asserteq_mem(plain, out, len);
+	ut_assert(state.chunks >= min_chunks);
+
+	free(out);
+
+	return 0;
+}
+
+static int compression_test_zstd_blocks(struct unit_test_state *uts)
+{
+	char *plain;
+	int i, ret;
+
+	plain = malloc(ZSTD_BLOCKS_SIZE);
+	ut_assertnonnull(plain);
+	for (i = 0; i < ZSTD_BLOCKS_SIZE; i++)
+		plain[i] = "0123456789abcdef"[i % 16];
+
+	/* Each of the three blocks is handed over on its own */
+	ret = zstd_check(uts, zstd_blocks_compressed,
+			 zstd_blocks_compressed_size, plain, ZSTD_BLOCKS_SIZE,
+			 3);
+	free(plain);
+
+	return ret;
+}
+COMPRESSION_TEST(compression_test_zstd_blocks, 0);
+
+static int compression_test_zstd_literals(struct unit_test_state *uts)
+{
+	return zstd_check(uts, zstd_literals_compressed,
+			  zstd_literals_compressed_size, zstd_literals_plain,
+			  strlen(zstd_literals_plain), 1);
+}
+COMPRESSION_TEST(compression_test_zstd_literals, 0);
+
+static int compression_test_zstd_repeat(struct unit_test_state *uts)
+{
+	return zstd_check(uts, zstd_repeat_compressed,
+			  zstd_repeat_compressed_size, zstd_repeat_plain,
+			  strlen(zstd_repeat_plain), 1);
+}
+COMPRESSION_TEST(compression_test_zstd_repeat, 0);
+
+/* Flip @mask in byte @pos of @src and check that both decoders refuse it */
+static int zstd_check_corrupt(struct unit_test_state *uts, const char *src,
+			      size_t srcn, int pos, u8 mask)
+{
+	struct stream_state state = { 0 };
+	char *bad, out[TEST_BUFFER_SIZE];
+	size_t size = sizeof(out);
+
+	bad = malloc(srcn);
+	ut_assertnonnull(bad);
+	memcpy(bad, src, srcn);
+	bad[pos] ^= mask;
+
+	ut_asserteq(-EINVAL, zstd_decompress(bad, srcn, out, &size));
+	state.max = sizeof(out);
+	state.buf = out;
+	ut_asserteq(-EINVAL, zstd_decompress_stream(bad, srcn, stream_consume,
+						    &state));
+	free(bad);
+
+	return 0;
+}
+
+static int compression_test_zstd_corrupt(struct unit_test_state *uts)
+{
+	const char *lit = zstd_literals_compressed;
+	size_t lit_size = zstd_literals_compressed_size;
+	const char *rep = zstd_repeat_compressed;
+	size_t rep_size = zstd_repeat_compressed_size;
+
+	/* Reserved bit in the frame header */
+	ut_assertok(zstd_check_corrupt(uts, lit, lit_size, 4, 0x08));
+	/* Content size which does not match the blocks */
+	ut_assertok(zstd_check_corrupt(uts, lit, lit_size, 5, 0x01));
+	/* Reserved block type */
+	ut_assertok(zstd_check_corrupt(uts, lit, lit_size, 6, 0x06));
+	/* Literals header */
+	ut_assertok(zstd_check_corrupt(uts, rep, rep_size, 9, 0x80));
+	/* Sequences which decode, but to the wrong number of bytes */
+	ut_assertok(zstd_check_corrupt(uts, rep, rep_size, 48, 0x01));
+	/* Sequences which do not decode */
+	ut_assertok(zstd_check_corrupt(uts, rep, rep_size, 60, 0x01));
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_zstd_corrupt, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -526,6 +873,12 @@ static int compression_test_bootm_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_lz4, 0);
 
+static int compression_test_bootm_zstd(struct unit_test_state *uts)
+{
+	return run_bootm_test(uts, IH_COMP_ZSTD, compress_using_zstd);
+}
+COMPRESSION_TEST(compression_test_bootm_zstd, 0);
+
 static int compression_test_bootm_none(struct unit_test_state *uts)
 {
 	return run_bootm_test(uts, IH_COMP_NONE, compress_using_none);
@@ -5,6 +5,8 @@
 
 #include <common.h>
 #include <dm.h>
+#include <os.h>
+#include <sandboxblockdev.h>
 #include <usb.h>
 #include <asm/state.h>
 #include <dm/test.h>
@@ -162,3 +164,114 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+static void blk_test_complete(struct blk_req *req)
+{
+	int *count = req->priv;
+
+	(*count)++;
+}
+
+/* Test asynchronous requests, queued by the host device */
+static int dm_test_blk_submit(struct unit_test_state *uts)
+{
+	const char *fname = "blk_submit_test.img";
+	struct blk_req req[2], wreq;
+	struct blk_desc *desc;
+	u8 buf[2][4 * 512], data[4 * 512];
+	int count = 0;
+	int fd, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i / 512;
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	for (i = 0; i < 16; i++)
+		ut_asserteq(sizeof(data), os_write(fd, data, sizeof(data)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(2, (char *)fname));
+	ut_asserteq(2, blk_get_device_by_str("host", "2", &desc));
+
+	/* Two reads stay in flight until polled, then complete in order */
+	for (i = 0; i < 2; i++) {
+		memset(&req[i], '\0', sizeof(req[i]));
+		req[i].op = BLK_REQ_READ;
+		req[i].start = 4 + i * 4;
+		req[i].blkcnt = 4;
+		req[i].buffer = buf[i];
+		req[i].complete = blk_test_complete;
+		req[i].priv = &count;
+		ut_assertok(blk_submit(desc, &req[i]));
+	}
+	ut_asserteq(false, req[0].done);
+	ut_asserteq(1, blk_poll(desc));
+	ut_asserteq(1, count);
+	ut_asserteq(0, blk_poll(desc));
+	ut_asserteq(2, count);
+	ut_asserteq(4, req[1].result);
+	ut_assertok(memcmp(data, buf[0], sizeof(data)));
+	ut_assertok(memcmp(data, buf[1], sizeof(data)));
+
+	/* A synchronous read waits for a write still in flight */
+	memset(buf[0], 0xa5, sizeof(buf[0]));
+	memset(&wreq, '\0', sizeof(wreq));
+	wreq.op = BLK_REQ_WRITE;
+	wreq.start = 8;
+	wreq.blkcnt = 4;
+	wreq.buffer = buf[0];
+	ut_assertok(blk_submit(desc, &wreq));
+	ut_asserteq(4, blk_dread(desc, 8, 4, buf[1]));
+	ut_assertok(memcmp(buf[0], buf[1], sizeof(buf[1])));
+	ut_asserteq(true, wreq.done);
+
+	/* Reading past the end of the device fails */
+	memset(&req[0], '\0', sizeof(req[0]));
+	req[0].op = BLK_REQ_READ;
+	req[0].start = 62;
+	req[0].blkcnt = 4;
+	req[0].buffer = buf[0];
+	ut_assertok(blk_submit(desc, &req[0]));
+	ut_asserteq(-EIO, blk_wait(desc, &req[0]));
+
+	/* Removing the device completes the requests in flight */
+	count = 0;
+	ut_assertok(blk_submit(desc, &req[1]));
+	ut_assertok(host_dev_bind(2, NULL));
+	ut_asserteq(1, count);
+	ut_asserteq(4, req[1].result);
+	os_unlink(fname);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Test asynchronous requests on a device without native support */
+static int dm_test_blk_submit_sync(struct unit_test_state *uts)
+{
+	struct blk_desc *desc;
+	struct blk_req req;
+	u8 buf[512], data[512];
+	int count = 0;
+
+	ut_asserteq(0, blk_get_device_by_str("mmc", "0", &desc));
+	ut_asserteq(1, blk_dread(desc, 1, 1, data));
+
+	memset(&req, '\0', sizeof(req));
+	req.op = BLK_REQ_READ;
+	req.start = 1;
+	req.blkcnt = 1;
+	req.buffer = buf;
+	req.complete = blk_test_complete;
+	req.priv = &count;
+	ut_assertok(blk_submit(desc, &req));
+
+	/* The transfer is done, but completes only when polled */
+	ut_asserteq(true, req.done);
+	ut_asserteq(0, count);
+	ut_assertok(blk_wait(desc, &req));
+	ut_asserteq(1, count);
+	ut_assertok(memcmp(data, buf, sizeof(buf)));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit_sync, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -39,6 +39,75 @@ static int dm_test_eth(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_eth, DM_TESTF_SCAN_FDT);
 
+static int dm_test_eth_stats(struct unit_test_state *uts)
+{
+	struct eth_stats before, after;
+	struct udevice *dev;
+	int i;
+
+	net_ping_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10002000");
+	dev = eth_get_dev_by_name("eth@10002000");
+	ut_assertnonnull(dev);
+
+	ut_assertok(eth_get_stats(dev, &before));
+	ut_assertok(net_loop(PING));
+	ut_assertok(eth_get_stats(dev, &after));
+
+	/* An ARP request and an echo request, and a reply to each */
+	ut_asserteq(before.tx_packets + 2, after.tx_packets);
+	ut_asserteq(before.rx_packets + 2, after.rx_packets);
+	ut_asserteq(before.rx_missed, after.rx_missed);
+
+	/* Fill the receive buffers: the next packet is lost */
+	for (i = 0; i < PKTBUFSRX; i++)
+		ut_assertok(sandbox_eth_recv_arp_req(dev));
+	ut_asserteq(-EOVERFLOW, sandbox_eth_recv_arp_req(dev));
+	ut_assertok(eth_get_stats(dev, &after));
+	ut_asserteq(before.rx_missed + 1, after.rx_missed);
+
+	ut_assertok(run_command("net stats eth@10002000", 0));
+	ut_asserteq(1, run_command("net stats nosuchdevice", 0));
+	env_set("ethact", NULL);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_stats, DM_TESTF_SCAN_FDT);
+
+/* Received packets are handed to the stack in place, without a copy */
+static int dm_test_eth_rx_in_place(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	struct udevice *dev;
+	uchar *first, *second;
+
+	net_ping_ip = string_to_ip("1.1.2.2");
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_loop(PING));
+	dev = eth_get_dev();
+	ut_assertnonnull(dev);
+	priv = dev_get_priv(dev);
+
+	ut_assertok(eth_init());
+	ut_assertok(sandbox_eth_recv_arp_req(dev));
+	ut_assertok(sandbox_eth_recv_arp_req(dev));
+	first = priv->recv_packet_buffer[0];
+	second = priv->recv_packet_buffer[1];
+
+	/* Both are processed from the driver's buffers and then recycled */
+	ut_assertok(eth_rx());
+	ut_asserteq_ptr(second, net_rx_packet);
+	ut_asserteq(0, priv->recv_packets);
+	ut_asserteq_ptr(second, priv->recv_packet_buffer[PKTBUFSRX - 1]);
+	ut_asserteq_ptr(first, priv->recv_packet_buffer[PKTBUFSRX - 2]);
+
+	eth_halt();
+	env_set("ethact", NULL);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_rx_in_place, DM_TESTF_SCAN_FDT);
+
 static int dm_test_eth_alias(struct unit_test_state *uts)
 {
 	net_ping_ip = string_to_ip("1.1.2.2");
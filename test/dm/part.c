@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the partition table cache
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <os.h>
+#include <part.h>
+#include <sandboxblockdev.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+static const char *const part_test_uuids[] = {
+	"24dd6d56-1e5a-4bc4-9d6b-91d0a3a1f5b1",
+	"b58d8f0e-3b2b-4a16-8ac2-4a0f2a1f9c22",
+	"c1f6a8e3-77d0-4f4e-a6b0-0c6f7f2e3d33",
+};
+
+/* Write a table with three partitions, named @prefix1 to @prefix3 */
+static int part_test_restore(struct unit_test_state *uts,
+			     struct blk_desc *desc, const char *prefix)
+{
+	char disk_guid[UUID_STR_LEN + 1] =
+		"375a56f7-d6c9-4e81-b5f0-09d41ca89efe";
+	disk_partition_t parts[3];
+	int i;
+
+	memset(parts, '\0', sizeof(parts));
+	for (i = 0; i < 3; i++) {
+		parts[i].start = 64 + i * 256;
+		parts[i].size = 256;
+		parts[i].blksz = desc->blksz;
+		snprintf((char *)parts[i].name, sizeof(parts[i].name), "%s%d",
+			 prefix, i + 1);
+		strcpy(parts[i].uuid, part_test_uuids[i]);
+	}
+	ut_assertok(gpt_restore(desc, disk_guid, parts, 3));
+
+	return 0;
+}
+
+/* Count the reads made by the device, bypassing the block cache */
+static ulong part_test_reads(struct blk_desc *desc)
+{
+	struct host_block_dev *host_dev = dev_get_platdata(desc->bdev);
+	ulong reads = host_dev->reads;
+
+	blkcache_invalidate(desc->if_type, desc->devnum);
+	host_dev->reads = 0;
+
+	return reads;
+}
+
+/* Test that partition lookups use the cached table until it changes */
+static int dm_test_part_cache(struct unit_test_state *uts)
+{
+	const char *fname = "part_cache_test.img";
+	struct blk_desc *desc;
+	disk_partition_t info;
+	char guid[UUID_STR_LEN + 1];
+	u8 buf[512];
+	int fd, i;
+
+	memset(buf, '\0', sizeof(buf));
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	for (i = 0; i < 2048; i++)
+		ut_asserteq(sizeof(buf), os_write(fd, buf, sizeof(buf)));
+	os_close(fd);
+	ut_assertok(host_dev_bind(2, (char *)fname));
+	ut_asserteq(2, blk_get_device_by_str("host", "2", &desc));
+	ut_assertok(part_test_restore(uts, desc, "part"));
+
+	/* The first lookup reads the table */
+	part_test_reads(desc);
+	ut_asserteq(2, part_get_info_by_name(desc, "part2", &info));
+	ut_asserteq(64 + 256, info.start);
+	ut_asserteq(256, info.size);
+	ut_assert(part_test_reads(desc) > 0);
+
+	/* Later ones, by name, UUID or number, do not */
+	ut_asserteq(3, part_get_info_by_name(desc, "part3", &info));
+	ut_asserteq(-1, part_get_info_by_name(desc, "part4", &info));
+	ut_asserteq(1, part_get_info_by_uuid(desc, part_test_uuids[0], &info));
+	ut_asserteq_str("part1", (char *)info.name);
+	ut_asserteq(3, part_get_info_by_uuid(desc, part_test_uuids[2], &info));
+	ut_assertok(part_get_info(desc, 2, &info));
+	ut_asserteq_str(part_test_uuids[1], info.uuid);
+	ut_assertok(get_disk_guid(desc, guid));
+	ut_asserteq(0, part_test_reads(desc));
+
+	/* Writing to a partition keeps the table */
+	ut_asserteq(1, blk_dwrite(desc, 64, 1, buf));
+	ut_asserteq(1, part_get_info_by_name(desc, "part1", &info));
+	ut_asserteq(0, part_test_reads(desc));
+
+	/* Writing a new table drops it */
+	ut_assertok(part_test_restore(uts, desc, "new"));
+	part_test_reads(desc);
+	ut_asserteq(-1, part_get_info_by_name(desc, "part2", &info));
+	ut_asserteq(2, part_get_info_by_name(desc, "new2", &info));
+	ut_assert(part_test_reads(desc) > 0);
+
+	/* So does binding the device again */
+	ut_assertok(host_dev_bind(2, (char *)fname));
+	ut_asserteq(2, blk_get_device_by_str("host", "2", &desc));
+	part_test_reads(desc);
+	ut_asserteq(3, part_get_info_by_name(desc, "new3", &info));
+	ut_assert(part_test_reads(desc) > 0);
+
+	ut_assertok(host_dev_bind(2, NULL));
+	os_unlink(fname);
+
+	return 0;
+}
+DM_TEST(dm_test_part_cache, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -0,0 +1,472 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the TCP client and wget, against a mock HTTP server behind the
+ * sandbox Ethernet driver
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <net/wget.h>
+#include <asm/eth.h>
+#include <dm/test.h>
+#include <test/ut.h>
+
+#define WGET_TEST_ADDR		0x1000000
+#define WGET_TEST_SERVER	"1.1.2.2"
+#define WGET_TEST_ISS		0xfffff000	/* wraps during the test */
+
+/**
+ * struct wget_test_server - State of the mock server
+ *
+ * Offsets are into the response. Faults are only applied to the first
+ * sending of a segment.
+ *
+ * @uts:	Test state, for the ut_assert macros in the handler
+ * @resp:	Response to send, head and body
+ * @resp_len:	Length of the response
+ * @mss:	Largest segment to send
+ * @refuse:	Reset the connection instead of accepting it
+ * @keep_open:	Do not close the connection after the response
+ * @drop:	Offset of a segment to lose, or 0 for none
+ * @swap:	Offset of a segment to send after the next one, or 0 for none
+ * @request:	Request received from the client
+ * @req_len:	Length of the request
+ * @client_ip:	Client address
+ * @client_mac:	Client MAC address
+ * @client_port: Client port
+ * @rcv_nxt:	Next sequence number expected from the client
+ * @sent:	Offset of the next segment to send
+ * @sent_max:	Highest offset sent so far
+ * @acked:	Offset acknowledged by the client
+ * @in_recovery: A duplicate ACK has been answered, until the next new ACK
+ * @fin_sent:	We have sent our FIN
+ * @client_fin:	The client has sent its FIN
+ * @segs:	Number of data segments sent
+ * @acks:	Number of pure ACKs received
+ * @dup_acks:	Number of duplicate ACKs received
+ * @resets:	Number of resets received
+ * @max_win:	Largest window advertised by the client
+ */
+struct wget_test_server {
+	struct unit_test_state *uts;
+	const uchar *resp;
+	uint resp_len;
+	uint mss;
+	bool refuse;
+	bool keep_open;
+	uint drop;
+	uint swap;
+	char request[512];
+	uint req_len;
+	struct in_addr client_ip;
+	uchar client_mac[ARP_HLEN];
+	int client_port;
+	u32 rcv_nxt;
+	uint sent;
+	uint sent_max;
+	uint acked;
+	bool in_recovery;
+	bool fin_sent;
+	bool client_fin;
+	int segs;
+	int acks;
+	int dup_acks;
+	int resets;
+	uint max_win;
+};
+
+/* Work out the TCP checksum, the long way round */
+static u16 wget_test_csum(struct ip_tcp_hdr *ip, uint tcp_len)
+{
+	const u8 *p = (u8 *)&ip->ip_src;
+	u32 sum = IPPROTO_TCP + tcp_len;
+	uint i;
+
+	for (i = 0; i < 8; i += 2)
+		sum += p[i] << 8 | p[i + 1];
+	p = (u8 *)&ip->tcp_src;
+	for (i = 0; i < tcp_len; i += 2)
+		sum += p[i] << 8 | (i + 1 < tcp_len ? p[i + 1] : 0);
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum & 0xffff;
+}
+
+/* Queue a segment from the server, as if received by the client */
+static void wget_test_send(struct udevice *dev, struct wget_test_server *srv,
+			   u8 flags, uint off, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uchar *pkt = priv->recv_packet_buffer[priv->recv_packets];
+	struct ethernet_hdr *eth = (struct ethernet_hdr *)pkt;
+	struct ip_tcp_hdr *ip = (void *)pkt + ETHER_HDR_SIZE;
+	uint hdr_len = TCP_HDR_SIZE;
+
+	if (flags & TCP_SYN) {
+		uchar *opt = (uchar *)ip + IP_TCP_HDR_SIZE;
+
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = TCP_OPT_MSS_LEN;
+		opt[2] = srv->mss >> 8;
+		opt[3] = srv->mss & 0xff;
+		hdr_len += TCP_OPT_MSS_LEN;
+	}
+	memcpy((uchar *)ip + IP_HDR_SIZE + hdr_len, srv->resp + off, len);
+
+	memcpy(eth->et_dest, srv->client_mac, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(PROT_IP);
+
+	ip->ip_hl_v = 0x45;
+	ip->ip_tos = 0;
+	ip->ip_len = htons(IP_HDR_SIZE + hdr_len + len);
+	ip->ip_id = 0;
+	ip->ip_off = 0;
+	ip->ip_ttl = 64;
+	ip->ip_p = IPPROTO_TCP;
+	ip->ip_sum = 0;
+	net_write_ip(&ip->ip_src, string_to_ip(WGET_TEST_SERVER));
+	net_copy_ip(&ip->ip_dst, &srv->client_ip);
+	ip->ip_sum = compute_ip_checksum(ip, IP_HDR_SIZE);
+
+	ip->tcp_src = htons(WGET_HTTP_PORT);
+	ip->tcp_dst = htons(srv->client_port);
+	ip->tcp_seq = htonl(WGET_TEST_ISS + (flags & TCP_SYN ? 0 : 1 + off));
+	ip->tcp_ack = htonl(srv->rcv_nxt);
+	ip->tcp_hlen = (hdr_len / 4) << 4;
+	ip->tcp_flags = flags;
+	ip->tcp_win = htons(8192);
+	ip->tcp_xsum = 0;
+	ip->tcp_urg = 0;
+	ip->tcp_xsum = htons(wget_test_csum(ip, hdr_len + len));
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE +
+		IP_HDR_SIZE + hdr_len + len;
+	priv->recv_packets++;
+}
+
+/* Send as much of the response as the client's window allows */
+static void wget_test_output(struct udevice *dev,
+			     struct wget_test_server *srv, uint wnd)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	while (srv->sent < srv->resp_len && priv->recv_packets < PKTBUFSRX &&
+	       srv->sent + srv->mss <= srv->acked + wnd) {
+		uint off = srv->sent;
+		uint len = min(srv->mss, srv->resp_len - off);
+		bool first = off >= srv->sent_max;
+
+		srv->sent += len;
+		srv->sent_max = max(srv->sent_max, srv->sent);
+		if (first && off && off == srv->drop)
+			continue;
+		if (first && off && off == srv->swap &&
+		    srv->sent < srv->resp_len &&
+		    priv->recv_packets < PKTBUFSRX - 1) {
+			uint next = min(srv->mss, srv->resp_len - srv->sent);
+
+			wget_test_send(dev, srv, TCP_ACK, srv->sent, next);
+			srv->sent += next;
+			srv->sent_max = max(srv->sent_max, srv->sent);
+			srv->segs++;
+		}
+		wget_test_send(dev, srv, TCP_ACK | TCP_PSH, off, len);
+		srv->segs++;
+	}
+
+	if (srv->sent == srv->resp_len && !srv->keep_open && !srv->fin_sent &&
+	    priv->recv_packets < PKTBUFSRX) {
+		wget_test_send(dev, srv, TCP_FIN | TCP_ACK, srv->resp_len, 0);
+		srv->fin_sent = true;
+	}
+}
+
+static int sb_wget_handler(struct udevice *dev, void *packet, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct wget_test_server *srv = priv->priv;
+	struct unit_test_state *uts = srv->uts;
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *ip = packet + ETHER_HDR_SIZE;
+	uint tcp_len, hdr_len, data_len;
+	u8 flags;
+	uint ack;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_TCP)
+		return 0;
+
+	tcp_len = ntohs(ip->ip_len) - IP_HDR_SIZE;
+	hdr_len = (ip->tcp_hlen >> 4) * 4;
+	data_len = tcp_len - hdr_len;
+	flags = ip->tcp_flags;
+	ut_asserteq(0, wget_test_csum(ip, tcp_len));
+	ut_asserteq(WGET_HTTP_PORT, ntohs(ip->tcp_dst));
+
+	if (flags & TCP_SYN) {
+		ut_asserteq(TCP_SYN, flags);
+		srv->client_ip = net_read_ip(&ip->ip_src);
+		memcpy(srv->client_mac, eth->et_src, ARP_HLEN);
+		srv->client_port = ntohs(ip->tcp_src);
+		srv->rcv_nxt = ntohl(ip->tcp_seq) + 1;
+		wget_test_send(dev, srv, srv->refuse ? TCP_RST | TCP_ACK :
+			       TCP_SYN | TCP_ACK, 0, 0);
+		return 0;
+	}
+	if (flags & TCP_RST) {
+		srv->resets++;
+		return 0;
+	}
+	ut_assert(flags & TCP_ACK);
+
+	if (data_len) {
+		/* The request is small enough to arrive in order */
+		ut_asserteq(srv->rcv_nxt, ntohl(ip->tcp_seq));
+		/* Keep the request nul-terminated */
+		ut_assert(srv->req_len + data_len < sizeof(srv->request));
+		memcpy(srv->request + srv->req_len,
+		       (uchar *)ip + IP_HDR_SIZE + hdr_len, data_len);
+		srv->req_len += data_len;
+		srv->rcv_nxt += data_len;
+	}
+	if (flags & TCP_FIN) {
+		srv->client_fin = true;
+		srv->rcv_nxt++;
+		wget_test_send(dev, srv, TCP_ACK, srv->sent_max +
+			       srv->fin_sent, 0);
+		return 0;
+	}
+
+	ack = ntohl(ip->tcp_ack) - WGET_TEST_ISS - 1;
+	srv->max_win = max(srv->max_win, (uint)ntohs(ip->tcp_win));
+	if (!data_len)
+		srv->acks++;
+	if (ack > srv->acked && ack <= srv->sent_max + 1) {
+		srv->acked = min(ack, srv->resp_len);
+		srv->in_recovery = false;
+	} else if (!data_len && ack == srv->acked &&
+		   srv->sent_max > srv->acked) {
+		/* Go back to the first missing segment, once */
+		srv->dup_acks++;
+		if (!srv->in_recovery)
+			srv->sent = srv->acked;
+		srv->in_recovery = true;
+	}
+
+	if (strstr(srv->request, "\r\n\r\n"))
+		wget_test_output(dev, srv, ntohs(ip->tcp_win));
+
+	return 0;
+}
+
+/* Build a response with the given head and body, chunked if needed */
+static uchar *wget_test_response(const char *head, const uchar *body,
+				 uint body_len, uint chunk, uint *lenp)
+{
+	uchar *resp = malloc(strlen(head) + body_len * 2 + 64);
+	uint len, off;
+
+	len = sprintf((char *)resp, "%s", head);
+	if (!chunk) {
+		memcpy(resp + len, body, body_len);
+		*lenp = len + body_len;
+		return resp;
+	}
+	for (off = 0; off < body_len; off += chunk) {
+		uint n = min(chunk, body_len - off);
+
+		len += sprintf((char *)resp + len, "%x;ext=1\r\n", n);
+		memcpy(resp + len, body + off, n);
+		len += n;
+		len += sprintf((char *)resp + len, "\r\n");
+	}
+	len += sprintf((char *)resp + len, "0\r\nX-Trailer: 1\r\n\r\n");
+	*lenp = len;
+
+	return resp;
+}
+
+/* Run wget against the server, returning the result of net_loop() */
+static int wget_test_run(struct unit_test_state *uts,
+			 struct wget_test_server *srv, const char *url)
+{
+	int ret;
+
+	srv->uts = uts;
+	if (!srv->mss)
+		srv->mss = TCP_MSS;
+	sandbox_eth_set_tx_handler(0, sb_wget_handler);
+	sandbox_eth_set_priv(0, srv);
+	env_set("ethact", "eth@10002000");
+	load_addr = WGET_TEST_ADDR;
+	copy_filename(net_boot_file_name, url, sizeof(net_boot_file_name));
+	ret = net_loop(WGET);
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return ret;
+}
+
+static u8 *wget_test_body(uint len)
+{
+	u8 *body = malloc(len);
+	uint i;
+
+	for (i = 0; i < len; i++)
+		body[i] = (i * 7) ^ (i >> 8);
+
+	return body;
+}
+
+/* Test a download into memory, with the length given by the server */
+static int dm_test_wget_length(struct unit_test_state *uts)
+{
+	const uint body_len = 100000;
+	struct wget_test_server srv;
+	u8 *body = wget_test_body(body_len);
+	char head[128];
+	uchar *resp;
+	uint resp_len;
+
+	snprintf(head, sizeof(head),
+		 "HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n", body_len);
+	resp = wget_test_response(head, body, body_len, 0, &resp_len);
+	memset(&srv, '\0', sizeof(srv));
+	srv.resp = resp;
+	srv.resp_len = resp_len;
+	srv.keep_open = true;
+	ut_asserteq(body_len, wget_test_run(uts, &srv, "http://"
+					    WGET_TEST_SERVER "/test.bin"));
+	ut_assertok(memcmp(map_sysmem(WGET_TEST_ADDR, body_len), body,
+			   body_len));
+
+	/* The request, then a close once the body has arrived */
+	ut_assert(!strncmp(srv.request, "GET /test.bin HTTP/1.1\r\n", 24));
+	ut_assertnonnull(strstr(srv.request, "Host: " WGET_TEST_SERVER
+				":80\r\n"));
+	ut_assert(srv.client_fin);
+	ut_asserteq(0, srv.resets);
+
+	/* An ACK for every segment, and the largest window we can offer */
+	ut_asserteq(0, srv.dup_acks);
+	ut_assert(srv.acks >= srv.segs);
+	ut_asserteq(0xffff, srv.max_win);
+
+	free(resp);
+	free(body);
+
+	return 0;
+}
+DM_TEST(dm_test_wget_length, DM_TESTF_SCAN_FDT);
+
+struct wget_test_buf {
+	u8 *buf;
+	uint len;
+};
+
+static int wget_test_consume(void *priv, const void *buf, size_t len)
+{
+	struct wget_test_buf *out = priv;
+
+	memcpy(out->buf + out->len, buf, len);
+	out->len += len;
+
+	return 0;
+}
+
+/* Test lost and reordered segments, and a chunked body to a consumer */
+static int dm_test_wget_faults(struct unit_test_state *uts)
+{
+	const char *head = "HTTP/1.1 200 OK\r\n"
+			   "Transfer-Encoding: chunked\r\n\r\n";
+	const uint body_len = 50000;
+	struct wget_test_server srv;
+	struct wget_test_buf out;
+	u8 *body = wget_test_body(body_len);
+	uchar *resp;
+	uint resp_len;
+
+	resp = wget_test_response(head, body, body_len, 777, &resp_len);
+	memset(&srv, '\0', sizeof(srv));
+	srv.resp = resp;
+	srv.resp_len = resp_len;
+	srv.mss = 1000;
+	srv.drop = 3000;
+	srv.swap = 10000;
+	out.buf = malloc(body_len);
+	out.len = 0;
+	wget_set_consumer(wget_test_consume, &out);
+	ut_asserteq(body_len, wget_test_run(uts, &srv, WGET_TEST_SERVER
+					    ":test.bin"));
+	ut_asserteq(body_len, out.len);
+	ut_assertok(memcmp(out.buf, body, body_len));
+	ut_assert(srv.dup_acks > 0);
+	ut_assert(srv.sent_max == resp_len);
+
+	/* The consumer was for that download only: this one goes to memory */
+	memset(&srv, '\0', sizeof(srv));
+	srv.resp = resp;
+	srv.resp_len = resp_len;
+	ut_asserteq(body_len, wget_test_run(uts, &srv, WGET_TEST_SERVER
+					    ":test.bin"));
+	ut_asserteq(body_len, out.len);
+	ut_assertok(memcmp(map_sysmem(WGET_TEST_ADDR, body_len), body,
+			   body_len));
+
+	free(out.buf);
+	free(resp);
+	free(body);
+
+	return 0;
+}
+DM_TEST(dm_test_wget_faults, DM_TESTF_SCAN_FDT);
+
+/* Test a body ended by the server closing, and failed downloads */
+static int dm_test_wget_close(struct unit_test_state *uts)
+{
+	const char *head = "HTTP/1.0 200 OK\r\nServer: test\r\n\r\n";
+	const uint body_len = 5000;
+	struct wget_test_server srv;
+	u8 *body = wget_test_body(body_len);
+	uchar *resp;
+	uint resp_len;
+
+	resp = wget_test_response(head, body, body_len, 0, &resp_len);
+	memset(&srv, '\0', sizeof(srv));
+	srv.resp = resp;
+	srv.resp_len = resp_len;
+	ut_asserteq(body_len, wget_test_run(uts, &srv, "http://"
+					    WGET_TEST_SERVER ":80/x"));
+	ut_assertok(memcmp(map_sysmem(WGET_TEST_ADDR, body_len), body,
+			   body_len));
+	ut_assert(srv.client_fin);
+	free(resp);
+
+	/* An error status fails, and resets the connection */
+	head = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+	memset(&srv, '\0', sizeof(srv));
+	srv.resp = (uchar *)head;
+	srv.resp_len = strlen(head);
+	srv.keep_open = true;
+	ut_assert(wget_test_run(uts, &srv, "http://" WGET_TEST_SERVER
+				"/missing") < 0);
+	ut_asserteq(1, srv.resets);
+
+	/* So does a refused connection */
+	memset(&srv, '\0', sizeof(srv));
+	srv.refuse = true;
+	ut_assert(wget_test_run(uts, &srv, "http://" WGET_TEST_SERVER
+				"/x") < 0);
+	ut_asserteq(0, srv.req_len);
+
+	free(body);
+
+	return 0;
+}
+DM_TEST(dm_test_wget_close, DM_TESTF_SCAN_FDT);
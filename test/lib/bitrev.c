@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for bit reversal functions
+ *
+ * bitrev8_buf() runs through different lines of code depending on the
+ * alignment and length of the buffer, so these are swept.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/bitrev.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Number of different alignment values */
+#define SWEEP 16
+/* Allow for reversing up to 32 bytes */
+#define BUFLEN (SWEEP + 33)
+/* Size of the buffer used to measure throughput */
+#define BENCH_LEN SZ_1M
+
+/* Reverse the bits of a byte one at a time, as a reference */
+static u8 slow_bitrev8(u8 x)
+{
+	u8 r = 0;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		r = (r << 1) | (x & 1);
+		x >>= 1;
+	}
+
+	return r;
+}
+
+static int lib_bitrev_words(struct unit_test_state *uts)
+{
+	int i;
+
+	for (i = 0; i < 256; i++)
+		ut_asserteq(slow_bitrev8(i), bitrev8(i));
+
+	ut_asserteq(0x2c48, bitrev16(0x1234));
+	ut_asserteq(0x1e6a2c48, bitrev32(0x12345678));
+	ut_asserteq(0x00000001, bitrev32(0x80000000));
+	ut_assert(bitrev64(0x0123456789abcdefULL) == 0xf7b3d591e6a2c480ULL);
+	ut_assert(bitrev64(0x8000000000000000ULL) == 0x1ULL);
+	ut_assert(bitrev8x8(0x0123456789abcdefULL) == 0x80c4a2e691d5b3f7ULL);
+
+	return 0;
+}
+
+LIB_TEST(lib_bitrev_words, 0);
+
+static int lib_bitrev8_buf(struct unit_test_state *uts)
+{
+	u8 buf[BUFLEN] __aligned(8);
+	int offset, len, i;
+
+	for (offset = 0; offset <= SWEEP; ++offset) {
+		for (len = 0; len < BUFLEN - SWEEP; ++len) {
+			for (i = 0; i < BUFLEN; ++i)
+				buf[i] = i * 37;
+
+			bitrev8_buf(buf + offset, len);
+
+			for (i = 0; i < BUFLEN; ++i) {
+				u8 expect = i * 37;
+
+				if (i >= offset && i < offset + len)
+					expect = slow_bitrev8(expect);
+				ut_asserteq(expect, buf[i]);
+			}
+		}
+	}
+
+	return 0;
+}
+
+LIB_TEST(lib_bitrev8_buf, 0);
+
+/* Report throughput of bitrev8_buf() against the one bit at a time loop */
+static int lib_bitrev8_buf_bench(struct unit_test_state *uts)
+{
+	unsigned long start, slow_us, fast_us;
+	u8 *buf;
+	int i;
+
+	buf = malloc(BENCH_LEN);
+	ut_assertnonnull(buf);
+
+	for (i = 0; i < BENCH_LEN; i++)
+		buf[i] = i;
+
+	start = timer_get_us();
+	for (i = 0; i < BENCH_LEN; i++)
+		buf[i] = slow_bitrev8(buf[i]);
+	slow_us = max(timer_get_us() - start, 1UL);
+
+	start = timer_get_us();
+	bitrev8_buf(buf, BENCH_LEN);
+	fast_us = max(timer_get_us() - start, 1UL);
+
+	/* Reversing twice restores the original data */
+	for (i = 0; i < BENCH_LEN; i++)
+		ut_asserteq((u8)i, buf[i]);
+
+	printf("bitrev8_buf: %lu MB/s, bit loop: %lu MB/s\n",
+	       BENCH_LEN / fast_us, BENCH_LEN / slow_us);
+	free(buf);
+
+	return 0;
+}
+
+LIB_TEST(lib_bitrev8_buf_bench, 0);
@@ -0,0 +1,71 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test the block cache: hits, sequential read-ahead and disabling it.
+
+import pytest
+import re
+
+def make_disk_image(u_boot_console):
+    """Create a 1 MiB disk image filled with a known pattern.
+
+    Args:
+        u_boot_console: A U-Boot console.
+
+    Returns:
+        The path of the image.
+    """
+
+    path = u_boot_console.config.result_dir + '/test_blkcache_disk_image.bin'
+    with open(path, 'wb') as fd:
+        for blk in range(2048):
+            fd.write(bytearray([blk & 0xff]) * 512)
+    return path
+
+def dev_stats(output):
+    """Parse the host 0 line of 'blkcache show'.
+
+    Args:
+        output: Output of the command.
+
+    Returns:
+        Tuple of hits, misses, blocks read ahead and read-ahead hits.
+    """
+
+    m = re.search(r'host 0: hits (\d+), misses (\d+), '
+                  r'read ahead (\d+) blocks, (\d+) hits', output)
+    assert m
+    return tuple(int(x) for x in m.groups())
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_block_cache')
+@pytest.mark.buildconfigspec('cmd_read')
+def test_blkcache(u_boot_console):
+    """Test block cache hits and read-ahead."""
+
+    path = make_disk_image(u_boot_console)
+    u_boot_console.run_command('host bind 0 ' + path)
+    u_boot_console.run_command('blkcache configure 8 64 4 32')
+    u_boot_console.run_command('blkcache show')
+
+    # Sequential single block reads: only a few miss, since read-ahead
+    # fetches the following blocks along with each miss.
+    for blk in range(64):
+        output = u_boot_console.run_command(
+            'read host 0 ${loadaddr} %x 1; echo rc=$?' % blk)
+        assert 'rc=0' in output
+    output = u_boot_console.run_command('md.b ${loadaddr} 4')
+    assert '3f 3f 3f 3f' in output
+    hits, misses, ahead, ahead_hits = dev_stats(
+        u_boot_console.run_command('blkcache show'))
+    assert misses < 8
+    assert hits + misses == 64
+    assert ahead > 0
+    assert ahead_hits > 0
+
+    # With the cache disabled every read goes to the device
+    u_boot_console.run_command('blkcache configure 8 0')
+    u_boot_console.run_command('read host 0 ${loadaddr} 0 1')
+    output = u_boot_console.run_command('blkcache show')
+    assert 'max cache entries: 0' in output
+    u_boot_console.run_command('blkcache configure 8 256 4 64')
+    u_boot_console.run_command('host bind 0')
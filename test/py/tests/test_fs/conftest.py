@@ -13,6 +13,8 @@ supported_fs_basic = ['fat16', 'fat32', 'ext4']
 supported_fs_ext = ['fat16', 'fat32']
 supported_fs_mkdir = ['fat16', 'fat32']
 supported_fs_unlink = ['fat16', 'fat32']
+supported_fs_perf = ['fat32', 'ext4']
+supported_squashfs_comp = ['gzip', 'lzma', 'lz4', 'zstd']
 
 #
 # Filesystem test specific setup
@@ -48,6 +50,8 @@ def pytest_configure(config):
     global supported_fs_ext
     global supported_fs_mkdir
     global supported_fs_unlink
+    global supported_fs_perf
+    global supported_squashfs_comp
 
     def intersect(listA, listB):
         return  [x for x in listA if x in listB]
@@ -59,6 +63,9 @@ def pytest_configure(config):
         supported_fs_ext =  intersect(supported_fs, supported_fs_ext)
         supported_fs_mkdir =  intersect(supported_fs, supported_fs_mkdir)
         supported_fs_unlink =  intersect(supported_fs, supported_fs_unlink)
+        supported_fs_perf =  intersect(supported_fs, supported_fs_perf)
+        if 'squashfs' not in supported_fs:
+            supported_squashfs_comp = []
 
 def pytest_generate_tests(metafunc):
     """Parametrize fixtures, fs_obj_xxx
@@ -84,6 +91,12 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_unlink' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_unlink', supported_fs_unlink,
             indirect=True, scope='module')
+    if 'fs_obj_perf' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_perf', supported_fs_perf,
+            indirect=True, scope='module')
+    if 'fs_obj_squashfs' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_squashfs', supported_squashfs_comp,
+            indirect=True, scope='module')
 
 #
 # Helper functions
@@ -523,3 +536,159 @@ def fs_obj_unlink(request, u_boot_config):
         call('rmdir %s' % mount_dir, shell=True)
         if fs_img:
             call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for read throughput test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_perf(request, u_boot_config):
+    """Set up a file system to be used in read throughput test.
+
+    Args:
+        request: Pytest request object.
+	u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for read throughput test, i.e. a triplet of file system
+        type, volume file name and a dictionary of file names and their
+        MD5 hashes.
+    """
+    fs_type = request.param
+    fs_img = ''
+
+    fs_ubtype = fstype_to_ubname(fs_type)
+    check_ubconfig(u_boot_config, fs_ubtype)
+
+    mount_dir = u_boot_config.persistent_data_dir + '/mnt'
+
+    try:
+
+        # 256MiB volume
+        fs_img = mk_fs(u_boot_config, fs_type, 0x10000000, '256MB')
+
+        # Mount the image so we can populate it.
+        check_call('mkdir -p %s' % mount_dir, shell=True)
+        mount_fs(fs_type, fs_img, mount_dir)
+
+        # A file laid out in one piece
+        check_call('dd if=/dev/urandom of=%s/%s bs=1M count=%d'
+            % (mount_dir, PERF_CONT_FILE, PERF_FILE_MB), shell=True)
+        call('sync')
+
+        # Fill the volume up with small files and delete every other one,
+        # so that the next file is spread over the holes left behind.
+        check_call('mkdir %s/fill' % mount_dir, shell=True)
+        nfill = 0
+        while nfill < PERF_FILL_FILES:
+            if call('dd if=/dev/zero of=%s/fill/%04d bs=256K count=1 '
+                    '2> /dev/null' % (mount_dir, nfill), shell=True):
+                break
+            nfill += 1
+        call('sync')
+        for i in range(0, nfill, 2):
+            check_call('rm %s/fill/%04d' % (mount_dir, i), shell=True)
+        call('sync')
+
+        check_call('dd if=/dev/urandom of=%s/%s bs=1M count=%d'
+            % (mount_dir, PERF_FRAG_FILE, PERF_FILE_MB), shell=True)
+
+        md5val = {}
+        for name in [PERF_CONT_FILE, PERF_FRAG_FILE]:
+            out = check_output('md5sum %s/%s' % (mount_dir, name),
+                shell=True)
+            md5val[name] = out.split()[0]
+
+        umount_fs(mount_dir)
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ' + fs_type)
+        return
+    else:
+        yield [fs_ubtype, fs_img, md5val]
+    finally:
+        umount_fs(mount_dir)
+        call('rmdir %s' % mount_dir, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for SquashFS test
+#
+# NOTE: yield_fixture was deprecated since pytest-3.0
+@pytest.yield_fixture()
+def fs_obj_squashfs(request, u_boot_config):
+    """Set up a SquashFS image to be used in SquashFS test.
+
+    SquashFS is read-only, so the files are created in a directory which
+    mksquashfs then turns into an image compressed with the parametrized
+    compressor.
+
+    Args:
+        request: Pytest request object.
+	u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for SquashFS test, i.e. a duplet of volume file name and
+        a dictionary of file names and their MD5 hashes.
+    """
+    comp = request.param
+    fs_img = ''
+
+    if not u_boot_config.buildconfig.get('config_fs_squashfs', None):
+        pytest.skip('.config feature "FS_SQUASHFS" not enabled')
+    # gzip is always built in
+    if comp != 'gzip' and not u_boot_config.buildconfig.get(
+            'config_%s' % comp, None):
+        pytest.skip('.config feature "%s" not enabled' % comp.upper())
+
+    src_dir = u_boot_config.persistent_data_dir + '/squashfs'
+
+    try:
+        check_call('rm -rf %s' % src_dir, shell=True)
+        check_call('mkdir -p %s/SUBDIR' % src_dir, shell=True)
+
+        # Random data, which is stored uncompressed.
+        check_call('dd if=/dev/urandom of=%s/%s bs=1M count=1'
+            % (src_dir, SMALL_FILE), shell=True)
+
+        # Text, which compresses well and whose tail goes in a fragment.
+        check_call('seq 1 4000 > %s/%s' % (src_dir, MIN_FILE), shell=True)
+
+        # A sparse file, with data only in its first and last MB.
+        check_call('dd if=/dev/urandom of=%s/%s bs=1M count=1'
+            % (src_dir, SQFS_SPARSE_FILE), shell=True)
+        check_call('dd if=/dev/urandom of=%s/%s bs=1M count=1 seek=7'
+            % (src_dir, SQFS_SPARSE_FILE), shell=True)
+
+        check_call('ln -s ../%s %s/SUBDIR/link' % (SMALL_FILE, src_dir),
+            shell=True)
+        check_call('gzip -c %s/%s > %s/%s'
+            % (src_dir, SMALL_FILE, src_dir, SQFS_GZ_FILE), shell=True)
+
+        md5val = {}
+        for name in [SMALL_FILE, MIN_FILE, SQFS_SPARSE_FILE]:
+            out = check_output('md5sum %s/%s' % (src_dir, name), shell=True)
+            md5val[name] = out.split()[0]
+        out = check_output(
+            'dd if=%s/%s bs=1K skip=100 count=10 2> /dev/null | md5sum'
+            % (src_dir, SMALL_FILE), shell=True)
+        md5val['offset'] = out.split()[0]
+        # For hash -f, which has no md5
+        out = check_output('sha256sum %s/%s' % (src_dir, SQFS_SPARSE_FILE),
+            shell=True)
+        md5val['sha256'] = out.split()[0]
+
+        fs_img = '%s/squashfs.%s.img' % (u_boot_config.persistent_data_dir,
+            comp)
+        check_call('rm -f %s' % fs_img, shell=True)
+        check_call('mksquashfs %s %s -comp %s -all-root -no-progress'
+            % (src_dir, fs_img, comp), shell=True)
+    except CalledProcessError:
+        pytest.skip('Setup failed for SquashFS with ' + comp)
+        return
+    else:
+        yield [fs_img, md5val]
+    finally:
+        call('rm -rf %s' % src_dir, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
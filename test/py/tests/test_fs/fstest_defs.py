@@ -9,5 +9,20 @@ SMALL_FILE='1MB.file'
 # $BIG_FILE is the name of the 2.5GB file in the file system image
 BIG_FILE='2.5GB.file'
 
+# $PERF_CONT_FILE and $PERF_FRAG_FILE are the names of the files read by the
+# throughput test, laid out in one piece and spread over many holes
+PERF_CONT_FILE='contiguous.file'
+PERF_FRAG_FILE='fragmented.file'
+PERF_FILE_MB=48
+PERF_FILL_FILES=1024
+# size of the pieces the fragmented file is read in, as streaming loaders do
+PERF_PIECE_MB=4
+
+# $SQFS_SPARSE_FILE is the name of the 8MB file with a hole in its middle in
+# the SquashFS image
+SQFS_SPARSE_FILE='sparse.file'
+# and a gzip'd copy of SMALL_FILE, for unzip -f
+SQFS_GZ_FILE='1MB.file.gz'
+
 ADDR=0x01000008
 LENGTH=0x00100000
@@ -0,0 +1,104 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:Read Throughput Test
+
+"""
+This test measures how fast whole files are read from a file system, both
+for a file laid out in one piece and for a fragmented one, and how fast the
+fragmented one is read in pieces. The throughput is written to the log, so
+that it can be compared between builds.
+"""
+
+import pytest
+import re
+from fstest_defs import *
+
+def load_file(u_boot_console, fs_type, fs_img, name):
+    """Load a file and return its MD5 hash and the read throughput.
+
+    Args:
+        u_boot_console: A U-Boot console connection.
+        fs_type: File system type.
+        fs_img: Volume file name.
+        name: Name of the file to load.
+
+    Return:
+        A duplet of the output of md5sum and the throughput in MiB/s.
+    """
+    output = u_boot_console.run_command_list([
+        'host bind 0 %s' % fs_img,
+        'time %sload host 0:0 %x /%s' % (fs_type, ADDR, name),
+        'md5sum %x $filesize' % ADDR,
+        'setenv filesize'])
+    output = ''.join(output)
+
+    m = re.search('time: ([0-9]+)\.([0-9]+) seconds', output)
+    assert(m)
+    secs = int(m.group(1)) + int(m.group(2)) / 1000.0
+    rate = PERF_FILE_MB / max(secs, 0.001)
+    u_boot_console.log.info('%s %s: %.3f s, %.1f MiB/s'
+        % (fs_type, name, secs, rate))
+
+    return output, rate
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_time')
+@pytest.mark.slow
+class TestFsPerf(object):
+    def test_fs_perf1(self, u_boot_console, fs_obj_perf):
+        """
+        Test Case 1 - read a contiguous file
+        """
+        fs_type,fs_img,md5val = fs_obj_perf
+        with u_boot_console.log.section('Test Case 1 - read (contiguous)'):
+            output, rate = load_file(u_boot_console, fs_type, fs_img,
+                PERF_CONT_FILE)
+            assert(md5val[PERF_CONT_FILE] in output)
+
+    def test_fs_perf2(self, u_boot_console, fs_obj_perf):
+        """
+        Test Case 2 - read a fragmented file
+        """
+        fs_type,fs_img,md5val = fs_obj_perf
+        with u_boot_console.log.section('Test Case 2 - read (fragmented)'):
+            output, rate = load_file(u_boot_console, fs_type, fs_img,
+                PERF_FRAG_FILE)
+            assert(md5val[PERF_FRAG_FILE] in output)
+
+    def test_fs_perf3(self, u_boot_console, fs_obj_perf):
+        """
+        Test Case 3 - read a fragmented file again, from the caches
+        """
+        fs_type,fs_img,md5val = fs_obj_perf
+        with u_boot_console.log.section('Test Case 3 - read (again)'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, PERF_FRAG_FILE),
+                'time %sload host 0:0 %x /%s' % (fs_type, ADDR,
+                    PERF_FRAG_FILE),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[PERF_FRAG_FILE] in ''.join(output))
+
+    def test_fs_perf4(self, u_boot_console, fs_obj_perf):
+        """
+        Test Case 4 - read a fragmented file piece by piece
+        """
+        fs_type,fs_img,md5val = fs_obj_perf
+        with u_boot_console.log.section('Test Case 4 - read (pieces)'):
+            piece = PERF_PIECE_MB << 20
+            cmds = ['host bind 0 %s' % fs_img]
+            for pos in range(0, PERF_FILE_MB << 20, piece):
+                cmds.append('time %sload host 0:0 %x /%s %x %x'
+                    % (fs_type, ADDR + pos, PERF_FRAG_FILE, piece, pos))
+            cmds.append('md5sum %x %x' % (ADDR, PERF_FILE_MB << 20))
+            output = ''.join(u_boot_console.run_command_list(cmds))
+
+            secs = 0.0
+            for m in re.finditer('time: ([0-9]+)\.([0-9]+) seconds', output):
+                secs += int(m.group(1)) + int(m.group(2)) / 1000.0
+            rate = PERF_FILE_MB / max(secs, 0.001)
+            u_boot_console.log.info('%s %s in %d MiB pieces: %.3f s, '
+                '%.1f MiB/s' % (fs_type, PERF_FRAG_FILE, PERF_PIECE_MB, secs,
+                rate))
+            assert(md5val[PERF_FRAG_FILE] in output)
@@ -0,0 +1,129 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:SquashFS Test
+
+"""
+This test verifies that files are listed and read correctly from SquashFS
+images made with each supported compressor, through the generic ls, size
+and load commands, and through the streamed reads of hash -f and unzip -f.
+"""
+
+import pytest
+import re
+from fstest_defs import *
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('fs_squashfs')
+class TestSquashfs(object):
+    def test_sqfs1(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 1 - ls command, listing the root and a missing directory
+        """
+        fs_img,md5val = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 1a - ls'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'ls host 0:0'])
+            assert(re.search('1048576 *%s' % SMALL_FILE, ''.join(output)))
+            assert(re.search('8388608 *%s' % SQFS_SPARSE_FILE,
+                ''.join(output)))
+            assert(re.search('SUBDIR/', ''.join(output)))
+
+        with u_boot_console.log.section('Test Case 1b - ls (invalid dir)'):
+            output = u_boot_console.run_command('ls host 0:0 invalid_d')
+            assert('' == output)
+
+    def test_sqfs2(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 2 - size command, directly and through '..'
+        """
+        fs_img,md5val = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 2 - size'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'size host 0:0 /%s' % SMALL_FILE,
+                'printenv filesize',
+                'size host 0:0 /SUBDIR/../%s' % SQFS_SPARSE_FILE,
+                'printenv filesize',
+                'setenv filesize'])
+            assert('filesize=100000' in ''.join(output))
+            assert('filesize=800000' in ''.join(output))
+
+    def test_sqfs3(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 3 - load whole files
+        """
+        fs_img,md5val = fs_obj_squashfs
+        for name in [SMALL_FILE, MIN_FILE, SQFS_SPARSE_FILE]:
+            with u_boot_console.log.section('Test Case 3 - load %s' % name):
+                output = u_boot_console.run_command_list([
+                    'host bind 0 %s' % fs_img,
+                    'load host 0:0 %x /%s' % (ADDR, name),
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                assert(md5val[name] in ''.join(output))
+
+    def test_sqfs4(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 4 - load part of a file, and a file through a symlink
+        """
+        fs_img,md5val = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 4a - load (offset)'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s 0x2800 0x19000'
+                    % (ADDR, SMALL_FILE),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val['offset'] in ''.join(output))
+
+        with u_boot_console.log.section('Test Case 4b - load (symlink)'):
+            output = u_boot_console.run_command_list([
+                'load host 0:0 %x /SUBDIR/link' % ADDR,
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[SMALL_FILE] in ''.join(output))
+
+    def test_sqfs5(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 5 - load a missing file
+        """
+        fs_img,md5val = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 5 - load (missing)'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /missing.file' % ADDR])
+            assert('File not found' in ''.join(output))
+
+    @pytest.mark.buildconfigspec('cmd_hash')
+    @pytest.mark.buildconfigspec('sha256')
+    def test_sqfs6(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 6 - hash a file as it is read, over several chunks
+        """
+        fs_img,md5val = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 6a - hash -f'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'hash -f sha256 host 0:0 /%s' % SQFS_SPARSE_FILE])
+            assert(md5val['sha256'] in ''.join(output))
+
+        with u_boot_console.log.section('Test Case 6b - hash -f (missing)'):
+            output = u_boot_console.run_command(
+                'hash -f sha256 host 0:0 /missing.file')
+            assert('Unable to hash' in output)
+
+    @pytest.mark.buildconfigspec('cmd_unzip')
+    def test_sqfs7(self, u_boot_console, fs_obj_squashfs):
+        """
+        Test Case 7 - unzip a gzip'd file as it is read
+        """
+        fs_img,md5val = fs_obj_squashfs
+        with u_boot_console.log.section('Test Case 7 - unzip -f'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'unzip -f host 0:0 /%s %x' % (SQFS_GZ_FILE, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert('Uncompressed size: 1048576' in ''.join(output))
+            assert(md5val[SMALL_FILE] in ''.join(output))
@@ -0,0 +1,187 @@
+# SPDX-License-Identifier: GPL-2.0+
+
+# Test TFTP downloads against a local server, over sandbox's raw Ethernet
+# driver bound to the host's loopback interface. Opening the raw socket needs
+# CAP_NET_RAW, so the test is skipped when not running as root.
+
+import os
+import pytest
+import socket
+import struct
+import threading
+import zlib
+
+TFTP_RRQ = 1
+TFTP_DATA = 3
+TFTP_ACK = 4
+TFTP_OACK = 6
+
+class TftpServer(threading.Thread):
+    """A TFTP server for a single file, supporting RFC 7440 windows.
+
+    Faults may be injected to check how the client copes with them: each
+    block in 'drop' is not sent the first time, each block in 'swap' is sent
+    the first time after the following one, and each block in 'dup' is sent
+    twice the first time.
+    """
+
+    def __init__(self, data):
+        super(TftpServer, self).__init__()
+        self.daemon = True
+        self.data = data
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(('127.0.0.1', 0))
+        self.sock.settimeout(0.2)
+        self.port = self.sock.getsockname()[1]
+        self.running = True
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self, drop=(), swap=(), dup=()):
+        """Clear the statistics and set the faults for the next transfer."""
+        self.wait()
+        self.drop = set(drop)
+        self.swap = set(swap)
+        self.dup = set(dup)
+        self.window = None
+        self.acks = 0
+        self.sent = 0
+
+    def wait(self):
+        """Wait until the server has seen the end of a transfer."""
+        with self.lock:
+            pass
+
+    def stop(self):
+        self.running = False
+        self.join()
+        self.sock.close()
+
+    def run(self):
+        while self.running:
+            try:
+                pkt, peer = self.sock.recvfrom(2048)
+            except socket.timeout:
+                continue
+            if struct.unpack('>H', pkt[:2])[0] == TFTP_RRQ:
+                with self.lock:
+                    self.transfer(pkt[2:], peer)
+
+    def send_window(self, xfer, peer, first, last, blksize):
+        blocks = list(range(first, last + 1))
+        for i in range(len(blocks) - 1):
+            if blocks[i] in self.swap:
+                self.swap.discard(blocks[i])
+                blocks[i], blocks[i + 1] = blocks[i + 1], blocks[i]
+        for blk in blocks:
+            if blk in self.drop:
+                self.drop.discard(blk)
+                continue
+            count = 1
+            if blk in self.dup:
+                self.dup.discard(blk)
+                count = 2
+            chunk = self.data[(blk - 1) * blksize:blk * blksize]
+            for _ in range(count):
+                xfer.sendto(struct.pack('>HH', TFTP_DATA, blk & 0xffff) +
+                            chunk, peer)
+                self.sent += 1
+
+    def transfer(self, req, peer):
+        fields = req.split(b'\0')
+        opts = dict(zip([f.lower() for f in fields[2:-1:2]], fields[3::2]))
+        blksize = int(opts.get(b'blksize', 512))
+        self.window = int(opts.get(b'windowsize', 1))
+        reply = [(k, v) for k, v in opts.items()
+                 if k in (b'blksize', b'windowsize', b'timeout')]
+        if b'tsize' in opts:
+            reply.append((b'tsize', str(len(self.data)).encode()))
+        oack = struct.pack('>H', TFTP_OACK)
+        for k, v in reply:
+            oack += k + b'\0' + v + b'\0'
+
+        xfer = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        xfer.bind(('127.0.0.1', 0))
+        xfer.settimeout(1)
+        nblocks = len(self.data) // blksize + 1
+        acked = -1
+        retries = 0
+        while acked < nblocks and retries < 10:
+            if acked < 0:
+                xfer.sendto(oack, peer)
+            else:
+                self.send_window(xfer, peer, acked + 1,
+                                 min(acked + self.window, nblocks), blksize)
+            try:
+                pkt = xfer.recv(2048)
+            except socket.timeout:
+                retries += 1
+                continue
+            op, blk = struct.unpack('>HH', pkt[:4])
+            if op != TFTP_ACK:
+                break
+            self.acks += 1
+            base = max(acked, 0)
+            blk = base + ((blk - base) & 0xffff)
+            if blk <= base + self.window:
+                acked = blk
+        xfer.close()
+
+@pytest.fixture(scope='module')
+def tftp_server(u_boot_console):
+    if os.geteuid():
+        pytest.skip('Raw sockets need CAP_NET_RAW')
+    data = os.urandom(3 * 1024 * 1024 + 123)
+    server = TftpServer(data)
+    server.start()
+    u_boot_console.run_command('setenv ethact host_lo')
+    u_boot_console.run_command('setenv tftpdstp %d' % server.port)
+    yield server
+    u_boot_console.run_command('setenv ethact')
+    u_boot_console.run_command('setenv tftpdstp')
+    u_boot_console.run_command('setenv tftpwindowsize')
+    server.stop()
+
+def tftp_get(u_boot_console, server, window):
+    """Download the file served with a given window size and check it.
+
+    Returns:
+        The number of data packets the server sent.
+    """
+
+    u_boot_console.run_command('setenv tftpwindowsize %d' % window)
+    output = u_boot_console.run_command('tftpboot ${loadaddr} test.bin')
+    assert 'Bytes transferred = %d' % len(server.data) in output
+    output = u_boot_console.run_command('crc32 ${fileaddr} ${filesize}')
+    assert '%08x' % (zlib.crc32(server.data) & 0xffffffff) in output
+    server.wait()
+    assert server.window == window
+    return server.sent
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_tftpboot')
+@pytest.mark.buildconfigspec('cmd_crc32')
+def test_tftp_window(u_boot_console, tftp_server):
+    """Test that a window of blocks is acknowledged at once."""
+
+    tftp_server.reset()
+    blocks = tftp_get(u_boot_console, tftp_server, 1)
+    assert tftp_server.acks == blocks + 1
+
+    tftp_server.reset()
+    assert tftp_get(u_boot_console, tftp_server, 16) == blocks
+    assert tftp_server.acks <= blocks // 16 + 2
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_tftpboot')
+@pytest.mark.buildconfigspec('cmd_crc32')
+def test_tftp_window_faults(u_boot_console, tftp_server):
+    """Test windowed downloads with lost, reordered and repeated blocks."""
+
+    tftp_server.reset(drop=(5, 100, 101, 1000), swap=(1, 40, 47, 500),
+                      dup=(3, 64, 800))
+    tftp_get(u_boot_console, tftp_server, 8)
+
+    # A window ending with a lost block is only sent again after a timeout
+    tftp_server.reset(drop=(16,))
+    tftp_get(u_boot_console, tftp_server, 8)